@@ -10,6 +10,21 @@
 
 #include "Buffer.h"
 #include "Util/onceToken.h"
+#include "Util/logger.h"
+
+#if defined(__linux__) || defined(__linux)
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#define HAS_SENDMMSG
+
+#if !defined(SOL_UDP)
+#define SOL_UDP 17
+#endif
+
+#if !defined(UDP_SEGMENT)
+#define UDP_SEGMENT 103
+#endif
+#endif // defined(__linux__) || defined(__linux)
 
 namespace toolkit {
 
@@ -39,7 +54,7 @@ bool BufferList::empty() {
 }
 
 size_t BufferList::count(){
-    return _iovec.size() - _iovec_off;
+    return _pkt_list.size();
 }
 
 #if defined(_WIN32)
@@ -87,9 +102,11 @@ ssize_t BufferList::send_l(int fd, int flags,bool udp) {
             msg.msg_namelen = ptr ? ptr->_addr_len : 0;
         }
 
+        size_t bytes;
         msg.msg_iov = &(_iovec[_iovec_off]);
         msg.msg_iovlen = (decltype(msg.msg_iovlen)) (_iovec.size() - _iovec_off);
-        size_t max = udp ? 1 : IOV_MAX;
+        //udp每次发送一个数据报，即一个缓存的全部内存片段
+        size_t max = udp ? getIovecCount(_iovec_off, bytes) : IOV_MAX;
         if (msg.msg_iovlen > max) {
             msg.msg_iovlen = max;
         }
@@ -98,14 +115,19 @@ ssize_t BufferList::send_l(int fd, int flags,bool udp) {
         msg.msg_flags = flags;
         n = sendmsg(fd, &msg, flags);
     } while (-1 == n && UV_EINTR == get_uv_error(true));
+    ++_syscalls;
+    onSent(n);
+    return n;
+}
 
+void BufferList::onSent(ssize_t n) {
     if (n >= (ssize_t) _remain_size) {
         //全部写完了
         _iovec_off = _iovec.size();
         _remain_size = 0;
         if (!_cb) {
             _pkt_list.clear();
-            return n;
+            return;
         }
 
         //全部发送成功回调
@@ -113,22 +135,138 @@ ssize_t BufferList::send_l(int fd, int flags,bool udp) {
             _cb(_pkt_list.front().first, true);
             _pkt_list.pop_front();
         }
-        return n;
+        return;
     }
 
     if (n > 0) {
         //部分发送成功
         reOffset(n);
-        return n;
     }
-
     //一个字节都未发送
-    return n;
 }
 
-ssize_t BufferList::send(int fd, int flags, bool udp) {
+#if defined(HAS_SENDMMSG)
+//单次sendmmsg最多发送的报文个数
+#define MAX_MMSG_COUNT 64
+//单个GSO报文最多合并的数据报个数(内核UDP_MAX_SEGMENTS)
+#define MAX_GSO_SEGMENTS 64
+//单个udp报文最大负载
+#define MAX_UDP_PAYLOAD 65507
+//只合并不超过以太网MTU的数据报，超过路径MTU时内核会返回EINVAL
+#define MAX_GSO_SEG_SIZE 1472
+
+static bool isSameAddr(const struct sockaddr *addr_a, int len_a, const struct sockaddr *addr_b, int len_b) {
+    if (!addr_a || !addr_b) {
+        return addr_a == addr_b;
+    }
+    return len_a == len_b && 0 == memcmp(addr_a, addr_b, len_a);
+}
+
+ssize_t BufferList::sendmmsg_l(int fd, int flags, UdpSendMode &udp_mode) {
+    struct mmsghdr msgs[MAX_MMSG_COUNT];
+    char controls[MAX_MMSG_COUNT][CMSG_SPACE(sizeof(uint16_t))];
+    size_t bytes[MAX_MMSG_COUNT];
+
+    while (true) {
+        //udp不存在部分发送，所以_pkt_list头部与_iovec_off一一对应
+        auto it = _pkt_list.begin();
+        auto i = _iovec_off;
+        unsigned int count = 0;
+        while (i < _iovec.size() && count < MAX_MMSG_COUNT) {
+            auto ptr = getBufferSockPtr(*it);
+            auto addr = ptr ? ptr->_addr : nullptr;
+            auto addr_len = ptr ? ptr->_addr_len : 0;
+            auto &msg = msgs[count].msg_hdr;
+            size_t seg_size;
+            msg.msg_name = addr;
+            msg.msg_namelen = addr_len;
+            msg.msg_iov = &(_iovec[i]);
+            msg.msg_iovlen = getIovecCount(i, seg_size);
+            msg.msg_control = nullptr;
+            msg.msg_controllen = 0;
+            msg.msg_flags = 0;
+            auto total = seg_size;
+            size_t segments = 1;
+            i += msg.msg_iovlen;
+            ++it;
+
+            if (udp_mode == UdpSend_Gso && seg_size && seg_size <= MAX_GSO_SEG_SIZE) {
+                //合并后续目标地址相同、长度相同的数据报，只有最后一个可以更短；
+                //内核按字节数切分，所以每个数据报由几个内存片段组成并不影响合并
+                while (i < _iovec.size() && segments < MAX_GSO_SEGMENTS) {
+                    auto next = getBufferSockPtr(*it);
+                    size_t len;
+                    auto iov_count = getIovecCount(i, len);
+                    if (len > seg_size || total + len > MAX_UDP_PAYLOAD ||
+                        !isSameAddr(addr, addr_len, next ? next->_addr : nullptr, next ? next->_addr_len : 0)) {
+                        break;
+                    }
+                    total += len;
+                    msg.msg_iovlen += iov_count;
+                    i += iov_count;
+                    ++it;
+                    ++segments;
+                    if (len < seg_size) {
+                        break;
+                    }
+                }
+                if (segments > 1) {
+                    //告知内核按seg_size切分成多个数据报
+                    msg.msg_control = controls[count];
+                    msg.msg_controllen = CMSG_SPACE(sizeof(uint16_t));
+                    auto cmsg = CMSG_FIRSTHDR(&msg);
+                    cmsg->cmsg_level = SOL_UDP;
+                    cmsg->cmsg_type = UDP_SEGMENT;
+                    cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+                    *((uint16_t *) CMSG_DATA(cmsg)) = (uint16_t) seg_size;
+                }
+            }
+            bytes[count++] = total;
+        }
+
+        int n;
+        do {
+            n = sendmmsg(fd, msgs, count, flags);
+        } while (-1 == n && UV_EINTR == get_uv_error(true));
+        ++_syscalls;
+
+        if (n == -1) {
+            auto err = get_uv_error(false);
+            if (udp_mode == UdpSend_Gso && (err == UV_EIO || err == UV_EINVAL || err == UV_ENOTSUP)) {
+                //网卡或协议栈不支持GSO，降级为sendmmsg后重试
+                WarnL << "udp gso send failed, fallback to sendmmsg:" << get_uv_errmsg(false);
+                udp_mode = UdpSend_Mmsg;
+                continue;
+            }
+            if (err == UV_ENOSYS) {
+                //系统不支持sendmmsg，降级为逐个发送
+                udp_mode = UdpSend_Single;
+            }
+            return -1;
+        }
+
+        ssize_t sent = 0;
+        for (int j = 0; j < n; ++j) {
+            sent += bytes[j];
+        }
+        onSent(sent);
+        return sent;
+    }
+}
+#endif // defined(HAS_SENDMMSG)
+
+ssize_t BufferList::send(int fd, int flags, bool udp, UdpSendMode *udp_mode) {
     auto remainSize = _remain_size;
+#if defined(HAS_SENDMMSG)
+    if (udp && udp_mode && *udp_mode > UdpSend_Single) {
+        while (_remain_size && sendmmsg_l(fd, flags, *udp_mode) != -1);
+    }
+    if (_remain_size && (!udp || !udp_mode || *udp_mode <= UdpSend_Single)) {
+        while (_remain_size && send_l(fd, flags, udp) != -1);
+    }
+#else
     while (_remain_size && send_l(fd, flags, udp) != -1);
+#endif // defined(HAS_SENDMMSG)
 
     ssize_t sent = remainSize - _remain_size;
     if (sent > 0) {
@@ -161,6 +299,10 @@ void BufferList::reOffset(size_t n) {
 
     //删除已经发送的数据，节省内存
     for (auto i = last_off; i < _iovec_off; ++i) {
+        if (!_iovec_tail[i]) {
+            //该缓存还有内存片段未发送完毕
+            continue;
+        }
         if (_cb) {
             //发送成功回调
             _cb(_pkt_list.front().first, true);
@@ -169,14 +311,40 @@ void BufferList::reOffset(size_t n) {
     }
 }
 
-BufferList::BufferList(List<std::pair<Buffer::Ptr, bool> > &list, SendResult cb) : _iovec(list.size()), _cb(std::move(cb)) {
+size_t BufferList::getSendSyscalls() const {
+    return _syscalls;
+}
+
+size_t BufferList::getIovecCount(size_t index, size_t &bytes) const {
+    bytes = 0;
+    for (auto i = index; i < _iovec.size(); ++i) {
+        bytes += _iovec[i].iov_len;
+        if (_iovec_tail[i]) {
+            return i + 1 - index;
+        }
+    }
+    return _iovec.size() - index;
+}
+
+BufferList::BufferList(List<std::pair<Buffer::Ptr, bool> > &list, SendResult cb) : _cb(std::move(cb)) {
     _pkt_list.swap(list);
-    auto it = _iovec.begin();
+    _iovec.reserve(_pkt_list.size());
+    _iovec_tail.reserve(_pkt_list.size());
     _pkt_list.for_each([&](std::pair<Buffer::Ptr, bool> &pr) {
-        it->iov_base = pr.first->data();
-        it->iov_len = (decltype(it->iov_len)) pr.first->size();
-        _remain_size += it->iov_len;
-        ++it;
+        struct iovec iov[Buffer::kMaxIovecCount];
+#if defined(_WIN32)
+        //windows下模拟的sendmsg逐个iovec发送，udp数据报不能拆分，所以使用连续内存
+        iov[0].iov_base = pr.first->data();
+        iov[0].iov_len = (decltype(iov[0].iov_len)) pr.first->size();
+        size_t count = 1;
+#else
+        auto count = pr.first->getIovec(iov);
+#endif
+        for (size_t i = 0; i < count; ++i) {
+            _remain_size += iov[i].iov_len;
+            _iovec.emplace_back(iov[i]);
+            _iovec_tail.emplace_back(i + 1 == count);
+        }
     });
 }
 
@@ -216,4 +384,8 @@ size_t BufferSock::size() const {
     return _buffer->size();
 }
 
+size_t BufferSock::getIovec(struct iovec *iov) const {
+    return _buffer->getIovec(iov);
+}
+
 }//namespace toolkit
\ No newline at end of file
@@ -25,11 +25,35 @@
 #include "Util/List.h"
 #include "Util/uv_errno.h"
 #include "Util/ResourcePool.h"
+#include "Util/BufferPool.h"
 #include "Network/sockutil.h"
 using namespace std;
 
 namespace toolkit {
 
+#if defined(_WIN32)
+struct iovec {
+    void *   iov_base;	/* [XSI] Base address of I/O memory region */
+    size_t	 iov_len;	/* [XSI] Size of region iov_base points to */
+};
+struct msghdr {
+    void		*msg_name;	/* [XSI] optional address */
+    size_t  	msg_namelen;	/* [XSI] size of address */
+    struct		iovec *msg_iov;	/* [XSI] scatter/gather array */
+    size_t 		msg_iovlen;	/* [XSI] # elements in msg_iov */
+    void		*msg_control;	/* [XSI] ancillary data, see below */
+    int			msg_controllen;	/* [XSI] ancillary data buffer len */
+    int			msg_flags;	/* [XSI] flags on received message */
+};
+#else
+#include <sys/uio.h>
+#include <limits.h>
+#endif
+
+#if !defined(IOV_MAX)
+#define IOV_MAX 1024
+#endif
+
 template <typename T> struct is_pointer : public std::false_type {};
 template <typename T> struct is_pointer<shared_ptr<T> > : public std::true_type {};
 template <typename T> struct is_pointer<shared_ptr<T const> > : public std::true_type {};
@@ -54,6 +78,34 @@ public:
         return size();
     }
 
+    enum {
+        //单个缓存最多由几个内存片段组成
+        kMaxIovecCount = 4
+    };
+
+    /**
+     * 获取组成本缓存的内存片段，发送时每个片段对应一个iovec
+     * 默认为一整块连续内存；头部与负载分离的缓存(例如负载引用帧数据的rtp包)可以重载之，
+     * 这样可以通过writev/sendmsg分散聚集发送，免去拼接拷贝
+     * @param iov 存放内存片段，长度至少为kMaxIovecCount
+     * @return 片段个数
+     */
+    virtual size_t getIovec(struct iovec *iov) const {
+        iov->iov_base = data();
+        iov->iov_len = (decltype(iov->iov_len)) size();
+        return 1;
+    }
+
+    //Buffer对象(包括rtp、rtmp包与帧等)本身也从内存池分配，免去每个数据包的malloc/free
+    static void *operator new(size_t size) {
+        size_t capacity;
+        return BufferPool::allocate(size, capacity);
+    }
+
+    static void operator delete(void *ptr, size_t size) {
+        BufferPool::deallocate(ptr, size);
+    }
+
 private:
     //对象个数统计
     ObjectStatistic<Buffer> _statistic;
@@ -122,7 +174,7 @@ public:
 
     ~BufferRaw() override{
         if(_data){
-            delete [] _data;
+            BufferPool::deallocate(_data, _capacity);
         }
     }
     //在写入数据时请确保内存是否越界
@@ -153,10 +205,10 @@ public:
                 }
             }while(false);
 
-            delete [] _data;
+            BufferPool::deallocate(_data, _capacity);
         }
-        _data = new char[capacity];
-        _capacity = capacity;
+        //从内存池分配，实际分配大小可能大于请求大小
+        _data = BufferPool::allocate(capacity, _capacity);
     }
     //设置有效数据大小
     void setSize(size_t size){
@@ -447,28 +499,13 @@ private:
     ObjectStatistic<BufferLikeString> _statistic;
 };
 
-#if defined(_WIN32)
-struct iovec {
-    void *   iov_base;	/* [XSI] Base address of I/O memory region */
-    size_t	 iov_len;	/* [XSI] Size of region iov_base points to */
-};
-struct msghdr {
-    void		*msg_name;	/* [XSI] optional address */
-    size_t  	msg_namelen;	/* [XSI] size of address */
-    struct		iovec *msg_iov;	/* [XSI] scatter/gather array */
-    size_t 		msg_iovlen;	/* [XSI] # elements in msg_iov */
-    void		*msg_control;	/* [XSI] ancillary data, see below */
-    int			msg_controllen;	/* [XSI] ancillary data buffer len */
-    int			msg_flags;	/* [XSI] flags on received message */
-};
-#else
-#include <sys/uio.h>
-#include <limits.h>
-#endif
-
-#if !defined(IOV_MAX)
-#define IOV_MAX 1024
-#endif
+//udp数据报发送方式
+typedef enum {
+    UdpSend_Auto = -1, //尚未确定，由Socket在首次发送时根据系统能力自动选择
+    UdpSend_Single = 0, //每个数据报一次sendmsg
+    UdpSend_Mmsg = 1, //sendmmsg一次系统调用发送多个数据报
+    UdpSend_Gso = 2, //在UdpSend_Mmsg基础上，同目标、等长的连续数据报通过UDP_SEGMENT(GSO)合并成一个报文交给内核分片
+} UdpSendMode;
 
 class BufferList;
 class BufferSock : public Buffer {
@@ -481,6 +518,7 @@ public:
 
     char *data() const override;
     size_t size() const override;
+    size_t getIovec(struct iovec *iov) const override;
 
 private:
     int _addr_len = 0;
@@ -497,16 +535,38 @@ public:
 
     bool empty();
     size_t count();
-    ssize_t send(int fd, int flags, bool udp);
+
+    /**
+     * 发送数据
+     * @param fd 套接字
+     * @param flags 发送flags
+     * @param udp 是否为udp套接字
+     * @param udp_mode udp批量发送方式，为nullptr时逐个数据报发送;
+     *                 如果系统或网卡不支持该方式，发送时会自动降级并修改该值
+     * @return 发送的字节数，一个字节都未发送成功时返回-1
+     */
+    ssize_t send(int fd, int flags, bool udp, UdpSendMode *udp_mode = nullptr);
+
+    /**
+     * 本对象发送数据时调用的系统调用次数
+     */
+    size_t getSendSyscalls() const;
 
 private:
+    //获取从第index个iovec开始的那个缓存所占的iovec个数以及字节数
+    size_t getIovecCount(size_t index, size_t &bytes) const;
     void reOffset(size_t n);
+    void onSent(ssize_t n);
     ssize_t send_l(int fd, int flags, bool udp);
+    ssize_t sendmmsg_l(int fd, int flags, UdpSendMode &udp_mode);
 
 private:
+    size_t _syscalls = 0;
     size_t _iovec_off = 0;
     size_t _remain_size = 0;
     vector<struct iovec> _iovec;
+    //iovec是否为其所属缓存的最后一个内存片段
+    vector<bool> _iovec_tail;
     List<std::pair<Buffer::Ptr, bool> > _pkt_list;
     SendResult _cb;
     //对象个数统计
@@ -10,12 +10,20 @@
 
 #include "Network/Session.h"
 
+//未设置空闲超时时，触发onManager的间隔
+#define SESSION_MANAGER_MS 2000
+
 namespace toolkit {
 
 Session::Session(const Socket::Ptr &sock) : SocketHelper(sock) {
 }
 
-Session::~Session() = default;
+Session::~Session() {
+    if (_manager_task) {
+        //时间轮中的任务在到期或降层时丢弃
+        _manager_task->cancel();
+    }
+}
 
 string Session::getIdentifier() const{
     return std::to_string(reinterpret_cast<uint64_t>(this));
@@ -31,6 +39,74 @@ void Session::safeShutdown(const SockException &ex) {
     });
 }
 
+void Session::setTimeout(uint64_t timeout_ms) {
+    _timeout_ms = timeout_ms;
+    resetTimeout();
+    if (_manager_started) {
+        scheduleManager();
+    }
+}
+
+uint64_t Session::getTimeout() const {
+    return _timeout_ms;
+}
+
+void Session::resetTimeout() {
+    _last_active_ms = getCurrentMillisecond();
+}
+
+void Session::startManager() {
+    _manager_started = true;
+    resetTimeout();
+    scheduleManager();
+}
+
+void Session::onTimeout() {
+    shutdown(SockException(Err_timeout, "session timeout"));
+}
+
+void Session::scheduleManager() {
+    if (_manager_task) {
+        _manager_task->cancel();
+    }
+    std::weak_ptr<Session> weak_self = shared_from_this();
+    if (!_timeout_ms) {
+        _manager_task = getPoller()->doDelayTask(SESSION_MANAGER_MS, [weak_self]() -> uint64_t {
+            auto strong_self = weak_self.lock();
+            if (!strong_self) {
+                return 0;
+            }
+            try {
+                strong_self->onManager();
+            } catch (std::exception &ex) {
+                WarnL << ex.what();
+            }
+            return SESSION_MANAGER_MS;
+        });
+        return;
+    }
+
+    _manager_task = getPoller()->doDelayTask(_timeout_ms, [weak_self]() -> uint64_t {
+        auto strong_self = weak_self.lock();
+        if (!strong_self) {
+            return 0;
+        }
+        auto timeout_ms = strong_self->_timeout_ms;
+        auto idle_ms = getCurrentMillisecond() - strong_self->_last_active_ms;
+        if (idle_ms < timeout_ms) {
+            //期间有数据，按最后活跃时间重新计时，不必每次收到数据都移动定时器
+            return timeout_ms - idle_ms;
+        }
+        try {
+            strong_self->onTimeout();
+        } catch (std::exception &ex) {
+            WarnL << ex.what();
+        }
+        //onTimeout中可能刷新了空闲计时并继续
+        return timeout_ms;
+    });
+}
+
 StatisticImp(Session)
 StatisticImp(UdpSession)
 StatisticImp(TcpSession)
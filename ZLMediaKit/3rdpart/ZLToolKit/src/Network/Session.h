@@ -63,7 +63,45 @@ public:
      */
     void safeShutdown(const SockException &ex = SockException(Err_shutdown, "self shutdown"));
 
+    /**
+     * 设置空闲超时时间，由EventPoller的时间轮管理，开启后Server不再定时触发本会话的onManager
+     * 超过该时间没有收到数据或调用resetTimeout时触发onTimeout
+     * 必须在会话所在的poller线程中调用，一般在attachServer中调用
+     * @param timeout_ms 超时时间，单位毫秒，为0时关闭，恢复定时触发onManager
+     */
+    void setTimeout(uint64_t timeout_ms);
+
+    /**
+     * 获取空闲超时时间，为0时未开启
+     */
+    uint64_t getTimeout() const;
+
+    /**
+     * 刷新空闲计时，只记录当前时间；收到数据时Server会自动调用
+     */
+    void resetTimeout();
+
+    /**
+     * 开始超时管理，由Server在会话创建后调用
+     * 未设置空闲超时时每隔2秒触发一次onManager，否则由空闲超时管理
+     */
+    void startManager();
+
+protected:
+    /**
+     * 空闲超时回调，默认断开连接
+     */
+    virtual void onTimeout();
+
+private:
+    void scheduleManager();
+
 private:
+    bool _manager_started = false;
+    uint64_t _timeout_ms = 0;
+    uint64_t _last_active_ms = 0;
+    //时间轮中的超时管理任务，每个会话各自一个，Server不必定时遍历所有会话
+    DelayTask::Ptr _manager_task;
     // 对象个数统计
     ObjectStatistic<Session> _statistic;
 };
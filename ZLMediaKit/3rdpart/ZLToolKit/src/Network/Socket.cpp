@@ -17,6 +17,20 @@
 #include "Thread/semaphore.h"
 #include "Poller/EventPoller.h"
 #include "Thread/WorkThreadPool.h"
+
+#if defined(__linux__) || defined(__linux)
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <sys/sendfile.h>
+
+#if !defined(SOL_UDP)
+#define SOL_UDP 17
+#endif
+
+#if !defined(UDP_SEGMENT)
+#define UDP_SEGMENT 103
+#endif
+#endif // defined(__linux__) || defined(__linux)
 using namespace std;
 
 #define LOCK_GUARD(mtx) lock_guard<decltype(mtx)> lck(mtx)
@@ -82,6 +96,11 @@ void Socket::setOnRead(onReadCB cb) {
     }
 }
 
+void Socket::setOnMultiRead(onMultiReadCB cb) {
+    LOCK_GUARD(_mtx_event);
+    _on_multi_read = std::move(cb);
+}
+
 void Socket::setOnErr(onErrCB cb) {
     LOCK_GUARD(_mtx_event);
     if (cb) {
@@ -129,6 +148,57 @@ void Socket::setOnSendResult(onSendResult cb) {
     _send_result = std::move(cb);
 }
 
+void Socket::setOnSendMark(onSendMark cb) {
+    {
+        LOCK_GUARD(_mtx_event);
+        _on_send_mark = std::move(cb);
+    }
+    _enable_send_mark = (bool) _on_send_mark;
+}
+
+void Socket::addSendMark(uint64_t mark) {
+    if (!_enable_send_mark) {
+        return;
+    }
+    {
+        LOCK_GUARD(_mtx_send_buf_waiting);
+        if (_bytes_flushed < _bytes_enqueued) {
+            _send_marks.emplace_back(_bytes_enqueued, mark);
+            return;
+        }
+    }
+    //数据已经全部写入socket
+    LOCK_GUARD(_mtx_event);
+    if (_on_send_mark) {
+        _on_send_mark(mark);
+    }
+}
+
+void Socket::onSendBytes(size_t bytes) {
+    if (!_enable_send_mark) {
+        //未使用发送标记时不统计，免去每次写socket加锁
+        return;
+    }
+    List<std::pair<uint64_t, uint64_t> > marks;
+    {
+        LOCK_GUARD(_mtx_send_buf_waiting);
+        _bytes_flushed += bytes;
+        while (!_send_marks.empty() && _send_marks.front().first <= _bytes_flushed) {
+            marks.emplace_back(_send_marks.front());
+            _send_marks.pop_front();
+        }
+    }
+    if (marks.empty()) {
+        return;
+    }
+    LOCK_GUARD(_mtx_event);
+    if (_on_send_mark) {
+        marks.for_each([&](std::pair<uint64_t, uint64_t> &pr) {
+            _on_send_mark(pr.second);
+        });
+    }
+}
+
 #define CLOSE_SOCK(fd) if(fd != -1) {close(fd);}
 
 void Socket::connect(const string &url, uint16_t port, onErrCB con_cb_in, float timeout_sec, const string &local_ip, uint16_t local_port) {
@@ -256,7 +326,21 @@ bool Socket::attachEvent(const SockFD::Ptr &sock, bool is_udp) {
     return -1 != result;
 }
 
+//单次recvmmsg最多读取的数据报个数
+#define MAX_RECV_MMSG_COUNT 32
+
+static atomic<bool> s_udp_batch_recv(true);
+
+void Socket::setUdpBatchRecv(bool enable) {
+    s_udp_batch_recv = enable;
+}
+
 ssize_t Socket::onRead(const SockFD::Ptr &sock, bool is_udp) noexcept{
+#if defined(__linux__) || defined(__linux)
+    if (is_udp && s_udp_batch_recv) {
+        return onMultiRead(sock);
+    }
+#endif
     ssize_t ret = 0, nread = 0;
     auto sock_fd = sock->rawFd();
 
@@ -304,6 +388,83 @@ ssize_t Socket::onRead(const SockFD::Ptr &sock, bool is_udp) noexcept{
     return 0;
 }
 
+ssize_t Socket::onMultiRead(const SockFD::Ptr &sock) noexcept {
+#if defined(__linux__) || defined(__linux)
+    ssize_t ret = 0;
+    auto sock_fd = sock->rawFd();
+
+    while (_enable_recv) {
+        //每次读取前重新获取，上次回调中被上层持有的缓存会被替换
+        auto &buffers = _poller->getSharedBufferList();
+        auto count = std::min(buffers.size(), (size_t) MAX_RECV_MMSG_COUNT);
+        struct mmsghdr msgs[MAX_RECV_MMSG_COUNT];
+        struct iovec iovs[MAX_RECV_MMSG_COUNT];
+        struct sockaddr addrs[MAX_RECV_MMSG_COUNT];
+        for (size_t i = 0; i < count; ++i) {
+            auto &buffer = buffers[i];
+            iovs[i].iov_base = buffer->data();
+            //最后一个字节设置为'\0'
+            iovs[i].iov_len = buffer->getCapacity() - 1;
+            auto &msg = msgs[i].msg_hdr;
+            msg.msg_name = &addrs[i];
+            msg.msg_namelen = sizeof(struct sockaddr);
+            msg.msg_iov = &iovs[i];
+            msg.msg_iovlen = 1;
+            msg.msg_control = nullptr;
+            msg.msg_controllen = 0;
+            msg.msg_flags = 0;
+        }
+
+        int nread;
+        do {
+            nread = recvmmsg(sock_fd, msgs, count, 0, nullptr);
+        } while (-1 == nread && UV_EINTR == get_uv_error(true));
+
+        if (nread == -1) {
+            auto err = get_uv_error(true);
+            if (err != UV_EAGAIN) {
+                emitErr(toSockException(err));
+            }
+            return ret;
+        }
+
+        for (int i = 0; i < nread; ++i) {
+            auto &buffer = buffers[i];
+            auto size = msgs[i].msg_len;
+            ret += size;
+            buffer->data()[size] = '\0';
+            //设置buffer有效数据大小
+            buffer->setSize(size);
+        }
+
+        //触发回调
+        {
+            LOCK_GUARD(_mtx_event);
+            try {
+                //此处捕获异常，目的是防止数据未读尽，epoll边沿触发失效的问题
+                if (_on_multi_read) {
+                    _on_multi_read(buffers.data(), addrs, nread);
+                } else {
+                    for (int i = 0; i < nread; ++i) {
+                        _on_read(buffers[i], &addrs[i], msgs[i].msg_hdr.msg_namelen);
+                    }
+                }
+            } catch (std::exception &ex) {
+                ErrorL << "触发socket on_read事件时,捕获到异常:" << ex.what();
+            }
+        }
+
+        if ((size_t) nread < count) {
+            //已经读尽，后续有新数据到达时会再次触发可读事件，无需再读一次等待EAGAIN
+            return ret;
+        }
+    }
+    return 0;
+#else
+    return onRead(sock, true);
+#endif
+}
+
 bool Socket::emitErr(const SockException& err) noexcept{
     {
         LOCK_GUARD(_mtx_sock_fd);
@@ -355,6 +516,77 @@ ssize_t Socket::send(Buffer::Ptr buf, struct sockaddr *addr, socklen_t addr_len,
     return send_l(std::make_shared<BufferSock>(std::move(buf), addr, addr_len), true, try_flush);
 }
 
+ssize_t Socket::sendFile(int file_fd, uint64_t offset, size_t size) {
+#if defined(__linux__) || defined(__linux)
+    SockFD::Ptr sock;
+    {
+        LOCK_GUARD(_mtx_sock_fd);
+        sock = _sock_fd;
+    }
+    if (!sock || sock->type() != SockNum::Sock_TCP) {
+        return -1;
+    }
+    if (!_sendable) {
+        //等待可写事件
+        return 0;
+    }
+    bool empty;
+    {
+        LOCK_GUARD(_mtx_send_buf_waiting);
+        empty = _send_buf_waiting.empty();
+    }
+    if (empty) {
+        LOCK_GUARD(_mtx_send_buf_sending);
+        empty = _send_buf_sending.empty();
+    }
+    if (!empty) {
+        //先发送缓存中的数据(例如http头)，未能全部发送时等待可写后触发onFlush回调
+        if (!flushData(sock, false)) {
+            return -1;
+        }
+        if (!_sendable) {
+            return 0;
+        }
+    }
+
+    off_t off = (off_t) offset;
+    ssize_t n;
+    do {
+        n = ::sendfile(sock->rawFd(), file_fd, &off, size);
+    } while (-1 == n && UV_EINTR == get_uv_error(true));
+
+    if (n > 0) {
+        _send_flush_ticker.resetTime();
+        if (_enable_send_mark) {
+            //sendfile的数据不经过发送缓存，并且调用前发送缓存已清空，同时计入入队与写入的字节数，保持标记位置正确
+            LOCK_GUARD(_mtx_send_buf_waiting);
+            _bytes_enqueued += n;
+            _bytes_flushed += n;
+        }
+        if ((size_t) n < size) {
+            //socket写缓存已满，等待可写
+            _wait_send_file = true;
+            startWriteAbleEvent(sock);
+        }
+        return n;
+    }
+    if (n == 0) {
+        //文件真实长度小于声明长度
+        return -1;
+    }
+    int err = get_uv_error(true);
+    if (err == UV_EAGAIN) {
+        _wait_send_file = true;
+        startWriteAbleEvent(sock);
+        return 0;
+    }
+    emitErr(toSockException(err));
+    return -1;
+#else
+    return -1;
+#endif
+}
+
 ssize_t Socket::send_l(Buffer::Ptr buf, bool is_buf_sock, bool try_flush) {
     auto size = buf ? buf->size() : 0;
     if (!size) {
@@ -375,6 +607,9 @@ ssize_t Socket::send_l(Buffer::Ptr buf, bool is_buf_sock, bool try_flush) {
     {
         LOCK_GUARD(_mtx_send_buf_waiting);
         _send_buf_waiting.emplace_back(std::move(buf), is_buf_sock);
+        if (_enable_send_mark) {
+            _bytes_enqueued += size;
+        }
     }
 
     if(try_flush){
@@ -456,8 +691,8 @@ bool Socket::listen(const SockFD::Ptr &sock){
     return true;
 }
 
-bool Socket::listen(uint16_t port, const string &local_ip, int backlog) {
-    int sock = SockUtil::listen(port, local_ip.data(), backlog);
+bool Socket::listen(uint16_t port, const string &local_ip, int backlog, bool reuse_port) {
+    int sock = SockUtil::listen(port, local_ip.data(), backlog, reuse_port);
     if (sock == -1) {
         return false;
     }
@@ -604,6 +839,29 @@ string Socket::getIdentifier() const{
     return class_name + to_string(reinterpret_cast<uint64_t>(this));
 }
 
+static atomic<bool> s_udp_batch_send(true);
+
+void Socket::setUdpBatchSend(bool enable) {
+    s_udp_batch_send = enable;
+}
+
+static UdpSendMode getUdpSendMode(int fd) {
+    if (!s_udp_batch_send) {
+        return UdpSend_Single;
+    }
+#if defined(__linux__) || defined(__linux)
+    int gso_size = 0;
+    socklen_t len = sizeof(gso_size);
+    if (0 == getsockopt(fd, SOL_UDP, UDP_SEGMENT, &gso_size, &len)) {
+        //内核支持UDP_SEGMENT(4.18+)
+        return UdpSend_Gso;
+    }
+    return UdpSend_Mmsg;
+#else
+    return UdpSend_Single;
+#endif
+}
+
 bool Socket::flushData(const SockFD::Ptr &sock, bool poller_thread) {
     decltype(_send_buf_sending) send_buf_sending_tmp;
     {
@@ -640,11 +898,15 @@ bool Socket::flushData(const SockFD::Ptr &sock, bool poller_thread) {
 
     int fd = sock->rawFd();
     bool is_udp = sock->type() == SockNum::Sock_UDP;
+    if (is_udp && _udp_send_mode == UdpSend_Auto) {
+        _udp_send_mode = getUdpSendMode(fd);
+    }
     while (!send_buf_sending_tmp.empty()) {
         auto &packet = send_buf_sending_tmp.front();
-        auto n = packet->send(fd, _sock_flags, is_udp);
+        auto n = packet->send(fd, _sock_flags, is_udp, &_udp_send_mode);
         if (n > 0) {
             //全部或部分发送成功
+            onSendBytes(n);
             if (packet->empty()) {
                 //全部发送成功
                 send_buf_sending_tmp.pop_front();
@@ -704,6 +966,11 @@ void Socket::onWriteAble(const SockFD::Ptr &sock) {
     if (empty_waiting && empty_sending) {
         //数据已经清空了，我们停止监听可写事件
         stopWriteAbleEvent(sock);
+        if (_wait_send_file) {
+            //sendfile等待的可写事件，通知上层继续发送
+            _wait_send_file = false;
+            onFlushed(sock);
+        }
     } else {
         //socket可写，我们尝试发送剩余的数据
         flushData(sock, true);
@@ -256,6 +256,8 @@ public:
     using Ptr = std::shared_ptr<Socket>;
     //接收数据回调
     using onReadCB = function<void(const Buffer::Ptr &buf, struct sockaddr *addr, int addr_len)>;
+    //udp批量接收回调，buf与addr均为长度为count的数组
+    using onMultiReadCB = function<void(const BufferRaw::Ptr *buf, struct sockaddr *addr, size_t count)>;
     //发生错误回调
     using onErrCB = function<void(const SockException &err)>;
     //tcp监听接收到连接请求
@@ -266,6 +268,8 @@ public:
     using onCreateSocket = function<Ptr(const EventPoller::Ptr &poller)>;
     //发送buffer成功与否回调
     using onSendResult = BufferList::SendResult;
+    //发送标记回调，标记之前的数据已经全部写入socket
+    using onSendMark = function<void(uint64_t mark)>;
 
     /**
      * 构造socket对象，尚未有实质操作
@@ -293,9 +297,10 @@ public:
      * @param port 监听端口，0则随机
      * @param local_ip 监听的网卡ip
      * @param backlog tcp最大积压数
+     * @param reuse_port 是否开启SO_REUSEPORT，用于多个socket分别监听同一端口
      * @return 是否成功
      */
-    virtual bool listen(uint16_t port, const string &local_ip = "0.0.0.0", int backlog = 1024);
+    virtual bool listen(uint16_t port, const string &local_ip = "0.0.0.0", int backlog = 1024, bool reuse_port = false);
 
     /**
      * 创建udp套接字,udp是无连接的，所以可以作为服务器和客户端
@@ -313,6 +318,20 @@ public:
      */
     virtual void setOnRead(onReadCB cb);
 
+    /**
+     * 设置udp批量数据接收回调，udp socket开启批量接收时有效
+     * 设置后一次recvmmsg读取到的多个数据报将通过一次回调交给上层，否则逐个触发setOnRead设置的回调
+     * 回调中的缓存如果被上层持有，下次读取时将自动替换，不会被覆盖
+     * @param cb 回调对象，置空则回退到逐个触发onRead回调
+     */
+    virtual void setOnMultiRead(onMultiReadCB cb);
+
+    /**
+     * 全局开启或关闭udp批量接收(recvmmsg)，默认开启
+     * @param enable 是否开启
+     */
+    static void setUdpBatchRecv(bool enable);
+
     /**
      * 设置异常事件(包括eof等)回调
      * @param cb 回调对象
@@ -344,6 +363,20 @@ public:
      */
     virtual void setOnSendResult(onSendResult cb);
 
+    /**
+     * 设置发送标记回调，见addSendMark
+     * 未设置回调时不统计发送字节数；需要在发送数据前设置，否则此前已入队的数据会使标记提前触发
+     * @param cb 回调，在写socket的线程触发
+     */
+    virtual void setOnSendMark(onSendMark cb);
+
+    /**
+     * 在发送队列当前位置插入标记，此前send的数据全部写入socket后触发setOnSendMark设置的回调
+     * 可用于统计数据在应用层发送缓存中的停留时间；未设置回调时忽略
+     * @param mark 标记值，原样回传
+     */
+    void addSendMark(uint64_t mark);
+
     ////////////发送数据相关接口////////////
 
     /**
@@ -368,6 +401,17 @@ public:
      */
     virtual ssize_t send(Buffer::Ptr buf, struct sockaddr *addr = nullptr, socklen_t addr_len = 0, bool try_flush = true);
 
+    /**
+     * 通过sendfile把文件内容直接从内核发送到tcp socket，不经过用户态拷贝，仅linux支持
+     * 只能在发送缓存清空后调用，必须在poller线程调用
+     * 返回0或者只发送了部分数据时socket已不可写，可写后将触发onFlush回调
+     * @param file_fd 文件描述符
+     * @param offset 文件偏移量
+     * @param size 最多发送字节数
+     * @return 发送的字节数，0代表socket不可写，-1代表不支持或发送失败
+     */
+    ssize_t sendFile(int file_fd, uint64_t offset, size_t size);
+
     /**
      * 关闭socket且触发onErr回调，onErr回调将在poller线程中进行
      * @param err 错误原因
@@ -427,6 +471,14 @@ public:
      */
     virtual void setSendFlags(int flags = SOCKET_DEFAULE_FLAGS);
 
+    /**
+     * 全局开启或关闭udp批量发送(sendmmsg/GSO)，默认开启
+     * 开启后udp socket首次发送时会探测系统能力，优先使用GSO，其次sendmmsg
+     * 只影响此后首次发送数据的socket
+     * @param enable 是否开启
+     */
+    static void setUdpBatchSend(bool enable);
+
     /**
      * 关闭套接字
      */
@@ -454,6 +506,7 @@ private:
     SockFD::Ptr makeSock(int sock, SockNum::SockType type);
     int onAccept(const SockFD::Ptr &sock, int event) noexcept;
     ssize_t onRead(const SockFD::Ptr &sock, bool is_udp = false) noexcept;
+    ssize_t onMultiRead(const SockFD::Ptr &sock) noexcept;
     void onWriteAble(const SockFD::Ptr &sock);
     void onConnected(const SockFD::Ptr &sock, const onErrCB &cb);
     void onFlushed(const SockFD::Ptr &pSock);
@@ -461,12 +514,17 @@ private:
     void stopWriteAbleEvent(const SockFD::Ptr &sock);
     bool listen(const SockFD::Ptr &sock);
     bool flushData(const SockFD::Ptr &sock, bool poller_thread);
+    void onSendBytes(size_t bytes);
     bool attachEvent(const SockFD::Ptr &sock, bool is_udp = false);
     ssize_t send_l(Buffer::Ptr buf, bool is_buf_sock, bool try_flush = true);
 
 private:
     //send socket时的flag
     int _sock_flags = SOCKET_DEFAULE_FLAGS;
+    //udp批量发送方式，首次发送时确定
+    UdpSendMode _udp_send_mode = UdpSend_Auto;
+    //sendfile因socket不可写而等待可写事件
+    bool _wait_send_file = false;
     //最大发送缓存，单位毫秒，距上次发送缓存清空时间不能超过该参数
     uint32_t _max_send_buffer_ms = SEND_TIME_OUT_SEC * 1000;
     //控制是否接收监听socket可读事件，关闭后可用于流量控制
@@ -494,6 +552,8 @@ private:
     onErrCB _on_err;
     //收到数据事件
     onReadCB _on_read;
+    //udp批量收到数据事件
+    onMultiReadCB _on_multi_read;
     //socket缓存清空事件(可用于发送流速控制)
     onFlush _on_flush;
     //tcp监听收到accept请求事件
@@ -513,6 +573,14 @@ private:
     MutexWrapper<recursive_mutex> _mtx_send_buf_sending;
     //发送buffer结果回调
     BufferList::SendResult _send_result;
+    //发送标记回调，以及是否已经设置
+    onSendMark _on_send_mark;
+    atomic<bool> _enable_send_mark {false};
+    //写入一级发送缓存、以及写入socket(包括sendfile)的总字节数，用于定位发送标记，只在设置了发送标记回调时统计，受一级发送缓存锁保护
+    uint64_t _bytes_enqueued = 0;
+    uint64_t _bytes_flushed = 0;
+    //发送标记列队，first为标记所在的发送字节位置
+    List<std::pair<uint64_t, uint64_t> > _send_marks;
     //对象个数统计
     ObjectStatistic<Socket> _statistic;
 };
@@ -584,6 +652,11 @@ public:
      */
     Socket::Ptr createSocket();
 
+    /**
+     * 是否为ssl加密连接，加密连接的数据必须经过ssl加密，不能绕过加密直接写socket(例如sendfile)
+     */
+    virtual bool overSsl() const { return false; }
+
     ///////////////////// SockInfo override /////////////////////
     string get_local_ip() override;
     uint16_t get_local_port() override;
@@ -8,6 +8,7 @@
  * may be found in the AUTHORS file in the root of the source tree.
  */
 
+#include <unordered_set>
 #include "TcpServer.h"
 
 namespace toolkit {
@@ -15,6 +16,10 @@ namespace toolkit {
 INSTANCE_IMP(SessionMap);
 StatisticImp(TcpServer);
 
+//已启动的tcp服务器(不含cloned server)，用于accept统计
+static mutex s_mtx_servers;
+static unordered_set<const TcpServer *> s_servers;
+
 TcpServer::TcpServer(const EventPoller::Ptr &poller) : Server(poller) {
     setOnCreateSocket(nullptr);
     _socket = createSocket(_poller);
@@ -22,6 +27,7 @@ TcpServer::TcpServer(const EventPoller::Ptr &poller) : Server(poller) {
         return onBeforeAcceptConnection(poller);
     });
     _socket->setOnAccept([this](Socket::Ptr &sock, shared_ptr<void> &complete) {
+        ++_accept_count;
         auto ptr = sock->getPoller().get();
         auto server = getServer(ptr);
         ptr->async([server, sock, complete]() {
@@ -32,10 +38,13 @@ TcpServer::TcpServer(const EventPoller::Ptr &poller) : Server(poller) {
 }
 
 TcpServer::~TcpServer() {
+    if (!_parent) {
+        lock_guard<mutex> lck(s_mtx_servers);
+        s_servers.erase(this);
+    }
     if (!_parent && _socket->rawFD() != -1) {
         InfoL << "close tcp server " << _socket->get_local_ip() << ":" << _socket->get_local_port();
     }
-    _timer.reset();
     //先关闭socket监听，防止收到新的连接
     _socket.reset();
     _session_map.clear();
@@ -49,6 +58,38 @@ uint16_t TcpServer::getPort() {
     return _socket->get_local_port();
 }
 
+void TcpServer::setReusePort(bool enable, bool cpu_affinity) {
+    _reuse_port = enable;
+    _cpu_affinity = enable && cpu_affinity;
+}
+
+vector<uint64_t> TcpServer::getAcceptCount() const {
+    vector<uint64_t> ret;
+    EventPollerPool::Instance().for_each([&](const TaskExecutor::Ptr &executor) {
+        auto poller = static_cast<const EventPoller *>(executor.get());
+        auto it = _cloned_server.find(poller);
+        if (it != _cloned_server.end()) {
+            ret.emplace_back(it->second->_accept_count.load());
+        } else {
+            ret.emplace_back(poller == _poller.get() ? _accept_count.load() : 0);
+        }
+    });
+    return ret;
+}
+
+vector<TcpServer::AcceptStatistic> TcpServer::getAcceptStatistic() {
+    vector<AcceptStatistic> ret;
+    lock_guard<mutex> lck(s_mtx_servers);
+    for (auto server : s_servers) {
+        AcceptStatistic stat;
+        stat.port = server->_listen_port;
+        stat.reuse_port = server->_reuse_port;
+        stat.accepts = server->getAcceptCount();
+        ret.emplace_back(std::move(stat));
+    }
+    return ret;
+}
+
 void TcpServer::setOnCreateSocket(Socket::onCreateSocket cb) {
     if (cb) {
         _on_create_socket = std::move(cb);
@@ -68,6 +109,10 @@ TcpServer::Ptr TcpServer::onCreatServer(const EventPoller::Ptr &poller) {
 
 Socket::Ptr TcpServer::onBeforeAcceptConnection(const EventPoller::Ptr &poller) {
     assert(_poller->isCurrentThread());
+    if (_reuse_port) {
+        //分片模式下连接已由内核分配到本线程，不再跨线程派发
+        return createSocket(_poller);
+    }
     //此处改成自定义获取poller对象，防止负载不均衡
     return createSocket(EventPollerPool::Instance().getPoller(false));
 }
@@ -78,16 +123,16 @@ void TcpServer::cloneFrom(const TcpServer &that) {
     }
     _on_create_socket = that._on_create_socket;
     _session_alloc = that._session_alloc;
-    _socket->cloneFromListenSocket(*(that._socket));
-    weak_ptr<TcpServer> weak_self = std::dynamic_pointer_cast<TcpServer>(shared_from_this());
-    _timer = std::make_shared<Timer>(2.0f, [weak_self]() -> bool {
-        auto strong_self = weak_self.lock();
-        if (!strong_self) {
-            return false;
+    _reuse_port = that._reuse_port;
+    if (_reuse_port) {
+        //分片模式下每个poller线程拥有独立的listen fd
+        if (!_socket->listen(that._listen_port, that._host, that._backlog, true)) {
+            throw std::runtime_error(StrPrinter << "listen on " << that._host << ":" << that._listen_port
+                                                << " with SO_REUSEPORT failed:" << get_uv_errmsg(true));
         }
-        strong_self->onManagerSession();
-        return true;
-    }, _poller);
+    } else {
+        _socket->cloneFromListenSocket(*(that._socket));
+    }
     this->mINI::operator=(that);
     _parent = &that;
 }
@@ -112,6 +157,7 @@ void TcpServer::onAcceptConnection(const Socket::Ptr &sock) {
         //获取会话强应用
         auto strong_session = weak_session.lock();
         if (strong_session) {
+            strong_session->resetTimeout();
             strong_session->onRecv(buf);
         }
     });
@@ -130,18 +176,7 @@ void TcpServer::onAcceptConnection(const Socket::Ptr &sock) {
             }
 
             assert(strong_self->_poller->isCurrentThread());
-            if (!strong_self->_is_on_manager) {
-                //该事件不是onManager时触发的，直接操作map
-                strong_self->_session_map.erase(ptr);
-            } else {
-                //遍历map时不能直接删除元素
-                strong_self->_poller->async([weak_self, ptr]() {
-                    auto strong_self = weak_self.lock();
-                    if (strong_self) {
-                        strong_self->_session_map.erase(ptr);
-                    }
-                }, false);
-            }
+            strong_self->_session_map.erase(ptr);
         });
 
         //获取会话强应用
@@ -151,29 +186,64 @@ void TcpServer::onAcceptConnection(const Socket::Ptr &sock) {
             strong_session->onError(err);
         }
     });
+
+    //超时管理由各会话在时间轮中自行完成，不再定时遍历所有会话
+    session->startManager();
 }
 
 void TcpServer::start_l(uint16_t port, const std::string &host, uint32_t backlog) {
-    if (!_socket->listen(port, host.c_str(), backlog)) {
-        //创建tcp监听失败，可能是由于端口占用或权限问题
-        string err = (StrPrinter << "listen on " << host << ":" << port << " failed:" << get_uv_errmsg(true));
-        throw std::runtime_error(err);
+    _listen_port = port;
+    _host = host;
+    _backlog = backlog;
+    if (_reuse_port) {
+        startReusePort();
+    } else {
+        if (!_socket->listen(port, host.c_str(), backlog)) {
+            //创建tcp监听失败，可能是由于端口占用或权限问题
+            string err = (StrPrinter << "listen on " << host << ":" << port << " failed:" << get_uv_errmsg(true));
+            throw std::runtime_error(err);
+        }
+        _listen_port = getPort();
+
+        EventPollerPool::Instance().for_each([&](const TaskExecutor::Ptr &executor) {
+            EventPoller::Ptr poller = dynamic_pointer_cast<EventPoller>(executor);
+            if (poller == _poller || !poller) {
+                return;
+            }
+            auto &serverRef = _cloned_server[poller.get()];
+            if (!serverRef) {
+                serverRef = onCreatServer(poller);
+            }
+            if (serverRef) {
+                serverRef->cloneFrom(*this);
+            }
+        });
     }
 
-    //新建一个定时器定时管理这些tcp会话
-    weak_ptr<TcpServer> weak_self = std::dynamic_pointer_cast<TcpServer>(shared_from_this());
-    _timer = std::make_shared<Timer>(2.0f, [weak_self]() -> bool {
-        auto strong_self = weak_self.lock();
-        if (!strong_self) {
-            return false;
-        }
-        strong_self->onManagerSession();
-        return true;
-    }, _poller);
+    {
+        lock_guard<mutex> lck(s_mtx_servers);
+        s_servers.emplace(this);
+    }
+    InfoL << "TCP Server listening on " << host << ":" << _listen_port << (_reuse_port ? " with SO_REUSEPORT" : "");
+}
 
+void TcpServer::startReusePort() {
+    //严格按照poller在EventPollerPool中的顺序listen，使SO_REUSEPORT组内套接字的顺序与poller序号(亦即其绑定的cpu)一致
+    bool in_pool = false;
+    uint32_t group_size = 0;
     EventPollerPool::Instance().for_each([&](const TaskExecutor::Ptr &executor) {
         EventPoller::Ptr poller = dynamic_pointer_cast<EventPoller>(executor);
-        if (poller == _poller || !poller) {
+        if (!poller) {
+            return;
+        }
+        ++group_size;
+        if (poller == _poller) {
+            in_pool = true;
+            if (!_socket->listen(_listen_port, _host, _backlog, true)) {
+                throw std::runtime_error(StrPrinter << "listen on " << _host << ":" << _listen_port
+                                                    << " with SO_REUSEPORT failed:" << get_uv_errmsg(true));
+            }
+            _listen_port = getPort();
             return;
         }
         auto &serverRef = _cloned_server[poller.get()];
@@ -182,28 +252,22 @@ void TcpServer::start_l(uint16_t port, const std::string &host, uint32_t backlog
         }
         if (serverRef) {
             serverRef->cloneFrom(*this);
+            if (!_listen_port) {
+                //随机端口，后续listen fd都使用第一个listen fd获取到的端口
+                _listen_port = serverRef->getPort();
+            }
         }
     });
 
-    InfoL << "TCP Server listening on " << host << ":" << port;
-}
-
-void TcpServer::onManagerSession() {
-    assert(_poller->isCurrentThread());
-
-    onceToken token([&]() {
-        _is_on_manager = true;
-    }, [&]() {
-        _is_on_manager = false;
-    });
+    if (!in_pool && !_socket->listen(_listen_port, _host, _backlog, true)) {
+        //自定义poller时，其listen fd位于监听组末尾
+        throw std::runtime_error(StrPrinter << "listen on " << _host << ":" << _listen_port
+                                            << " with SO_REUSEPORT failed:" << get_uv_errmsg(true));
+    }
+    _listen_port = getPort();
 
-    for (auto &pr : _session_map) {
-        //遍历时，可能触发onErr事件(也会操作_session_map)
-        try {
-            pr.second->session()->onManager();
-        } catch (exception &ex) {
-            WarnL << ex.what();
-        }
+    if (_cpu_affinity && SockUtil::setReusePortCpuAffinity(_socket->rawFD(), group_size) == -1) {
+        WarnL << "SO_REUSEPORT cpu affinity is not supported, fallback to kernel hash";
     }
 }
 
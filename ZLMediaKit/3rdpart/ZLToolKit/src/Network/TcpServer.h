@@ -13,6 +13,7 @@
 
 #include <assert.h>
 #include <mutex>
+#include <atomic>
 #include <memory>
 #include <exception>
 #include <functional>
@@ -41,6 +42,8 @@ public:
      * 这些子TcpServer对象通过Socket对象克隆的方式在多个poller线程中监听同一个listen fd
      * 这样这个TCP服务器将会通过抢占式accept的方式把客户端均匀的分布到不同的poller线程
      * 通过该方式能实现客户端负载均衡以及提高连接接收速度
+     * 调用setReusePort开启SO_REUSEPORT分片模式后，每个poller线程各自拥有独立的listen fd，
+     * 由内核把新连接分配给某个listen fd，连接在accept它的poller线程中处理，不再跨线程派发
      */
     explicit TcpServer(const EventPoller::Ptr &poller = nullptr);
     ~TcpServer() override;
@@ -67,6 +70,30 @@ public:
      */
     uint16_t getPort();
 
+    /**
+     * @brief 开启SO_REUSEPORT分片监听模式，必须在start之前调用
+     * @param enable 是否开启，开启后每个poller线程创建独立的listen fd
+     * @param cpu_affinity 是否挂载cbpf程序，使连接分配给与收到该连接的cpu序号对应的poller线程(仅linux)
+     */
+    void setReusePort(bool enable, bool cpu_affinity = true);
+
+    /**
+     * @brief 获取各poller线程accept的连接数，按EventPollerPool中poller的顺序排列
+     */
+    vector<uint64_t> getAcceptCount() const;
+
+    class AcceptStatistic {
+    public:
+        uint16_t port;
+        bool reuse_port;
+        vector<uint64_t> accepts;
+    };
+
+    /**
+     * @brief 获取所有已启动tcp服务器各poller线程的accept统计
+     */
+    static vector<AcceptStatistic> getAcceptStatistic();
+
     /**
      * @brief 自定义socket构建行为
      */
@@ -80,16 +107,21 @@ protected:
     virtual Socket::Ptr onBeforeAcceptConnection(const EventPoller::Ptr &poller);
 
 private:
-    void onManagerSession();
     Socket::Ptr createSocket(const EventPoller::Ptr &poller);
     void start_l(uint16_t port, const std::string &host, uint32_t backlog);
+    void startReusePort();
     Ptr getServer(const EventPoller *) const;
 
 private:
-    bool _is_on_manager = false;
+    bool _reuse_port = false;
+    bool _cpu_affinity = false;
+    uint16_t _listen_port = 0;
+    uint32_t _backlog = 0;
+    std::string _host;
+    //本服务器(所在poller线程)accept的连接数
+    std::atomic<uint64_t> _accept_count{0};
     const TcpServer *_parent = nullptr;
     Socket::Ptr _socket;
-    std::shared_ptr<Timer> _timer;
     Socket::onCreateSocket _on_create_socket;
     unordered_map<SessionHelper *, SessionHelper::Ptr> _session_map;
     function<SessionHelper::Ptr(const TcpServer::Ptr &server, const Socket::Ptr &)> _session_alloc;
@@ -49,6 +49,10 @@ public:
         TcpSessionType::send(std::move(const_cast<Buffer::Ptr &>(buf)));
     }
 
+    bool overSsl() const override {
+        return true;
+    }
+
 protected:
     ssize_t send(Buffer::Ptr buf) override {
         auto size = buf->size();
@@ -28,7 +28,6 @@ UdpServer::~UdpServer() {
     if (!_cloned && _socket->rawFD() != -1) {
         InfoL << "close udp server " << _socket->get_local_ip() << ":" << _socket->get_local_port();
     }
-    _timer.reset();
     _socket.reset();
     _cloned_server.clear();
     if (!_cloned) {
@@ -48,17 +47,6 @@ void UdpServer::start_l(uint16_t port, const std::string &host) {
         throw std::runtime_error(err);
     }
 
-    // 新建一个定时器定时管理这些 udp 会话,这些对象只由主server做超时管理，cloned server不管理
-    std::weak_ptr<UdpServer> weak_self = std::dynamic_pointer_cast<UdpServer>(shared_from_this());
-    _timer = std::make_shared<Timer>(2.0f, [weak_self]() -> bool {
-        auto strong_self = weak_self.lock();
-        if (!strong_self) {
-            return false;
-        }
-        strong_self->onManagerSession();
-        return true;
-    }, _poller);
-
     //clone server至不同线程，让udp server支持多线程
     EventPollerPool::Instance().for_each([&](const TaskExecutor::Ptr &executor) {
         auto poller = std::dynamic_pointer_cast<EventPoller>(executor);
@@ -111,6 +99,7 @@ void UdpServer::onRead_l(bool is_server_fd, const UdpServer::PeerIdType &id, con
         //数据可能漂移到其他线程，所以此处尝试切换线程(通常不需要)
         session->async([weak_session, buf]() {
             if (auto strong_session = weak_session.lock()) {
+                strong_session->resetTimeout();
                 strong_session->onRecv(buf);
             }
         });
@@ -125,36 +114,6 @@ void UdpServer::onRead_l(bool is_server_fd, const UdpServer::PeerIdType &id, con
     }
 }
 
-void UdpServer::onManagerSession() {
-    decltype(_session_map) copy_map;
-    {
-        std::lock_guard<std::recursive_mutex> lock(*_session_mutex);
-        //拷贝map，防止遍历时移除对象
-        copy_map = std::make_shared<std::unordered_map<PeerIdType, SessionHelper::Ptr> >(*_session_map);
-    }
-    EventPollerPool::Instance().for_each([copy_map](const TaskExecutor::Ptr &executor) {
-        auto poller = std::dynamic_pointer_cast<EventPoller>(executor);
-        if (!poller) {
-            return;
-        }
-        poller->async([copy_map]() {
-            for (auto &pr : *copy_map) {
-                auto &session = pr.second->session();
-                if (!session->getPoller()->isCurrentThread()) {
-                    //该session不归属该poller管理
-                    continue;
-                }
-                try {
-                    // UDP 会话需要处理超时
-                    session->onManager();
-                } catch (exception &ex) {
-                    WarnL << ex.what();
-                }
-            }
-        });
-    });
-}
-
 const Session::Ptr& UdpServer::getOrCreateSession(const UdpServer::PeerIdType &id, sockaddr *addr, int addr_len, bool &is_new) {
     {
         //减小临界区
@@ -193,6 +152,7 @@ const Session::Ptr& UdpServer::createSession(const PeerIdType &id, sockaddr *add
         //快速判断是否为本会话的的数据, 通常应该成立
         if (id == makeSockId(addr, addr_len)) {
             if (auto strong_session = weak_session.lock()) {
+                strong_session->resetTimeout();
                 strong_session->onRecv(buf);
             }
             return;
@@ -201,6 +161,26 @@ const Session::Ptr& UdpServer::createSession(const PeerIdType &id, sockaddr *add
         //收到非本peer fd的数据，让server去派发此数据到合适的session对象
         strong_self->onRead_l(false, id, buf, addr, addr_len);
     });
+    socket->setOnMultiRead([weak_self, weak_session, id](const BufferRaw::Ptr *buf, struct sockaddr *addr, size_t count) {
+        auto strong_self = weak_self.lock();
+        if (!strong_self) {
+            return;
+        }
+        //一批数据只需要获取一次会话强引用
+        auto strong_session = weak_session.lock();
+        if (strong_session) {
+            strong_session->resetTimeout();
+        }
+        for (size_t i = 0; i < count; ++i) {
+            if (id == makeSockId(addr + i, sizeof(struct sockaddr))) {
+                if (strong_session) {
+                    strong_session->onRecv(buf[i]);
+                }
+                continue;
+            }
+            strong_self->onRead_l(false, id, buf[i], addr + i, sizeof(struct sockaddr));
+        }
+    });
     socket->setOnErr([weak_self, weak_session, id](const SockException &err) {
         // 在本函数作用域结束时移除会话对象
         // 目的是确保移除会话前执行其 onError 函数
@@ -224,6 +204,9 @@ const Session::Ptr& UdpServer::createSession(const PeerIdType &id, sockaddr *add
         }
     });
 
+    //UDP 会话需要处理超时，由各会话在时间轮中自行完成
+    session->startManager();
+
     lock_guard<std::recursive_mutex> lck(*_session_mutex);
     auto pr = _session_map->emplace(id, std::move(helper));
     assert(pr.second);
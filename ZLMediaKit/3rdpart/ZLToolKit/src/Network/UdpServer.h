@@ -60,11 +60,6 @@ private:
      */
     void start_l(uint16_t port, const std::string &host = "0.0.0.0");
 
-    /**
-     * @brief 定时管理 Session, UDP 会话需要根据需要处理超时
-     */
-    void onManagerSession();
-
     void onRead(const Buffer::Ptr &buf, struct sockaddr *addr, int addr_len);
 
     /**
@@ -95,7 +90,6 @@ private:
 private:
     bool _cloned = false;
     Socket::Ptr _socket;
-    std::shared_ptr<Timer> _timer;
     Socket::onCreateSocket _on_create_socket;
     //cloned server共享主server的session map，防止数据在不同server间漂移
     std::shared_ptr<std::recursive_mutex> _session_mutex;
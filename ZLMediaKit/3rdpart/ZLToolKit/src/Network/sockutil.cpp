@@ -22,6 +22,9 @@
 #if defined (__APPLE__)
 #include <ifaddrs.h>
 #endif
+#if defined(__linux) || defined(__linux__)
+#include <linux/filter.h>
+#endif
 using namespace std;
 
 namespace toolkit {
@@ -90,6 +93,30 @@ int SockUtil::setReuseable(int sockFd, bool on, bool reuse_port) {
     return ret;
 }
 
+int SockUtil::setReusePortCpuAffinity(int sockFd, uint32_t group_size) {
+#if (defined(__linux) || defined(__linux__)) && defined(SO_ATTACH_REUSEPORT_CBPF)
+    if (!group_size) {
+        return -1;
+    }
+    //A = 当前cpu序号; A %= group_size; return A
+    struct sock_filter code[] = {
+        { BPF_LD | BPF_W | BPF_ABS, 0, 0, (uint32_t) (SKF_AD_OFF + SKF_AD_CPU) },
+        { BPF_ALU | BPF_MOD | BPF_K, 0, 0, group_size },
+        { BPF_RET | BPF_A, 0, 0, 0 },
+    };
+    struct sock_fprog prog;
+    prog.len = sizeof(code) / sizeof(code[0]);
+    prog.filter = code;
+    int ret = setsockopt(sockFd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog));
+    if (ret == -1) {
+        WarnL << "设置 SO_ATTACH_REUSEPORT_CBPF 失败:" << get_uv_errmsg(true);
+    }
+    return ret;
+#else
+    return -1;
+#endif
+}
+
 int SockUtil::setBroadcast(int sockFd, bool on) {
     int opt = on ? 1 : 0;
     int ret = setsockopt(sockFd, SOL_SOCKET, SO_BROADCAST, (char *)&opt,static_cast<socklen_t>(sizeof(opt)));
@@ -297,14 +324,14 @@ int SockUtil::connect(const char *host, uint16_t port,bool bAsync,const char *lo
     return -1;
 }
 
-int SockUtil::listen(const uint16_t port, const char* localIp, int backLog) {
+int SockUtil::listen(const uint16_t port, const char* localIp, int backLog, bool reusePort) {
     int sockfd = -1;
     if ((sockfd = (int)socket(AF_INET, SOCK_STREAM, IPPROTO_TCP)) == -1) {
         WarnL << "创建套接字失败:" << get_uv_errmsg(true);
         return -1;
     }
 
-    setReuseable(sockfd, true, false);
+    setReuseable(sockfd, true, reusePort);
     setNoBlocked(sockfd);
     setCloExec(sockfd);
 
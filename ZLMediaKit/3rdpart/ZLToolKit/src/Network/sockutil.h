@@ -68,9 +68,10 @@ public:
      * @param port 监听的本地端口
      * @param localIp 绑定的本地网卡ip
      * @param backLog accept列队长度
+     * @param reusePort 是否开启SO_REUSEPORT，开启后多个套接字可以监听同一端口，由内核分配新连接
      * @return -1代表失败，其他为socket fd号
      */
-    static int listen(const uint16_t port, const char *localIp = "0.0.0.0", int backLog = 1024);
+    static int listen(const uint16_t port, const char *localIp = "0.0.0.0", int backLog = 1024, bool reusePort = false);
 
     /**
      * 创建udp套接字
@@ -154,6 +155,15 @@ public:
      */
     static int setReuseable(int sock, bool on = true, bool reuse_port = true);
 
+    /**
+     * 给SO_REUSEPORT监听组挂载cbpf程序，使新连接分配给组内第(收到该连接的cpu序号 % group_size)个套接字
+     * 组内套接字按照listen的先后顺序排列，仅linux支持
+     * @param sock 监听组内任意一个socket fd号
+     * @param group_size 监听组内套接字个数
+     * @return 0代表成功，-1为失败
+     */
+    static int setReusePortCpuAffinity(int sock, uint32_t group_size);
+
     /**
      * 运行发送或接收udp广播信息
      * @param sock socket fd号
@@ -24,6 +24,7 @@
 
 #if defined(HAS_EPOLL)
     #include <sys/epoll.h>
+    #include <sys/eventfd.h>
 
     #if !defined(EPOLLEXCLUSIVE)
     #define EPOLLEXCLUSIVE 0
@@ -42,27 +43,37 @@
 
 namespace toolkit {
 
+//当前线程所属的EventPoller，非poller线程为nullptr
+static thread_local EventPoller *s_current_poller = nullptr;
+
 EventPoller &EventPoller::Instance() {
     return *(EventPollerPool::Instance().getFirstPoller());
 }
 
 EventPoller::EventPoller(ThreadPool::Priority priority ) {
     _priority = priority;
-    SockUtil::setNoBlocked(_pipe.readFD());
-    SockUtil::setNoBlocked(_pipe.writeFD());
-
 #if defined(HAS_EPOLL)
     _epoll_fd = epoll_create(EPOLL_SIZE);
     if (_epoll_fd == -1) {
         throw runtime_error(StrPrinter << "创建epoll文件描述符失败:" << get_uv_errmsg());
     }
     SockUtil::setCloExec(_epoll_fd);
+
+    _event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (_event_fd == -1) {
+        throw runtime_error(StrPrinter << "创建eventfd失败:" << get_uv_errmsg());
+    }
+    auto wakeup_fd = _event_fd;
+#else
+    SockUtil::setNoBlocked(_pipe.readFD());
+    SockUtil::setNoBlocked(_pipe.writeFD());
+    auto wakeup_fd = _pipe.readFD();
 #endif //HAS_EPOLL
     _logger = Logger::Instance().shared_from_this();
     _loop_thread_id = this_thread::get_id();
 
     //添加内部管道事件
-    if (addEvent(_pipe.readFD(), Event_Read, [this](int event) { onPipeEvent(); }) == -1) {
+    if (addEvent(wakeup_fd, Event_Read, [this](int event) { onPipeEvent(); }) == -1) {
         throw std::runtime_error("epoll添加管道失败");
     }
 }
@@ -92,6 +103,12 @@ EventPoller::~EventPoller() {
     //退出前清理管道中的数据
     _loop_thread_id = this_thread::get_id();
     onPipeEvent();
+#if defined(HAS_EPOLL)
+    if (_event_fd != -1) {
+        close(_event_fd);
+        _event_fd = -1;
+    }
+#endif //defined(HAS_EPOLL)
     InfoL << this;
 }
 
@@ -197,17 +214,82 @@ Task::Ptr EventPoller::async_l(TaskIn task,bool may_sync, bool first) {
     }
 
     auto ret = std::make_shared<Task>(std::move(task));
+    List<Task::Ptr> tasks;
+    tasks.emplace_back(ret);
+    addTasks(tasks, first);
+    return ret;
+}
+
+void EventPoller::asyncBatch(List<TaskIn> tasks, bool may_sync) {
+    TimeTicker();
+    if (may_sync && isCurrentThread()) {
+        tasks.for_each([](TaskIn &task) {
+            task();
+        });
+        return;
+    }
+
+    List<Task::Ptr> task_list;
+    tasks.for_each([&](TaskIn &task) {
+        task_list.emplace_back(std::make_shared<Task>(std::move(task)));
+    });
+    addTasks(task_list, false);
+}
+
+Task::Ptr EventPoller::asyncStaged(TaskIn task) {
+    auto poller = s_current_poller;
+    if (!poller || poller == this) {
+        //非poller线程没有事件循环来刷新暂存列队，投递到本线程也无需暂存
+        return async_l(std::move(task), false);
+    }
+    auto ret = std::make_shared<Task>(std::move(task));
+    poller->_staged_task_map[shared_from_this()].emplace_back(ret);
+    return ret;
+}
+
+void EventPoller::addTasks(List<Task::Ptr> &tasks, bool first) {
+    if (tasks.empty()) {
+        return;
+    }
+    bool need_wakeup;
     {
         lock_guard<mutex> lck(_mtx_task);
+        //列队非空说明轮询线程已被唤醒但还未取走任务，它会一并处理本次任务
+        need_wakeup = _list_task.empty();
         if (first) {
-            _list_task.emplace_front(ret);
+            tasks.append(_list_task);
+            tasks.swap(_list_task);
         } else {
-            _list_task.emplace_back(ret);
+            _list_task.append(tasks);
         }
     }
+    if (need_wakeup) {
+        wakeup();
+    }
+}
+
+void EventPoller::flushStagedTasks() {
+    if (_staged_task_map.empty()) {
+        return;
+    }
+    decltype(_staged_task_map) task_map;
+    task_map.swap(_staged_task_map);
+    for (auto &pr : task_map) {
+        pr.first->addTasks(pr.second, false);
+    }
+}
+
+void EventPoller::wakeup() {
+#if defined(HAS_EPOLL)
+    uint64_t one = 1;
+    int ret;
+    do {
+        ret = write(_event_fd, &one, sizeof(one));
+    } while (-1 == ret && UV_EINTR == get_uv_error(true));
+#else
     //写数据到管道,唤醒主线程
     _pipe.write("", 1);
-    return ret;
+#endif //HAS_EPOLL
 }
 
 bool EventPoller::isCurrentThread() {
@@ -216,6 +298,14 @@ bool EventPoller::isCurrentThread() {
 
 inline void EventPoller::onPipeEvent() {
     TimeTicker();
+#if defined(HAS_EPOLL)
+    //eventfd一次读取即可清零计数
+    uint64_t count;
+    int ret;
+    do {
+        ret = read(_event_fd, &count, sizeof(count));
+    } while (-1 == ret && UV_EINTR == get_uv_error(true));
+#else
     char buf[1024];
     int err = 0;
     do {
@@ -224,12 +314,15 @@ inline void EventPoller::onPipeEvent() {
         }
         err = get_uv_error(true);
     } while (err != UV_EAGAIN);
+#endif //HAS_EPOLL
 
     decltype(_list_task) _list_swap;
     {
         lock_guard<mutex> lck(_mtx_task);
         _list_swap.swap(_list_task);
     }
+    _wakeup_count.fetch_add(1, memory_order_relaxed);
+    _async_task_count.fetch_add(_list_swap.size(), memory_order_relaxed);
 
     _list_swap.for_each([&](const Task::Ptr &task) {
         try {
@@ -260,10 +353,38 @@ BufferRaw::Ptr EventPoller::getSharedBuffer() {
     return ret;
 }
 
+//批量读缓存个数，即单次recvmmsg最多读取的数据报个数
+#define SHARED_BUFFER_LIST_SIZE 32
+//单个udp数据报最大长度，预留一个字节存放\0结尾符
+#define SHARED_BUFFER_LIST_CAPACITY (1 + 64 * 1024)
+
+vector<BufferRaw::Ptr> &EventPoller::getSharedBufferList() {
+    if (!_buffer_pool) {
+        _buffer_pool = std::make_shared<ResourcePool<BufferRaw> >(SHARED_BUFFER_LIST_CAPACITY);
+        _buffer_pool->setSize(SHARED_BUFFER_LIST_SIZE);
+        _shared_buffer_list.resize(SHARED_BUFFER_LIST_SIZE);
+    }
+    for (auto &buffer : _shared_buffer_list) {
+        if (!buffer || buffer.use_count() > 1) {
+            //该缓存还被上层持有，不能覆盖
+            buffer = _buffer_pool->obtain();
+        }
+    }
+    return _shared_buffer_list;
+}
+
 const thread::id &EventPoller::getThreadId() const {
     return _loop_thread_id;
 }
 
+uint64_t EventPoller::getWakeupCount() const {
+    return _wakeup_count.load(memory_order_relaxed);
+}
+
+uint64_t EventPoller::getAsyncTaskCount() const {
+    return _async_task_count.load(memory_order_relaxed);
+}
+
 //static
 EventPoller::Ptr EventPoller::getCurrentPoller(){
     lock_guard<mutex> lck(s_all_poller_mtx);
@@ -283,6 +404,7 @@ void EventPoller::runLoop(bool blocked,bool regist_self) {
             lock_guard<mutex> lck(s_all_poller_mtx);
             s_all_poller[_loop_thread_id] = shared_from_this();
         }
+        s_current_poller = this;
         _sem_run_started.post();
         _exit_flag = false;
         uint64_t minDelay;
@@ -290,6 +412,8 @@ void EventPoller::runLoop(bool blocked,bool regist_self) {
         struct epoll_event events[EPOLL_SIZE];
         while (!_exit_flag) {
             minDelay = getMinDelay();
+            //休眠前批量投递本轮循环中暂存的跨线程任务
+            flushStagedTasks();
             startSleep();//用于统计当前线程负载情况
             int ret = epoll_wait(_epoll_fd, events, EPOLL_SIZE, minDelay ? minDelay : -1);
             sleepWakeUp();//用于统计当前线程负载情况
@@ -324,6 +448,9 @@ void EventPoller::runLoop(bool blocked,bool regist_self) {
             tv.tv_sec = (decltype(tv.tv_sec))(minDelay / 1000);
             tv.tv_usec = 1000 * (minDelay % 1000);
 
+            //休眠前批量投递本轮循环中暂存的跨线程任务
+            flushStagedTasks();
+
             set_read.fdZero();
             set_write.fdZero();
             set_err.fdZero();
@@ -386,44 +513,41 @@ void EventPoller::runLoop(bool blocked,bool regist_self) {
 }
 
 uint64_t EventPoller::flushDelayTask(uint64_t now_time) {
-    decltype(_delay_task_map) task_copy;
-    task_copy.swap(_delay_task_map);
+    List<DelayTask::Ptr> task_list;
+    _delay_task_wheel.expire(now_time, task_list);
 
-    for (auto it = task_copy.begin(); it != task_copy.end() && it->first <= now_time; it = task_copy.erase(it)) {
+    task_list.for_each([&](DelayTask::Ptr &task) {
         //已到期的任务
         try {
-            auto next_delay = (*(it->second))();
+            auto next_delay = (*task)();
             if (next_delay) {
                 //可重复任务,更新时间截止线
-                _delay_task_map.emplace(next_delay + now_time, std::move(it->second));
+                _delay_task_wheel.add(next_delay + now_time, std::move(task));
             }
         } catch (std::exception &ex) {
             ErrorL << "EventPoller执行延时任务捕获到异常:" << ex.what();
         }
-    }
-
-    task_copy.insert(_delay_task_map.begin(), _delay_task_map.end());
-    task_copy.swap(_delay_task_map);
+    });
 
-    auto it = _delay_task_map.begin();
-    if (it == _delay_task_map.end()) {
+    auto next_time = _delay_task_wheel.nextTime();
+    if (!next_time) {
         //没有剩余的定时器了
         return 0;
     }
-    //最近一个定时器的执行延时
-    return it->first - now_time;
+    //最近一次需要处理定时器的延时，到期的任务已经取出，所以肯定大于0
+    return next_time - now_time;
 }
 
 uint64_t EventPoller::getMinDelay() {
-    auto it = _delay_task_map.begin();
-    if (it == _delay_task_map.end()) {
+    auto next_time = _delay_task_wheel.nextTime();
+    if (!next_time) {
         //没有剩余的定时器了
         return 0;
     }
     auto now = getCurrentMillisecond();
-    if (it->first > now) {
+    if (next_time > now) {
         //所有任务尚未到期
-        return it->first - now;
+        return next_time - now;
     }
     //执行已到期的任务并刷新休眠延时
     return flushDelayTask(now);
@@ -434,7 +558,7 @@ DelayTask::Ptr EventPoller::doDelayTask(uint64_t delayMS, function<uint64_t()> t
     auto time_line = getCurrentMillisecond() + delayMS;
     async_first([time_line, ret, this]() {
         //异步执行的目的是刷新select或epoll的休眠时间
-        _delay_task_map.emplace(time_line, ret);
+        _delay_task_wheel.add(time_line, ret);
     });
     return ret;
 }
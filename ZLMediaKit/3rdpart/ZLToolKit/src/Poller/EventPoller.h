@@ -16,11 +16,14 @@
 #include <string>
 #include <functional>
 #include <memory>
+#include <atomic>
 #include <unordered_map>
 #include "PipeWrap.h"
+#include "TimingWheel.h"
 #include "Util/logger.h"
 #include "Util/util.h"
 #include "Util/List.h"
+#include "Util/ResourcePool.h"
 #include "Thread/TaskExecutor.h"
 #include "Thread/ThreadPool.h"
 #include "Network/Buffer.h"
@@ -41,7 +44,6 @@ typedef enum {
 
 using PollEventCB = function<void(int event)>;
 using PollDelCB = function<void(bool success)>;
-using DelayTask = TaskCancelableImp<uint64_t(void)>;
 
 class EventPoller : public TaskExecutor, public AnyStorage, public std::enable_shared_from_this<EventPoller> {
 public:
@@ -98,6 +100,22 @@ public:
      */
     Task::Ptr async_first(TaskIn task, bool may_sync = true) override ;
 
+    /**
+     * 批量异步执行任务，整批任务只加一次锁、最多唤醒一次轮询线程
+     * @param tasks 任务列表
+     * @param may_sync 如果调用该函数的线程就是本对象的轮询线程，那么may_sync为true时就是同步执行任务
+     */
+    void asyncBatch(List<TaskIn> tasks, bool may_sync = true);
+
+    /**
+     * 在其他poller线程中调用时，任务先暂存在调用线程的队列中，
+     * 等调用线程本轮事件循环结束时再批量投递，这样同一轮循环中投递到本对象的多个任务只需加锁、唤醒一次;
+     * 在非poller线程中调用时等同于async(task, false)
+     * @param task 任务
+     * @return 可取消的任务本体
+     */
+    Task::Ptr asyncStaged(TaskIn task);
+
     /**
      * 判断执行该接口的线程是否为本对象的轮询线程
      * @return 是否为本对象的轮询线程
@@ -122,11 +140,28 @@ public:
      */
     BufferRaw::Ptr getSharedBuffer();
 
+    /**
+     * 获取当前线程下所有udp socket共享的批量读缓存(recvmmsg使用)
+     * 被上层持有(引用计数不为1)的缓存会从缓存池中替换成新的，确保返回的缓存都可以被安全覆盖
+     * 只能在poller线程调用
+     */
+    vector<BufferRaw::Ptr> &getSharedBufferList();
+
     /**
      * 获取poller线程id
      */
     const thread::id& getThreadId() const;
 
+    /**
+     * 获取轮询线程被跨线程任务唤醒的累计次数
+     */
+    uint64_t getWakeupCount() const;
+
+    /**
+     * 获取跨线程投递并执行的累计任务个数
+     */
+    uint64_t getAsyncTaskCount() const;
+
 private:
     /**
      * 本对象只允许在EventPollerPool中构造
@@ -145,6 +180,24 @@ private:
      */
     void onPipeEvent();
 
+    /**
+     * 唤醒轮询线程
+     */
+    void wakeup();
+
+    /**
+     * 把任务加入任务列队，只有列队由空变为非空时才唤醒轮询线程，
+     * 这样轮询线程处理完之前的连续投递只需要一次唤醒
+     * @param tasks 任务列表
+     * @param first 是否加入列队头
+     */
+    void addTasks(List<Task::Ptr> &tasks, bool first);
+
+    /**
+     * 批量投递本线程暂存的跨线程任务
+     */
+    void flushStagedTasks();
+
     /**
      * 切换线程并执行任务
      * @param task
@@ -188,6 +241,10 @@ private:
     bool _exit_flag;
     //当前线程下，所有socket共享的读缓存
     weak_ptr<BufferRaw> _shared_buffer;
+    //当前线程下，所有udp socket共享的批量读缓存
+    vector<BufferRaw::Ptr> _shared_buffer_list;
+    //批量读缓存被上层持有后，从此池中获取替换的缓存
+    std::shared_ptr<ResourcePool<BufferRaw> > _buffer_pool;
     //线程优先级
     ThreadPool::Priority _priority;
     //正在运行事件循环时该锁处于被锁定状态
@@ -199,11 +256,21 @@ private:
     //通知事件循环的线程已启动
     semaphore _sem_run_started;
 
+#if defined(HAS_EPOLL)
+    //内部事件通知，linux下使用eventfd，多次写入只需一次读取
+    int _event_fd = -1;
+#else
     //内部事件管道
     PipeWrap _pipe;
+#endif //HAS_EPOLL
     //从其他线程切换过来的任务
     mutex _mtx_task;
     List<Task::Ptr> _list_task;
+    //本线程投递到其他poller、尚未批量提交的任务，只在本轮询线程访问
+    unordered_map<EventPoller::Ptr, List<Task::Ptr> > _staged_task_map;
+    //唤醒次数与跨线程任务个数统计
+    atomic<uint64_t> _wakeup_count{0};
+    atomic<uint64_t> _async_task_count{0};
 
     //保持日志可用
     Logger::Ptr _logger;
@@ -223,8 +290,8 @@ private:
     unordered_map<int, Poll_Record::Ptr> _event_map;
 #endif //HAS_EPOLL
 
-    //定时器相关
-    multimap<uint64_t, DelayTask::Ptr> _delay_task_map;
+    //定时器相关，使用时间轮，添加与取消延时任务都为O(1)
+    TimingWheel _delay_task_wheel;
 };
 
 class EventPollerPool : public std::enable_shared_from_this<EventPollerPool>, public TaskExecutorGetterImp {
@@ -0,0 +1,166 @@
+﻿/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/xia-chu/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include "TimingWheel.h"
+#include "Util/util.h"
+
+#define NEAR_BITS 8
+#define NEAR_SIZE (1 << NEAR_BITS)
+#define NEAR_MASK (NEAR_SIZE - 1)
+#define FAR_BITS 6
+#define FAR_SIZE (1 << FAR_BITS)
+#define FAR_MASK (FAR_SIZE - 1)
+#define FAR_LEVEL 3
+//第level层(从0开始)每个槽的时长对应的位数
+#define FAR_SHIFT(level) (NEAR_BITS + (level) * FAR_BITS)
+//时间轮能容纳的最长时长
+#define MAX_SPAN ((1ULL << FAR_SHIFT(FAR_LEVEL)) - 1)
+
+namespace toolkit {
+
+TimingWheel::TimingWheel() {
+    _tick = getCurrentMillisecond();
+}
+
+size_t TimingWheel::size() const {
+    return _size;
+}
+
+void TimingWheel::add(uint64_t expire_ms, DelayTask::Ptr task) {
+    Entry entry;
+    entry.expire = expire_ms;
+    entry.task = std::move(task);
+    addEntry(std::move(entry));
+    ++_size;
+}
+
+void TimingWheel::addEntry(Entry &&entry) {
+    //已经过期的任务在下次处理时到期
+    auto expire = entry.expire < _tick ? _tick : entry.expire;
+    auto diff = expire - _tick;
+    if (diff < NEAR_SIZE) {
+        _near[expire & NEAR_MASK].emplace_back(std::move(entry));
+        ++_near_size;
+        if (_next_time && expire < _next_time) {
+            _next_time = expire;
+        }
+        return;
+    }
+
+    if (diff > MAX_SPAN) {
+        //超过时间轮的最长时长，先放在最外层，降层时重新计算位置
+        expire = _tick + MAX_SPAN;
+        diff = MAX_SPAN;
+    }
+    int level = 0;
+    while (diff >= (1ULL << FAR_SHIFT(level + 1))) {
+        ++level;
+    }
+    auto shift = FAR_SHIFT(level);
+    _far[level][(expire >> shift) & FAR_MASK].emplace_back(std::move(entry));
+    //该槽降层的时间点
+    auto cascade_time = (expire >> shift) << shift;
+    if (_next_time && cascade_time < _next_time) {
+        _next_time = cascade_time;
+    }
+}
+
+bool TimingWheel::cascade(int level) {
+    auto shift = FAR_SHIFT(level);
+    auto index = (_tick >> shift) & FAR_MASK;
+    Slot slot;
+    slot.swap(_far[level][index]);
+    while (!slot.empty()) {
+        auto &entry = slot.front();
+        if (*entry.task) {
+            //重新计算位置，放入更内层
+            addEntry(std::move(entry));
+        } else {
+            //已经取消的任务直接丢弃
+            --_size;
+        }
+        slot.pop_front();
+    }
+    //本层转完一圈时，外层也需要降层
+    return index == 0;
+}
+
+void TimingWheel::expire(uint64_t now_ms, List<DelayTask::Ptr> &out) {
+    _next_time = 0;
+    while (_tick <= now_ms) {
+        if (!_size) {
+            _tick = now_ms + 1;
+            break;
+        }
+        auto index = _tick & NEAR_MASK;
+        if (index == 0) {
+            for (int level = 0; level < FAR_LEVEL && cascade(level); ++level);
+        }
+        if (!_near_size) {
+            //第0层没有任务，直接跳到下一次降层的时间点
+            auto next_tick = (_tick | NEAR_MASK) + 1;
+            if (next_tick > now_ms) {
+                _tick = now_ms + 1;
+                break;
+            }
+            _tick = next_tick;
+            continue;
+        }
+        auto &slot = _near[index];
+        _near_size -= slot.size();
+        _size -= slot.size();
+        while (!slot.empty()) {
+            auto &entry = slot.front();
+            if (*entry.task) {
+                out.emplace_back(std::move(entry.task));
+            }
+            slot.pop_front();
+        }
+        ++_tick;
+    }
+}
+
+uint64_t TimingWheel::nextTime() {
+    if (!_size) {
+        return 0;
+    }
+    if (_next_time) {
+        return _next_time;
+    }
+    auto ret = UINT64_MAX;
+    if (_near_size) {
+        for (uint64_t i = 0; i < NEAR_SIZE; ++i) {
+            if (!_near[(_tick + i) & NEAR_MASK].empty()) {
+                ret = _tick + i;
+                break;
+            }
+        }
+    }
+    for (int level = 0; level < FAR_LEVEL; ++level) {
+        auto shift = FAR_SHIFT(level);
+        auto base = _tick >> shift;
+        //_tick刚好是尚未处理的降层时间点时，当前槽最先降层；否则当前槽已经降层过，其中的任务要等转完一圈
+        uint64_t begin = (base << shift) == _tick ? 0 : 1;
+        for (uint64_t i = begin; i < begin + FAR_SIZE; ++i) {
+            if (!_far[level][(base + i) & FAR_MASK].empty()) {
+                //该槽降层的时间点
+                auto cascade_time = (base + i) << shift;
+                if (cascade_time < ret) {
+                    ret = cascade_time;
+                }
+                break;
+            }
+        }
+    }
+    _next_time = ret;
+    return ret;
+}
+
+} /* namespace toolkit */
@@ -0,0 +1,84 @@
+﻿/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/xia-chu/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef ZLTOOLKIT_TIMINGWHEEL_H
+#define ZLTOOLKIT_TIMINGWHEEL_H
+
+#include <memory>
+#include "Util/List.h"
+#include "Thread/TaskExecutor.h"
+
+namespace toolkit {
+
+using DelayTask = TaskCancelableImp<uint64_t(void)>;
+
+/**
+ * 分层时间轮，添加与取消任务都为O(1)，用于EventPoller的延时任务
+ * 第0层256个槽，每槽1毫秒；第1~3层各64个槽，每槽为下一层转一圈的时长，最长约18.6小时，
+ * 更久的任务先放在最外层，降层时重新计算位置
+ * 任务取消后不立即移除，在降层或到期时丢弃
+ * 非线程安全，只能在所属的poller线程中使用
+ */
+class TimingWheel {
+public:
+    TimingWheel();
+    ~TimingWheel() = default;
+
+    /**
+     * 添加任务
+     * @param expire_ms 到期时间，单位毫秒，早于当前时间时在下次处理时到期
+     * @param task 任务
+     */
+    void add(uint64_t expire_ms, DelayTask::Ptr task);
+
+    /**
+     * 取出截止到now_ms已经到期的任务，按到期时间先后排序，已取消的任务直接丢弃
+     * @param now_ms 当前时间，单位毫秒
+     * @param out 到期的任务
+     */
+    void expire(uint64_t now_ms, List<DelayTask::Ptr> &out);
+
+    /**
+     * 获取下次需要处理的时间，可能早于最近任务的到期时间(此时只是降层)，但是不会晚于
+     * @return 单位毫秒，没有任务时返回0
+     */
+    uint64_t nextTime();
+
+    /**
+     * 任务个数，包括已取消但尚未丢弃的任务
+     */
+    size_t size() const;
+
+private:
+    class Entry {
+    public:
+        uint64_t expire;
+        DelayTask::Ptr task;
+    };
+
+    using Slot = List<Entry>;
+
+    void addEntry(Entry &&entry);
+    bool cascade(int level);
+
+private:
+    //下一个待处理的时间点
+    uint64_t _tick;
+    //缓存的下次处理时间，为0时需要重新计算
+    uint64_t _next_time = 0;
+    size_t _size = 0;
+    //第0层任务个数，为0时可以直接跳到下一次降层的时间点
+    size_t _near_size = 0;
+    Slot _near[256];
+    Slot _far[3][64];
+};
+
+} /* namespace toolkit */
+#endif /* ZLTOOLKIT_TIMINGWHEEL_H */
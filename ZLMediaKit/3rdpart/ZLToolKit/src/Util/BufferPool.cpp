@@ -0,0 +1,296 @@
+﻿/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/xia-chu/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <mutex>
+#include <atomic>
+#include <algorithm>
+#include "BufferPool.h"
+
+namespace toolkit {
+
+//最小级别64字节，逐级翻倍，最大级别64KB
+#define MIN_CLASS_SHIFT 6
+#define MAX_CLASS_SHIFT 16
+#define CLASS_COUNT (MAX_CLASS_SHIFT - MIN_CLASS_SHIFT + 1)
+
+//每个线程每个级别最多缓存512KB，块数在[8, 256]之间
+#define THREAD_CACHE_BYTES (512 * 1024)
+#define THREAD_CACHE_MIN_COUNT 8
+#define THREAD_CACHE_MAX_COUNT 256
+
+//线程命中次数累计到一定值后才合并到全局统计，避免每次分配都操作原子变量
+#define HIT_FLUSH_COUNT 256
+
+static atomic<bool> s_enable(true);
+static atomic<size_t> s_max_cache_size(16 * 1024 * 1024);
+
+static inline size_t getClassSize(int index) {
+    return (size_t) 1 << (index + MIN_CLASS_SHIFT);
+}
+
+//返回-1说明超过最大级别
+static inline int getClassIndex(size_t size) {
+    if (size <= getClassSize(0)) {
+        return 0;
+    }
+    if (size > getClassSize(CLASS_COUNT - 1)) {
+        return -1;
+    }
+#if defined(__GNUC__) || defined(__clang__)
+    return (int) (sizeof(unsigned long long) * 8 - __builtin_clzll(size - 1)) - MIN_CLASS_SHIFT;
+#else
+    int index = 0;
+    while (getClassSize(index) < size) {
+        ++index;
+    }
+    return index;
+#endif
+}
+
+//全局空闲链表，各线程空闲链表溢出时归还至此
+class SizeClass {
+public:
+    mutex mtx;
+    vector<void *> free_list;
+    atomic<uint64_t> hit{0};
+    atomic<uint64_t> miss{0};
+    atomic<size_t> blocks{0};
+
+    //从系统分配
+    char *allocBlock(int index) {
+        ++miss;
+        ++blocks;
+        return new char[getClassSize(index)];
+    }
+
+    //归还系统
+    void freeBlock(void *ptr) {
+        --blocks;
+        delete[] (char *) ptr;
+    }
+
+    size_t maxCacheCount(int index) const {
+        return s_max_cache_size / getClassSize(index);
+    }
+};
+
+static SizeClass *getSizeClasses() {
+    //故意不释放，程序退出时可能还有全局对象在释放内存
+    static SizeClass *s_classes = new SizeClass[CLASS_COUNT];
+    return s_classes;
+}
+
+//线程空闲链表
+class ThreadCache {
+public:
+    class FreeList {
+    public:
+        vector<void *> blocks;
+        size_t max_count = 0;
+        uint64_t hit = 0;
+    };
+
+    ThreadCache() {
+        for (int i = 0; i < CLASS_COUNT; ++i) {
+            auto &list = _lists[i];
+            list.max_count = std::min<size_t>(std::max<size_t>(THREAD_CACHE_BYTES / getClassSize(i), THREAD_CACHE_MIN_COUNT), THREAD_CACHE_MAX_COUNT);
+            list.blocks.reserve(list.max_count);
+        }
+    }
+
+    ~ThreadCache() {
+        //线程退出，全部归还到全局空闲链表
+        for (int i = 0; i < CLASS_COUNT; ++i) {
+            flush(i, _lists[i].blocks.size());
+        }
+    }
+
+    void *allocate(int index) {
+        auto &list = _lists[index];
+        auto &cls = getSizeClasses()[index];
+        if (list.blocks.empty()) {
+            //从全局空闲链表批量取回一半
+            lock_guard<mutex> lck(cls.mtx);
+            auto count = std::min(list.max_count / 2, cls.free_list.size());
+            list.blocks.insert(list.blocks.end(), cls.free_list.end() - count, cls.free_list.end());
+            cls.free_list.resize(cls.free_list.size() - count);
+        }
+        if (list.blocks.empty()) {
+            cls.hit += list.hit;
+            list.hit = 0;
+            return cls.allocBlock(index);
+        }
+        if (++list.hit >= HIT_FLUSH_COUNT) {
+            cls.hit += list.hit;
+            list.hit = 0;
+        }
+        auto ret = list.blocks.back();
+        list.blocks.pop_back();
+        return ret;
+    }
+
+    void deallocate(void *ptr, int index) {
+        auto &list = _lists[index];
+        if (list.blocks.size() >= list.max_count) {
+            //线程空闲链表已满，批量归还一半到全局空闲链表
+            flush(index, list.max_count / 2);
+        }
+        list.blocks.emplace_back(ptr);
+    }
+
+private:
+    void flush(int index, size_t count) {
+        auto &list = _lists[index];
+        auto &cls = getSizeClasses()[index];
+        cls.hit += list.hit;
+        list.hit = 0;
+        if (!count) {
+            return;
+        }
+        auto begin = list.blocks.end() - count;
+        {
+            lock_guard<mutex> lck(cls.mtx);
+            auto max_count = cls.maxCacheCount(index);
+            while (begin != list.blocks.end() && cls.free_list.size() < max_count) {
+                cls.free_list.emplace_back(*begin++);
+            }
+        }
+        //全局空闲链表已满，超过部分归还系统
+        for (auto it = begin; it != list.blocks.end(); ++it) {
+            cls.freeBlock(*it);
+        }
+        list.blocks.resize(list.blocks.size() - count);
+    }
+
+private:
+    FreeList _lists[CLASS_COUNT];
+};
+
+static thread_local ThreadCache *s_thread_cache = nullptr;
+static thread_local bool s_thread_exited = false;
+
+class ThreadCacheHolder {
+public:
+    ~ThreadCacheHolder() {
+        auto cache = s_thread_cache;
+        s_thread_cache = nullptr;
+        s_thread_exited = true;
+        delete cache;
+    }
+};
+
+//线程退出后(线程局部变量析构之后)返回nullptr
+static ThreadCache *getThreadCache() {
+    if (s_thread_cache) {
+        return s_thread_cache;
+    }
+    if (s_thread_exited) {
+        return nullptr;
+    }
+    static thread_local ThreadCacheHolder s_holder;
+    s_thread_cache = new ThreadCache;
+    return s_thread_cache;
+}
+
+char *BufferPool::allocate(size_t size, size_t &capacity) {
+    auto index = getClassIndex(size);
+    if (index < 0) {
+        capacity = size;
+        return new char[size];
+    }
+    //关闭内存池时也按级别大小分配，这样重新开启后可以直接回收
+    capacity = getClassSize(index);
+    auto &cls = getSizeClasses()[index];
+    if (!s_enable) {
+        return cls.allocBlock(index);
+    }
+    auto cache = getThreadCache();
+    if (cache) {
+        return (char *) cache->allocate(index);
+    }
+    {
+        lock_guard<mutex> lck(cls.mtx);
+        if (!cls.free_list.empty()) {
+            auto ret = cls.free_list.back();
+            cls.free_list.pop_back();
+            ++cls.hit;
+            return (char *) ret;
+        }
+    }
+    return cls.allocBlock(index);
+}
+
+void BufferPool::deallocate(void *ptr, size_t size) {
+    if (!ptr) {
+        return;
+    }
+    auto index = getClassIndex(size);
+    if (index < 0) {
+        delete[] (char *) ptr;
+        return;
+    }
+    auto &cls = getSizeClasses()[index];
+    if (!s_enable) {
+        cls.freeBlock(ptr);
+        return;
+    }
+    auto cache = getThreadCache();
+    if (cache) {
+        cache->deallocate(ptr, index);
+        return;
+    }
+    {
+        lock_guard<mutex> lck(cls.mtx);
+        if (cls.free_list.size() < cls.maxCacheCount(index)) {
+            cls.free_list.emplace_back(ptr);
+            return;
+        }
+    }
+    cls.freeBlock(ptr);
+}
+
+void BufferPool::setEnable(bool enable) {
+    s_enable = enable;
+    if (enable) {
+        return;
+    }
+    //线程空闲链表在线程退出时释放
+    for (int i = 0; i < CLASS_COUNT; ++i) {
+        auto &cls = getSizeClasses()[i];
+        vector<void *> free_list;
+        {
+            lock_guard<mutex> lck(cls.mtx);
+            free_list.swap(cls.free_list);
+        }
+        for (auto ptr : free_list) {
+            cls.freeBlock(ptr);
+        }
+    }
+}
+
+void BufferPool::setMaxCacheSize(size_t bytes) {
+    s_max_cache_size = bytes;
+}
+
+vector<BufferPool::Statistic> BufferPool::getStatistic() {
+    vector<Statistic> ret;
+    for (int i = 0; i < CLASS_COUNT; ++i) {
+        auto &cls = getSizeClasses()[i];
+        Statistic stat;
+        stat.size = getClassSize(i);
+        stat.hit = cls.hit;
+        stat.miss = cls.miss;
+        stat.resident_bytes = cls.blocks * stat.size;
+        ret.emplace_back(stat);
+    }
+    return ret;
+}
+
+} /* namespace toolkit */
@@ -0,0 +1,74 @@
+﻿/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/xia-chu/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef UTIL_BUFFERPOOL_H_
+#define UTIL_BUFFERPOOL_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+using namespace std;
+
+namespace toolkit {
+
+/**
+ * 按大小分级的内存池，Buffer对象本身及BufferRaw的数据内存都从这里分配
+ * 内存块从64字节开始逐级翻倍直到64KB，更大的内存直接从系统分配
+ * 每个线程每个级别都有独立的空闲链表，分配释放无需加锁；
+ * 数据包一般在一个线程生成，在另外一个线程释放，所以线程空闲链表满后会批量归还到全局空闲链表，
+ * 其他线程空闲链表为空时再从全局空闲链表批量取回，实现跨线程复用
+ */
+class BufferPool {
+public:
+    class Statistic {
+    public:
+        //该级别内存块大小
+        size_t size = 0;
+        //从空闲链表分配的次数
+        uint64_t hit = 0;
+        //空闲链表为空，从系统分配的次数
+        uint64_t miss = 0;
+        //该级别从系统分配且尚未归还系统的内存字节数(包括使用中与空闲的)
+        size_t resident_bytes = 0;
+    };
+
+    /**
+     * 申请内存
+     * @param size 请求的字节数
+     * @param capacity 返回实际可用字节数，大于等于size
+     */
+    static char *allocate(size_t size, size_t &capacity);
+
+    /**
+     * 释放内存
+     * @param ptr allocate返回的指针
+     * @param size 申请时请求的字节数或返回的capacity
+     */
+    static void deallocate(void *ptr, size_t size);
+
+    /**
+     * 开启或关闭内存池，默认开启
+     * 关闭后内存直接从系统分配并归还系统，并立即释放全局空闲链表
+     */
+    static void setEnable(bool enable);
+
+    /**
+     * 设置每个级别全局空闲链表最多缓存的字节数，超过部分归还系统，默认16MB
+     */
+    static void setMaxCacheSize(size_t bytes);
+
+    /**
+     * 获取各级别统计信息
+     */
+    static vector<Statistic> getStatistic();
+};
+
+} /* namespace toolkit */
+#endif /* UTIL_BUFFERPOOL_H_ */
@@ -194,8 +194,8 @@ public:
         if (other.empty()) {
             return;
         }
-        this->insert(this->end(), other.begin(), other.end());
-        other.clear();
+        //直接转移节点，不拷贝元素也不重新分配内存
+        this->splice(this->end(), other);
     }
 
     template<typename FUNC>
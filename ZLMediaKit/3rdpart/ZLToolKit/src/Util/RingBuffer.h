@@ -14,6 +14,7 @@
 #include <atomic>
 #include <memory>
 #include <mutex>
+#include <vector>
 #include <unordered_map>
 #include <condition_variable>
 #include <functional>
@@ -42,6 +43,9 @@ class _RingStorage;
 template<typename T>
 class _RingReaderDispatcher;
 
+template<typename T>
+class _RingSlots;
+
 /**
 * 环形缓存读取器
 * 该对象的事件触发都会在绑定的poller线程中执行
@@ -55,8 +59,8 @@ public:
     typedef std::shared_ptr<_RingReader> Ptr;
     friend class _RingReaderDispatcher<T>;
 
-    _RingReader(const std::shared_ptr<_RingStorage<T> > &storage, bool use_cache) {
-        _storage = storage;
+    _RingReader(const std::weak_ptr<_RingReaderDispatcher<T> > &dispatcher, bool use_cache) {
+        _dispatcher = dispatcher;
         _use_cache = use_cache;
     }
 
@@ -92,14 +96,16 @@ private:
         if (!_use_cache) {
             return;
         }
-        _storage->getCache().for_each([&](const pair<bool, T> &pr) {
-            onRead(pr.second, pr.first);
-        });
+        auto dispatcher = _dispatcher.lock();
+        if (dispatcher) {
+            //gop缓存可能是本poller私有的拷贝，也可能是所有poller共享的槽位数组，由派发器决定
+            dispatcher->flushGop(this);
+        }
     }
 
 private:
     bool _use_cache;
-    shared_ptr<_RingStorage<T> > _storage;
+    weak_ptr<_RingReaderDispatcher<T> > _dispatcher;
     function<void(void)> _detach_cb = []() {};
     function<void(const T &)> _read_cb = [](const T &) {};
 };
@@ -174,6 +180,154 @@ private:
     List<pair<bool, T> > _data_cache;
 };
 
+/**
+ * 单生产者多消费者(SPMC)无锁环形槽位数组
+ * 生产者把数据按递增序号写入共享槽位，各poller线程在自己被唤醒时按序号批量读取，
+ * 同时该数组也是所有poller共享的gop缓存(引用计数，不再为每个poller克隆一份)
+ * write/clearCache只能在同一个线程(生产者)调用，read/forEachGop可以在任意线程调用
+ * @tparam T
+ */
+template<typename T>
+class _RingSlots {
+public:
+    typedef std::shared_ptr<_RingSlots> Ptr;
+    static constexpr uint64_t kInvalidSeq = UINT64_MAX;
+
+    _RingSlots(int max_size) {
+        //gop缓存个数不能小于32
+        if (max_size < RING_MIN_SIZE) {
+            max_size = RING_MIN_SIZE;
+        }
+        _max_size = max_size;
+        //槽位个数为2的幂，且不小于gop缓存长度的2倍，保证整个gop始终留在环内并给慢速poller留有余量
+        size_t capacity = 1;
+        while (capacity < 2 * (size_t) max_size) {
+            capacity <<= 1;
+        }
+        _mask = capacity - 1;
+        _slots.reset(new Slot[capacity]);
+    }
+
+    ~_RingSlots() {}
+
+    /**
+     * 写入数据，只能由生产者线程调用
+     * @param in 数据
+     * @param is_key 是否为关键帧
+     */
+    void write(T in, bool is_key = true) {
+        auto seq = _write_seq.load(memory_order_relaxed);
+        auto &slot = _slots[seq & _mask];
+        {
+            SlotLock lock(slot);
+            //被覆盖的老数据交换到in中，在解锁后再释放
+            std::swap(slot.data, in);
+            slot.is_key = is_key;
+            slot.seq = seq;
+        }
+
+        if (is_key) {
+            //遇到I帧，那么gop从此处开始
+            _gop_size = 0;
+            _gop_begin = seq;
+        }
+        if (_gop_begin.load(memory_order_relaxed) != kInvalidSeq && ++_gop_size > _max_size) {
+            //GOP缓存溢出，等待下一个关键帧
+            _gop_begin = kInvalidSeq;
+        }
+        //发布数据，此后消费者可见
+        _write_seq = seq + 1;
+    }
+
+    /**
+     * 读取某序号的数据
+     * @param seq 序号
+     * @param out 数据
+     * @param is_key 是否为关键帧
+     * @return 该序号的数据是否还在环内(未写入或已被覆盖返回false)
+     */
+    bool read(uint64_t seq, T &out, bool &is_key) const {
+        auto &slot = _slots[seq & _mask];
+        SlotLock lock(slot);
+        if (slot.seq != seq) {
+            return false;
+        }
+        out = slot.data;
+        is_key = slot.is_key;
+        return true;
+    }
+
+    /**
+     * 遍历gop缓存中序号小于end的数据
+     * @param end 截止序号(不包含)，一般为消费者的读取位置
+     */
+    template<typename FUNC>
+    void forEachGop(uint64_t end, FUNC &&func) const {
+        auto begin = _gop_begin.load();
+        if (begin == kInvalidSeq) {
+            return;
+        }
+        T data;
+        bool is_key;
+        for (auto seq = begin; seq < end; ++seq) {
+            if (read(seq, data, is_key)) {
+                func(data, is_key);
+            }
+        }
+    }
+
+    /**
+     * 下一个待写入的序号，亦即已发布数据的个数
+     */
+    uint64_t writeSeq() const {
+        return _write_seq.load();
+    }
+
+    /**
+     * 槽位个数
+     */
+    size_t capacity() const {
+        return _mask + 1;
+    }
+
+    void clearCache() {
+        _gop_begin = kInvalidSeq;
+    }
+
+private:
+    struct Slot {
+        //仅在拷贝/交换数据时持有，临界区只有几条指令
+        atomic<bool> busy{false};
+        bool is_key = false;
+        uint64_t seq = kInvalidSeq;
+        T data;
+    };
+
+    class SlotLock {
+    public:
+        SlotLock(Slot &slot) : _slot(slot) {
+            while (_slot.busy.exchange(true, memory_order_acquire)) {
+                this_thread::yield();
+            }
+        }
+
+        ~SlotLock() {
+            _slot.busy.store(false, memory_order_release);
+        }
+
+    private:
+        Slot &_slot;
+    };
+
+private:
+    int _max_size;
+    int _gop_size = 0;
+    size_t _mask;
+    std::unique_ptr<Slot[]> _slots;
+    atomic<uint64_t> _write_seq{0};
+    atomic<uint64_t> _gop_begin{kInvalidSeq};
+};
+
 template<typename T>
 class RingBuffer;
 
@@ -187,8 +341,10 @@ public:
     typedef std::shared_ptr<_RingReaderDispatcher> Ptr;
     typedef _RingReader<T> RingReader;
     typedef _RingStorage<T> RingStorage;
+    typedef _RingSlots<T> RingSlots;
 
     friend class RingBuffer<T>;
+    friend class _RingReader<T>;
 
     ~_RingReaderDispatcher() {
         decltype(_reader_map) reader_map;
@@ -208,7 +364,54 @@ private:
         _on_size_changed = onSizeChanged;
     }
 
+    _RingReaderDispatcher(const typename RingSlots::Ptr &slots, const function<void(int, bool)> &onSizeChanged) {
+        _slots = slots;
+        _read_seq = slots->writeSeq();
+        _reader_size = 0;
+        _on_size_changed = onSizeChanged;
+    }
+
     void write(T in, bool is_key = true) {
+        dispatch(in, is_key);
+        _storage->write(std::move(in), is_key);
+    }
+
+    /**
+     * SPMC模式下，生产者写入数据后调用，同一时刻最多只有一个消费任务在poller中排队
+     */
+    void notifyWrite(const EventPoller::Ptr &poller) {
+        if (_pending.exchange(true)) {
+            //已经有消费任务在排队，该任务会把本次写入的数据一并消费
+            return;
+        }
+        auto strongSelf = this->shared_from_this();
+        poller->asyncStaged([strongSelf]() {
+            strongSelf->drain();
+        });
+    }
+
+    /**
+     * SPMC模式下，在poller线程中批量消费共享槽位中的数据
+     */
+    void drain() {
+        //先清除标记再读取写入位置，确保之后的写入一定会再次触发消费任务
+        _pending = false;
+        auto end = _slots->writeSeq();
+        if (end - _read_seq > _slots->capacity()) {
+            //本poller过于繁忙，被生产者套圈，跳过已经被覆盖的数据
+            WarnL << "ring reader dispatcher lagged behind, drop " << end - _read_seq - _slots->capacity() << " items";
+            _read_seq = end - _slots->capacity();
+        }
+        T data;
+        bool is_key;
+        for (; _read_seq < end; ++_read_seq) {
+            if (_slots->read(_read_seq, data, is_key)) {
+                dispatch(data, is_key);
+            }
+        }
+    }
+
+    void dispatch(const T &in, bool is_key) {
         for (auto it = _reader_map.begin(); it != _reader_map.end();) {
             auto reader = it->second.lock();
             if (!reader) {
@@ -220,7 +423,19 @@ private:
             reader->onRead(in, is_key);
             ++it;
         }
-        _storage->write(std::move(in), is_key);
+    }
+
+    void flushGop(RingReader *reader) {
+        if (_slots) {
+            //只回放本poller已经派发过的数据，之后的数据由drain派发
+            _slots->forEachGop(_read_seq, [&](const T &data, bool is_key) {
+                reader->onRead(data, is_key);
+            });
+            return;
+        }
+        _storage->getCache().for_each([&](const pair<bool, T> &pr) {
+            reader->onRead(pr.second, pr.first);
+        });
     }
 
     std::shared_ptr<RingReader> attach(const EventPoller::Ptr &poller, bool use_cache) {
@@ -240,7 +455,7 @@ private:
             });
         };
 
-        std::shared_ptr<RingReader> reader(new RingReader(_storage, use_cache), on_dealloc);
+        std::shared_ptr<RingReader> reader(new RingReader(weakSelf, use_cache), on_dealloc);
         _reader_map[reader.get()] = std::move(reader);
         ++_reader_size;
         onSizeChanged(true);
@@ -262,6 +477,12 @@ private:
     function<void(int, bool)> _on_size_changed;
     typename RingStorage::Ptr _storage;
     unordered_map<void *, std::weak_ptr<RingReader> > _reader_map;
+    //以下为SPMC模式相关
+    typename RingSlots::Ptr _slots;
+    //本poller的读取位置，只在poller线程中访问
+    uint64_t _read_seq = 0;
+    //是否已经有消费任务在poller中排队
+    atomic<bool> _pending{false};
 };
 
 template<typename T>
@@ -271,11 +492,23 @@ public:
     typedef _RingReader<T> RingReader;
     typedef _RingStorage<T> RingStorage;
     typedef _RingReaderDispatcher<T> RingReaderDispatcher;
+    typedef _RingSlots<T> RingSlots;
     typedef function<void(int size)> onReaderChanged;
 
-    RingBuffer(int max_size = 1024, const onReaderChanged &cb = nullptr) {
+    /**
+     * 构造函数
+     * @param max_size gop缓存最大长度
+     * @param cb 读取器个数变化回调
+     * @param spmc 是否使用单生产者多消费者无锁模式，
+     *             该模式下每个poller每次唤醒批量消费，gop缓存在所有poller间共享，但是write必须在同一个线程调用
+     */
+    RingBuffer(int max_size = 1024, const onReaderChanged &cb = nullptr, bool spmc = false) {
         _on_reader_changed = cb;
-        _storage = std::make_shared<RingStorage>(max_size);
+        if (spmc) {
+            _slots = std::make_shared<RingSlots>(max_size);
+        } else {
+            _storage = std::make_shared<RingStorage>(max_size);
+        }
     }
 
     ~RingBuffer() {}
@@ -286,13 +519,25 @@ public:
             return;
         }
 
+        if (_slots) {
+            _slots->write(std::move(in), is_key);
+            //无锁获取派发器快照，每个poller最多投递一个消费任务
+            auto dispatchers = std::atomic_load(&_dispatcher_list);
+            if (dispatchers) {
+                for (auto &pr : *dispatchers) {
+                    pr.second->notifyWrite(pr.first);
+                }
+            }
+            return;
+        }
+
         LOCK_GUARD(_mtx_map);
         for (auto &pr : _dispatcher_map) {
             auto &second = pr.second;
-            //切换线程后触发onRead事件
-            pr.first->async([second, in, is_key]() {
+            //切换线程后触发onRead事件，同一轮事件循环中的写入合并投递
+            pr.first->asyncStaged([second, in, is_key]() {
                 second->write(std::move(const_cast<T &>(in)), is_key);
-            }, false);
+            });
         }
         _storage->write(std::move(in), is_key);
     }
@@ -321,7 +566,12 @@ public:
                         delete ptr;
                     });
                 };
-                ref.reset(new RingReaderDispatcher(_storage->clone(), std::move(onSizeChanged)), std::move(onDealloc));
+                if (_slots) {
+                    ref.reset(new RingReaderDispatcher(_slots, std::move(onSizeChanged)), std::move(onDealloc));
+                } else {
+                    ref.reset(new RingReaderDispatcher(_storage->clone(), std::move(onSizeChanged)), std::move(onDealloc));
+                }
+                updateDispatcherList();
             }
             dispatcher = ref;
         }
@@ -333,15 +583,24 @@ public:
         return _total_count;
     }
 
+    bool isSpmc() const {
+        return _slots != nullptr;
+    }
+
     void clearCache(){
+        if (_slots) {
+            //gop缓存为所有poller共享，清空一次即可
+            _slots->clearCache();
+            return;
+        }
         LOCK_GUARD(_mtx_map);
         _storage->clearCache();
         for (auto &pr : _dispatcher_map) {
             auto &second = pr.second;
-            //切换线程后清空缓存
-            pr.first->async([second]() {
+            //切换线程后清空缓存，与write保持相同的投递顺序
+            pr.first->asyncStaged([second]() {
                 second->clearCache();
-            }, false);
+            });
         }
     }
 
@@ -350,6 +609,7 @@ private:
         if (size == 0) {
             LOCK_GUARD(_mtx_map);
             _dispatcher_map.erase(poller);
+            updateDispatcherList();
         }
 
         if (add_flag) {
@@ -363,6 +623,17 @@ private:
         }
     }
 
+    /**
+     * SPMC模式下，派发器增删时重新生成供write线程无锁读取的快照，调用者需持有_mtx_map
+     */
+    void updateDispatcherList() {
+        if (!_slots) {
+            return;
+        }
+        auto dispatchers = std::make_shared<DispatcherList>(_dispatcher_map.begin(), _dispatcher_map.end());
+        std::atomic_store(&_dispatcher_list, std::shared_ptr<const DispatcherList>(std::move(dispatchers)));
+    }
+
 private:
     struct HashOfPtr {
         std::size_t operator()(const EventPoller::Ptr &key) const {
@@ -377,6 +648,10 @@ private:
     typename RingDelegate<T>::Ptr _delegate;
     onReaderChanged _on_reader_changed;
     unordered_map<EventPoller::Ptr, typename RingReaderDispatcher::Ptr, HashOfPtr> _dispatcher_map;
+    //以下为SPMC模式相关
+    typedef vector<pair<EventPoller::Ptr, typename RingReaderDispatcher::Ptr> > DispatcherList;
+    typename RingSlots::Ptr _slots;
+    std::shared_ptr<const DispatcherList> _dispatcher_list;
 };
 
 } /* namespace toolkit */
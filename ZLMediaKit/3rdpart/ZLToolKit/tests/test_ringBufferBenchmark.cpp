@@ -0,0 +1,117 @@
+﻿/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/xia-chu/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <signal.h>
+#include <atomic>
+#include <new>
+#include <cstdlib>
+#include <iostream>
+#include "Util/logger.h"
+#include "Util/TimeTicker.h"
+#include "Util/RingBuffer.h"
+#include "Poller/EventPoller.h"
+
+using namespace std;
+using namespace toolkit;
+
+//统计全局内存分配次数
+static atomic<uint64_t> s_alloc_count(0);
+
+void *operator new(size_t size) {
+    ++s_alloc_count;
+    auto ptr = malloc(size ? size : 1);
+    if (!ptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void operator delete(void *ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept {
+    free(ptr);
+}
+
+typedef std::shared_ptr<string> Packet;
+typedef RingBuffer<Packet> RingType;
+
+//每轮写入的数据个数
+static constexpr int kPacketCount = 100 * 1000;
+//每批写入的数据个数，需小于环形缓存长度，防止spmc模式下慢速poller被套圈
+static constexpr int kBurstSize = 256;
+//gop长度
+static constexpr int kGopSize = 50;
+
+static void bench(const vector<EventPoller::Ptr> &pollers, int reader_count, bool spmc) {
+    auto ring = std::make_shared<RingType>(1024, nullptr, spmc);
+    atomic<uint64_t> received(0);
+    vector<RingType::RingReader::Ptr> readers(reader_count);
+    for (int i = 0; i < reader_count; ++i) {
+        auto &poller = pollers[i % pollers.size()];
+        poller->sync([&]() {
+            readers[i] = ring->attach(poller, false);
+            readers[i]->setReadCB([&received](const Packet &pkt) {
+                ++received;
+            });
+        });
+    }
+
+    //所有数据共用一个负载，只统计环形缓存自身的内存分配
+    auto pkt = std::make_shared<string>(1024, 'a');
+    auto alloc_begin = s_alloc_count.load();
+    Ticker ticker;
+    for (int i = 0; i < kPacketCount;) {
+        //突发写入一批数据，然后等待所有读取器消费完毕
+        for (int j = 0; j < kBurstSize && i < kPacketCount; ++j, ++i) {
+            ring->write(pkt, i % kGopSize == 0);
+        }
+        uint64_t expected = (uint64_t) i * reader_count;
+        while (received < expected) {
+            this_thread::yield();
+        }
+    }
+    auto elapsed_ms = ticker.elapsedTime();
+    auto allocs = s_alloc_count.load() - alloc_begin;
+
+    InfoL << (spmc ? "spmc  " : "legacy") << " readers:" << reader_count
+          << " packets/sec:" << (uint64_t) (kPacketCount * 1000.0 / (elapsed_ms ? elapsed_ms : 1))
+          << " allocs/packet:" << (double) allocs / kPacketCount
+          << " cost:" << elapsed_ms << "ms";
+
+    for (int i = 0; i < reader_count; ++i) {
+        pollers[i % pollers.size()]->sync([&]() {
+            readers[i] = nullptr;
+        });
+    }
+}
+
+int main(int argc, char *argv[]) {
+    signal(SIGINT, [](int) {
+        exit(0);
+    });
+    //初始化日志系统
+    Logger::Instance().add(std::make_shared<ConsoleChannel>());
+    Logger::Instance().setWriter(std::make_shared<AsyncLogWriter>());
+
+    //默认模拟16个poller线程
+    EventPollerPool::setPoolSize(argc > 1 ? atoi(argv[1]) : 16);
+    vector<EventPoller::Ptr> pollers;
+    EventPollerPool::Instance().for_each([&](const TaskExecutor::Ptr &executor) {
+        pollers.emplace_back(dynamic_pointer_cast<EventPoller>(executor));
+    });
+
+    for (auto reader_count : {1, 16, 100, 500, 2000}) {
+        bench(pollers, reader_count, false);
+        bench(pollers, reader_count, true);
+    }
+    return 0;
+}
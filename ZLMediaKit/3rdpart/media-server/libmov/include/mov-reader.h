@@ -39,6 +39,13 @@ typedef void* (*mov_onalloc)(void* param, int bytes);
 /// @return 1-read one frame, 0-EOF, <0-error
 int mov_reader_read2(mov_reader_t* mov, mov_onalloc onalloc,  mov_reader_onread onread, void* param);
 
+/// sample index callback, don't read sample data
+/// @param[in] offset sample data offset in file
+typedef void (*mov_reader_onindex)(void* param, uint32_t track, uint64_t offset, size_t bytes, int64_t pts, int64_t dts, int flags);
+/// walk all samples in mov_reader_read order, read position is not changed
+/// @return >=0-sample count, <0-error
+int mov_reader_index(mov_reader_t* mov, mov_reader_onindex onindex, void* param);
+
 /// @param[in,out] timestamp input seek timestamp, output seek location timestamp
 /// @return 0-ok, other-error
 int mov_reader_seek(mov_reader_t* mov, int64_t* timestamp);
@@ -468,6 +468,42 @@ int mov_reader_read2(mov_reader_t* reader, mov_onalloc onalloc,  mov_reader_onre
     return 1;
 }
 
+int mov_reader_index(mov_reader_t* reader, mov_reader_onindex onindex, void* param)
+{
+    int i, count;
+    size_t* offsets;
+    struct mov_track_t* track;
+    struct mov_sample_t* sample;
+
+    offsets = (size_t*)calloc(reader->mov.track_count + 1, sizeof(size_t));
+    if (NULL == offsets)
+        return -ENOMEM;
+
+    for (i = 0; i < reader->mov.track_count; i++)
+    {
+        offsets[i] = reader->mov.tracks[i].sample_offset;
+        reader->mov.tracks[i].sample_offset = 0;
+    }
+
+    count = 0;
+    while (1)
+    {
+        track = mov_reader_next(reader);
+        if (NULL == track || 0 == track->mdhd.timescale)
+            break; // EOF
+
+        sample = &track->samples[track->sample_offset++];
+        onindex(param, track->tkhd.track_ID, sample->offset, sample->bytes, sample->pts * 1000 / track->mdhd.timescale, sample->dts * 1000 / track->mdhd.timescale, sample->flags);
+        count++;
+    }
+
+    // restore read position
+    for (i = 0; i < reader->mov.track_count; i++)
+        reader->mov.tracks[i].sample_offset = offsets[i];
+    free(offsets);
+    return count;
+}
+
 int mov_reader_seek(struct mov_reader_t* reader, int64_t* timestamp)
 {
 	int i;
@@ -22,17 +22,24 @@
 #endif //ENABLE_MYSQL
 #include "Common/config.h"
 #include "Common/MediaSource.h"
+#include "Common/FrameGopCache.h"
+#include "Common/StreamLatency.h"
 #include "Http/HttpRequester.h"
 #include "Http/HttpSession.h"
+#include "Http/HttpFileCache.h"
 #include "Network/TcpServer.h"
 #include "Network/UdpServer.h"
 #include "Player/PlayerProxy.h"
+#include "Player/EdgeProxy.h"
 #include "Pusher/PusherProxy.h"
 #include "Util/MD5.h"
+#include "Util/BufferPool.h"
 #include "WebApi.h"
 #include "WebHook.h"
 #include "Thread/WorkThreadPool.h"
 #include "Rtp/RtpSelector.h"
+#include "Record/AsyncFileWriter.h"
+#include "Record/MP4Index.h"
 #include "FFmpegSource.h"
 #if defined(ENABLE_RTPPROXY)
 #include "Rtp/RtpServer.h"
@@ -291,6 +298,43 @@ static inline string getPusherKey(const string &schema, const string &vhost, con
     return schema + "/" + vhost + "/" + app + "/" + stream + "/" + MD5(dst_url).hexdigest();
 }
 
+/**
+ * 获取各poller线程的跨线程任务唤醒统计，速率为距离上次查询期间的平均值
+ * 返回数组顺序与EventPollerPool::getExecutorLoad()一致
+ */
+static Value getPollerWakeupStatistic() {
+    static mutex s_mtx;
+    static Ticker s_ticker;
+    static vector<pair<uint64_t, uint64_t> > s_last;
+
+    lock_guard<mutex> lck(s_mtx);
+    auto elapsed_ms = s_ticker.elapsedTime();
+    s_ticker.resetTime();
+
+    Value ret(arrayValue);
+    size_t i = 0;
+    EventPollerPool::Instance().for_each([&](const TaskExecutor::Ptr &executor) {
+        auto poller = dynamic_pointer_cast<EventPoller>(executor);
+        uint64_t wakeups = poller->getWakeupCount();
+        uint64_t tasks = poller->getAsyncTaskCount();
+        if (s_last.size() <= i) {
+            s_last.emplace_back(0, 0);
+        }
+        auto delta_wakeups = wakeups - s_last[i].first;
+        auto delta_tasks = tasks - s_last[i].second;
+        s_last[i] = std::make_pair(wakeups, tasks);
+        ++i;
+
+        Value obj(objectValue);
+        obj["wakeups"] = (Json::UInt64) wakeups;
+        obj["tasks"] = (Json::UInt64) tasks;
+        obj["tasks_per_wakeup"] = delta_wakeups ? (double) delta_tasks / delta_wakeups : 0.0;
+        obj["wakeups_per_sec"] = elapsed_ms ? delta_wakeups * 1000.0 / elapsed_ms : 0.0;
+        ret.append(obj);
+    });
+    return ret;
+}
+
 Value makeMediaSourceJson(MediaSource &media){
     Value item;
     item["schema"] = media.getSchema();
@@ -307,6 +351,12 @@ Value makeMediaSourceJson(MediaSource &media){
     item["originUrl"] = media.getOriginUrl();
     item["isRecordingMP4"] = media.isRecording(Recorder::type_mp4);
     item["isRecordingHLS"] = media.isRecording(Recorder::type_hls);
+    item["gopCacheBytes"] = (Json::UInt64) media.getGopCacheBytes();
+    //合并写窗口与每秒刷新次数，每次刷新每个观看者一般对应一次writev，据此估算每秒发送系统调用次数(非实测值)
+    auto flush_speed = media.getFlushSpeed();
+    item["mergeWriteMS"] = media.getMergeWriteMS();
+    item["flushPerSecond"] = flush_speed;
+    item["estimatedSyscallsPerSecond"] = flush_speed * media.readerCount();
     auto originSock = media.getOriginSock();
     if (originSock) {
         item["originSock"]["local_ip"] = originSock->get_local_ip();
@@ -370,6 +420,79 @@ Value getStatisticJson() {
 
     val["RtpPacket"] = (Json::UInt64)(ObjectStatistic<RtpPacket>::count());
     val["RtmpPacket"] = (Json::UInt64)(ObjectStatistic<RtmpPacket>::count());
+
+#ifdef ENABLE_MP4
+    //mp4点播共享的索引个数
+    val["MP4Index"] = (Json::UInt64) MP4Index::getIndexCount();
+#endif
+
+    //所有流共享gop缓存占用的内存
+    val["FrameGopCacheBytes"] = (Json::UInt64) FrameGopCache::getTotalBytes();
+
+    //内存池各级别命中率与占用内存
+    for (auto &stat : BufferPool::getStatistic()) {
+        Value obj(objectValue);
+        obj["size"] = (Json::UInt64) stat.size;
+        obj["hit"] = (Json::UInt64) stat.hit;
+        obj["miss"] = (Json::UInt64) stat.miss;
+        obj["hitRate"] = stat.hit + stat.miss ? (double) stat.hit / (stat.hit + stat.miss) : 0.0;
+        obj["residentBytes"] = (Json::UInt64) stat.resident_bytes;
+        val["BufferPool"].append(obj);
+    }
+
+    //http静态文件热点缓存
+    {
+        auto stat = HttpFileCache::Instance().getStatistic();
+        Value obj(objectValue);
+        obj["files"] = (Json::UInt64) stat.files;
+        obj["bytes"] = (Json::UInt64) stat.bytes;
+        obj["hit"] = (Json::UInt64) stat.hit;
+        obj["miss"] = (Json::UInt64) stat.miss;
+        obj["hitRate"] = stat.hit + stat.miss ? (double) stat.hit / (stat.hit + stat.miss) : 0.0;
+        val["HttpFileCache"] = obj;
+    }
+
+    //边缘节点从源站拉流与复用情况
+    {
+        auto stat = EdgeManager::Instance().getStatistic();
+        Value obj(objectValue);
+        obj["edges"] = (Json::UInt64) stat.edges;
+        obj["pending"] = (Json::UInt64) stat.pending;
+        obj["originFetches"] = (Json::UInt64) stat.origin_fetches;
+        obj["originFailures"] = (Json::UInt64) stat.origin_failures;
+        obj["coalesced"] = (Json::UInt64) stat.coalesced;
+        obj["edgeHits"] = (Json::UInt64) stat.edge_hits;
+        obj["idleCloses"] = (Json::UInt64) stat.idle_closes;
+        val["Edge"] = obj;
+    }
+
+    //tcp服务器各poller线程accept的连接数
+    for (auto &stat : TcpServer::getAcceptStatistic()) {
+        Value obj(objectValue);
+        obj["port"] = stat.port;
+        obj["reusePort"] = stat.reuse_port;
+        for (auto count : stat.accepts) {
+            obj["accepts"].append((Json::UInt64) count);
+        }
+        val["TcpServerAccept"].append(obj);
+    }
+
+    //录制异步写文件的排队情况与写入耗时(微秒)分布
+    for (auto &stat : AsyncFileWriter::getStatistic()) {
+        Value obj(objectValue);
+        obj["path"] = stat.path;
+        obj["backend"] = stat.backend;
+        obj["queueDepth"] = (Json::UInt64) stat.queue_depth;
+        obj["queueBytes"] = (Json::UInt64) stat.queue_bytes;
+        obj["writeCount"] = (Json::UInt64) stat.write_count;
+        obj["writeBytes"] = (Json::UInt64) stat.write_bytes;
+        obj["errorCount"] = (Json::UInt64) stat.error_count;
+        obj["latencyP50"] = stat.latency_p50;
+        obj["latencyP90"] = stat.latency_p90;
+        obj["latencyP99"] = stat.latency_p99;
+        obj["latencyMax"] = stat.latency_max;
+        val["AsyncFileWriter"].append(obj);
+    }
 #ifdef ENABLE_MEM_DEBUG
     auto bytes = getTotalMemUsage();
     val["totalMemUsage"] = (Json::UInt64)bytes;
@@ -378,6 +501,103 @@ Value getStatisticJson() {
     return val;
 }
 
+//遍历端到端延时统计，vhost、app、stream为可选筛选参数
+static void forEachStreamLatency(const HttpAllArgs<ApiArgsType> &allArgs, const function<void(const StreamLatency::Ptr &latency)> &cb) {
+    const string vhost = allArgs["vhost"], app = allArgs["app"], stream = allArgs["stream"];
+    StreamLatency::forEach([&](const StreamLatency::Ptr &latency) {
+        if ((!vhost.empty() && vhost != latency->getVhost()) || (!app.empty() && app != latency->getApp()) ||
+            (!stream.empty() && stream != latency->getStream())) {
+            return;
+        }
+        cb(latency);
+    });
+}
+
+//单个流的端到端延时统计，耗时单位均为微秒
+static Value makeStreamLatencyJson(const StreamLatency &latency) {
+    Value item(objectValue);
+    item["vhost"] = latency.getVhost();
+    item["app"] = latency.getApp();
+    item["stream"] = latency.getStream();
+    item["frames"] = (Json::UInt64) latency.getFrameCount();
+    item["videoJitter"] = (Json::UInt64) latency.getJitter(TrackVideo);
+    item["audioJitter"] = (Json::UInt64) latency.getJitter(TrackAudio);
+    for (int i = 0; i < StreamLatency::ProtocolMax; ++i) {
+        auto protocol = (StreamLatency::Protocol) i;
+        Value obj(objectValue);
+        for (int j = 0; j < StreamLatency::StageMax; ++j) {
+            auto stage = (StreamLatency::Stage) j;
+            auto snap = latency.getHistogram(protocol, stage).snapshot();
+            Value hist(objectValue);
+            hist["count"] = (Json::UInt64) snap.count;
+            hist["avg"] = (Json::UInt64) (snap.count ? snap.sum_us / snap.count : 0);
+            hist["p50"] = (Json::UInt64) snap.p50_us;
+            hist["p90"] = (Json::UInt64) snap.p90_us;
+            hist["p99"] = (Json::UInt64) snap.p99_us;
+            hist["p999"] = (Json::UInt64) snap.p999_us;
+            hist["max"] = (Json::UInt64) snap.max_us;
+            obj[StreamLatency::getStageName(stage)] = hist;
+        }
+        item[StreamLatency::getProtocolName(protocol)] = obj;
+    }
+    return item;
+}
+
+static string escapeLabelValue(const string &str) {
+    string ret;
+    for (auto ch : str) {
+        switch (ch) {
+            case '\\': ret += "\\\\"; break;
+            case '"': ret += "\\\""; break;
+            case '\n': ret += "\\n"; break;
+            default: ret += ch; break;
+        }
+    }
+    return ret;
+}
+
+static string toSecond(uint64_t us) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%.6f", us / 1000000.0);
+    return buf;
+}
+
+//prometheus文本格式的端到端延时统计，没有样本的直方图不输出
+static string makeStreamLatencyMetrics(const HttpAllArgs<ApiArgsType> &allArgs) {
+    static const uint64_t kBucketUS[] = {1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 500000,
+                                         1000000, 2500000, 5000000, 10000000};
+    _StrPrinter latency_out, jitter_out;
+    latency_out << "# HELP zlm_stream_latency_seconds Time from frame ingest to muxer output (mux) or socket write (send).\n"
+                << "# TYPE zlm_stream_latency_seconds histogram\n";
+    jitter_out << "# HELP zlm_stream_ingest_jitter_seconds Interarrival jitter of ingested frames (RFC 3550).\n"
+               << "# TYPE zlm_stream_ingest_jitter_seconds gauge\n";
+    forEachStreamLatency(allArgs, [&](const StreamLatency::Ptr &latency) {
+        string stream_labels = "vhost=\"" + escapeLabelValue(latency->getVhost()) + "\",app=\"" + escapeLabelValue(latency->getApp())
+                               + "\",stream=\"" + escapeLabelValue(latency->getStream()) + "\"";
+        for (int i = 0; i < StreamLatency::ProtocolMax; ++i) {
+            for (int j = 0; j < StreamLatency::StageMax; ++j) {
+                auto &hist = latency->getHistogram((StreamLatency::Protocol) i, (StreamLatency::Stage) j);
+                auto snap = hist.snapshot();
+                if (!snap.count) {
+                    continue;
+                }
+                string labels = stream_labels + ",protocol=\"" + StreamLatency::getProtocolName((StreamLatency::Protocol) i)
+                                + "\",stage=\"" + StreamLatency::getStageName((StreamLatency::Stage) j) + "\"";
+                for (auto bucket : kBucketUS) {
+                    latency_out << "zlm_stream_latency_seconds_bucket{" << labels << ",le=\"" << bucket / 1000000.0 << "\"} "
+                                << hist.countNotGreaterThan(bucket) << "\n";
+                }
+                latency_out << "zlm_stream_latency_seconds_bucket{" << labels << ",le=\"+Inf\"} " << snap.count << "\n";
+                latency_out << "zlm_stream_latency_seconds_sum{" << labels << "} " << toSecond(snap.sum_us) << "\n";
+                latency_out << "zlm_stream_latency_seconds_count{" << labels << "} " << snap.count << "\n";
+            }
+        }
+        jitter_out << "zlm_stream_ingest_jitter_seconds{" << stream_labels << ",track=\"video\"} " << toSecond(latency->getJitter(TrackVideo)) << "\n";
+        jitter_out << "zlm_stream_ingest_jitter_seconds{" << stream_labels << ",track=\"audio\"} " << toSecond(latency->getJitter(TrackAudio)) << "\n";
+    });
+    return latency_out << jitter_out;
+}
+
 /**
  * 安装api接口
  * 所有api都支持GET和POST两种方式
@@ -393,9 +613,10 @@ void installWebApi() {
         EventPollerPool::Instance().getExecutorDelay([invoker, headerOut](const vector<int> &vecDelay) {
             Value val;
             auto vec = EventPollerPool::Instance().getExecutorLoad();
+            auto wakeup_statistic = getPollerWakeupStatistic();
             int i = API::Success;
             for (auto load : vec) {
-                Value obj(objectValue);
+                Value obj = wakeup_statistic[i];
                 obj["load"] = load;
                 obj["delay"] = vecDelay[i++];
                 val["data"].append(obj);
@@ -1183,6 +1404,24 @@ void installWebApi() {
         val["data"] = getStatisticJson();
     });
 
+    //获取流的端到端延时统计(接收->复用->socket发送)以及接收抖动，vhost/app/stream为可选筛选参数
+    //测试url http://127.0.0.1/index/api/getStreamLatency?app=live&stream=test
+    api_regist("/index/api/getStreamLatency",[](API_ARGS_MAP){
+        CHECK_SECRET();
+        val["data"] = Value(arrayValue);
+        forEachStreamLatency(allArgs, [&](const StreamLatency::Ptr &latency) {
+            val["data"].append(makeStreamLatencyJson(*latency));
+        });
+    });
+
+    //prometheus格式的端到端延时统计
+    //测试url http://127.0.0.1/index/api/getStreamLatencyMetrics
+    api_regist("/index/api/getStreamLatencyMetrics",[](API_ARGS_MAP_ASYNC){
+        CHECK_SECRET();
+        headerOut["Content-Type"] = "text/plain; version=0.0.4";
+        invoker(200, headerOut, makeStreamLatencyMetrics(allArgs));
+    });
+
 #ifdef ENABLE_WEBRTC
     api_regist("/index/api/webrtc",[](API_ARGS_STRING_ASYNC){
         CHECK_ARGS("app", "stream");
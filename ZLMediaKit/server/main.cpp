@@ -23,6 +23,7 @@
 #include "Shell/ShellSession.h"
 #include "Http/WebSocketSession.h"
 #include "Rtp/RtpServer.h"
+#include "Player/EdgeProxy.h"
 #include "WebApi.h"
 #include "WebHook.h"
 #include "../webrtc/Sdp.h"
@@ -297,6 +298,13 @@ int start_main(int argc,char *argv[]) {
         TcpServer::Ptr httpSrv(new TcpServer());
         TcpServer::Ptr httpsSrv(new TcpServer());
 
+        //SO_REUSEPORT分片监听
+        bool reusePort = mINI::Instance()[General::kReusePortListen];
+        bool reusePortCpuAffinity = mINI::Instance()[General::kReusePortCpuAffinity];
+        for (auto &server : {shellSrv, rtspSrv, rtspSSLSrv, rtmpSrv, rtmpsSrv, httpSrv, httpsSrv}) {
+            server->setReusePort(reusePort, reusePortCpuAffinity);
+        }
+
 #if defined(ENABLE_RTPPROXY)
         //GB28181 rtp推流端口，支持UDP/TCP
         RtpServer::Ptr rtpServer = std::make_shared<RtpServer>();
@@ -342,6 +350,7 @@ int start_main(int argc,char *argv[]) {
         InfoL << "已启动http api 接口";
         installWebHook();
         InfoL << "已启动http hook 接口";
+        EdgeManager::Instance().install();
 
 #if !defined(_WIN32) && !defined(ANDROID)
         if (!bDaemon) {
@@ -365,6 +374,7 @@ int start_main(int argc,char *argv[]) {
     }
     unInstallWebApi();
     unInstallWebHook();
+    EdgeManager::Instance().uninstall();
     //休眠1秒再退出，防止资源释放顺序错误
     InfoL << "程序退出中,请等待...";
     sleep(1);
@@ -0,0 +1,185 @@
+﻿/*
+ * Copyright (c) 2016 The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/xia-chu/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <mutex>
+#include <unordered_set>
+#include "FrameGopCache.h"
+#include "Common/config.h"
+
+//单个gop缓存最多缓存的帧数，防止长时间没有关键帧时内存无限增长
+#define FRAME_GOP_MAX_SIZE 4096
+
+namespace mediakit {
+
+static mutex s_mtx;
+static unordered_set<FrameGopCache *> s_caches;
+static atomic<size_t> s_total_bytes{0};
+//已经选中淘汰但是尚未清空的字节数，防止重复淘汰
+static atomic<size_t> s_evicting_bytes{0};
+
+FrameGopCache::FrameGopCache() {
+    _last_use_ms = getCurrentMillisecond();
+    lock_guard<mutex> lck(s_mtx);
+    s_caches.emplace(this);
+}
+
+FrameGopCache::~FrameGopCache() {
+    {
+        lock_guard<mutex> lck(s_mtx);
+        s_caches.erase(this);
+    }
+    clear();
+}
+
+void FrameGopCache::inputFrame(const Frame::Ptr &frame, bool have_video) {
+    if (_evict_bytes) {
+        DebugL << "gop cache evicted, bytes:" << _bytes;
+        clear();
+    }
+    if (!have_video) {
+        //不存在视频时gop缓存没有意义
+        return;
+    }
+    if (frame->getTrackType() == TrackVideo) {
+        //sps、pps与关键帧时间戳相同，一并作为gop的开头
+        auto is_key = frame->keyFrame() || frame->configFrame();
+        if (is_key && (!_last_is_key || frame->dts() != _last_key_dts)) {
+            //新的gop开始，移除老数据
+            clear();
+            _have_key = true;
+        }
+        _last_is_key = is_key;
+        if (is_key) {
+            _last_key_dts = frame->dts();
+        }
+    }
+    if (!_have_key) {
+        //缓存中没有关键帧，那么gop缓存无效
+        return;
+    }
+
+    _frames.emplace_back(frame);
+    _bytes += frame->size();
+    s_total_bytes += frame->size();
+    if (_frames.size() > FRAME_GOP_MAX_SIZE) {
+        //gop缓存溢出，等待下一个关键帧
+        clear();
+        return;
+    }
+    checkTotalBytes();
+}
+
+void FrameGopCache::forEach(const function<void(const Frame::Ptr &frame)> &cb) {
+    _last_use_ms = getCurrentMillisecond();
+    _frames.for_each(cb);
+}
+
+void FrameGopCache::clear() {
+    _have_key = false;
+    _last_is_key = false;
+    _frames.clear();
+    s_total_bytes -= _bytes.exchange(0);
+    s_evicting_bytes -= _evict_bytes.exchange(0);
+}
+
+size_t FrameGopCache::getBytes() const {
+    return _bytes;
+}
+
+size_t FrameGopCache::getTotalBytes() {
+    return s_total_bytes;
+}
+
+void FrameGopCache::checkTotalBytes() {
+    GET_CONFIG(size_t, max_mb, General::kSharedGopCacheMaxMB);
+    auto max_bytes = max_mb * 1024 * 1024;
+    if (!max_bytes || s_total_bytes <= s_evicting_bytes + max_bytes) {
+        return;
+    }
+    {
+        lock_guard<mutex> lck(s_mtx);
+        while (s_total_bytes > s_evicting_bytes + max_bytes) {
+            //超过全局上限，淘汰最久未被回放的gop缓存(无人观看的流优先)
+            FrameGopCache *victim = nullptr;
+            for (auto cache : s_caches) {
+                if (cache->_evict_bytes || !cache->_bytes) {
+                    continue;
+                }
+                if (!victim || cache->_last_use_ms < victim->_last_use_ms) {
+                    victim = cache;
+                }
+            }
+            if (!victim) {
+                break;
+            }
+            //先累加再标记，确保清空时减去的字节数已经累加过
+            auto bytes = victim->_bytes.load();
+            s_evicting_bytes += bytes;
+            victim->_evict_bytes = bytes;
+        }
+    }
+    if (_evict_bytes) {
+        //自己被选中淘汰，立即清空
+        clear();
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////
+
+static bool isDemand(bool protocol_demand) {
+    GET_CONFIG(bool, shared_gop, General::kSharedGopCache);
+    //开启共享gop缓存时，无人观看也不打包
+    return protocol_demand || shared_gop;
+}
+
+void MuxerDemand::onReaderChanged(bool protocol_demand, int size) {
+    auto demand = isDemand(protocol_demand);
+    auto last = _enabled.exchange(demand ? size != 0 : true);
+    if (demand && size && !last) {
+        //由无人观看变为有人观看，先回放共享的gop缓存
+        _replay_gop = true;
+    }
+    if (!size && demand) {
+        _clear_cache = true;
+    }
+}
+
+bool MuxerDemand::popClearCache(bool protocol_demand) {
+    return isDemand(protocol_demand) && _clear_cache.exchange(false);
+}
+
+bool MuxerDemand::needMux(bool protocol_demand) const {
+    return _enabled || !isDemand(protocol_demand);
+}
+
+bool MuxerDemand::isEnabled(bool protocol_demand) const {
+    return protocol_demand ? (_clear_cache ? true : _enabled.load()) : true;
+}
+
+bool MuxerDemand::popReplayGop(bool have_video) {
+    if (!_replay_gop.exchange(false)) {
+        return false;
+    }
+    _wait_key = have_video;
+    return true;
+}
+
+bool MuxerDemand::dropOutput(bool is_key) {
+    if (!_wait_key) {
+        return false;
+    }
+    if (is_key) {
+        _wait_key = false;
+        return false;
+    }
+    return true;
+}
+
+}//namespace mediakit
@@ -0,0 +1,129 @@
+﻿/*
+ * Copyright (c) 2016 The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/xia-chu/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef ZLMEDIAKIT_FRAMEGOPCACHE_H
+#define ZLMEDIAKIT_FRAMEGOPCACHE_H
+
+#include <atomic>
+#include "Util/List.h"
+#include "Extension/Frame.h"
+
+namespace mediakit {
+
+/**
+ * 各协议共享的帧级别gop缓存，缓存的是打包前的原始帧
+ * 某协议由无人观看变为有人观看时，由MultiMediaSourceMuxer把缓存的帧回放给该协议的muxer重新打包，
+ * 这样各协议无人观看时就不必各自缓存一份打包后的gop
+ * 所有实例的内存总和受全局上限限制，超过上限时淘汰最久未被回放的gop缓存
+ * inputFrame/forEach/clear只能在生产者线程调用，getBytes可以在任意线程调用
+ */
+class FrameGopCache {
+public:
+    using Ptr = std::shared_ptr<FrameGopCache>;
+
+    FrameGopCache();
+    ~FrameGopCache();
+
+    /**
+     * 输入帧，必须为可缓存的帧
+     * @param frame 帧
+     * @param have_video 是否存在视频，不存在视频时不缓存
+     */
+    void inputFrame(const Frame::Ptr &frame, bool have_video);
+
+    /**
+     * 遍历缓存的帧
+     */
+    void forEach(const function<void(const Frame::Ptr &frame)> &cb);
+
+    /**
+     * 清空缓存，等待下一个关键帧
+     */
+    void clear();
+
+    /**
+     * 本gop缓存占用的内存字节数
+     */
+    size_t getBytes() const;
+
+    /**
+     * 所有gop缓存占用的内存字节数
+     */
+    static size_t getTotalBytes();
+
+private:
+    void checkTotalBytes();
+
+private:
+    //是否已经缓存了关键帧
+    bool _have_key = false;
+    //上一个视频帧是否为关键帧或配置帧
+    bool _last_is_key = false;
+    uint32_t _last_key_dts = 0;
+    List<Frame::Ptr> _frames;
+    atomic<size_t> _bytes{0};
+    //最后一次被回放的时间，用于淘汰
+    atomic<uint64_t> _last_use_ms;
+    //被选中淘汰时的字节数，非0时在生产者线程下次输入帧时清空
+    atomic<size_t> _evict_bytes{0};
+};
+
+/**
+ * rtsp/rtmp/ts/fmp4复用器共用的按需打包状态
+ * 开启按需转协议或者共享gop缓存时，无人观看不打包；由无人观看变为有人观看时，需要先回放共享的gop缓存
+ * onReaderChanged在观看者所在线程触发，其他接口在复用器线程调用，所以状态都是原子变量
+ */
+class MuxerDemand {
+public:
+    /**
+     * 观看人数改变
+     * @param protocol_demand 该协议是否开启按需转协议
+     * @param size 观看人数
+     */
+    void onReaderChanged(bool protocol_demand, int size);
+
+    /**
+     * 是否需要清空该协议的缓存，调用后复位，在输入帧前调用
+     */
+    bool popClearCache(bool protocol_demand);
+
+    /**
+     * 是否需要打包该帧
+     */
+    bool needMux(bool protocol_demand) const;
+
+    /**
+     * 是否需要输入帧，缓存尚未清空时也需要输入，以便及时清空缓存
+     */
+    bool isEnabled(bool protocol_demand) const;
+
+    /**
+     * 是否需要先回放共享的gop缓存，调用后复位
+     * @param have_video 是否有视频，有视频时回放后丢弃关键帧之前的输出
+     */
+    bool popReplayGop(bool have_video);
+
+    /**
+     * 复用器输出数据时调用，判断是否丢弃该数据
+     * 停止打包时复用器内部可能残留尚未输出的帧(例如等待下一帧才输出的h264帧)，回放时会先于关键帧输出，需要丢弃
+     * @param is_key 是否为关键帧的数据
+     */
+    bool dropOutput(bool is_key);
+
+private:
+    atomic<bool> _enabled{true};
+    atomic<bool> _clear_cache{false};
+    atomic<bool> _replay_gop{false};
+    //以下只在复用器线程访问
+    bool _wait_key = false;
+};
+
+}//namespace mediakit
+#endif //ZLMEDIAKIT_FRAMEGOPCACHE_H
@@ -21,8 +21,197 @@ namespace toolkit {
 
 namespace mediakit {
 
-recursive_mutex s_media_source_mtx;
-MediaSource::SchemaVhostAppStreamMap s_media_source_map;
+//媒体源注册表分片个数，必须为2的次幂
+#define MEDIA_SOURCE_SHARD_SIZE 64
+//遍历时获取一致性快照的最大重试次数
+#define MEDIA_SOURCE_SNAPSHOT_RETRY 8
+
+static size_t getMediaSourceKeyHash(const string &schema, const string &vhost, const string &app, const string &stream) {
+    std::hash<string> hasher;
+    size_t ret = hasher(schema);
+    for (auto key : {&vhost, &app, &stream}) {
+        ret ^= hasher(*key) + 0x9e3779b9 + (ret << 6) + (ret >> 2);
+    }
+    return ret;
+}
+
+namespace {
+
+class MediaSourceEntry {
+public:
+    using Ptr = std::shared_ptr<const MediaSourceEntry>;
+
+    MediaSourceEntry(const MediaSource::Ptr &src)
+        : schema(src->getSchema()), vhost(src->getVhost()), app(src->getApp()), stream(src->getId()), media(src) {}
+
+    bool match(const string &schema_in, const string &vhost_in, const string &app_in, const string &stream_in) const {
+        return stream == stream_in && app == app_in && vhost == vhost_in && schema == schema_in;
+    }
+
+    string schema;
+    string vhost;
+    string app;
+    string stream;
+    weak_ptr<MediaSource> media;
+};
+
+/**
+ * 媒体源注册表
+ * 按schema/vhost/app/stream_id的哈希值分片，每个分片采用写时复制：
+ * 注册与注销在分片锁内复制一份新表再原子替换，查找时原子获取分片当前版本后无锁查询，
+ * 这样海量播放器同时查找流时不会在同一把锁上排队
+ */
+class MediaSourceRegistry {
+public:
+    using Map = unordered_multimap<size_t, MediaSourceEntry::Ptr>;
+    using MapPtr = std::shared_ptr<const Map>;
+
+    //遍历用的快照(各分片的只读版本)及其对应的注册表版本号
+    class Snapshot {
+    public:
+        using Ptr = std::shared_ptr<const Snapshot>;
+        uint64_t epoch = 0;
+        vector<MapPtr> maps;
+    };
+
+    static MediaSourceRegistry &Instance() {
+        static MediaSourceRegistry s_instance;
+        return s_instance;
+    }
+
+    void regist(size_t hash, const MediaSource::Ptr &src) {
+        auto entry = std::make_shared<MediaSourceEntry>(src);
+        modify(hash, [&](Map &map) {
+            //同名媒体源，后注册者覆盖前者
+            eraseIf(map, hash, [&](const MediaSourceEntry &item) {
+                return item.match(entry->schema, entry->vhost, entry->app, entry->stream);
+            });
+            map.emplace(hash, std::move(entry));
+            return true;
+        });
+    }
+
+    bool unregist(size_t hash, const MediaSource *thiz) {
+        return modify(hash, [&](Map &map) {
+            return eraseIf(map, hash, [&](const MediaSourceEntry &item) {
+                if (!item.match(thiz->getSchema(), thiz->getVhost(), thiz->getApp(), thiz->getId())) {
+                    return false;
+                }
+                //对象已经销毁或者对象就是自己，那么移除之
+                auto src = item.media.lock();
+                return !src || src.get() == thiz;
+            });
+        });
+    }
+
+    MediaSource::Ptr find(const string &schema, const string &vhost, const string &app, const string &stream) const {
+        auto hash = getMediaSourceKeyHash(schema, vhost, app, stream);
+        auto map = std::atomic_load(&getShard(hash).map);
+        auto range = map->equal_range(hash);
+        for (auto it = range.first; it != range.second; ++it) {
+            if (it->second->match(schema, vhost, app, stream)) {
+                return it->second->media.lock();
+            }
+        }
+        return nullptr;
+    }
+
+    /**
+     * 获取所有媒体源的一致性快照，用于遍历
+     * 读取前后注册表版本号不变且没有正在进行的修改时，说明这些分片属于同一时刻；
+     * 快照按版本号缓存，注册表未变化时多次遍历共用同一份快照
+     */
+    Snapshot::Ptr snapshot() const {
+        auto epoch = _epoch.load();
+        auto cache = std::atomic_load(&_snapshot);
+        if (cache && cache->epoch == epoch && !_writing.load()) {
+            return cache;
+        }
+
+        auto ret = std::make_shared<Snapshot>();
+        for (int retry = 0; retry < MEDIA_SOURCE_SNAPSHOT_RETRY; ++retry) {
+            epoch = _epoch.load();
+            if (_writing.load()) {
+                this_thread::yield();
+                continue;
+            }
+            collect(ret->maps);
+            if (epoch == _epoch.load()) {
+                //版本号不变，缓存之
+                ret->epoch = epoch;
+                Snapshot::Ptr snapshot = std::move(ret);
+                std::atomic_store(&_snapshot, snapshot);
+                return snapshot;
+            }
+        }
+        //注册表一直在变化，那么返回最近一次的快照
+        collect(ret->maps);
+        return ret;
+    }
+
+private:
+    class Shard {
+    public:
+        mutex mtx;
+        MapPtr map = std::make_shared<Map>();
+    };
+
+    MediaSourceRegistry() = default;
+
+    void collect(vector<MapPtr> &maps) const {
+        maps.clear();
+        maps.reserve(MEDIA_SOURCE_SHARD_SIZE);
+        for (auto &shard : _shards) {
+            maps.emplace_back(std::atomic_load(&shard.map));
+        }
+    }
+
+    Shard &getShard(size_t hash) const {
+        return _shards[hash & (MEDIA_SOURCE_SHARD_SIZE - 1)];
+    }
+
+    template<typename FUNC>
+    static bool eraseIf(Map &map, size_t hash, const FUNC &func) {
+        bool ret = false;
+        auto range = map.equal_range(hash);
+        for (auto it = range.first; it != range.second;) {
+            if (func(*it->second)) {
+                it = map.erase(it);
+                ret = true;
+            } else {
+                ++it;
+            }
+        }
+        return ret;
+    }
+
+    template<typename FUNC>
+    bool modify(size_t hash, const FUNC &func) {
+        auto &shard = getShard(hash);
+        lock_guard<mutex> lck(shard.mtx);
+        //写时复制，正在被查找或遍历的旧版本不受影响
+        auto map = std::make_shared<Map>(*shard.map);
+        if (!func(*map)) {
+            return false;
+        }
+        ++_writing;
+        std::atomic_store(&shard.map, MapPtr(std::move(map)));
+        ++_epoch;
+        --_writing;
+        return true;
+    }
+
+private:
+    mutable Shard _shards[MEDIA_SOURCE_SHARD_SIZE];
+    //注册表版本号，每次修改后递增
+    atomic<uint64_t> _epoch{0};
+    //正在修改的分片个数
+    atomic<int> _writing{0};
+    //遍历用的快照缓存
+    mutable Snapshot::Ptr _snapshot;
+};
+
+} // namespace
 
 string getOriginTypeString(MediaOriginType type){
 #define SWITCH_CASE(type) case MediaOriginType::type : return #type
@@ -61,6 +250,7 @@ MediaSource::MediaSource(const string &schema, const string &vhost, const string
     _schema = schema;
     _app = app;
     _stream_id = stream_id;
+    _key_hash = getMediaSourceKeyHash(_schema, _vhost, _app, _stream_id);
     _create_stamp = time(NULL);
 }
 
@@ -237,40 +427,27 @@ bool MediaSource::stopSendRtp(const string &ssrc) {
     return listener->stopSendRtp(*this, ssrc);
 }
 
-template<typename MAP, typename LIST, typename First, typename ...KeyTypes>
-static void for_each_media_l(const MAP &map, LIST &list, const First &first, const KeyTypes &...keys) {
-    if (first.empty()) {
-        for (auto &pr : map) {
-            for_each_media_l(pr.second, list, keys...);
-        }
-        return;
-    }
-    auto it = map.find(first);
-    if (it != map.end()) {
-        for_each_media_l(it->second, list, keys...);
+size_t MediaSource::getGopCacheBytes() const {
+    auto listener = _listener.lock();
+    if (!listener) {
+        return 0;
     }
+    return listener->getGopCacheBytes(const_cast<MediaSource &>(*this));
 }
 
-template<typename LIST, typename Ptr>
-static void emplace_back(LIST &list, const Ptr &ptr) {
-    auto src = ptr.lock();
-    if (src) {
-        list.emplace_back(std::move(src));
-    }
+void MediaSource::onReaderSendBacklog(size_t count) {
+    //只记录最大值
+    auto last = _reader_send_backlog.load();
+    while (count > last && !_reader_send_backlog.compare_exchange_weak(last, count));
 }
 
-template<typename MAP, typename LIST, typename First>
-static void for_each_media_l(const MAP &map, LIST &list, const First &first) {
-    if (first.empty()) {
-        for (auto &pr : map) {
-            emplace_back(list, pr.second);
-        }
-        return;
-    }
-    auto it = map.find(first);
-    if (it != map.end()) {
-        emplace_back(list, it->second);
-    }
+size_t MediaSource::popReaderSendBacklog() {
+    return _reader_send_backlog.exchange(0);
+}
+
+static bool match_key(const string &key, const string &value) {
+    //空字符串代表不限
+    return key.empty() || key == value;
 }
 
 void MediaSource::for_each_media(const function<void(const Ptr &src)> &cb,
@@ -278,10 +455,30 @@ void MediaSource::for_each_media(const function<void(const Ptr &src)> &cb,
                                  const string &vhost,
                                  const string &app,
                                  const string &stream) {
+    auto &registry = MediaSourceRegistry::Instance();
+    if (!schema.empty() && !vhost.empty() && !app.empty() && !stream.empty()) {
+        //指定了全部条件，直接根据哈希值查找
+        auto src = registry.find(schema, vhost, app, stream);
+        if (src) {
+            cb(src);
+        }
+        return;
+    }
+
     deque<Ptr> src_list;
-    {
-        lock_guard<recursive_mutex> lock(s_media_source_mtx);
-        for_each_media_l(s_media_source_map, src_list, schema, vhost, app, stream);
+    auto snapshot = registry.snapshot();
+    for (auto &map : snapshot->maps) {
+        for (auto &pr : *map) {
+            auto &entry = *pr.second;
+            if (!match_key(schema, entry.schema) || !match_key(vhost, entry.vhost) ||
+                !match_key(app, entry.app) || !match_key(stream, entry.stream)) {
+                continue;
+            }
+            auto src = entry.media.lock();
+            if (src) {
+                src_list.emplace_back(std::move(src));
+            }
+        }
     }
     for (auto &src : src_list) {
         cb(src);
@@ -301,7 +498,11 @@ static MediaSource::Ptr find_l(const string &schema, const string &vhost_in, con
     }
 
     MediaSource::Ptr ret;
-    MediaSource::for_each_media([&](const MediaSource::Ptr &src) { ret = std::move(const_cast<MediaSource::Ptr &>(src)); }, schema, vhost, app, id);
+    if (!schema.empty()) {
+        ret = MediaSourceRegistry::Instance().find(schema, vhost, app, id);
+    } else {
+        MediaSource::for_each_media([&](const MediaSource::Ptr &src) { ret = std::move(const_cast<MediaSource::Ptr &>(src)); }, schema, vhost, app, id);
+    }
 
     if(!ret && create_new && schema != HLS_SCHEMA){
         //未查找媒体源，则读取mp4创建一个
@@ -415,46 +616,13 @@ void MediaSource::emitEvent(bool regist){
 }
 
 void MediaSource::regist() {
-    {
-        //减小互斥锁临界区
-        lock_guard<recursive_mutex> lock(s_media_source_mtx);
-        s_media_source_map[_schema][_vhost][_app][_stream_id] = shared_from_this();
-    }
+    MediaSourceRegistry::Instance().regist(_key_hash, shared_from_this());
     emitEvent(true);
 }
 
-template<typename MAP, typename First, typename ...KeyTypes>
-static bool erase_media_source(bool &hit, const MediaSource *thiz, MAP &map, const First &first, const KeyTypes &...keys) {
-    auto it = map.find(first);
-    if (it != map.end() && erase_media_source(hit, thiz, it->second, keys...)) {
-        map.erase(it);
-    }
-    return map.empty();
-}
-
-template<typename MAP, typename First>
-static bool erase_media_source(bool &hit, const MediaSource *thiz, MAP &map, const First &first) {
-    auto it = map.find(first);
-    if (it != map.end()) {
-        auto src = it->second.lock();
-        if (!src || src.get() == thiz) {
-            //对象已经销毁或者对象就是自己，那么移除之
-            map.erase(it);
-            hit = true;
-        }
-    }
-    return map.empty();
-}
-
 //反注册该源
 bool MediaSource::unregist() {
-    bool ret = false;
-    {
-        //减小互斥锁临界区
-        lock_guard<recursive_mutex> lock(s_media_source_mtx);
-        erase_media_source(ret, this, s_media_source_map, _schema, _vhost, _app, _stream_id);
-    }
-
+    auto ret = MediaSourceRegistry::Instance().unregist(_key_hash, this);
     if (ret) {
         emitEvent(false);
     }
@@ -711,6 +879,14 @@ bool MediaSourceEventInterceptor::stopSendRtp(MediaSource &sender, const string
     return false;
 }
 
+size_t MediaSourceEventInterceptor::getGopCacheBytes(MediaSource &sender) const {
+    auto listener = _listener.lock();
+    if (!listener) {
+        return 0;
+    }
+    return listener->getGopCacheBytes(sender);
+}
+
 void MediaSourceEventInterceptor::setDelegate(const std::weak_ptr<MediaSourceEvent> &listener) {
     if (listener.lock().get() == this) {
         throw std::invalid_argument("can not set self as a delegate");
@@ -730,8 +906,8 @@ static bool isFlushAble_default(bool is_video, uint64_t last_stamp, uint64_t new
         return true;
     }
 
-    //时间戳发送变化或者缓存超过1024个,sendmsg接口一般最多只能发送1024个数据包
-    return last_stamp != new_stamp || cache_size >= 1024;
+    //时间戳发送变化或者缓存超过IOV_MAX个,sendmsg接口一般最多只能发送IOV_MAX(1024)个数据包
+    return last_stamp != new_stamp || cache_size >= IOV_MAX;
 }
 
 static bool isFlushAble_merge(bool is_video, uint64_t last_stamp, uint64_t new_stamp, size_t cache_size, int merge_ms) {
@@ -745,18 +921,19 @@ static bool isFlushAble_merge(bool is_video, uint64_t last_stamp, uint64_t new_s
         return true;
     }
 
-    //缓存数超过1024个,这个逻辑用于避免时间戳异常的流导致的内存暴增问题
-    //而且sendmsg接口一般最多只能发送1024个数据包
-    return cache_size >= 1024;
+    //缓存数超过IOV_MAX个,这个逻辑用于避免时间戳异常的流导致的内存暴增问题
+    //而且sendmsg接口一般最多只能发送IOV_MAX(1024)个数据包
+    return cache_size >= IOV_MAX;
 }
 
 bool FlushPolicy::isFlushAble(bool is_video, bool is_key, uint64_t new_stamp, size_t cache_size) {
+    ++_packet_count;
     bool flush_flag = false;
     if (is_key && is_video) {
         //遇到关键帧flush掉前面的数据，确保关键帧为该组数据的第一帧，确保GOP缓存有效
         flush_flag = true;
     } else {
-        GET_CONFIG(int, mergeWriteMS, General::kMergeWriteMS);
+        auto mergeWriteMS = getMergeWriteMS();
         if (mergeWriteMS <= 0) {
             //关闭了合并写或者合并写阈值小于等于0
             flush_flag = isFlushAble_default(is_video, _last_stamp[is_video], new_stamp, cache_size);
@@ -771,4 +948,57 @@ bool FlushPolicy::isFlushAble(bool is_video, bool is_key, uint64_t new_stamp, si
     return flush_flag;
 }
 
-} /* namespace mediakit */
\ No newline at end of file
+//观看人数达到该值后才开始合并写，之后观看人数每翻一倍合并写窗口增加ADAPTIVE_MERGE_STEP_MS
+#define ADAPTIVE_MERGE_MIN_READERS 8
+#define ADAPTIVE_MERGE_STEP_MS 10
+//有观看者socket发送缓存积压超过该包数时，说明发送跟不上，加大合并写窗口
+#define ADAPTIVE_MERGE_BACKLOG 128
+#define ADAPTIVE_MERGE_BACKLOG_MS 40
+//单次合并写的数据量上限，避免一次writev数据过多导致观看者socket发送缓存溢出
+#define ADAPTIVE_MERGE_MAX_BYTES (1024 * 1024)
+
+void FlushPolicy::update(int reader_count, size_t send_backlog, int bytes_speed) {
+    auto elapsed = _packet_ticker.elapsedTime();
+    auto packet_speed = elapsed ? _packet_count * 1000 / elapsed : 0;
+    _packet_count = 0;
+    _packet_ticker.resetTime();
+
+    GET_CONFIG(bool, adaptive, General::kAdaptiveMergeWrite);
+    GET_CONFIG(int, max_ms, General::kMergeWriteMaxMS);
+    if (!adaptive || max_ms <= 0) {
+        _adaptive_ms = 0;
+        return;
+    }
+
+    int target = 0;
+    if (reader_count >= ADAPTIVE_MERGE_MIN_READERS) {
+        //观看人数多时合并写，每秒系统调用次数约为刷新次数乘以观看人数
+        for (auto count = reader_count; count >= ADAPTIVE_MERGE_MIN_READERS; count /= 2) {
+            target += ADAPTIVE_MERGE_STEP_MS;
+        }
+    }
+    if (send_backlog >= ADAPTIVE_MERGE_BACKLOG) {
+        target = MAX(target * 2, ADAPTIVE_MERGE_BACKLOG_MS);
+    }
+    int last = _adaptive_ms;
+    if (target < last) {
+        //缩小窗口时逐步缩小，防止观看人数或积压在阈值附近时来回抖动
+        target = (target + last) / 2;
+    }
+    if (target && packet_speed) {
+        //合并写窗口内的数据包个数不超过单次writev可发送的个数
+        target = MIN(target, (int) (IOV_MAX * 1000 / packet_speed));
+    }
+    if (target && bytes_speed > 0) {
+        //合并写窗口内的数据量不宜过大
+        target = MIN(target, (int) (ADAPTIVE_MERGE_MAX_BYTES * 1000LL / bytes_speed));
+    }
+    _adaptive_ms = MIN(target, max_ms);
+}
+
+int FlushPolicy::getMergeWriteMS() const {
+    GET_CONFIG(int, mergeWriteMS, General::kMergeWriteMS);
+    return MAX(mergeWriteMS, _adaptive_ms.load());
+}
+
+} /* namespace mediakit */
@@ -12,6 +12,7 @@
 #define ZLMEDIAKIT_MEDIASOURCE_H
 
 #include <mutex>
+#include <atomic>
 #include <string>
 #include <memory>
 #include <functional>
@@ -91,6 +92,8 @@ public:
     virtual void startSendRtp(MediaSource &sender, const string &dst_url, uint16_t dst_port, const string &ssrc, bool is_udp, uint16_t src_port, const function<void(uint16_t local_port, const SockException &ex)> &cb) { cb(0, SockException(Err_other, "not implemented"));};
     // 停止发送ps-rtp
     virtual bool stopSendRtp(MediaSource &sender, const string &ssrc) {return false; }
+    // 获取共享gop缓存占用的内存字节数
+    virtual size_t getGopCacheBytes(MediaSource &sender) const { return 0; }
 
 private:
     Timer::Ptr _async_close_timer;
@@ -121,6 +124,7 @@ public:
     vector<Track::Ptr> getMediaTracks(MediaSource &sender, bool trackReady = true) const override;
     void startSendRtp(MediaSource &sender, const string &dst_url, uint16_t dst_port, const string &ssrc, bool is_udp, uint16_t src_port, const function<void(uint16_t local_port, const SockException &ex)> &cb) override;
     bool stopSendRtp(MediaSource &sender, const string &ssrc) override;
+    size_t getGopCacheBytes(MediaSource &sender) const override;
 
 private:
     std::weak_ptr<MediaSourceEvent> _listener;
@@ -271,6 +275,14 @@ public:
     void startSendRtp(const string &dst_url, uint16_t dst_port, const string &ssrc, bool is_udp, uint16_t src_port, const function<void(uint16_t local_port, const SockException &ex)> &cb);
     // 停止发送ps-rtp
     bool stopSendRtp(const string &ssrc);
+    // 获取共享gop缓存占用的内存字节数
+    size_t getGopCacheBytes() const;
+    // 获取当前合并写窗口，单位毫秒
+    virtual int getMergeWriteMS() const { return 0; }
+    // 获取每秒合并写刷新次数，每次刷新每个观看者一般对应一次writev系统调用
+    virtual int getFlushSpeed() { return 0; }
+    // 观看者上报其socket发送缓存中积压的数据包个数，用于自适应合并写
+    void onReaderSendBacklog(size_t count);
 
     ////////////////static方法，查找或生成MediaSource////////////////
 
@@ -294,6 +306,8 @@ public:
 protected:
     //媒体注册
     void regist();
+    //获取并清空上次获取以来观看者上报的最大发送积压包数
+    size_t popReaderSendBacklog();
 
 private:
     //媒体注销
@@ -311,7 +325,11 @@ private:
     string _vhost;
     string _app;
     string _stream_id;
+    //schema/vhost/app/stream_id的哈希值，用于在注册表中快速定位
+    size_t _key_hash;
     std::weak_ptr<MediaSourceEvent> _listener;
+    //观看者上报的最大发送积压包数
+    atomic<size_t> _reader_send_backlog{0};
     //对象个数统计
     ObjectStatistic<MediaSource> _statistic;
 };
@@ -324,8 +342,26 @@ public:
 
     bool isFlushAble(bool is_video, bool is_key, uint64_t new_stamp, size_t cache_size);
 
+    /**
+     * 自适应调整合并写窗口，由PacketCache每秒调用一次
+     * @param reader_count 观看人数
+     * @param send_backlog 观看者socket发送缓存中积压的最大数据包个数
+     * @param bytes_speed 码率，单位bytes/s
+     */
+    void update(int reader_count, size_t send_backlog, int bytes_speed);
+
+    /**
+     * 获取当前合并写窗口，单位毫秒
+     */
+    int getMergeWriteMS() const;
+
 private:
     uint64_t _last_stamp[2] = {0, 0};
+    //自适应计算的合并写窗口，实际窗口不小于mergeWriteMS配置
+    atomic<int> _adaptive_ms{0};
+    //统计包速率
+    size_t _packet_count = 0;
+    Ticker _packet_ticker;
 };
 
 /// 合并写缓存模板
@@ -344,6 +380,11 @@ public:
     void inputPacket(uint64_t stamp, bool is_video, std::shared_ptr<packet> pkt, bool key_pos) {
         if (_policy.isFlushAble(is_video, key_pos, stamp, _cache->size())) {
             flushAll();
+            if (_update_ticker.elapsedTime() >= 1000) {
+                //每秒调整一次刷新策略
+                _update_ticker.resetTime();
+                onUpdatePolicy(_policy);
+            }
         }
 
         //追加数据到最后
@@ -359,11 +400,33 @@ public:
 
     virtual void onFlush(std::shared_ptr<packet_list>, bool key_pos) = 0;
 
+    /**
+     * 获取当前合并写窗口，单位毫秒
+     */
+    int getMergeWriteMS() const {
+        return _policy.getMergeWriteMS();
+    }
+
+    /**
+     * 获取每秒刷新次数
+     */
+    int getFlushSpeed() {
+        return _flush_speed.getSpeed();
+    }
+
+protected:
+    /**
+     * 调整刷新策略，子类可以根据观看人数、码率等信息调整合并写窗口
+     */
+    virtual void onUpdatePolicy(policy &p) {}
+
 private:
     void flushAll() {
         if (_cache->empty()) {
             return;
         }
+        //复用BytesSpeed统计刷新次数
+        _flush_speed += 1;
         onFlush(std::move(_cache), _key_pos);
         _cache = std::make_shared<packet_list>();
         _key_pos = false;
@@ -372,6 +435,8 @@ private:
 private:
     bool _key_pos = false;
     policy _policy;
+    Ticker _update_ticker;
+    BytesSpeed _flush_speed;
     std::shared_ptr<packet_list> _cache;
 };
 
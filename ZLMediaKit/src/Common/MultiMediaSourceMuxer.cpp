@@ -86,6 +86,23 @@ MultiMediaSourceMuxer::MultiMediaSourceMuxer(const string &vhost, const string &
 #if defined(ENABLE_MP4)
     _fmp4 = std::make_shared<FMP4MediaSourceMuxer>(vhost, app, stream);
 #endif
+
+    GET_CONFIG(bool, shared_gop, General::kSharedGopCache);
+    if (shared_gop) {
+        _gop_cache = std::make_shared<FrameGopCache>();
+    }
+
+    _latency = StreamLatency::create(vhost, app, stream);
+    if (_rtmp) {
+        _rtmp->setLatency(_latency);
+    }
+    if (_rtsp) {
+        _rtsp->setLatency(_latency);
+    }
+    _ts->setLatency(_latency);
+#if defined(ENABLE_MP4)
+    _fmp4->setLatency(_latency);
+#endif
 }
 
 void MultiMediaSourceMuxer::setMediaListener(const std::weak_ptr<MediaSourceEvent> &listener) {
@@ -244,6 +261,10 @@ vector<Track::Ptr> MultiMediaSourceMuxer::getMediaTracks(MediaSource &sender, bo
     return getTracks(trackReady);
 }
 
+size_t MultiMediaSourceMuxer::getGopCacheBytes(MediaSource &sender) const {
+    return _gop_cache ? _gop_cache->getBytes() : 0;
+}
+
 void MultiMediaSourceMuxer::onTrackReady(const Track::Ptr &track) {
     if (CodecL16 == track->getCodecId()) {
         WarnL << "L16音频格式目前只支持RTSP协议推流拉流!!!";
@@ -278,6 +299,7 @@ void MultiMediaSourceMuxer::onTrackReady(const Track::Ptr &track) {
 
 void MultiMediaSourceMuxer::onAllTrackReady() {
     setMediaListener(getDelegate());
+    _have_video = (bool) getTrack(TrackVideo);
 
     if (_rtmp) {
         _rtmp->onAllTrackReady();
@@ -299,6 +321,9 @@ void MultiMediaSourceMuxer::onAllTrackReady() {
 
 void MultiMediaSourceMuxer::resetTracks() {
     MediaSink::resetTracks();
+    if (_gop_cache) {
+        _gop_cache->clear();
+    }
 
     if (_rtmp) {
         _rtmp->resetTracks();
@@ -386,6 +411,25 @@ private:
     Frame::Ptr _frame;
 };
 
+template<typename Muxer>
+void MultiMediaSourceMuxer::inputFrameToMuxer(const Muxer &muxer, const Frame::Ptr &frame) {
+    if (!muxer) {
+        return;
+    }
+    if (_gop_cache && muxer->popReplayGop(_have_video)) {
+        //该协议无人观看时未打包，先把共享的gop缓存重新打包给它
+        _gop_cache->forEach([&](const Frame::Ptr &cached) {
+            muxer->inputFrame(cached);
+        });
+    }
+    muxer->inputFrame(frame);
+}
+
+void MultiMediaSourceMuxer::inputFrame(const Frame::Ptr &frame) {
+    _latency->onIngest(frame);
+    MediaSink::inputFrame(frame);
+}
+
 void MultiMediaSourceMuxer::onTrackFrame(const Frame::Ptr &frame_in) {
     GET_CONFIG(bool, modify_stamp, General::kModifyStamp);
     auto frame = frame_in;
@@ -393,17 +437,16 @@ void MultiMediaSourceMuxer::onTrackFrame(const Frame::Ptr &frame_in) {
         //开启了时间戳覆盖
         frame = std::make_shared<FrameModifyStamp>(frame, _stamp[frame->getTrackType()]);
     }
-
-    if (_rtmp) {
-        _rtmp->inputFrame(frame);
-    }
-    if (_rtsp) {
-        _rtsp->inputFrame(frame);
-    }
-    if (_ts) {
-        _ts->inputFrame(frame);
+    _latency->onTrackFrame((uint32_t) frame_in->dts(), (uint32_t) frame->dts(), (uint32_t) frame->pts());
+    if (_gop_cache) {
+        //各协议共用一份可缓存的帧，免去各自拷贝
+        frame = Frame::getCacheAbleFrame(frame);
     }
 
+    inputFrameToMuxer(_rtmp, frame);
+    inputFrameToMuxer(_rtsp, frame);
+    inputFrameToMuxer(_ts, frame);
+
     //拷贝智能指针，目的是为了防止跨线程调用设置录像相关api导致的线程竞争问题
     //此处使用智能指针拷贝来确保线程安全，比互斥锁性能更优
     auto hls = _hls;
@@ -416,11 +459,14 @@ void MultiMediaSourceMuxer::onTrackFrame(const Frame::Ptr &frame_in) {
     }
 
 #if defined(ENABLE_MP4)
-    if (_fmp4) {
-        _fmp4->inputFrame(frame);
-    }
+    inputFrameToMuxer(_fmp4, frame);
 #endif
 
+    if (_gop_cache) {
+        //回放后再缓存，防止本帧被重复输入
+        _gop_cache->inputFrame(frame, _have_video);
+    }
+
 #if defined(ENABLE_RTPPROXY)
     lock_guard<mutex> lck(_rtp_sender_mtx);
     for (auto &pr : _rtp_sender) {
@@ -451,6 +497,9 @@ bool MultiMediaSourceMuxer::isEnabled(){
         if (_is_enable) {
             //无人观看时，不刷新计时器,因为无人观看时每次都会检查一遍，所以刷新计数器无意义且浪费cpu
             _last_check.resetTime();
+        } else if (_gop_cache) {
+            //此后不再输入帧，gop缓存已经过时
+            _gop_cache->clear();
         }
     }
     return _is_enable;
@@ -12,6 +12,8 @@
 #define ZLMEDIAKIT_MULTIMEDIASOURCEMUXER_H
 
 #include "Common/Stamp.h"
+#include "Common/FrameGopCache.h"
+#include "Common/StreamLatency.h"
 #include "Rtp/RtpSender.h"
 #include "Record/Recorder.h"
 #include "Record/HlsRecorder.h"
@@ -71,6 +73,11 @@ public:
      */
     void resetTracks() override;
 
+    /**
+     * 输入帧，记录帧的入口时刻用于统计端到端延时
+     */
+    void inputFrame(const Frame::Ptr &frame) override;
+
     /////////////////////////////////MediaSourceEvent override/////////////////////////////////
 
     /**
@@ -119,6 +126,11 @@ public:
      */
     vector<Track::Ptr> getMediaTracks(MediaSource &sender, bool trackReady = true) const override;
 
+    /**
+     * 获取共享gop缓存占用的内存字节数
+     */
+    size_t getGopCacheBytes(MediaSource &sender) const override;
+
 protected:
     /////////////////////////////////MediaSink override/////////////////////////////////
 
@@ -140,8 +152,16 @@ protected:
      */
     void onTrackFrame(const Frame::Ptr &frame) override;
 
+private:
+    /**
+     * 输入帧到各协议muxer，由无人观看变为有人观看的协议先回放共享的gop缓存
+     */
+    template<typename Muxer>
+    void inputFrameToMuxer(const Muxer &muxer, const Frame::Ptr &frame);
+
 private:
     bool _is_enable = false;
+    bool _have_video = false;
     Ticker _last_check;
     Stamp _stamp[2];
     std::weak_ptr<Listener> _track_listener;
@@ -159,6 +179,10 @@ private:
     TSMediaSourceMuxer::Ptr _ts;
     MediaSinkInterface::Ptr _mp4;
     HlsRecorder::Ptr _hls;
+    //各协议共享的帧级别gop缓存
+    FrameGopCache::Ptr _gop_cache;
+    //端到端延时统计
+    StreamLatency::Ptr _latency;
 
     //对象个数统计
     ObjectStatistic<MultiMediaSourceMuxer> _statistic;
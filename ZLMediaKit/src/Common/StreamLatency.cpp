@@ -0,0 +1,297 @@
+﻿/*
+ * Copyright (c) 2016 The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/xia-chu/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <mutex>
+#include <unordered_map>
+#include "StreamLatency.h"
+#include "Util/util.h"
+#include "Common/macros.h"
+
+//记录最近入口帧的个数，需要覆盖muxer的最大缓存时长(例如fmp4片段、rtmp合并帧)
+#define LATENCY_FRAME_CACHE_SIZE 256
+
+namespace mediakit {
+
+static uint32_t highestBit(uint64_t val) {
+    uint32_t ret = 0;
+    while (val >>= 1) {
+        ++ret;
+    }
+    return ret;
+}
+
+LatencyHistogram::LatencyHistogram() {
+    for (auto &bucket : _buckets) {
+        bucket = 0;
+    }
+}
+
+uint32_t LatencyHistogram::bucketIndex(uint64_t us) {
+    if (us < kSubBucketCount) {
+        return (uint32_t) us;
+    }
+    auto bit = highestBit(us);
+    if (bit >= kMaxValueBits) {
+        return kBucketCount - 1;
+    }
+    //第一组[0, 16)线性，之后每组[2^bit, 2^(bit+1))分为16个桶
+    auto shift = bit - kSubBucketBits;
+    return (uint32_t) (kSubBucketCount * (shift + 1) + (us >> shift) - kSubBucketCount);
+}
+
+uint64_t LatencyHistogram::bucketUpperBound(uint32_t index) {
+    if (index < kSubBucketCount) {
+        return index;
+    }
+    auto shift = index / kSubBucketCount - 1;
+    auto sub = index % kSubBucketCount;
+    return ((uint64_t) (kSubBucketCount + sub + 1) << shift) - 1;
+}
+
+void LatencyHistogram::record(uint64_t us) {
+    _buckets[bucketIndex(us)].fetch_add(1, memory_order_relaxed);
+    _sum_us.fetch_add(us, memory_order_relaxed);
+    _count.fetch_add(1, memory_order_relaxed);
+    auto max_us = _max_us.load(memory_order_relaxed);
+    while (us > max_us && !_max_us.compare_exchange_weak(max_us, us, memory_order_relaxed));
+}
+
+LatencyHistogram::Snapshot LatencyHistogram::snapshot() const {
+    Snapshot ret;
+    uint64_t buckets[kBucketCount];
+    for (uint32_t i = 0; i < kBucketCount; ++i) {
+        buckets[i] = _buckets[i].load(memory_order_relaxed);
+        ret.count += buckets[i];
+    }
+    ret.sum_us = _sum_us.load(memory_order_relaxed);
+    ret.max_us = _max_us.load(memory_order_relaxed);
+    if (!ret.count) {
+        return ret;
+    }
+
+    uint64_t *percentiles[] = {&ret.p50_us, &ret.p90_us, &ret.p99_us, &ret.p999_us};
+    const uint64_t permille[] = {500, 900, 990, 999};
+    uint64_t total = 0;
+    size_t index = 0;
+    for (uint32_t i = 0; i < kBucketCount && index < 4; ++i) {
+        total += buckets[i];
+        while (index < 4 && total * 1000 >= ret.count * permille[index]) {
+            //桶上限可能超过实际最大值
+            *percentiles[index++] = MIN(bucketUpperBound(i), ret.max_us);
+        }
+    }
+    return ret;
+}
+
+uint64_t LatencyHistogram::countNotGreaterThan(uint64_t us) const {
+    uint64_t ret = 0;
+    for (uint32_t i = 0; i < kBucketCount && bucketUpperBound(i) <= us; ++i) {
+        ret += _buckets[i].load(memory_order_relaxed);
+    }
+    return ret;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+static mutex s_mtx;
+static unordered_map<string, weak_ptr<StreamLatency> > s_latency_map;
+
+static string getKey(const string &vhost, const string &app, const string &stream) {
+    return vhost + "/" + app + "/" + stream;
+}
+
+StreamLatency::Ptr StreamLatency::create(const string &vhost, const string &app, const string &stream) {
+    Ptr ret(new StreamLatency(vhost, app, stream));
+    lock_guard<mutex> lck(s_mtx);
+    s_latency_map[getKey(vhost, app, stream)] = ret;
+    return ret;
+}
+
+StreamLatency::Ptr StreamLatency::find(const string &vhost, const string &app, const string &stream) {
+    lock_guard<mutex> lck(s_mtx);
+    auto it = s_latency_map.find(getKey(vhost, app, stream));
+    return it == s_latency_map.end() ? nullptr : it->second.lock();
+}
+
+void StreamLatency::forEach(const function<void(const Ptr &latency)> &cb) {
+    vector<Ptr> all;
+    {
+        lock_guard<mutex> lck(s_mtx);
+        for (auto &pr : s_latency_map) {
+            if (auto latency = pr.second.lock()) {
+                all.emplace_back(std::move(latency));
+            }
+        }
+    }
+    for (auto &latency : all) {
+        cb(latency);
+    }
+}
+
+void StreamLatency::attachSocket(const Socket::Ptr &sock, const string &vhost, const string &app, const string &stream, Protocol protocol) {
+    auto latency = find(vhost, app, stream);
+    if (!sock || !latency) {
+        return;
+    }
+    weak_ptr<StreamLatency> weak_latency = latency;
+    sock->setOnSendMark([weak_latency, protocol](uint64_t ingest_stamp) {
+        if (auto strong_latency = weak_latency.lock()) {
+            strong_latency->onSend(protocol, ingest_stamp);
+        }
+    });
+}
+
+StreamLatency::StreamLatency(const string &vhost, const string &app, const string &stream) {
+    _vhost = vhost;
+    _app = app;
+    _stream = stream;
+    _ingest.resize(LATENCY_FRAME_CACHE_SIZE);
+    _frames.resize(LATENCY_FRAME_CACHE_SIZE);
+    for (int i = 0; i < ProtocolMax; ++i) {
+        _have_last_key[i] = false;
+        _last_key[i] = 0;
+        _last_stamp[i] = 0;
+    }
+}
+
+StreamLatency::~StreamLatency() {
+    lock_guard<mutex> lck(s_mtx);
+    auto it = s_latency_map.find(getKey(_vhost, _app, _stream));
+    //同名流可能已经重新登记
+    if (it != s_latency_map.end() && it->second.expired()) {
+        s_latency_map.erase(it);
+    }
+}
+
+void StreamLatency::onIngest(const Frame::Ptr &frame) {
+    auto now = getCurrentMicrosecond();
+    auto dts = (uint32_t) frame->dts();
+    auto &item = _ingest[_ingest_pos++ % _ingest.size()];
+    item.dts = dts;
+    item.stamp = now;
+    _frame_count.fetch_add(1, memory_order_relaxed);
+
+    auto type = frame->getTrackType();
+    if (type < 0 || type >= TrackMax) {
+        return;
+    }
+    auto &jitter = _jitter[type];
+    if (jitter.have_last && dts == jitter.last_dts) {
+        //同一帧的多个部分(例如sps、pps与idr)
+        return;
+    }
+    if (jitter.have_last) {
+        //rfc3550 6.4.1: J(i) = J(i-1) + (|D(i-1,i)| - J(i-1)) / 16
+        int64_t diff = (int64_t) (now - jitter.last_arrival) - (int64_t) (int32_t) (dts - jitter.last_dts) * 1000;
+        int64_t last = jitter.jitter_us.load(memory_order_relaxed);
+        last += ((diff < 0 ? -diff : diff) - last) / 16;
+        jitter.jitter_us.store(last, memory_order_relaxed);
+    }
+    jitter.have_last = true;
+    jitter.last_dts = dts;
+    jitter.last_arrival = now;
+}
+
+void StreamLatency::onTrackFrame(uint32_t dts_in, uint32_t dts, uint32_t pts) {
+    uint64_t stamp = 0;
+    //从最新的入口帧开始查找
+    for (size_t i = 1; i <= _ingest.size() && i <= _ingest_pos; ++i) {
+        auto &item = _ingest[(_ingest_pos - i) % _ingest.size()];
+        if (item.dts == dts_in) {
+            stamp = item.stamp;
+            break;
+        }
+    }
+    if (!stamp) {
+        return;
+    }
+    auto &item = _frames[_frame_pos++ % _frames.size()];
+    item.dts = dts;
+    item.pts = pts;
+    item.stamp = stamp;
+}
+
+uint64_t StreamLatency::findFrame(const function<bool(const FrameItem &item)> &match) const {
+    for (size_t i = 1; i <= _frames.size() && i <= _frame_pos; ++i) {
+        auto &item = _frames[(_frame_pos - i) % _frames.size()];
+        if (match(item)) {
+            return item.stamp;
+        }
+    }
+    return 0;
+}
+
+uint64_t StreamLatency::recordMux(Protocol protocol, uint32_t key, const function<bool(const FrameItem &item)> &match) {
+    if (_have_last_key[protocol] && _last_key[protocol] == key) {
+        //同一帧的多个数据包
+        return _last_stamp[protocol];
+    }
+    auto stamp = findFrame(match);
+    _have_last_key[protocol] = true;
+    _last_key[protocol] = key;
+    _last_stamp[protocol] = stamp;
+    if (stamp) {
+        _histogram[protocol][StageMux].record(getCurrentMicrosecond() - stamp);
+    }
+    return stamp;
+}
+
+uint64_t StreamLatency::onMuxOutput(Protocol protocol, uint32_t dts) {
+    return recordMux(protocol, dts, [dts](const FrameItem &item) {
+        return item.dts == dts;
+    });
+}
+
+uint64_t StreamLatency::onMuxOutputRtp(uint32_t rtp_stamp, uint32_t sample_rate) {
+    return recordMux(ProtocolRtsp, rtp_stamp, [rtp_stamp, sample_rate](const FrameItem &item) {
+        //与RtpInfo::makeRtp中的换算方式一致
+        return (uint32_t) (uint64_t(item.pts) * sample_rate / 1000) == rtp_stamp;
+    });
+}
+
+void StreamLatency::onSend(Protocol protocol, uint64_t ingest_stamp) {
+    auto now = getCurrentMicrosecond();
+    _histogram[protocol][StageSend].record(now > ingest_stamp ? now - ingest_stamp : 0);
+}
+
+const LatencyHistogram &StreamLatency::getHistogram(Protocol protocol, Stage stage) const {
+    return _histogram[protocol][stage];
+}
+
+uint64_t StreamLatency::getJitter(TrackType type) const {
+    if (type < 0 || type >= TrackMax) {
+        return 0;
+    }
+    return _jitter[type].jitter_us.load(memory_order_relaxed);
+}
+
+uint64_t StreamLatency::getFrameCount() const {
+    return _frame_count.load(memory_order_relaxed);
+}
+
+const char *StreamLatency::getProtocolName(Protocol protocol) {
+    switch (protocol) {
+        case ProtocolRtsp: return "rtsp";
+        case ProtocolRtmp: return "rtmp";
+        case ProtocolTS: return "ts";
+        case ProtocolFMP4: return "fmp4";
+        default: return "invalid";
+    }
+}
+
+const char *StreamLatency::getStageName(Stage stage) {
+    switch (stage) {
+        case StageMux: return "mux";
+        case StageSend: return "send";
+        default: return "invalid";
+    }
+}
+
+}//namespace mediakit
@@ -0,0 +1,244 @@
+﻿/*
+ * Copyright (c) 2016 The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/xia-chu/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef ZLMEDIAKIT_STREAMLATENCY_H
+#define ZLMEDIAKIT_STREAMLATENCY_H
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <functional>
+#include "Network/Socket.h"
+#include "Extension/Frame.h"
+
+using namespace std;
+using namespace toolkit;
+
+namespace mediakit {
+
+/**
+ * HDR风格的延时直方图，单位微秒
+ * 按2的幂分组，每组再线性分为16个桶，相对误差不超过1/16，最大统计到2^27微秒(约134秒)
+ * record可以在任意线程并发调用，只有若干原子加操作
+ */
+class LatencyHistogram {
+public:
+    class Snapshot {
+    public:
+        uint64_t count = 0;
+        uint64_t sum_us = 0;
+        uint64_t max_us = 0;
+        uint64_t p50_us = 0;
+        uint64_t p90_us = 0;
+        uint64_t p99_us = 0;
+        uint64_t p999_us = 0;
+    };
+
+    //每组桶数的位数
+    static constexpr uint32_t kSubBucketBits = 4;
+    static constexpr uint32_t kSubBucketCount = 1 << kSubBucketBits;
+    //最大可统计值的位数
+    static constexpr uint32_t kMaxValueBits = 27;
+    static constexpr uint32_t kBucketCount = kSubBucketCount * (kMaxValueBits - kSubBucketBits + 1);
+
+    LatencyHistogram();
+
+    /**
+     * 记录一次耗时
+     * @param us 耗时，单位微秒，超过最大值时按最大值统计
+     */
+    void record(uint64_t us);
+
+    /**
+     * 获取统计结果
+     */
+    Snapshot snapshot() const;
+
+    /**
+     * 获取不大于指定值的样本个数(近似值，按桶上限比较)，用于输出prometheus直方图
+     */
+    uint64_t countNotGreaterThan(uint64_t us) const;
+
+    /**
+     * 值所在的桶
+     */
+    static uint32_t bucketIndex(uint64_t us);
+
+    /**
+     * 桶所能表示的最大值
+     */
+    static uint64_t bucketUpperBound(uint32_t index);
+
+private:
+    atomic<uint64_t> _count{0};
+    atomic<uint64_t> _sum_us{0};
+    atomic<uint64_t> _max_us{0};
+    atomic<uint64_t> _buckets[kBucketCount];
+};
+
+/**
+ * 单个流的端到端延时统计，各协议数据从入口到打包输出、再到写入socket的耗时
+ * 入口: MultiMediaSourceMuxer::inputFrame，记录帧的入口时刻，并统计各track的到达抖动(rfc3550算法)
+ * 打包: 各协议muxer输出数据时，根据时间戳找到对应帧的入口时刻，统计打包耗时，并把入口时刻记录在数据包中
+ * 发送: 播放器会话把数据包的入口时刻作为socket发送标记，数据写入socket时统计总耗时
+ * 直接转发推流数据的协议(例如rtmp推流rtmp播放)，入口时刻为推流数据包到达时刻，没有打包耗时
+ * onIngest/onTrackFrame/onMuxOutput只能在生产者线程调用，其他接口可以在任意线程调用
+ */
+class StreamLatency : public std::enable_shared_from_this<StreamLatency> {
+public:
+    using Ptr = std::shared_ptr<StreamLatency>;
+
+    //按数据包格式区分协议，rtmp包括rtmp、http-flv、websocket-flv播放，ts、fmp4包括http与websocket播放
+    enum Protocol {
+        ProtocolRtsp = 0,
+        ProtocolRtmp,
+        ProtocolTS,
+        ProtocolFMP4,
+        ProtocolMax
+    };
+
+    enum Stage {
+        StageMux = 0,
+        StageSend,
+        StageMax
+    };
+
+    /**
+     * 创建并登记，同名流已经存在时覆盖
+     */
+    static Ptr create(const string &vhost, const string &app, const string &stream);
+
+    /**
+     * 查找流的延时统计，不存在时返回nullptr
+     */
+    static Ptr find(const string &vhost, const string &app, const string &stream);
+
+    /**
+     * 遍历所有流的延时统计
+     */
+    static void forEach(const function<void(const Ptr &latency)> &cb);
+
+    /**
+     * 设置socket发送标记回调，统计该socket发送阶段的耗时
+     * 之后发送数据包时，通过Socket::addSendMark插入数据包的入口时刻即可
+     * @param sock 播放器socket
+     * @param vhost 虚拟主机
+     * @param app 应用名
+     * @param stream 流id
+     * @param protocol 播放的协议
+     */
+    static void attachSocket(const Socket::Ptr &sock, const string &vhost, const string &app, const string &stream, Protocol protocol);
+
+    ~StreamLatency();
+
+    const string &getVhost() const { return _vhost; }
+    const string &getApp() const { return _app; }
+    const string &getStream() const { return _stream; }
+
+    /**
+     * 帧进入MultiMediaSourceMuxer时调用，记录入口时刻
+     */
+    void onIngest(const Frame::Ptr &frame);
+
+    /**
+     * 帧输入到各协议muxer前调用，用于开启时间戳覆盖等情况下把muxer看到的时间戳与入口时刻对应起来
+     * @param dts_in 入口时的dts
+     * @param dts 输入muxer的dts
+     * @param pts 输入muxer的pts
+     */
+    void onTrackFrame(uint32_t dts_in, uint32_t dts, uint32_t pts);
+
+    /**
+     * muxer输出数据时调用，根据dts查找入口时刻并统计打包耗时，同一dts只统计一次
+     * @return 入口时刻，单位微秒，找不到时返回0
+     */
+    uint64_t onMuxOutput(Protocol protocol, uint32_t dts);
+
+    /**
+     * rtp打包输出时调用，根据rtp时间戳(由pts换算而来)查找入口时刻并统计打包耗时
+     * @return 入口时刻，单位微秒，找不到时返回0
+     */
+    uint64_t onMuxOutputRtp(uint32_t rtp_stamp, uint32_t sample_rate);
+
+    /**
+     * 数据写入socket时调用
+     * @param protocol 协议
+     * @param ingest_stamp 数据的入口时刻，单位微秒
+     */
+    void onSend(Protocol protocol, uint64_t ingest_stamp);
+
+    /**
+     * 获取某协议某阶段的延时直方图
+     */
+    const LatencyHistogram &getHistogram(Protocol protocol, Stage stage) const;
+
+    /**
+     * 获取某track的到达抖动，单位微秒
+     */
+    uint64_t getJitter(TrackType type) const;
+
+    /**
+     * 入口帧个数
+     */
+    uint64_t getFrameCount() const;
+
+    static const char *getProtocolName(Protocol protocol);
+    static const char *getStageName(Stage stage);
+
+private:
+    class IngestItem {
+    public:
+        uint32_t dts = 0;
+        uint64_t stamp = 0;
+    };
+
+    class FrameItem {
+    public:
+        uint32_t dts = 0;
+        uint32_t pts = 0;
+        uint64_t stamp = 0;
+    };
+
+    class TrackJitter {
+    public:
+        bool have_last = false;
+        uint32_t last_dts = 0;
+        uint64_t last_arrival = 0;
+        atomic<uint64_t> jitter_us{0};
+    };
+
+    StreamLatency(const string &vhost, const string &app, const string &stream);
+    uint64_t findFrame(const function<bool(const FrameItem &item)> &match) const;
+    uint64_t recordMux(Protocol protocol, uint32_t key, const function<bool(const FrameItem &item)> &match);
+
+    string _vhost;
+    string _app;
+    string _stream;
+
+    //以下只在生产者线程访问
+    //最近入口帧的dts与入口时刻
+    vector<IngestItem> _ingest;
+    size_t _ingest_pos = 0;
+    //最近输入muxer的帧的时间戳与入口时刻
+    vector<FrameItem> _frames;
+    size_t _frame_pos = 0;
+    //各协议最近一次统计的时间戳及其入口时刻，同一时间戳的多个数据包只统计一次
+    bool _have_last_key[ProtocolMax];
+    uint32_t _last_key[ProtocolMax];
+    uint64_t _last_stamp[ProtocolMax];
+
+    TrackJitter _jitter[TrackMax];
+    atomic<uint64_t> _frame_count{0};
+    LatencyHistogram _histogram[ProtocolMax][StageMax];
+};
+
+}//namespace mediakit
+#endif //ZLMEDIAKIT_STREAMLATENCY_H
@@ -14,6 +14,8 @@
 #include "Util/onceToken.h"
 #include "Util/NoticeCenter.h"
 #include "Network/sockutil.h"
+#include "Network/Socket.h"
+#include "Util/BufferPool.h"
 
 using namespace toolkit;
 
@@ -68,6 +70,8 @@ const string kResetWhenRePlay = GENERAL_FIELD"resetWhenRePlay";
 const string kPublishToHls = GENERAL_FIELD"publishToHls";
 const string kPublishToMP4 = GENERAL_FIELD"publishToMP4";
 const string kMergeWriteMS = GENERAL_FIELD"mergeWriteMS";
+const string kAdaptiveMergeWrite = GENERAL_FIELD"adaptiveMergeWrite";
+const string kMergeWriteMaxMS = GENERAL_FIELD"mergeWriteMaxMS";
 const string kModifyStamp = GENERAL_FIELD"modifyStamp";
 const string kHlsDemand = GENERAL_FIELD"hls_demand";
 const string kRtspDemand = GENERAL_FIELD"rtsp_demand";
@@ -75,6 +79,15 @@ const string kRtmpDemand = GENERAL_FIELD"rtmp_demand";
 const string kTSDemand = GENERAL_FIELD"ts_demand";
 const string kFMP4Demand = GENERAL_FIELD"fmp4_demand";
 const string kEnableAudio = GENERAL_FIELD"enable_audio";
+const string kLockFreeRing = GENERAL_FIELD"lockFreeRing";
+const string kUdpBatchSend = GENERAL_FIELD"udpBatchSend";
+const string kUdpBatchRecv = GENERAL_FIELD"udpBatchRecv";
+const string kBufferPool = GENERAL_FIELD"bufferPool";
+const string kBufferPoolMaxCacheMB = GENERAL_FIELD"bufferPoolMaxCacheMB";
+const string kSharedGopCache = GENERAL_FIELD"sharedGopCache";
+const string kSharedGopCacheMaxMB = GENERAL_FIELD"sharedGopCacheMaxMB";
+const string kReusePortListen = GENERAL_FIELD"reusePortListen";
+const string kReusePortCpuAffinity = GENERAL_FIELD"reusePortCpuAffinity";
 
 onceToken token([](){
     mINI::Instance()[kFlowThreshold] = 1024;
@@ -86,6 +99,8 @@ onceToken token([](){
     mINI::Instance()[kPublishToHls] = 1;
     mINI::Instance()[kPublishToMP4] = 0;
     mINI::Instance()[kMergeWriteMS] = 0;
+    mINI::Instance()[kAdaptiveMergeWrite] = 0;
+    mINI::Instance()[kMergeWriteMaxMS] = 200;
     mINI::Instance()[kModifyStamp] = 0;
     mINI::Instance()[kMediaServerId] = makeRandStr(16);
     mINI::Instance()[kHlsDemand] = 0;
@@ -94,7 +109,23 @@ onceToken token([](){
     mINI::Instance()[kTSDemand] = 0;
     mINI::Instance()[kFMP4Demand] = 0;
     mINI::Instance()[kEnableAudio] = 1;
-
+    mINI::Instance()[kLockFreeRing] = 0;
+    mINI::Instance()[kUdpBatchSend] = 1;
+    mINI::Instance()[kUdpBatchRecv] = 1;
+    mINI::Instance()[kBufferPool] = 1;
+    mINI::Instance()[kBufferPoolMaxCacheMB] = 16;
+    mINI::Instance()[kSharedGopCache] = 0;
+    mINI::Instance()[kSharedGopCacheMaxMB] = 1024;
+    mINI::Instance()[kReusePortListen] = 0;
+    mINI::Instance()[kReusePortCpuAffinity] = 1;
+
+    //该配置作用于ZLToolKit的Socket与BufferPool，需要在加载配置后同步过去
+    NoticeCenter::Instance().addListener(ReloadConfigTag, Broadcast::kBroadcastReloadConfig, [](BroadcastReloadConfigArgs) {
+        Socket::setUdpBatchSend(mINI::Instance()[kUdpBatchSend].as<bool>());
+        Socket::setUdpBatchRecv(mINI::Instance()[kUdpBatchRecv].as<bool>());
+        BufferPool::setMaxCacheSize(mINI::Instance()[kBufferPoolMaxCacheMB].as<size_t>() * 1024 * 1024);
+        BufferPool::setEnable(mINI::Instance()[kBufferPool].as<bool>());
+    });
 },nullptr);
 
 }//namespace General
@@ -116,12 +147,18 @@ const string kRootPath = HTTP_FIELD"rootPath";
 const string kNotFound = HTTP_FIELD"notFound";
 //是否显示文件夹菜单
 const string kDirMenu = HTTP_FIELD"dirMenu";
+const string kFileCacheMaxMB = HTTP_FIELD"fileCacheMaxMB";
+const string kFileCacheMaxFileKB = HTTP_FIELD"fileCacheMaxFileKB";
+const string kSendFile = HTTP_FIELD"sendfile";
 
 onceToken token([](){
     mINI::Instance()[kSendBufSize] = 64 * 1024;
     mINI::Instance()[kMaxReqSize] = 4 * 10240;
     mINI::Instance()[kKeepAliveSecond] = 15;
     mINI::Instance()[kDirMenu] = true;
+    mINI::Instance()[kFileCacheMaxMB] = 64;
+    mINI::Instance()[kFileCacheMaxFileKB] = 1024;
+    mINI::Instance()[kSendFile] = 1;
 
 #if defined(_WIN32)
     mINI::Instance()[kCharSet] = "gb2312";
@@ -177,11 +214,15 @@ namespace Rtmp {
 const string kModifyStamp = RTMP_FIELD"modifyStamp";
 const string kHandshakeSecond = RTMP_FIELD"handshakeSecond";
 const string kKeepAliveSecond = RTMP_FIELD"keepAliveSecond";
+const string kShareFlvTag = RTMP_FIELD"shareFlvTag";
+const string kReserveChunkBody = RTMP_FIELD"reserveChunkBody";
 
 onceToken token([](){
     mINI::Instance()[kModifyStamp] = false;
     mINI::Instance()[kHandshakeSecond] = 15;
     mINI::Instance()[kKeepAliveSecond] = 15;
+    mINI::Instance()[kShareFlvTag] = false;
+    mINI::Instance()[kReserveChunkBody] = true;
 },nullptr);
 } //namespace RTMP
 
@@ -236,6 +277,12 @@ const string kFileBufSize = RECORD_FIELD"fileBufSize";
 const string kFastStart = RECORD_FIELD"fastStart";
 //mp4文件是否重头循环读取
 const string kFileRepeat = RECORD_FIELD"fileRepeat";
+//录制(mp4/hls/flv)是否在后台异步写文件
+const string kAsyncWrite = RECORD_FIELD"asyncWrite";
+//异步写文件是否优先使用io_uring
+const string kIoUring = RECORD_FIELD"ioUring";
+//单个文件异步写入积压上限，超过后录制器丢帧，单位MB
+const string kWriteQueueMaxMB = RECORD_FIELD"writeQueueMaxMB";
 
 onceToken token([](){
     mINI::Instance()[kAppName] = "record";
@@ -245,6 +292,9 @@ onceToken token([](){
     mINI::Instance()[kFileBufSize] = 64 * 1024;
     mINI::Instance()[kFastStart] = false;
     mINI::Instance()[kFileRepeat] = false;
+    mINI::Instance()[kAsyncWrite] = false;
+    mINI::Instance()[kIoUring] = true;
+    mINI::Instance()[kWriteQueueMaxMB] = 32;
 },nullptr);
 } //namespace Record
 
@@ -265,6 +315,12 @@ const string kFilePath = HLS_FIELD"filePath";
 const string kBroadcastRecordTs = HLS_FIELD"broadcastRecordTs";
 //hls直播文件删除延时，单位秒
 const string kDeleteDelaySec = HLS_FIELD"deleteDelaySec";
+//hls直播切片与m3u8是否只保存在内存中
+const string kInMemory = HLS_FIELD"inMemory";
+//是否开启低延时hls
+const string kLowLatency = HLS_FIELD"lowLatency";
+//低延时hls的part时长
+const string kPartDuration = HLS_FIELD"partDur";
 
 onceToken token([](){
     mINI::Instance()[kSegmentDuration] = 2;
@@ -274,6 +330,9 @@ onceToken token([](){
     mINI::Instance()[kFilePath] = "./www";
     mINI::Instance()[kBroadcastRecordTs] = false;
     mINI::Instance()[kDeleteDelaySec] = 0;
+    mINI::Instance()[kInMemory] = 0;
+    mINI::Instance()[kLowLatency] = 0;
+    mINI::Instance()[kPartDuration] = 0.5;
 },nullptr);
 } //namespace Hls
 
@@ -292,6 +351,20 @@ onceToken token([](){
 },nullptr);
 } //namespace RtpProxy
 
+////////////边缘节点相关配置///////////
+namespace Edge {
+#define EDGE_FIELD "edge."
+const string kOrigin = EDGE_FIELD"origin";
+const string kRtpType = EDGE_FIELD"rtpType";
+const string kIdleTimeoutMS = EDGE_FIELD"idleTimeoutMS";
+
+onceToken token([](){
+    mINI::Instance()[kOrigin] = "";
+    mINI::Instance()[kRtpType] = 0;
+    mINI::Instance()[kIdleTimeoutMS] = 10000;
+},nullptr);
+} //namespace Edge
+
 
 namespace Client {
 const string kNetAdapter = "net_adapter";
@@ -158,6 +158,11 @@ extern const string kPublishToMP4 ;
 //合并写缓存大小(单位毫秒)，合并写指服务器缓存一定的数据后才会一次性写入socket，这样能提高性能，但是会提高延时
 //开启后会同时关闭TCP_NODELAY并开启MSG_MORE
 extern const string kMergeWriteMS ;
+//是否开启自适应合并写，开启后每个流根据观看人数、观看者socket发送缓存积压与码率自动调整合并写窗口
+//观看人数少时逐帧发送保证低延时，观看人数多或者发送积压时合并写以减少系统调用，此时mergeWriteMS为窗口下限
+extern const string kAdaptiveMergeWrite;
+//自适应合并写窗口上限，单位毫秒
+extern const string kMergeWriteMaxMS;
 //全局的时间戳覆盖开关，在转协议时，对frame进行时间戳覆盖
 extern const string kModifyStamp;
 //按需转协议的开关
@@ -168,6 +173,25 @@ extern const string kTSDemand;
 extern const string kFMP4Demand;
 //转协议是否全局开启或忽略音频
 extern const string kEnableAudio;
+//rtsp/rtmp/ts/fmp4媒体源的环形缓存是否使用单生产者多消费者无锁模式
+//开启后每个poller线程每次唤醒批量派发数据，gop缓存在所有poller间共享，适合单个流观看人数很多的场景
+extern const string kLockFreeRing;
+//udp发送是否使用批量发送(sendmmsg)，内核支持时同目标等长数据报通过GSO合并发送，可降低rtp over udp的系统调用次数
+extern const string kUdpBatchSend;
+//udp接收是否使用批量接收(recvmmsg)，一次系统调用读取多个数据报，可降低rtp over udp(如GB28181)收流的系统调用次数
+extern const string kUdpBatchRecv;
+//Buffer对象及其数据内存(rtp/rtmp包、帧等)是否从分级内存池分配，可降低海量流时malloc/free的开销
+extern const string kBufferPool;
+//内存池每个级别全局空闲链表最多缓存的内存大小，单位MB，超过部分归还系统
+extern const string kBufferPoolMaxCacheMB;
+//是否开启各协议共享的帧级别gop缓存，开启后各协议无人观看时不打包也不缓存，有人观看时回放共享的gop缓存重新打包
+extern const string kSharedGopCache;
+//所有流共享gop缓存占用内存的上限，单位MB，超过后淘汰最久未被回放的gop缓存，0为不限制
+extern const string kSharedGopCacheMaxMB;
+//tcp服务器是否使用SO_REUSEPORT分片监听，每个poller线程独立listen，连接由内核分配且不再跨线程派发
+extern const string kReusePortListen;
+//SO_REUSEPORT分片监听时是否按收到连接的cpu选择poller线程(linux cbpf)，关闭则由内核按四元组哈希分配
+extern const string kReusePortCpuAffinity;
 }//namespace General
 
 
@@ -187,6 +211,12 @@ extern const string kRootPath;
 extern const string kNotFound;
 //是否显示文件夹菜单
 extern const string kDirMenu;
+//热点文件内存缓存总大小上限，单位MB，0为关闭
+extern const string kFileCacheMaxMB;
+//可缓存的单个文件大小上限，单位KB
+extern const string kFileCacheMaxFileKB;
+//未缓存的文件在非ssl连接上是否通过sendfile发送
+extern const string kSendFile;
 }//namespace Http
 
 ////////////SHELL配置///////////
@@ -219,6 +249,10 @@ extern const string kModifyStamp;
 extern const string kHandshakeSecond;
 //维持链接超时时间，默认15秒
 extern const string kKeepAliveSecond;
+//http-flv/ws-flv播放器是否共享序列化后的flv tag
+extern const string kShareFlvTag;
+//chunk重组时是否按消息长度一次性预留内存
+extern const string kReserveChunkBody;
 } //namespace RTMP
 
 
@@ -258,6 +292,12 @@ extern const string kFileBufSize;
 extern const string kFastStart;
 //mp4文件是否重头循环读取
 extern const string kFileRepeat;
+//录制(mp4/hls/flv)是否在后台异步写文件
+extern const string kAsyncWrite;
+//异步写文件是否优先使用io_uring
+extern const string kIoUring;
+//单个文件异步写入积压上限，超过后录制器丢帧，单位MB
+extern const string kWriteQueueMaxMB;
 } //namespace Record
 
 ////////////HLS相关配置///////////
@@ -276,6 +316,13 @@ extern const string kFilePath;
 extern const string kBroadcastRecordTs;
 //hls直播文件删除延时，单位秒
 extern const string kDeleteDelaySec;
+//hls直播切片与m3u8是否只保存在内存中，开启后直播hls不写磁盘，http服务器直接从内存回复
+//hls录制(segNum为0)时仍然保存到磁盘，是否异步写入由record.asyncWrite决定
+extern const string kInMemory;
+//是否开启低延时hls(LL-HLS)，基于fmp4生成，播放地址为http://vhost-url:port/app/stream/ll-hls.m3u8
+extern const string kLowLatency;
+//低延时hls的part时长，单位秒
+extern const string kPartDuration;
 } //namespace Hls
 
 ////////////Rtp代理相关配置///////////
@@ -286,6 +333,17 @@ extern const string kDumpDir;
 extern const string kTimeoutSec;
 } //namespace RtpProxy
 
+////////////边缘节点相关配置///////////
+namespace Edge {
+//源站地址，例如rtmp://10.0.0.1:1935，置空则关闭边缘模式
+//开启后播放本机不存在的流时，从源站拉取同app/stream的流
+extern const string kOrigin;
+//拉流方式，0:tcp，1:udp，仅rtsp源站有效
+extern const string kRtpType;
+//边缘流无人观看多久后断开源站拉流，单位毫秒
+extern const string kIdleTimeoutMS;
+} //namespace Edge
+
 /**
  * rtsp/rtmp播放器、推流器相关设置名，
  * 这些设置项都不是配置文件用
@@ -247,8 +247,8 @@ void FrameMerger::inputFrame(const Frame::Ptr &frame, const onOutput &cb, Buffer
         Buffer::Ptr merged_frame = back;
         bool have_key_frame = back->keyFrame();
 
-        if (_frame_cache.size() != 1 || _type == mp4_nal_size || buffer) {
-            //在MP4模式下，一帧数据也需要在前添加nalu_size
+        if (_frame_cache.size() != 1 || _type == mp4_nal_size || buffer || (_type == h264_prefix && !back->prefixSize())) {
+            //在MP4模式下，一帧数据也需要在前添加nalu_size，h264_prefix模式下不带起始码的帧需要添加起始码
             BufferLikeString tmp;
             BufferLikeString &merged = buffer ? *buffer : tmp;
 
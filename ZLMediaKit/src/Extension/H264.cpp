@@ -10,6 +10,7 @@
 
 #include "H264.h"
 #include "SPSParser.h"
+#include "StartCode.h"
 #include "Util/logger.h"
 using namespace toolkit;
 
@@ -38,24 +39,16 @@ bool getAVCInfo(const string &strSps, int &iVideoWidth, int &iVideoHeight, float
     return getAVCInfo(strSps.data(), strSps.size(), iVideoWidth, iVideoHeight, iVideoFps);
 }
 
-static const char *memfind(const char *buf, ssize_t len, const char *subbuf, ssize_t sublen) {
-    for (auto i = 0; i < len - sublen; ++i) {
-        if (memcmp(buf + i, subbuf, sublen) == 0) {
-            return buf + i;
-        }
-    }
-    return NULL;
-}
-
 void splitH264(const char *ptr, size_t len, size_t prefix, const std::function<void(const char *, size_t , size_t)> &cb) {
     auto start = ptr + prefix;
     auto end = ptr + len;
     size_t next_prefix;
     while (true) {
-        auto next_start = memfind(start, end - start, "\x00\x00\x01", 3);
+        //起始码后面至少还有一个字节才算找到下一帧
+        auto next_start = end - start > 1 ? findStartCode(start, end - start - 1) : nullptr;
         if (next_start) {
             //找到下一帧
-            if (*(next_start - 1) == 0x00) {
+            if (next_start > start && *(next_start - 1) == 0x00) {
                 //这个是00 00 00 01开头
                 next_start -= 1;
                 next_prefix = 4;
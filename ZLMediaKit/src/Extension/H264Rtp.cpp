@@ -198,32 +198,34 @@ void H264RtpEncoder::insertConfigFrame(uint32_t pts){
         return;
     }
     //gop缓存从sps开始，sps、pps后面还有时间戳相同的关键帧，所以mark bit为false
-    packRtp(_sps->data() + _sps->prefixSize(), _sps->size() - _sps->prefixSize(), pts, false, true);
-    packRtp(_pps->data() + _pps->prefixSize(), _pps->size() - _pps->prefixSize(), pts, false, false);
+    packRtp(_sps, _sps->data() + _sps->prefixSize(), _sps->size() - _sps->prefixSize(), pts, false, true);
+    packRtp(_pps, _pps->data() + _pps->prefixSize(), _pps->size() - _pps->prefixSize(), pts, false, false);
 }
 
-void H264RtpEncoder::packRtp(const char *ptr, size_t len, uint32_t pts, bool is_mark, bool gop_pos){
+void H264RtpEncoder::packRtp(const Frame::Ptr &frame, const char *ptr, size_t len, uint32_t pts, bool is_mark, bool gop_pos){
     if (len + 3 <= getMaxSize()) {
         //STAP-A模式打包小于MTU
-        packRtpStapA(ptr, len, pts, is_mark, gop_pos);
+        packRtpStapA(frame, ptr, len, pts, is_mark, gop_pos);
     } else {
         //STAP-A模式打包会大于MTU,所以采用FU-A模式
-        packRtpFu(ptr, len, pts, is_mark, gop_pos);
+        packRtpFu(frame, ptr, len, pts, is_mark, gop_pos);
     }
 }
 
-void H264RtpEncoder::packRtpFu(const char *ptr, size_t len, uint32_t pts, bool is_mark, bool gop_pos){
+void H264RtpEncoder::packRtpFu(const Frame::Ptr &frame, const char *ptr, size_t len, uint32_t pts, bool is_mark, bool gop_pos){
     auto packet_size = getMaxSize() - 2;
     if (len <= packet_size + 1) {
         //小于FU-A打包最小字节长度要求，采用STAP-A模式
-        packRtpStapA(ptr, len, pts, is_mark, gop_pos);
+        packRtpStapA(frame, ptr, len, pts, is_mark, gop_pos);
         return;
     }
 
-    //末尾5bit为nalu type，固定为28(FU-A)
-    auto fu_char_0 = (ptr[0] & (~0x1F)) | 28;
-    auto fu_char_1 = H264_TYPE(ptr[0]);
-    FuFlags *fu_flags = (FuFlags *) (&fu_char_1);
+    //FU-A 第1个字节，末尾5bit为nalu type，固定为28(FU-A)
+    uint8_t fu_header[2];
+    fu_header[0] = (ptr[0] & (~0x1F)) | 28;
+    //FU-A 第2个字节
+    fu_header[1] = H264_TYPE(ptr[0]);
+    FuFlags *fu_flags = (FuFlags *) (&fu_header[1]);
     fu_flags->start_bit = 1;
 
     size_t offset = 1;
@@ -234,16 +236,8 @@ void H264RtpEncoder::packRtpFu(const char *ptr, size_t len, uint32_t pts, bool i
             fu_flags->end_bit = 1;
         }
 
-        //传入nullptr先不做payload的内存拷贝
-        auto rtp = makeRtp(getTrackType(), nullptr, packet_size + 2, fu_flags->end_bit && is_mark, pts);
-        //rtp payload 负载部分
-        uint8_t *payload = rtp->getPayload();
-        //FU-A 第1个字节
-        payload[0] = fu_char_0;
-        //FU-A 第2个字节
-        payload[1] = fu_char_1;
-        //H264 数据
-        memcpy(payload + 2, (uint8_t *) ptr + offset, packet_size);
+        //H264 数据直接引用帧，不做内存拷贝
+        auto rtp = makeRtp(getTrackType(), fu_header, 2, frame, ptr + offset, packet_size, fu_flags->end_bit && is_mark, pts);
         //输入到rtp环形缓存
         RtpCodec::inputRtp(rtp, gop_pos);
 
@@ -252,16 +246,14 @@ void H264RtpEncoder::packRtpFu(const char *ptr, size_t len, uint32_t pts, bool i
     }
 }
 
-void H264RtpEncoder::packRtpStapA(const char *ptr, size_t len, uint32_t pts, bool is_mark, bool gop_pos){
+void H264RtpEncoder::packRtpStapA(const Frame::Ptr &frame, const char *ptr, size_t len, uint32_t pts, bool is_mark, bool gop_pos){
     //如果帧长度不超过mtu,为了兼容性 webrtc，采用STAP-A模式打包
-    auto rtp = makeRtp(getTrackType(), nullptr, len + 3, is_mark, pts);
-    uint8_t *payload = rtp->getPayload();
+    uint8_t stap_a_header[3];
     //STAP-A
-    payload[0] = (ptr[0] & (~0x1F)) | 24;
-    payload[1] = (len >> 8) & 0xFF;
-    payload[2] = len & 0xff;
-    memcpy(payload + 3, (uint8_t *) ptr, len);
-
+    stap_a_header[0] = (ptr[0] & (~0x1F)) | 24;
+    stap_a_header[1] = (len >> 8) & 0xFF;
+    stap_a_header[2] = len & 0xff;
+    auto rtp = makeRtp(getTrackType(), stap_a_header, 3, frame, ptr, len, is_mark, pts);
     RtpCodec::inputRtp(rtp, gop_pos);
 }
 
@@ -295,7 +287,7 @@ void H264RtpEncoder::inputFrame_l(const Frame::Ptr &frame, bool is_mark){
         //保证每一个关键帧前都有SPS与PPS
         insertConfigFrame(frame->pts());
     }
-    packRtp(frame->data() + frame->prefixSize(), frame->size() - frame->prefixSize(), frame->pts(), is_mark, false);
+    packRtp(frame, frame->data() + frame->prefixSize(), frame->size() - frame->prefixSize(), frame->pts(), is_mark, false);
 }
 
 }//namespace mediakit
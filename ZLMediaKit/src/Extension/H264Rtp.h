@@ -89,9 +89,10 @@ public:
 private:
     void insertConfigFrame(uint32_t pts);
     void inputFrame_l(const Frame::Ptr &frame, bool is_mark);
-    void packRtp(const char *data, size_t len, uint32_t pts, bool is_mark, bool gop_pos);
-    void packRtpFu(const char *data, size_t len, uint32_t pts, bool is_mark, bool gop_pos);
-    void packRtpStapA(const char *data, size_t len, uint32_t pts, bool is_mark, bool gop_pos);
+    //frame必须可以缓存，rtp负载直接引用其内存
+    void packRtp(const Frame::Ptr &frame, const char *data, size_t len, uint32_t pts, bool is_mark, bool gop_pos);
+    void packRtpFu(const Frame::Ptr &frame, const char *data, size_t len, uint32_t pts, bool is_mark, bool gop_pos);
+    void packRtpStapA(const Frame::Ptr &frame, const char *data, size_t len, uint32_t pts, bool is_mark, bool gop_pos);
 
 private:
     Frame::Ptr _sps;
@@ -263,6 +263,9 @@ void H265RtpEncoder::inputFrame(const Frame::Ptr &frame) {
 
     //超过MTU,按照FU方式打包
     if (len > max_size + 2) {
+        //rtp负载直接引用帧数据，所以帧必须可以缓存
+        auto cache_frame = Frame::getCacheAbleFrame(frame);
+        ptr = (uint8_t *) cache_frame->data() + cache_frame->prefixSize();
         //获取帧头数据，1byte
         unsigned char s_e_flags;
         bool fu_start = true;
@@ -283,18 +286,15 @@ void H265RtpEncoder::inputFrame(const Frame::Ptr &frame) {
             }
 
             {
-                //传入nullptr先不做payload的内存拷贝
-                auto rtp = makeRtp(getTrackType(), nullptr, max_size + 3, mark_bit, pts);
-                //rtp payload 负载部分
-                uint8_t *payload = rtp->getPayload();
+                uint8_t fu_header[3];
                 //FU 第1个字节，表明为FU
-                payload[0] = 49 << 1;
+                fu_header[0] = 49 << 1;
                 //FU 第2个字节貌似固定为1
-                payload[1] = ptr[1];// 1;
+                fu_header[1] = ptr[1];// 1;
                 //FU 第3个字节
-                payload[2] = s_e_flags;
-                //H265 数据
-                memcpy(payload + 3, ptr + offset, max_size);
+                fu_header[2] = s_e_flags;
+                //H265 数据直接引用帧，不做内存拷贝
+                auto rtp = makeRtp(getTrackType(), fu_header, 3, cache_frame, (char *) ptr + offset, max_size, mark_bit, pts);
                 //输入到rtp环形缓存
                 RtpCodec::inputRtp(rtp, fu_start && frame->keyFrame());
             }
@@ -0,0 +1,193 @@
+﻿/*
+ * Copyright (c) 2016 The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/xia-chu/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <stdint.h>
+#include "StartCode.h"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define ENABLE_START_CODE_SIMD
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(ENABLE_START_CODE_SIMD) && (defined(__GNUC__) || defined(__clang__))
+//gcc/clang按函数开启指令集，其他函数仍然按编译选项生成，以便运行时选择
+#define START_CODE_TARGET(x) __attribute__((target(x)))
+#else
+#define START_CODE_TARGET(x)
+#endif
+
+namespace mediakit {
+
+static const char *findStartCode_c(const char *ptr, size_t len) {
+    auto start = (const uint8_t *) ptr;
+    auto end = start + len;
+    //p指向起始码最后一个字节(01)的候选位置，根据该字节跳过不可能的位置
+    for (auto p = start + 2; p < end;) {
+        if (*p > 1) {
+            //p、p+1、p+2都不可能是起始码的最后一个字节
+            p += 3;
+        } else if (*p == 0) {
+            //p可能是起始码的第一或第二个字节
+            ++p;
+        } else {
+            if (p[-1] == 0 && p[-2] == 0) {
+                return (const char *) (p - 2);
+            }
+            p += 3;
+        }
+    }
+    return nullptr;
+}
+
+#if defined(ENABLE_START_CODE_SIMD)
+
+static inline int countTrailingZero(uint32_t mask) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return (int) index;
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+
+START_CODE_TARGET("sse2")
+static const char *findStartCode_sse2(const char *ptr, size_t len) {
+    auto p = (const uint8_t *) ptr;
+    auto end = p + len;
+    auto zero = _mm_setzero_si128();
+    auto one = _mm_set1_epi8(1);
+    //一次判断16个位置是否为起始码，需要读取18个字节
+    while (p + 18 <= end) {
+        auto v0 = _mm_loadu_si128((const __m128i *) p);
+        auto v1 = _mm_loadu_si128((const __m128i *) (p + 1));
+        auto v2 = _mm_loadu_si128((const __m128i *) (p + 2));
+        auto match = _mm_and_si128(_mm_and_si128(_mm_cmpeq_epi8(v0, zero), _mm_cmpeq_epi8(v1, zero)), _mm_cmpeq_epi8(v2, one));
+        auto mask = (uint32_t) _mm_movemask_epi8(match);
+        if (mask) {
+            return (const char *) (p + countTrailingZero(mask));
+        }
+        p += 16;
+    }
+    return findStartCode_c((const char *) p, end - p);
+}
+
+START_CODE_TARGET("avx2")
+static const char *findStartCode_avx2(const char *ptr, size_t len) {
+    auto p = (const uint8_t *) ptr;
+    auto end = p + len;
+    auto zero = _mm256_setzero_si256();
+    auto one = _mm256_set1_epi8(1);
+    //一次判断32个位置是否为起始码，需要读取34个字节
+    while (p + 34 <= end) {
+        auto v0 = _mm256_loadu_si256((const __m256i *) p);
+        auto v1 = _mm256_loadu_si256((const __m256i *) (p + 1));
+        auto v2 = _mm256_loadu_si256((const __m256i *) (p + 2));
+        auto match = _mm256_and_si256(_mm256_and_si256(_mm256_cmpeq_epi8(v0, zero), _mm256_cmpeq_epi8(v1, zero)), _mm256_cmpeq_epi8(v2, one));
+        auto mask = (uint32_t) _mm256_movemask_epi8(match);
+        if (mask) {
+            return (const char *) (p + countTrailingZero(mask));
+        }
+        p += 32;
+    }
+    return findStartCode_sse2((const char *) p, end - p);
+}
+
+static bool cpuSupportAVX2() {
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) {
+        return false;
+    }
+    __cpuid(info, 1);
+    //cpu支持avx且操作系统开启了ymm寄存器保存
+    bool os_avx = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && ((_xgetbv(0) & 0x06) == 0x06);
+    __cpuidex(info, 7, 0);
+    return os_avx && (info[1] & (1 << 5));
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+static bool cpuSupportSSE2() {
+#if defined(__x86_64__) || defined(_M_X64)
+    //x86_64必定支持sse2
+    return true;
+#elif defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    return info[3] & (1 << 26);
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse2");
+#endif
+}
+
+#endif //defined(ENABLE_START_CODE_SIMD)
+
+StartCodeSimd getStartCodeSimd() {
+    static StartCodeSimd s_simd = []() {
+#if defined(ENABLE_START_CODE_SIMD)
+        if (cpuSupportAVX2()) {
+            return StartCodeAVX2;
+        }
+        if (cpuSupportSSE2()) {
+            return StartCodeSSE2;
+        }
+#endif
+        return StartCodeScalar;
+    }();
+    return s_simd;
+}
+
+const char *getStartCodeSimdName(StartCodeSimd simd) {
+    switch (simd) {
+        case StartCodeSSE2: return "sse2";
+        case StartCodeAVX2: return "avx2";
+        default: return "scalar";
+    }
+}
+
+const char *findStartCode(const char *ptr, size_t len, StartCodeSimd simd) {
+#if defined(ENABLE_START_CODE_SIMD)
+    //不得超过cpu支持的指令集
+    if (simd > getStartCodeSimd()) {
+        simd = getStartCodeSimd();
+    }
+    switch (simd) {
+        case StartCodeAVX2: return findStartCode_avx2(ptr, len);
+        case StartCodeSSE2: return findStartCode_sse2(ptr, len);
+        default: break;
+    }
+#endif
+    return findStartCode_c(ptr, len);
+}
+
+const char *findStartCode(const char *ptr, size_t len) {
+    using FindFunc = const char *(*)(const char *, size_t);
+    static FindFunc s_func = []() -> FindFunc {
+#if defined(ENABLE_START_CODE_SIMD)
+        switch (getStartCodeSimd()) {
+            case StartCodeAVX2: return findStartCode_avx2;
+            case StartCodeSSE2: return findStartCode_sse2;
+            default: break;
+        }
+#endif
+        return findStartCode_c;
+    }();
+    return s_func(ptr, len);
+}
+
+}//namespace mediakit
@@ -0,0 +1,49 @@
+﻿/*
+ * Copyright (c) 2016 The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/xia-chu/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef ZLMEDIAKIT_STARTCODE_H
+#define ZLMEDIAKIT_STARTCODE_H
+
+#include <stddef.h>
+
+namespace mediakit {
+
+//annexb起始码查找所用指令集
+typedef enum {
+    StartCodeScalar = 0, //纯C实现，所有平台可用
+    StartCodeSSE2, //每次比较16个字节
+    StartCodeAVX2, //每次比较32个字节
+} StartCodeSimd;
+
+/**
+ * 获取当前cpu支持的最优指令集，首次调用时检测
+ */
+StartCodeSimd getStartCodeSimd();
+
+/**
+ * 获取指令集名称
+ */
+const char *getStartCodeSimdName(StartCodeSimd simd);
+
+/**
+ * 查找annexb起始码00 00 01，使用当前cpu支持的最优指令集
+ * @param ptr 数据指针
+ * @param len 数据长度
+ * @return 起始码(第一个00)位置，找不到时返回nullptr
+ */
+const char *findStartCode(const char *ptr, size_t len);
+
+/**
+ * 使用指定指令集查找annexb起始码，cpu不支持该指令集时使用纯C实现，主要用于测试
+ */
+const char *findStartCode(const char *ptr, size_t len, StartCodeSimd simd);
+
+}//namespace mediakit
+#endif //ZLMEDIAKIT_STARTCODE_H
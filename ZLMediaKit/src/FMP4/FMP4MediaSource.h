@@ -12,6 +12,7 @@
 #define ZLMEDIAKIT_FMP4MEDIASOURCE_H
 
 #include "Common/MediaSource.h"
+#include "Record/LLHlsMaker.h"
 using namespace toolkit;
 #define FMP4_GOP_SIZE 512
 
@@ -28,6 +29,8 @@ public:
 
 public:
     uint32_t time_stamp = 0;
+    //入口时刻，单位微秒，用于统计端到端延时，0代表未知
+    uint64_t ingest_stamp = 0;
 };
 
 //FMP4直播源
@@ -36,6 +39,7 @@ public:
     using Ptr = std::shared_ptr<FMP4MediaSource>;
     using RingDataType = std::shared_ptr<List<FMP4Packet::Ptr> >;
     using RingType = RingBuffer<RingDataType>;
+    using ViewerRingType = RingBuffer<string>;
 
     FMP4MediaSource(const string &vhost,
                     const string &app,
@@ -70,10 +74,32 @@ public:
     }
 
     /**
-     * 获取播放器个数
+     * 获取低延时hls生成器，未开启时返回nullptr
+     */
+    const LLHlsMaker::Ptr &getLLHls() const {
+        return _ll_hls;
+    }
+
+    /**
+     * 设置低延时hls生成器
+     */
+    void setLLHls(LLHlsMaker::Ptr ll_hls) {
+        _ll_hls = std::move(ll_hls);
+    }
+
+    /**
+     * 获取ll-hls播放器计数用的环形缓冲，未开启ll-hls时返回nullptr
+     * 与hls一样，该环形缓冲不写入数据，ll-hls播放器只作为观看者计数，没有逐包分发的开销
+     */
+    const ViewerRingType::Ptr &getLLHlsRing() const {
+        return _ll_hls_ring;
+    }
+
+    /**
+     * 获取播放器个数，包括ll-hls播放器
      */
     int readerCount() override {
-        return _ring ? _ring->readerCount() : 0;
+        return (_ring ? _ring->readerCount() : 0) + (_ll_hls_ring ? _ll_hls_ring->readerCount() : 0);
     }
 
     /**
@@ -101,16 +127,37 @@ public:
         _ring->clearCache();
     }
 
+    /**
+     * 获取当前合并写窗口，单位毫秒
+     */
+    int getMergeWriteMS() const override {
+        return PacketCache<FMP4Packet>::getMergeWriteMS();
+    }
+
+    /**
+     * 获取每秒合并写刷新次数
+     */
+    int getFlushSpeed() override {
+        return PacketCache<FMP4Packet>::getFlushSpeed();
+    }
+
 private:
     void createRing(){
         weak_ptr<FMP4MediaSource> weak_self = dynamic_pointer_cast<FMP4MediaSource>(shared_from_this());
-        _ring = std::make_shared<RingType>(_ring_size, [weak_self](int size) {
+        auto on_reader_changed = [weak_self](int size) {
             auto strong_self = weak_self.lock();
             if (!strong_self) {
                 return;
             }
-            strong_self->onReaderChanged(size);
-        });
+            //fmp4与ll-hls播放器合计
+            strong_self->onReaderChanged(strong_self->readerCount());
+        };
+        if (_ll_hls) {
+            //在注册之前创建，播放器找到该流时已经可用
+            _ll_hls_ring = std::make_shared<ViewerRingType>(0, on_reader_changed);
+        }
+        GET_CONFIG(bool, lock_free_ring, General::kLockFreeRing);
+        _ring = std::make_shared<RingType>(_ring_size, on_reader_changed, lock_free_ring);
         onReaderChanged(0);
         if (!_init_segment.empty()) {
             regist();
@@ -127,11 +174,20 @@ private:
         _ring->write(std::move(packet_list), _have_video ? key_pos : true);
     }
 
+    /**
+     * 根据观看人数、观看者发送积压与码率调整合并写窗口
+     */
+    void onUpdatePolicy(FlushPolicy &policy) override {
+        policy.update(readerCount(), popReaderSendBacklog(), getBytesSpeed());
+    }
+
 private:
     bool _have_video = false;
     int _ring_size;
     string _init_segment;
     RingType::Ptr _ring;
+    LLHlsMaker::Ptr _ll_hls;
+    ViewerRingType::Ptr _ll_hls_ring;
 };
 
 
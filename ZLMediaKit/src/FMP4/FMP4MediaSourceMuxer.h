@@ -15,6 +15,8 @@
 
 #include "FMP4MediaSource.h"
 #include "Record/MP4Muxer.h"
+#include "Common/StreamLatency.h"
+#include "Common/FrameGopCache.h"
 
 namespace mediakit {
 
@@ -27,6 +29,15 @@ public:
                          const string &app,
                          const string &stream_id) {
         _media_src = std::make_shared<FMP4MediaSource>(vhost, app, stream_id);
+        GET_CONFIG(bool, low_latency, Hls::kLowLatency);
+        if (low_latency) {
+            GET_CONFIG(float, part_duration, Hls::kPartDuration);
+            GET_CONFIG(float, seg_duration, Hls::kSegmentDuration);
+            GET_CONFIG(uint32_t, seg_number, Hls::kSegmentNum);
+            GET_CONFIG(uint32_t, seg_retain, Hls::kSegmentRetain);
+            _ll_hls = std::make_shared<LLHlsMaker>(part_duration, seg_duration, seg_number, seg_retain);
+            _media_src->setLLHls(_ll_hls);
+        }
     }
 
     ~FMP4MediaSourceMuxer() override = default;
@@ -36,54 +47,88 @@ public:
         _media_src->setListener(shared_from_this());
     }
 
+    void setLatency(const StreamLatency::Ptr &latency) {
+        _latency = latency;
+    }
+
     int readerCount() const{
         return _media_src->readerCount();
     }
 
     void onReaderChanged(MediaSource &sender, int size) override {
         GET_CONFIG(bool, fmp4_demand, General::kFMP4Demand);
-        _enabled = fmp4_demand ? size : true;
-        if (!size && fmp4_demand) {
-            _clear_cache = true;
-        }
+        _demand.onReaderChanged(fmp4_demand, size);
         MediaSourceEventInterceptor::onReaderChanged(sender, size);
     }
 
     void inputFrame(const Frame::Ptr &frame) override {
         GET_CONFIG(bool, fmp4_demand, General::kFMP4Demand);
-        if (_clear_cache && fmp4_demand) {
-            _clear_cache = false;
+        if (_demand.popClearCache(fmp4_demand)) {
             _media_src->clearCache();
+            if (_ll_hls) {
+                _ll_hls->clear();
+            }
         }
-        if (_enabled || !fmp4_demand) {
+        if (_demand.needMux(fmp4_demand)) {
             MP4MuxerMemory::inputFrame(frame);
         }
     }
 
     bool isEnabled() {
         GET_CONFIG(bool, fmp4_demand, General::kFMP4Demand);
-        //缓存尚未清空时，还允许触发inputFrame函数，以便及时清空缓存
-        return fmp4_demand ? (_clear_cache ? true : _enabled) : true;
+        return _demand.isEnabled(fmp4_demand);
+    }
+
+    /**
+     * 是否需要先回放共享的gop缓存，调用后复位
+     */
+    bool popReplayGop(bool have_video) {
+        return _demand.popReplayGop(have_video);
     }
 
     void onAllTrackReady() {
         _media_src->setInitSegment(getInitSegment());
+        if (_ll_hls) {
+            _ll_hls->setInitSegment(getInitSegment());
+        }
+    }
+
+    void resetTracks() override {
+        MP4MuxerMemory::resetTracks();
+        if (_ll_hls) {
+            _ll_hls->clear();
+        }
     }
 
 protected:
     void onSegmentData(const string &string, uint32_t stamp, bool key_frame) override {
+        if (!string.empty() && _demand.dropOutput(key_frame || !haveVideo())) {
+            return;
+        }
+        if (_ll_hls) {
+            //空片段也需要输入，用于获取第一个片段的开始时间戳
+            _ll_hls->inputFragment(string, stamp, key_frame || !haveVideo());
+        }
+        //片段包含上个片段输出时刻(对应帧的dts)至今的帧，打包耗时从其中第一帧算起
+        auto first_dts = _segment_dts;
+        _segment_dts = stamp;
         if (string.empty()) {
             return;
         }
         FMP4Packet::Ptr packet = std::make_shared<FMP4Packet>(std::move(string));
         packet->time_stamp = stamp;
+        if (_latency) {
+            packet->ingest_stamp = _latency->onMuxOutput(StreamLatency::ProtocolFMP4, first_dts);
+        }
         _media_src->onWrite(std::move(packet), key_frame);
     }
 
 private:
-    bool _enabled = true;
-    bool _clear_cache = false;
+    MuxerDemand _demand;
+    uint32_t _segment_dts = 0;
     FMP4MediaSource::Ptr _media_src;
+    StreamLatency::Ptr _latency;
+    LLHlsMaker::Ptr _ll_hls;
 };
 
 }//namespace mediakit
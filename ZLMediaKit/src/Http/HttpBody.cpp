@@ -56,8 +56,8 @@ HttpFileBody::HttpFileBody(const string &filePath){
     }
 }
 
-HttpFileBody::HttpFileBody(const std::shared_ptr<FILE> &fp, size_t offset, size_t max_size) {
-    init(fp,offset,max_size);
+HttpFileBody::HttpFileBody(const std::shared_ptr<FILE> &fp, size_t offset, size_t max_size, bool send_file) {
+    init(fp, offset, max_size, send_file);
 }
 
 #if defined(_WIN32) || defined(_WIN64)
@@ -68,13 +68,20 @@ HttpFileBody::HttpFileBody(const std::shared_ptr<FILE> &fp, size_t offset, size_
     #define ftell64 ftell
 #endif
 
-void HttpFileBody::init(const std::shared_ptr<FILE> &fp,size_t offset, size_t max_size){
+void HttpFileBody::init(const std::shared_ptr<FILE> &fp,size_t offset, size_t max_size, bool send_file){
     _fp = fp;
     _max_size = max_size;
+    _file_offset = offset;
+#if defined(__linux__) || defined(__linux)
+    _send_file = send_file;
+#else
+    //仅linux支持sendfile，其他平台通过mmap发送
+    _send_file = false;
+#endif
 #ifdef ENABLE_MMAP
     do {
-        if(!_fp){
-            //文件不存在
+        if(!_fp || _send_file){
+            //文件不存在或者通过sendfile发送
             break;
         }
         int fd = fileno(fp.get());
@@ -158,6 +165,22 @@ Buffer::Ptr HttpFileBody::readData(size_t size) {
     return ret;
 }
 
+bool HttpFileBody::supportSendFile() const {
+    return _send_file && _fp;
+}
+
+ssize_t HttpFileBody::sendFile(const Socket::Ptr &sock) {
+    auto size = (size_t) remainSize();
+    if (!size) {
+        return -1;
+    }
+    auto ret = sock->sendFile(fileno(_fp.get()), _file_offset + _offset, size);
+    if (ret > 0) {
+        _offset += ret;
+    }
+    return ret;
+}
+
 //////////////////////////////////////////////////////////////////
 HttpMultiFormBody::HttpMultiFormBody(const HttpArgs &args,const string &filePath,const string &boundary){
     std::shared_ptr<FILE> fp(fopen(filePath.data(), "rb"), [](FILE *fp) {
@@ -14,6 +14,7 @@
 #include <stdlib.h>
 #include <memory>
 #include "Network/Buffer.h"
+#include "Network/Socket.h"
 #include "Util/ResourcePool.h"
 #include "Util/logger.h"
 #include "Thread/WorkThreadPool.h"
@@ -60,6 +61,18 @@ public:
         //(其实并没有读，拷贝文件数据时在内核态完成文件读)
         cb(readData(size));
     }
+
+    /**
+     * 是否支持通过sendFile直接发送到socket
+     */
+    virtual bool supportSendFile() const { return false; }
+
+    /**
+     * 通过sendfile把剩余数据直接发送到socket，必须在socket所在poller线程调用
+     * @param sock 发送的socket
+     * @return 发送的字节数，0代表socket不可写(可写后会触发onFlush)，-1代表不支持或失败
+     */
+    virtual ssize_t sendFile(const Socket::Ptr &sock) { return -1; }
 };
 
 /**
@@ -107,20 +120,26 @@ public:
      * @param fp 文件句柄，文件的偏移量必须为0
      * @param offset 相对文件头的偏移量
      * @param max_size 最大读取字节数，未判断是否大于文件真实大小
+     * @param send_file 是否优先通过sendfile发送，此时不映射文件，不能sendfile时通过fread读取
      */
-    HttpFileBody(const std::shared_ptr<FILE> &fp,size_t offset,size_t max_size);
+    HttpFileBody(const std::shared_ptr<FILE> &fp,size_t offset,size_t max_size, bool send_file = false);
     HttpFileBody(const string &file_path);
     ~HttpFileBody() override = default;
 
     ssize_t remainSize() override ;
     Buffer::Ptr readData(size_t size) override;
+    bool supportSendFile() const override;
+    ssize_t sendFile(const Socket::Ptr &sock) override;
 
 private:
-    void init(const std::shared_ptr<FILE> &fp,size_t offset,size_t max_size);
+    void init(const std::shared_ptr<FILE> &fp,size_t offset,size_t max_size, bool send_file = false);
 
 private:
+    bool _send_file = false;
     size_t _max_size;
     size_t _offset = 0;
+    //相对文件头的起始偏移量
+    size_t _file_offset = 0;
     std::shared_ptr<FILE> _fp;
     std::shared_ptr<char> _map_addr;
     ResourcePool<BufferRaw> _pool;
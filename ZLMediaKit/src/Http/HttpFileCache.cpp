@@ -0,0 +1,128 @@
+﻿/*
+ * Copyright (c) 2016 The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/xia-chu/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <stdio.h>
+#include "HttpFileCache.h"
+#include "Common/config.h"
+#include "Util/logger.h"
+#include "Util/uv_errno.h"
+
+namespace mediakit {
+
+static uint64_t getMTimeNS(const struct stat &st) {
+#if defined(__APPLE__)
+    return st.st_mtimespec.tv_sec * 1000000000ULL + st.st_mtimespec.tv_nsec;
+#elif defined(_WIN32)
+    return st.st_mtime * 1000000000ULL;
+#else
+    return st.st_mtim.tv_sec * 1000000000ULL + st.st_mtim.tv_nsec;
+#endif
+}
+
+static Buffer::Ptr readFile(const string &file_path, size_t size) {
+    auto fp = fopen(file_path.data(), "rb");
+    if (!fp) {
+        return nullptr;
+    }
+    auto ret = BufferRaw::create();
+    ret->setCapacity(size + 1);
+    auto read = fread(ret->data(), 1, size, fp);
+    fclose(fp);
+    if (read != size) {
+        //读取期间文件被修改
+        WarnL << "read file failed:" << file_path << " " << get_uv_errmsg();
+        return nullptr;
+    }
+    ret->setSize(size);
+    return ret;
+}
+
+HttpFileCache &HttpFileCache::Instance() {
+    static HttpFileCache s_instance;
+    return s_instance;
+}
+
+Buffer::Ptr HttpFileCache::get(const string &file_path, const struct stat &st) {
+    GET_CONFIG(size_t, maxMB, Http::kFileCacheMaxMB);
+    GET_CONFIG(size_t, maxFileKB, Http::kFileCacheMaxFileKB);
+    size_t size = st.st_size;
+    if (!maxMB || !size || size > maxFileKB * 1024 || size > maxMB * 1024 * 1024) {
+        return nullptr;
+    }
+
+    auto mtime_ns = getMTimeNS(st);
+    {
+        lock_guard<mutex> lck(_mtx);
+        auto it = _map.find(file_path);
+        if (it != _map.end()) {
+            auto item = it->second;
+            if (item->mtime_ns == mtime_ns && item->size == size) {
+                //命中，移到表头
+                _lru.splice(_lru.begin(), _lru, item);
+                ++_hit;
+                return item->data;
+            }
+            //文件已被修改
+            _bytes -= item->size;
+            _lru.erase(item);
+            _map.erase(it);
+        }
+    }
+
+    ++_miss;
+    //在锁外读文件，不阻塞其他线程的命中
+    auto data = readFile(file_path, size);
+    if (!data) {
+        return nullptr;
+    }
+
+    lock_guard<mutex> lck(_mtx);
+    auto it = _map.find(file_path);
+    if (it != _map.end()) {
+        //其他线程同时读取了该文件
+        _bytes -= it->second->size;
+        _lru.erase(it->second);
+        _map.erase(it);
+    }
+    _lru.emplace_front(Item{file_path, mtime_ns, size, data});
+    _map.emplace(file_path, _lru.begin());
+    _bytes += size;
+    evict(maxMB * 1024 * 1024);
+    return data;
+}
+
+void HttpFileCache::evict(size_t max_bytes) {
+    while (_bytes > max_bytes && !_lru.empty()) {
+        auto &item = _lru.back();
+        _bytes -= item.size;
+        _map.erase(item.path);
+        _lru.pop_back();
+    }
+}
+
+void HttpFileCache::clear() {
+    lock_guard<mutex> lck(_mtx);
+    _lru.clear();
+    _map.clear();
+    _bytes = 0;
+}
+
+HttpFileCache::Statistic HttpFileCache::getStatistic() const {
+    lock_guard<mutex> lck(_mtx);
+    return Statistic{_map.size(), _bytes, _hit.load(), _miss.load()};
+}
+
+string HttpFileCache::makeETag(const struct stat &st) {
+    char etag[64];
+    snprintf(etag, sizeof(etag), "\"%llx-%llx\"", (unsigned long long) getMTimeNS(st), (unsigned long long) st.st_size);
+    return etag;
+}
+
+}//namespace mediakit
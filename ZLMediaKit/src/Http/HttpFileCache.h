@@ -0,0 +1,91 @@
+﻿/*
+ * Copyright (c) 2016 The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/xia-chu/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef ZLMEDIAKIT_HTTPFILECACHE_H
+#define ZLMEDIAKIT_HTTPFILECACHE_H
+
+#include <sys/stat.h>
+#include <list>
+#include <mutex>
+#include <string>
+#include <atomic>
+#include <unordered_map>
+#include "Network/Buffer.h"
+using namespace std;
+using namespace toolkit;
+
+namespace mediakit {
+
+/**
+ * http静态文件热点缓存，按最近最少使用(LRU)淘汰，总大小受http.fileCacheMaxMB限制
+ * 以文件路径为key，通过stat获取的修改时间与文件大小校验缓存是否过期，命中时无需open/mmap/munmap
+ * 缓存的文件内容在各http连接间共享，回复时无需拷贝
+ */
+class HttpFileCache {
+public:
+    class Statistic {
+    public:
+        size_t files;
+        size_t bytes;
+        uint64_t hit;
+        uint64_t miss;
+    };
+
+    static HttpFileCache &Instance();
+
+    /**
+     * 获取文件内容，未命中时读取文件并加入缓存
+     * @param file_path 文件绝对路径
+     * @param st 文件的stat信息
+     * @return 文件内容，文件大于http.fileCacheMaxFileKB、缓存关闭或者读取失败时返回nullptr
+     */
+    Buffer::Ptr get(const string &file_path, const struct stat &st);
+
+    /**
+     * 清空缓存
+     */
+    void clear();
+
+    /**
+     * 获取缓存统计
+     */
+    Statistic getStatistic() const;
+
+    /**
+     * 根据文件修改时间与大小生成ETag
+     */
+    static string makeETag(const struct stat &st);
+
+private:
+    HttpFileCache() = default;
+    ~HttpFileCache() = default;
+
+    class Item {
+    public:
+        string path;
+        uint64_t mtime_ns;
+        size_t size;
+        Buffer::Ptr data;
+    };
+
+    void evict(size_t max_bytes);
+
+private:
+    mutable mutex _mtx;
+    size_t _bytes = 0;
+    atomic<uint64_t> _hit{0};
+    atomic<uint64_t> _miss{0};
+    //表头为最近访问的文件
+    list<Item> _lru;
+    unordered_map<string, list<Item>::iterator> _map;
+};
+
+}//namespace mediakit
+#endif //ZLMEDIAKIT_HTTPFILECACHE_H
@@ -17,6 +17,7 @@
 #include "Util/File.h"
 #include "HttpConst.h"
 #include "HttpSession.h"
+#include "HttpFileCache.h"
 #include "Record/HlsMediaSource.h"
 
 namespace mediakit {
@@ -340,6 +341,21 @@ static void sendNotFound(const HttpFileManager::invoker &cb) {
     cb(404, "text/html", StrCaseMap(), std::make_shared<HttpStringBody>(notFound));
 }
 
+/**
+ * 开启hls.inMemory时，从内存中查找hls文件
+ */
+static Buffer::Ptr findMemoryFile(const string &file_path) {
+    GET_CONFIG(bool, hls_in_memory, Hls::kInMemory);
+    return hls_in_memory ? HlsMemoryStore::findFile(file_path) : nullptr;
+}
+
+/**
+ * 文件是否存在于内存或磁盘中
+ */
+static bool isFileExist(const string &file_path) {
+    return findMemoryFile(file_path) || File::is_file(file_path.data());
+}
+
 /**
  * 拼接文件路径
  */
@@ -360,7 +376,7 @@ static string pathCat(const string &a, const string &b){
  */
 static void accessFile(TcpSession &sender, const Parser &parser, const MediaInfo &mediaInfo, const string &strFile, const HttpFileManager::invoker &cb) {
     bool is_hls = end_with(strFile, kHlsSuffix);
-    bool file_exist = File::is_file(strFile.data());
+    bool file_exist = isFileExist(strFile);
     if (!is_hls && !file_exist) {
         //文件不存在且不是hls,那么直接返回404
         sendNotFound(cb);
@@ -374,8 +390,10 @@ static void accessFile(TcpSession &sender, const Parser &parser, const MediaInfo
     }
 
     weak_ptr<TcpSession> weakSession = sender.shared_from_this();
+    //ssl连接的数据必须经过加密，不能sendfile，此时通过mmap读取文件
+    bool send_file = !sender.overSsl();
     //判断是否有权限访问该文件
-    canAccessPath(sender, parser, mediaInfo, false, [cb, strFile, parser, is_hls, mediaInfo, weakSession , file_exist](const string &errMsg, const HttpServerCookie::Ptr &cookie) {
+    canAccessPath(sender, parser, mediaInfo, false, [cb, strFile, parser, is_hls, mediaInfo, weakSession , file_exist, send_file](const string &errMsg, const HttpServerCookie::Ptr &cookie) {
         auto strongSession = weakSession.lock();
         if (!strongSession) {
             //http客户端已经断开，不需要回复
@@ -392,7 +410,7 @@ static void accessFile(TcpSession &sender, const Parser &parser, const MediaInfo
             return;
         }
 
-        auto response_file = [file_exist](const HttpServerCookie::Ptr &cookie, const HttpFileManager::invoker &cb, const string &strFile, const Parser &parser) {
+        auto response_file = [file_exist, send_file](const HttpServerCookie::Ptr &cookie, const HttpFileManager::invoker &cb, const string &strFile, const Parser &parser) {
             StrCaseMap httpHeader;
             if (cookie) {
                 auto lck = cookie->getLock();
@@ -402,13 +420,13 @@ static void accessFile(TcpSession &sender, const Parser &parser, const MediaInfo
                 if (cookie && file_exist) {
                     auto lck = cookie->getLock();
                     auto is_hls = (*cookie)[kCookieName].get<HttpCookieAttachment>()._is_hls;
-                    if (is_hls) {
+                    if (is_hls && body) {
                         (*cookie)[kCookieName].get<HttpCookieAttachment>()._hls_data->addByteUsage(body->remainSize());
                     }
                 }
                 cb(code, HttpFileManager::getContentType(strFile.data()), headerOut, body);
             };
-            invoker.responseFile(parser.getHeader(), httpHeader, strFile);
+            invoker.responseFile(parser.getHeader(), httpHeader, strFile, send_file);
         };
 
         if (!is_hls) {
@@ -438,7 +456,7 @@ static void accessFile(TcpSession &sender, const Parser &parser, const MediaInfo
                 //尝试添加HlsMediaSource的观看人数(HLS是按需生成的，这样可以触发HLS文件的生成)
                 (*cookie)[kCookieName].get<HttpCookieAttachment>()._hls_data->addByteUsage(0);
             }
-            if (src && File::is_file(strFile.data())) {
+            if (src && isFileExist(strFile)) {
                 //流和m3u8文件都存在，那么直接返回文件
                 response_file(cookie, cb, strFile, parser);
                 return;
@@ -546,23 +564,61 @@ HttpResponseInvokerImp::HttpResponseInvokerImp(const HttpResponseInvokerImp::Htt
     };
 }
 
+/**
+ * If-None-Match是否匹配ETag，可能是逗号分隔的多个ETag，也可能带有弱校验前缀W/
+ */
+static bool matchETag(const StrCaseMap &requestHeader, const string &etag) {
+    auto it = requestHeader.find("If-None-Match");
+    if (it == requestHeader.end() || it->second.empty()) {
+        return false;
+    }
+    for (auto &item : split(it->second, ",")) {
+        trim(item);
+        if (item == "*" || item == etag || (start_with(item, "W/") && item.compare(2, string::npos, etag) == 0)) {
+            return true;
+        }
+    }
+    return false;
+}
+
 void HttpResponseInvokerImp::responseFile(const StrCaseMap &requestHeader,
                                           const StrCaseMap &responseHeader,
-                                          const string &filePath) const {
+                                          const string &filePath,
+                                          bool send_file) const {
     StrCaseMap &httpHeader = const_cast<StrCaseMap &>(responseHeader);
-    std::shared_ptr<FILE> fp(fopen(filePath.data(), "rb"), [](FILE *fp) {
-        if (fp) {
-            fclose(fp);
+    //内存中的hls文件直接引用回复，无需读磁盘与拷贝
+    auto memory_file = findMemoryFile(filePath);
+    std::shared_ptr<FILE> fp;
+    size_t diskFileSize = 0;
+    struct stat st;
+    if (!memory_file && stat(filePath.data(), &st) == 0 && S_ISREG(st.st_mode)) {
+        auto etag = HttpFileCache::makeETag(st);
+        httpHeader["ETag"] = etag;
+        if (matchETag(requestHeader, etag)) {
+            //文件未修改，客户端直接使用本地缓存
+            (*this)(304, httpHeader, HttpBody::Ptr());
+            return;
         }
-    });
+        //热点小文件从内存缓存回复
+        memory_file = HttpFileCache::Instance().get(filePath, st);
+        if (!memory_file) {
+            fp.reset(fopen(filePath.data(), "rb"), [](FILE *fp) {
+                if (fp) {
+                    fclose(fp);
+                }
+            });
+            diskFileSize = st.st_size;
+        }
+    }
 
-    if (!fp) {
+    if (!fp && !memory_file) {
         //打开文件失败
         GET_CONFIG(string, notFound, Http::kNotFound);
         GET_CONFIG(string, charSet, Http::kCharSet);
 
         auto strContentType = StrPrinter << "text/html; charset=" << charSet << endl;
         httpHeader["Content-Type"] = strContentType;
+        httpHeader.erase("ETag");
         (*this)(404, httpHeader, notFound);
         return;
     }
@@ -570,7 +626,12 @@ void HttpResponseInvokerImp::responseFile(const StrCaseMap &requestHeader,
     auto &strRange = const_cast<StrCaseMap &>(requestHeader)["Range"];
     size_t iRangeStart = 0;
     size_t iRangeEnd = 0;
-    size_t fileSize = HttpMultiFormBody::fileSize(fp.get());
+    size_t fileSize = memory_file ? memory_file->size() : diskFileSize;
+    if (fileSize == 0) {
+        //空文件无法计算范围，忽略Range直接回复空body
+        (*this)(200, httpHeader, string());
+        return;
+    }
 
     int code;
     if (strRange.size() == 0) {
@@ -589,8 +650,22 @@ void HttpResponseInvokerImp::responseFile(const StrCaseMap &requestHeader,
         httpHeader.emplace("Content-Range", StrPrinter << "bytes " << iRangeStart << "-" << iRangeEnd << "/" << fileSize << endl);
     }
 
-    //回复文件
-    HttpBody::Ptr fileBody = std::make_shared<HttpFileBody>(fp, iRangeStart, iRangeEnd - iRangeStart + 1);
+    if (memory_file) {
+        if (iRangeStart >= fileSize || iRangeEnd < iRangeStart || iRangeEnd >= fileSize) {
+            //范围不合法，回复整个文件
+            code = 200;
+            iRangeStart = 0;
+            iRangeEnd = fileSize - 1;
+            httpHeader.erase("Content-Range");
+        }
+        Buffer::Ptr buffer = code == 200 ? memory_file : std::make_shared<BufferOffset<Buffer::Ptr> >(memory_file, iRangeStart, iRangeEnd - iRangeStart + 1);
+        (*this)(code, httpHeader, std::make_shared<HttpBufferBody>(std::move(buffer)));
+        return;
+    }
+
+    //回复文件，大文件在非ssl连接上通过sendfile发送，否则通过mmap读取
+    GET_CONFIG(bool, sendFile, Http::kSendFile);
+    HttpBody::Ptr fileBody = std::make_shared<HttpFileBody>(fp, iRangeStart, iRangeEnd - iRangeStart + 1, sendFile && send_file);
     (*this)(code, httpHeader, fileBody);
 }
 
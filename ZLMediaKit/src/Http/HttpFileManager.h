@@ -35,7 +35,11 @@ public:
     void operator()(int code, const StrCaseMap &headerOut, const HttpBody::Ptr &body) const;
     void operator()(int code, const StrCaseMap &headerOut, const string &body) const;
 
-    void responseFile(const StrCaseMap &requestHeader,const StrCaseMap &responseHeader,const string &filePath) const;
+    /**
+     * 回复文件
+     * @param send_file 是否允许通过sendfile发送(同时受http.sendfile配置控制)，ssl连接必须为false
+     */
+    void responseFile(const StrCaseMap &requestHeader,const StrCaseMap &responseHeader,const string &filePath, bool send_file = false) const;
     operator bool();
 private:
     HttpResponseInvokerLambda0 _lambad;
@@ -11,7 +11,9 @@
 #include <stdio.h>
 #include <sys/stat.h>
 #include <algorithm>
+#include <cinttypes>
 #include "Common/config.h"
+#include "Common/StreamLatency.h"
 #include "strCoding.h"
 #include "HttpSession.h"
 #include "HttpConst.h"
@@ -95,7 +97,6 @@ void HttpSession::onRecvContent(const char *data,size_t len) {
 }
 
 void HttpSession::onRecv(const Buffer::Ptr &pBuf) {
-    _ticker.resetTime();
     input(pBuf->data(),pBuf->size());
 }
 
@@ -123,12 +124,13 @@ void HttpSession::onError(const SockException& err) {
 }
 
 void HttpSession::onManager() {
-    GET_CONFIG(uint32_t,keepAliveSec,Http::kKeepAliveSecond);
+    //空闲超时由时间轮管理，见attachServer
+}
 
-    if(_ticker.elapsedTime() > keepAliveSec * 1000){
-        //1分钟超时
-        shutdown(SockException(Err_timeout,"session timeout"));
-    }
+void HttpSession::attachServer(const Server &server) {
+    GET_CONFIG(uint32_t,keepAliveSec,Http::kKeepAliveSecond);
+    //大量空闲的http长连接与flv播放器不再需要定时遍历，超时后默认断开连接
+    setTimeout(keepAliveSec * 1000);
 }
 
 bool HttpSession::checkWebSocket(){
@@ -265,6 +267,7 @@ bool HttpSession::checkLiveStreamFMP4(const function<void()> &cb){
         onWrite(std::make_shared<BufferString>(fmp4_src->getInitSegment()), true);
         weak_ptr<HttpSession> weak_self = dynamic_pointer_cast<HttpSession>(shared_from_this());
         _fmp4_reader = fmp4_src->getRing()->attach(getPoller());
+        StreamLatency::attachSocket(getSock(), fmp4_src->getVhost(), fmp4_src->getApp(), fmp4_src->getId(), StreamLatency::ProtocolFMP4);
         _fmp4_reader->setDetachCB([weak_self]() {
             auto strong_self = weak_self.lock();
             if (!strong_self) {
@@ -273,7 +276,8 @@ bool HttpSession::checkLiveStreamFMP4(const function<void()> &cb){
             }
             strong_self->shutdown(SockException(Err_shutdown, "fmp4 ring buffer detached"));
         });
-        _fmp4_reader->setReadCB([weak_self](const FMP4MediaSource::RingDataType &fmp4_list) {
+        weak_ptr<FMP4MediaSource> weak_src = fmp4_src;
+        _fmp4_reader->setReadCB([weak_self, weak_src](const FMP4MediaSource::RingDataType &fmp4_list) {
             auto strong_self = weak_self.lock();
             if (!strong_self) {
                 //本对象已经销毁
@@ -284,10 +288,218 @@ bool HttpSession::checkLiveStreamFMP4(const function<void()> &cb){
             fmp4_list->for_each([&](const FMP4Packet::Ptr &ts) {
                 strong_self->onWrite(ts, ++i == size);
             });
+            if (auto ingest_stamp = fmp4_list->back()->ingest_stamp) {
+                strong_self->onWriteMark(ingest_stamp);
+            }
+            GET_CONFIG(bool, adaptive_merge, General::kAdaptiveMergeWrite);
+            auto src = adaptive_merge ? weak_src.lock() : nullptr;
+            if (src) {
+                //上报发送积压，用于自适应合并写
+                src->onReaderSendBacklog(strong_self->getSock()->getSendBufferCount());
+            }
         });
     });
 }
 
+//ll-hls m3u8 链接格式:http://vhost-url:port/app/streamid/ll-hls.m3u8?_HLS_msn=1&_HLS_part=2&key1=value1
+//init segment、part、切片链接格式:http://vhost-url:port/app/streamid/ll-hls/init.mp4、{msn}.{part}.m4s、{msn}.m4s
+bool HttpSession::checkLLHls() {
+    static const string kPlaylist = "/ll-hls.m3u8";
+    static const string kDir = "/ll-hls/";
+    auto &url = _parser.Url();
+    string stream_path, file;
+    if (end_with(url, kPlaylist)) {
+        stream_path = url.substr(0, url.size() - kPlaylist.size());
+    } else {
+        auto pos = url.rfind(kDir);
+        if (pos == string::npos || pos + kDir.size() == url.size() || url.find('/', pos + kDir.size()) != string::npos) {
+            return false;
+        }
+        stream_path = url.substr(0, pos);
+        file = url.substr(pos + kDir.size());
+    }
+
+    MediaInfo media_info(string(FMP4_SCHEMA) + "://" + _parser["Host"] + stream_path + "?" + _parser.Params());
+    if (media_info._app.empty() || media_info._streamid.empty()) {
+        //url不合法
+        return false;
+    }
+
+    bool close_flag = !strcasecmp(_parser["Connection"].data(), "close");
+    auto stream_key = media_info._vhost + "/" + media_info._app + "/" + media_info._streamid;
+    weak_ptr<HttpSession> weak_self = dynamic_pointer_cast<HttpSession>(shared_from_this());
+
+    //鉴权结果回调
+    auto onRes = [weak_self, media_info, stream_key, file, close_flag](const string &err) {
+        auto strong_self = weak_self.lock();
+        if (!strong_self) {
+            //本对象已经销毁
+            return;
+        }
+        if (!err.empty()) {
+            //播放鉴权失败
+            strong_self->sendResponse(401, close_flag, nullptr, KeyValue(), std::make_shared<HttpStringBody>(err));
+            return;
+        }
+        //同一连接的后续请求不再重复鉴权
+        strong_self->_ll_hls_auth = stream_key;
+        //异步查找直播流，按需转协议时会等待fmp4源注册
+        MediaSource::findAsync(media_info, strong_self, [weak_self, file, close_flag](const MediaSource::Ptr &src) {
+            auto strong_self = weak_self.lock();
+            if (!strong_self) {
+                //本对象已经销毁
+                return;
+            }
+            auto fmp4_src = dynamic_pointer_cast<FMP4MediaSource>(src);
+            if (!fmp4_src || !fmp4_src->getLLHls()) {
+                //未找到该流或者未开启ll-hls
+                strong_self->sendNotFound(close_flag);
+                return;
+            }
+            strong_self->responseLLHls(fmp4_src, file, close_flag);
+        });
+    };
+
+    if (_ll_hls_auth == stream_key) {
+        onRes("");
+        return true;
+    }
+
+    Broadcast::AuthInvoker invoker = [weak_self, onRes](const string &err) {
+        auto strongSelf = weak_self.lock();
+        if (!strongSelf) {
+            return;
+        }
+        strongSelf->async([onRes, err]() {
+            onRes(err);
+        });
+    };
+
+    auto flag = NoticeCenter::Instance().emitEvent(Broadcast::kBroadcastMediaPlayed, media_info, invoker, static_cast<SockInfo &>(*this));
+    if (!flag) {
+        //该事件无人监听,默认不鉴权
+        onRes("");
+    }
+    return true;
+}
+
+void HttpSession::responseLLHls(const FMP4MediaSource::Ptr &src, const string &file, bool close_flag) {
+    auto ll_hls = src->getLLHls();
+    weak_ptr<HttpSession> weak_self = dynamic_pointer_cast<HttpSession>(shared_from_this());
+    if (!_ll_hls_reader || _ll_hls_src.lock() != src) {
+        //keep-alive连接可能切换到其他流，需要重新作为该流的观看者
+        _ll_hls_src = src;
+        _ll_hls_reader = src->getLLHlsRing()->attach(getPoller());
+        _ll_hls_reader->setDetachCB([weak_self]() {
+            if (auto strong_self = weak_self.lock()) {
+                strong_self->_ll_hls_reader = nullptr;
+            }
+        });
+    }
+
+    //需要等待的切片与part序号，msn小于0时无需等待
+    int64_t msn = -1;
+    int part = -1;
+    function<Buffer::Ptr()> get_file;
+    const char *content_type;
+    if (file.empty()) {
+        content_type = "application/vnd.apple.mpegurl";
+        get_file = [ll_hls]() { return ll_hls->getPlaylist(); };
+        auto &args = _parser.getUrlArgs();
+        if (!args["_HLS_msn"].empty()) {
+            //阻塞请求，等待m3u8中出现指定的part
+            msn = atoll(args["_HLS_msn"].data());
+            part = args["_HLS_part"].empty() ? -1 : atoi(args["_HLS_part"].data());
+        } else if (!ll_hls->getPlaylist()) {
+            //尚未生成任何part，等待第一个part生成
+            msn = 0;
+            part = 0;
+        }
+    } else if (file == "init.mp4") {
+        content_type = HttpFileManager::getContentType(".mp4").data();
+        get_file = [ll_hls]() { return ll_hls->getInitSegment(); };
+    } else {
+        content_type = HttpFileManager::getContentType(".mp4").data();
+        uint64_t file_msn;
+        uint32_t file_part;
+        char suffix[8] = {0};
+        if (sscanf(file.data(), "%" SCNu64 ".%" SCNu32 ".%7s", &file_msn, &file_part, suffix) == 3 && !strcmp(suffix, "m4s")) {
+            //part可能是预告的part，等待其生成
+            msn = file_msn;
+            part = file_part;
+            get_file = [ll_hls, file_msn, file_part]() { return ll_hls->getPart(file_msn, file_part); };
+        } else if (sscanf(file.data(), "%" SCNu64 ".%7s", &file_msn, suffix) == 2 && !strcmp(suffix, "m4s")) {
+            get_file = [ll_hls, file_msn]() { return ll_hls->getSegment(file_msn); };
+        } else {
+            sendNotFound(close_flag);
+            return;
+        }
+    }
+
+    auto response = [weak_self, get_file, content_type, close_flag]() {
+        auto strong_self = weak_self.lock();
+        if (!strong_self) {
+            //本对象已经销毁
+            return;
+        }
+        auto buffer = get_file();
+        if (!buffer) {
+            strong_self->sendNotFound(close_flag);
+            return;
+        }
+        KeyValue header;
+        header.emplace("Cache-Control", "no-cache");
+        strong_self->sendResponse(200, close_flag, content_type, header, std::make_shared<HttpBufferBody>(buffer));
+    };
+
+    if (msn < 0) {
+        response();
+        return;
+    }
+
+    //等待回调与超时定时器都在本poller线程执行，只有先执行的那个回复
+    auto done = std::make_shared<bool>(false);
+    uint64_t wait_id = 0;
+    auto ret = ll_hls->waitFor(msn, part, [weak_self, done, response]() {
+        auto strong_self = weak_self.lock();
+        if (!strong_self) {
+            //本对象已经销毁
+            return;
+        }
+        //在生产者线程触发，切换到本线程回复，不阻塞poller线程
+        strong_self->async([done, response]() {
+            if (!*done) {
+                *done = true;
+                response();
+            }
+        }, false);
+    }, &wait_id);
+
+    if (ret == 0) {
+        response();
+        return;
+    }
+    if (ret < 0) {
+        //请求的切片过新
+        sendResponse(400, close_flag, nullptr, KeyValue(), std::make_shared<HttpStringBody>("_HLS_msn is too far in the future"));
+        return;
+    }
+    weak_ptr<LLHlsMaker> weak_ll_hls = ll_hls;
+    getPoller()->doDelayTask(ll_hls->getBlockTimeoutMS(), [weak_self, weak_ll_hls, wait_id, done, close_flag]() {
+        if (auto strong_ll_hls = weak_ll_hls.lock()) {
+            //超时后不再等待，防止等待的part一直未生成(例如推流中断)时残留在等待列表中
+            strong_ll_hls->cancelWait(wait_id);
+        }
+        if (!*done) {
+            *done = true;
+            if (auto strong_self = weak_self.lock()) {
+                strong_self->sendResponse(503, close_flag);
+            }
+        }
+        return 0;
+    });
+}
+
 //http-ts 链接格式:http://vhost-url:port/app/streamid.live.ts?key1=value1&key2=value2
 bool HttpSession::checkLiveStreamTS(const function<void()> &cb){
     return checkLiveStream(TS_SCHEMA, ".live.ts", [this, cb](const MediaSource::Ptr &src) {
@@ -305,6 +517,7 @@ bool HttpSession::checkLiveStreamTS(const function<void()> &cb){
         setSocketFlags();
         weak_ptr<HttpSession> weak_self = dynamic_pointer_cast<HttpSession>(shared_from_this());
         _ts_reader = ts_src->getRing()->attach(getPoller());
+        StreamLatency::attachSocket(getSock(), ts_src->getVhost(), ts_src->getApp(), ts_src->getId(), StreamLatency::ProtocolTS);
         _ts_reader->setDetachCB([weak_self](){
             auto strong_self = weak_self.lock();
             if (!strong_self) {
@@ -313,7 +526,8 @@ bool HttpSession::checkLiveStreamTS(const function<void()> &cb){
             }
             strong_self->shutdown(SockException(Err_shutdown,"ts ring buffer detached"));
         });
-        _ts_reader->setReadCB([weak_self](const TSMediaSource::RingDataType &ts_list) {
+        weak_ptr<TSMediaSource> weak_src = ts_src;
+        _ts_reader->setReadCB([weak_self, weak_src](const TSMediaSource::RingDataType &ts_list) {
             auto strong_self = weak_self.lock();
             if (!strong_self) {
                 //本对象已经销毁
@@ -324,6 +538,15 @@ bool HttpSession::checkLiveStreamTS(const function<void()> &cb){
             ts_list->for_each([&](const TSPacket::Ptr &ts) {
                 strong_self->onWrite(ts, ++i == size);
             });
+            if (auto ingest_stamp = ts_list->back()->ingest_stamp) {
+                strong_self->onWriteMark(ingest_stamp);
+            }
+            GET_CONFIG(bool, adaptive_merge, General::kAdaptiveMergeWrite);
+            auto src = adaptive_merge ? weak_src.lock() : nullptr;
+            if (src) {
+                //上报发送积压，用于自适应合并写
+                src->onReaderSendBacklog(strong_self->getSock()->getSendBufferCount());
+            }
         });
     });
 }
@@ -357,6 +580,7 @@ bool HttpSession::checkLiveStreamFlv(const function<void()> &cb){
             }
         }
 
+        StreamLatency::attachSocket(getSock(), rtmp_src->getVhost(), rtmp_src->getApp(), rtmp_src->getId(), StreamLatency::ProtocolRtmp);
         start(getPoller(), rtmp_src);
     });
 }
@@ -397,6 +621,11 @@ void HttpSession::Handle_Req_GET_l(ssize_t &content_len, bool sendBody) {
         return;
     }
 
+    if (checkLLHls()) {
+        //拦截ll-hls播放器
+        return;
+    }
+
     bool bClose = !strcasecmp(_parser["Connection"].data(),"close");
     weak_ptr<HttpSession> weakSelf = dynamic_pointer_cast<HttpSession>(shared_from_this());
     HttpFileManager::onAccessPath(*this, _parser, [weakSelf, bClose](int code, const string &content_type,
@@ -430,6 +659,8 @@ public:
         _session = dynamic_pointer_cast<HttpSession>(session);
         _body = body;
         _close_when_complete = close_when_complete;
+        //ssl连接的数据必须经过加密，不能sendfile
+        _send_file = !session->overSsl() && body->supportSendFile();
     }
     ~AsyncSenderData() = default;
 private:
@@ -437,6 +668,8 @@ private:
     HttpBody::Ptr _body;
     bool _close_when_complete;
     bool _read_complete = false;
+    bool _send_file;
+    uint64_t _send_file_bytes = 0;
 };
 
 class AsyncSender {
@@ -451,6 +684,10 @@ public:
             return false;
         }
 
+        if (data->_send_file) {
+            return sendFile(data);
+        }
+
         GET_CONFIG(uint32_t, sendBufSize, Http::kSendBufSize);
         data->_body->readDataAsync(sendBufSize, [data](const Buffer::Ptr &sendBuf) {
             auto session = data->_session.lock();
@@ -471,8 +708,46 @@ public:
     }
 
 private:
+    static bool sendFile(const AsyncSenderData::Ptr &data) {
+        auto session = data->_session.lock();
+        if (!session) {
+            return false;
+        }
+        //在socket可写期间持续sendfile，文件内容不经过用户态
+        while (true) {
+            auto sent = data->_body->sendFile(session->getSock());
+            if (sent < 0) {
+                if (!data->_send_file_bytes) {
+                    //还未通过sendfile发送任何数据，改为读取文件后发送
+                    WarnL << "sendfile failed, fallback to read file";
+                    data->_send_file = false;
+                    return onSocketFlushed(data);
+                }
+                session->shutdown(SockException(Err_other, "sendfile failed"));
+                return false;
+            }
+            if (sent == 0) {
+                //socket不可写，等待onFlush
+                return true;
+            }
+            data->_send_file_bytes += sent;
+            session->resetTimeout();
+            if (!data->_body->remainSize()) {
+                //文件发送完毕
+                data->_read_complete = true;
+                if (!session->isSocketBusy() && data->_close_when_complete) {
+                    shutdown(session);
+                }
+                return true;
+            }
+            if (session->isSocketBusy()) {
+                return true;
+            }
+        }
+    }
+
     static void onRequestData(const AsyncSenderData::Ptr &data, const std::shared_ptr<HttpSession> &session, const Buffer::Ptr &sendBuf) {
-        session->_ticker.resetTime();
+        session->resetTimeout();
         if (sendBuf && session->send(sendBuf) != -1) {
             //文件还未读完，还需要继续发送
             if (!session->isSocketBusy()) {
@@ -579,7 +854,7 @@ void HttpSession::sendResponse(int code,
     }
     str += "\r\n";
     SockSender::send(std::move(str));
-    _ticker.resetTime();
+    resetTimeout();
 
     if(!size){
         //没有body
@@ -741,7 +1016,7 @@ void HttpSession::onWrite(const Buffer::Ptr &buffer, bool flush) {
         HttpSession::setSendFlushFlag(true);
     }
 
-    _ticker.resetTime();
+    resetTimeout();
     if (!_live_over_websocket) {
         _total_bytes_usage += buffer->size();
         send(buffer);
@@ -760,6 +1035,29 @@ void HttpSession::onWrite(const Buffer::Ptr &buffer, bool flush) {
     }
 }
 
+bool HttpSession::isShareFlvTag() {
+    GET_CONFIG(bool, share_flv_tag, Rtmp::kShareFlvTag);
+    return share_flv_tag;
+}
+
+void HttpSession::onWriteFlvTag(const RtmpPacket::Ptr &pkt, const FlvTagCache::Ptr &tag, bool flush) {
+    if (!_live_over_websocket) {
+        FlvMuxer::onWriteFlvTag(pkt, tag, flush);
+        return;
+    }
+    //websocket帧头已经预先生成，整个flv tag作为一个websocket帧发送
+    resetTimeout();
+    onWebSocketEncodeData(tag->ws_header);
+    onWebSocketEncodeData(pkt);
+    if (flush) {
+        HttpSession::setSendFlushFlag(true);
+    }
+    onWebSocketEncodeData(tag->tail);
+    if (flush) {
+        HttpSession::setSendFlushFlag(false);
+    }
+}
+
 void HttpSession::onWebSocketEncodeData(Buffer::Ptr buffer){
     _total_bytes_usage += buffer->size();
     send(std::move(buffer));
@@ -788,4 +1086,13 @@ std::shared_ptr<FlvMuxer> HttpSession::getSharedPtr(){
     return dynamic_pointer_cast<FlvMuxer>(shared_from_this());
 }
 
+size_t HttpSession::getSendBacklog() {
+    return getSock()->getSendBufferCount();
+}
+
+void HttpSession::onWriteMark(uint64_t ingest_stamp) {
+    //数据全部写入socket时统计端到端延时
+    getSock()->addSendMark(ingest_stamp);
+}
+
 } /* namespace mediakit */
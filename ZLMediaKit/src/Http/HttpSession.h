@@ -48,6 +48,7 @@ public:
     void onRecv(const Buffer::Ptr &) override;
     void onError(const SockException &err) override;
     void onManager() override;
+    void attachServer(const Server &server) override;
     static string urlDecode(const string &str);
 
 protected:
@@ -55,6 +56,10 @@ protected:
     void onWrite(const Buffer::Ptr &data, bool flush) override ;
     void onDetach() override;
     std::shared_ptr<FlvMuxer> getSharedPtr() override;
+    size_t getSendBacklog() override;
+    bool isShareFlvTag() override;
+    void onWriteFlvTag(const RtmpPacket::Ptr &pkt, const FlvTagCache::Ptr &tag, bool flush) override;
+    void onWriteMark(uint64_t ingest_stamp) override;
 
     //HttpRequestSplitter override
     ssize_t onRecvHeader(const char *data,size_t len) override;
@@ -112,6 +117,8 @@ private:
     bool checkLiveStreamFlv(const function<void()> &cb = nullptr);
     bool checkLiveStreamTS(const function<void()> &cb = nullptr);
     bool checkLiveStreamFMP4(const function<void()> &fmp4_list = nullptr);
+    bool checkLLHls();
+    void responseLLHls(const FMP4MediaSource::Ptr &src, const string &file, bool close_flag);
 
     bool checkWebSocket();
     bool emitHttpEvent(bool doInvoke);
@@ -135,6 +142,12 @@ private:
     MediaInfo _mediaInfo;
     TSMediaSource::RingType::RingReader::Ptr _ts_reader;
     FMP4MediaSource::RingType::RingReader::Ptr _fmp4_reader;
+    //ll-hls已经鉴权通过的流
+    string _ll_hls_auth;
+    //ll-hls播放器也计入fmp4的观看者，以便触发按需转协议
+    FMP4MediaSource::ViewerRingType::RingReader::Ptr _ll_hls_reader;
+    //_ll_hls_reader所属的流
+    weak_ptr<FMP4MediaSource> _ll_hls_src;
     //处理content数据的callback
     function<bool (const char *data,size_t len) > _contentCallBack;
 };
@@ -126,6 +126,8 @@ protected:
         if(strongServer){
             _session->attachServer(*strongServer);
         }
+        //超时管理交给websocket session的onManager
+        HttpSessionType::setTimeout(0);
 
         //此处截取数据并进行websocket协议打包
         weak_ptr<WebSocketSessionBase> weakSelf = dynamic_pointer_cast<WebSocketSessionBase>(HttpSessionType::shared_from_this());
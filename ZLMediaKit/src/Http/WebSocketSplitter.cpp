@@ -148,13 +148,11 @@ void WebSocketSplitter::onPayloadData(uint8_t *data, size_t len) {
     onWebSocketDecodePayload(*this, _mask_flag ? data - len : data, len, _payload_offset);
 }
 
-void WebSocketSplitter::encode(const WebSocketHeader &header,const Buffer::Ptr &buffer) {
+static string makeHeader(const WebSocketHeader &header, uint64_t len, bool mask_flag) {
     string ret;
-    uint64_t len = buffer ? buffer->size() : 0;
     uint8_t byte = header._fin << 7 | ((header._reserved & 0x07) << 4) | (header._opcode & 0x0F) ;
     ret.push_back(byte);
 
-    auto mask_flag = (header._mask_flag && header._mask.size() >= 4);
     byte = mask_flag << 7;
 
     if(len < 126){
@@ -175,6 +173,17 @@ void WebSocketSplitter::encode(const WebSocketHeader &header,const Buffer::Ptr &
         ret.append((char *)&len_high,4);
         ret.append((char *)&len_low,4);
     }
+    return ret;
+}
+
+string WebSocketSplitter::encodeHeader(const WebSocketHeader &header, uint64_t len) {
+    return makeHeader(header, len, false);
+}
+
+void WebSocketSplitter::encode(const WebSocketHeader &header,const Buffer::Ptr &buffer) {
+    uint64_t len = buffer ? buffer->size() : 0;
+    auto mask_flag = (header._mask_flag && header._mask.size() >= 4);
+    auto ret = makeHeader(header, len, mask_flag);
     if(mask_flag){
         ret.append((char *)header._mask.data(),4);
     }
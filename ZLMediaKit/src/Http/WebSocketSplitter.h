@@ -105,6 +105,13 @@ public:
      */
     void encode(const WebSocketHeader &header,const Buffer::Ptr &buffer);
 
+    /**
+     * 编码数据包头，负载由调用者自行发送，不支持掩码
+     * @param header 数据头
+     * @param len 负载数据长度
+     */
+    static string encodeHeader(const WebSocketHeader &header, uint64_t len);
+
 protected:
     /**
      * 收到一个webSocket数据包包头，后续将继续触发onWebSocketDecodePayload回调
@@ -0,0 +1,209 @@
+﻿/*
+ * Copyright (c) 2016 The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/xia-chu/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include "EdgeProxy.h"
+#include "Common/config.h"
+#include "Util/NoticeCenter.h"
+
+using namespace toolkit;
+
+namespace mediakit {
+
+EdgeProxy::EdgeProxy(const string &vhost, const string &app, const string &stream_id, const EventPoller::Ptr &poller)
+        : PlayerProxy(vhost, app, stream_id, true, false, 0, poller) {}
+
+EdgeProxy::~EdgeProxy() {
+    _idle_timer.reset();
+}
+
+void EdgeProxy::startIdleCheck(uint64_t idle_ms, const function<void()> &cb) {
+    _idle_ticker.resetTime();
+    weak_ptr<EdgeProxy> weak_self = dynamic_pointer_cast<EdgeProxy>(shared_from_this());
+    //检测间隔为100毫秒~1秒，idle_ms为0时也不至于每次轮询都触发定时器
+    auto interval_ms = MAX(MIN(idle_ms, 1000), 100);
+    _idle_timer = std::make_shared<Timer>(interval_ms / 1000.0f, [weak_self, idle_ms, cb]() {
+        auto strong_self = weak_self.lock();
+        if (!strong_self) {
+            return false;
+        }
+        if (strong_self->totalReaderCount()) {
+            strong_self->_idle_ticker.resetTime();
+            return true;
+        }
+        if (strong_self->_idle_ticker.elapsedTime() < idle_ms) {
+            return true;
+        }
+        cb();
+        return false;
+    }, getPoller());
+}
+
+uint64_t EdgeProxy::getPlayCount() const {
+    return _play_count.load();
+}
+
+void EdgeProxy::onReaderChanged(MediaSource &sender, int size) {
+    //各协议的观看者可能在不同线程增减，按总人数的增量统计观看人次
+    int total = totalReaderCount();
+    int last = _reader_count.exchange(total);
+    if (total > last) {
+        _play_count += total - last;
+    }
+    //不触发无人观看事件，边缘流由startIdleCheck负责关闭
+}
+
+////////////////////////////////////////////////////////////////////////////////////
+
+EdgeManager &EdgeManager::Instance() {
+    static EdgeManager s_instance;
+    return s_instance;
+}
+
+void EdgeManager::install() {
+    NoticeCenter::Instance().addListener(this, Broadcast::kBroadcastNotFoundStream, [this](BroadcastNotFoundStreamArgs) {
+        onStreamNotFound(args, closePlayer);
+    });
+}
+
+void EdgeManager::uninstall() {
+    NoticeCenter::Instance().delListener(this, Broadcast::kBroadcastNotFoundStream);
+    lock_guard<recursive_mutex> lck(_mtx);
+    _map.clear();
+}
+
+EdgeManager::Statistic EdgeManager::getStatistic() const {
+    Statistic ret;
+    ret.origin_fetches = _origin_fetches.load();
+    ret.origin_failures = _origin_failures.load();
+    ret.coalesced = _coalesced.load();
+    ret.idle_closes = _idle_closes.load();
+    lock_guard<recursive_mutex> lck(_mtx);
+    ret.edge_hits = _closed_play_count;
+    for (auto &pr : _map) {
+        ++(pr.second.ready ? ret.edges : ret.pending);
+        ret.edge_hits += pr.second.proxy->getPlayCount();
+    }
+    return ret;
+}
+
+void EdgeManager::onStreamNotFound(const MediaInfo &info, const function<void()> &close_player) {
+    GET_CONFIG(string, origin, Edge::kOrigin);
+    GET_CONFIG(int, rtp_type, Edge::kRtpType);
+    GET_CONFIG(bool, enable_vhost, General::kEnableVhost);
+    if (origin.empty() || info._app.empty() || info._streamid.empty()) {
+        return;
+    }
+    if (MediaSource::find(info._vhost, info._app, info._streamid)) {
+        //本机已经有该流(例如关闭了部分协议的转换)，不从源站拉流，防止重复注册
+        return;
+    }
+
+    auto key = info._vhost + "/" + info._app + "/" + info._streamid;
+    EdgeProxy::Ptr proxy;
+    {
+        lock_guard<recursive_mutex> lck(_mtx);
+        auto it = _map.find(key);
+        if (it != _map.end()) {
+            if (!it->second.ready) {
+                //已经在从源站拉流，合并到该次拉流，流注册后由MediaSource::findAsync回复播放器
+                it->second.waiters.emplace_back(close_player);
+                ++_coalesced;
+            }
+            return;
+        }
+        proxy = std::make_shared<EdgeProxy>(info._vhost, info._app, info._streamid, EventPollerPool::Instance().getPoller());
+        auto &item = _map[key];
+        item.proxy = proxy;
+        item.waiters.emplace_back(close_player);
+        ++_origin_fetches;
+    }
+
+    string url = origin;
+    while (!url.empty() && url.back() == '/') {
+        url.pop_back();
+    }
+    url += "/" + info._app + "/" + info._streamid;
+    if (enable_vhost && info._vhost != DEFAULT_VHOST) {
+        url += "?vhost=" + info._vhost;
+    }
+    InfoL << "边缘节点从源站拉流:" << url;
+
+    weak_ptr<EdgeProxy> weak_proxy = proxy;
+    proxy->setPlayCallbackOnce([this, key, weak_proxy](const SockException &ex) {
+        if (auto strong_proxy = weak_proxy.lock()) {
+            onPlayResult(key, strong_proxy, ex);
+        }
+    });
+    proxy->setOnClose([this, key, weak_proxy](const SockException &ex) {
+        //源站断开或拉流失败(不重试)
+        if (auto strong_proxy = weak_proxy.lock()) {
+            WarnL << "边缘流断开:" << key << " " << ex.what();
+            remove(key, strong_proxy.get(), false);
+        }
+    });
+    (*proxy)[Client::kRtpType] = rtp_type;
+    proxy->play(url);
+}
+
+void EdgeManager::onPlayResult(const string &key, const EdgeProxy::Ptr &proxy, const SockException &ex) {
+    if (ex) {
+        WarnL << "边缘节点从源站拉流失败:" << key << " " << ex.what();
+        ++_origin_failures;
+        //拉流失败后PlayerProxy不再重试，setOnClose回调负责移除并通知等待中的播放器
+        return;
+    }
+
+    vector<function<void()> > waiters;
+    {
+        lock_guard<recursive_mutex> lck(_mtx);
+        auto it = _map.find(key);
+        if (it == _map.end() || it->second.proxy != proxy) {
+            return;
+        }
+        it->second.ready = true;
+        //流注册后等待中的播放器会收到媒体注册事件，无需再通知
+        it->second.waiters.swap(waiters);
+    }
+
+    GET_CONFIG(uint64_t, idle_ms, Edge::kIdleTimeoutMS);
+    weak_ptr<EdgeProxy> weak_proxy = proxy;
+    proxy->startIdleCheck(idle_ms, [this, key, weak_proxy]() {
+        if (auto strong_proxy = weak_proxy.lock()) {
+            InfoL << "边缘流无人观看，断开源站拉流:" << key;
+            remove(key, strong_proxy.get(), true);
+        }
+    });
+}
+
+void EdgeManager::remove(const string &key, const EdgeProxy *proxy, bool idle) {
+    Item item;
+    {
+        lock_guard<recursive_mutex> lck(_mtx);
+        auto it = _map.find(key);
+        if (it == _map.end() || it->second.proxy.get() != proxy) {
+            return;
+        }
+        item = std::move(it->second);
+        _map.erase(it);
+        _closed_play_count += item.proxy->getPlayCount();
+    }
+    if (idle) {
+        ++_idle_closes;
+    }
+    //拉流未成功，等待中的播放器立即返回流不存在，而不是等到超时
+    for (auto &waiter : item.waiters) {
+        waiter();
+    }
+    //本函数在拉流代理的回调中执行，切换到其线程后再释放，防止在自己的成员函数中析构自己
+    auto strong_proxy = std::move(item.proxy);
+    strong_proxy->getPoller()->async([strong_proxy]() {}, false);
+}
+
+}//namespace mediakit
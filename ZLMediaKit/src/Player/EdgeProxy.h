@@ -0,0 +1,123 @@
+﻿/*
+ * Copyright (c) 2016 The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/xia-chu/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef ZLMEDIAKIT_EDGEPROXY_H
+#define ZLMEDIAKIT_EDGEPROXY_H
+
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <unordered_map>
+#include "PlayerProxy.h"
+
+namespace mediakit {
+
+/**
+ * 边缘节点从源站拉流的代理，在PlayerProxy基础上统计观看人次并在无人观看一段时间后通知关闭
+ */
+class EdgeProxy : public PlayerProxy {
+public:
+    using Ptr = std::shared_ptr<EdgeProxy>;
+
+    EdgeProxy(const string &vhost, const string &app, const string &stream_id, const EventPoller::Ptr &poller);
+    ~EdgeProxy() override;
+
+    /**
+     * 开始检测无人观看，必须在拉流成功后调用
+     * @param idle_ms 无人观看超过该时间后触发回调，单位毫秒
+     * @param cb 回调在拉流线程触发，只触发一次
+     */
+    void startIdleCheck(uint64_t idle_ms, const function<void()> &cb);
+
+    /**
+     * 获取累计观看人次
+     */
+    uint64_t getPlayCount() const;
+
+private:
+    //MediaSourceEvent override
+    void onReaderChanged(MediaSource &sender, int size) override;
+
+private:
+    atomic<int> _reader_count{0};
+    atomic<uint64_t> _play_count{0};
+    Ticker _idle_ticker;
+    Timer::Ptr _idle_timer;
+};
+
+/**
+ * 边缘节点管理器，edge.origin不为空时生效
+ * 监听未找到流事件，从源站拉取同app/stream的流，同一个流的并发播放请求合并为一次源站拉流
+ */
+class EdgeManager {
+public:
+    class Statistic {
+    public:
+        //在线的边缘流个数
+        size_t edges = 0;
+        //正在从源站拉流的个数
+        size_t pending = 0;
+        //从源站拉流次数
+        uint64_t origin_fetches = 0;
+        //从源站拉流失败次数
+        uint64_t origin_failures = 0;
+        //等待中的源站拉流合并的播放请求数
+        uint64_t coalesced = 0;
+        //边缘流的累计观看人次，每次源站拉流服务的观看人次越多，边缘节点越有效
+        uint64_t edge_hits = 0;
+        //无人观看而关闭的边缘流个数
+        uint64_t idle_closes = 0;
+    };
+
+    static EdgeManager &Instance();
+
+    /**
+     * 开始监听未找到流事件
+     */
+    void install();
+
+    /**
+     * 停止监听并断开所有边缘流
+     */
+    void uninstall();
+
+    /**
+     * 获取统计信息
+     */
+    Statistic getStatistic() const;
+
+private:
+    EdgeManager() = default;
+    ~EdgeManager() = default;
+
+    class Item {
+    public:
+        bool ready = false;
+        EdgeProxy::Ptr proxy;
+        //等待源站拉流结果的播放请求，拉流失败时通知其立即返回流不存在
+        vector<function<void()> > waiters;
+    };
+
+    void onStreamNotFound(const MediaInfo &info, const function<void()> &close_player);
+    void onPlayResult(const string &key, const EdgeProxy::Ptr &proxy, const SockException &ex);
+    void remove(const string &key, const EdgeProxy *proxy, bool idle);
+
+private:
+    mutable recursive_mutex _mtx;
+    unordered_map<string, Item> _map;
+    uint64_t _closed_play_count = 0;
+    atomic<uint64_t> _origin_fetches{0};
+    atomic<uint64_t> _origin_failures{0};
+    atomic<uint64_t> _coalesced{0};
+    atomic<uint64_t> _idle_closes{0};
+};
+
+}//namespace mediakit
+#endif //ZLMEDIAKIT_EDGEPROXY_H
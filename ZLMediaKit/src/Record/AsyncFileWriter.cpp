@@ -0,0 +1,644 @@
+﻿/*
+ * Copyright (c) 2016 The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/xia-chu/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <fcntl.h>
+#include <atomic>
+#include <algorithm>
+#include <unordered_set>
+#include "AsyncFileWriter.h"
+#include "Common/config.h"
+#include "Common/macros.h"
+#include "Util/File.h"
+#include "Util/List.h"
+#include "Util/logger.h"
+#include "Util/uv_errno.h"
+#include "Util/TimeTicker.h"
+#include "Thread/ThreadPool.h"
+
+#if !defined(_WIN32)
+#include <unistd.h>
+#endif
+
+#if defined(ENABLE_IO_URING)
+#include <poll.h>
+#include <thread>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#endif
+
+//批量缓存按4K对齐，满足O_DIRECT的要求
+#define FILE_WRITE_ALIGN 4096
+//统计写入耗时分布的样本个数
+#define FILE_WRITE_LATENCY_SAMPLES 256
+//io_uring队列深度
+#define IO_URING_ENTRIES 256
+
+namespace mediakit {
+
+/////////////////////////////////////////////////线程池后端/////////////////////////////////////////////////
+
+/**
+ * 使用独立的写线程，而不是WorkThreadPool：
+ * mp4 faststart时closeMP4在WorkThreadPool中执行并同步回读文件(AsyncFileWriter::read)，
+ * 如果写请求也投递到WorkThreadPool，可能排在被阻塞的同一线程上导致死锁
+ */
+class ThreadPoolWriteBackend : public FileWriteBackend {
+public:
+    const char *name() const override {
+        return "threadPool";
+    }
+
+    void write(int fd, const char *data, size_t len, uint64_t offset, onComplete cb) override {
+        _thread.async([fd, data, len, offset, cb]() {
+#if defined(_WIN32)
+            cb(-ENOTSUP);
+#else
+            size_t done = 0;
+            while (done < len) {
+                auto ret = pwrite(fd, data + done, len - done, offset + done);
+                if (ret < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    cb(-errno);
+                    return;
+                }
+                if (ret == 0) {
+                    //没有写入任何数据(例如磁盘已满)，视为错误，防止死循环
+                    cb(-EIO);
+                    return;
+                }
+                done += ret;
+            }
+            cb(done);
+#endif
+        }, false);
+    }
+
+private:
+    ThreadPool _thread{1, ThreadPool::PRIORITY_NORMAL, true};
+};
+
+/////////////////////////////////////////////////io_uring后端/////////////////////////////////////////////////
+
+#if defined(ENABLE_IO_URING)
+
+/**
+ * 不依赖liburing，直接使用系统调用
+ * 由一个后台线程独占提交队列与完成队列，其他线程提交的写请求先排队，再通过eventfd唤醒后台线程
+ * 后台线程在eventfd上挂一个poll请求，这样等待写完成与等待新请求都只需要一次io_uring_enter
+ */
+class IoUringWriteBackend : public FileWriteBackend {
+public:
+    IoUringWriteBackend() = default;
+
+    ~IoUringWriteBackend() override {
+        if (_thread.joinable()) {
+            _exit_flag = true;
+            wakeup();
+            _thread.join();
+        }
+        if (_sq_ptr && _sq_ptr != MAP_FAILED) {
+            munmap(_sq_ptr, _sq_size);
+        }
+        if (_cq_ptr && _cq_ptr != _sq_ptr && _cq_ptr != MAP_FAILED) {
+            munmap(_cq_ptr, _cq_size);
+        }
+        if (_sqes && _sqes != MAP_FAILED) {
+            munmap(_sqes, _sq_entries * sizeof(io_uring_sqe));
+        }
+        if (_event_fd != -1) {
+            ::close(_event_fd);
+        }
+        if (_ring_fd != -1) {
+            ::close(_ring_fd);
+        }
+    }
+
+    const char *name() const override {
+        return "ioUring";
+    }
+
+    /**
+     * 初始化io_uring，内核不支持或被禁止时返回false
+     */
+    bool setup() {
+        io_uring_params params;
+        memset(&params, 0, sizeof(params));
+        _ring_fd = (int) syscall(__NR_io_uring_setup, IO_URING_ENTRIES, &params);
+        if (_ring_fd < 0) {
+            WarnL << "io_uring_setup failed:" << get_uv_errmsg();
+            return false;
+        }
+        _sq_entries = params.sq_entries;
+        _sq_size = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+        _cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (single_mmap) {
+            _sq_size = _cq_size = MAX(_sq_size, _cq_size);
+        }
+        _sq_ptr = (uint8_t *) mmap(nullptr, _sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _ring_fd, IORING_OFF_SQ_RING);
+        if (_sq_ptr == MAP_FAILED) {
+            WarnL << "mmap io_uring sq failed:" << get_uv_errmsg();
+            return false;
+        }
+        _cq_ptr = single_mmap ? _sq_ptr : (uint8_t *) mmap(nullptr, _cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _ring_fd, IORING_OFF_CQ_RING);
+        if (_cq_ptr == MAP_FAILED) {
+            WarnL << "mmap io_uring cq failed:" << get_uv_errmsg();
+            return false;
+        }
+        _sqes = (io_uring_sqe *) mmap(nullptr, _sq_entries * sizeof(io_uring_sqe), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _ring_fd, IORING_OFF_SQES);
+        if (_sqes == MAP_FAILED) {
+            WarnL << "mmap io_uring sqes failed:" << get_uv_errmsg();
+            return false;
+        }
+        _sq_tail = (uint32_t *) (_sq_ptr + params.sq_off.tail);
+        _sq_mask = *(uint32_t *) (_sq_ptr + params.sq_off.ring_mask);
+        _sq_array = (uint32_t *) (_sq_ptr + params.sq_off.array);
+        _cq_head = (uint32_t *) (_cq_ptr + params.cq_off.head);
+        _cq_tail = (uint32_t *) (_cq_ptr + params.cq_off.tail);
+        _cq_mask = *(uint32_t *) (_cq_ptr + params.cq_off.ring_mask);
+        _cqes = (io_uring_cqe *) (_cq_ptr + params.cq_off.cqes);
+
+        _event_fd = eventfd(0, EFD_CLOEXEC);
+        if (_event_fd == -1) {
+            WarnL << "create eventfd failed:" << get_uv_errmsg();
+            return false;
+        }
+        _thread = std::thread([this]() { run(); });
+        return true;
+    }
+
+    void write(int fd, const char *data, size_t len, uint64_t offset, onComplete cb) override {
+        auto request = new Request;
+        request->fd = fd;
+        request->iov.iov_base = (void *) data;
+        request->iov.iov_len = len;
+        request->offset = offset;
+        request->cb = std::move(cb);
+        {
+            lock_guard<mutex> lck(_mtx);
+            _pending.emplace_back(request);
+        }
+        wakeup();
+    }
+
+private:
+    class Request {
+    public:
+        int fd;
+        iovec iov;
+        uint64_t offset;
+        onComplete cb;
+    };
+
+    void wakeup() {
+        uint64_t value = 1;
+        while (::write(_event_fd, &value, sizeof(value)) == -1 && errno == EINTR) {}
+    }
+
+    io_uring_sqe *getSqe() {
+        auto tail = *_sq_tail;
+        auto index = tail & _sq_mask;
+        auto sqe = &_sqes[index];
+        memset(sqe, 0, sizeof(*sqe));
+        _sq_array[index] = index;
+        //内核在io_uring_enter时才读取，tail的写入需要在sqe填充之后可见
+        __atomic_store_n(_sq_tail, tail + 1, __ATOMIC_RELEASE);
+        ++_to_submit;
+        return sqe;
+    }
+
+    void armPoll() {
+        auto sqe = getSqe();
+        sqe->opcode = IORING_OP_POLL_ADD;
+        sqe->fd = _event_fd;
+        sqe->poll32_events = POLLIN;
+        //user_data为0代表eventfd的poll请求
+        sqe->user_data = 0;
+    }
+
+    void submitPending() {
+        List<Request *> pending;
+        {
+            lock_guard<mutex> lck(_mtx);
+            //预留一个位置给eventfd的poll请求
+            while (!_pending.empty() && _inflight + 1 < _sq_entries) {
+                pending.emplace_back(_pending.front());
+                _pending.pop_front();
+                ++_inflight;
+            }
+        }
+        pending.for_each([&](Request *request) {
+            auto sqe = getSqe();
+            sqe->opcode = IORING_OP_WRITEV;
+            sqe->fd = request->fd;
+            sqe->addr = (uint64_t) (uintptr_t) &request->iov;
+            sqe->len = 1;
+            sqe->off = request->offset;
+            sqe->user_data = (uint64_t) (uintptr_t) request;
+        });
+    }
+
+    void run() {
+        setThreadName("io_uring writer");
+        armPoll();
+        while (!_exit_flag) {
+            auto ret = syscall(__NR_io_uring_enter, _ring_fd, _to_submit, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+            if (ret < 0) {
+                if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+                    ErrorL << "io_uring_enter failed:" << get_uv_errmsg();
+                    break;
+                }
+            } else {
+                _to_submit -= MIN((uint32_t) ret, _to_submit);
+            }
+            reapCompletions();
+            submitPending();
+        }
+        //退出前回调所有未完成的请求，防止写入器一直等待
+        List<Request *> pending;
+        {
+            lock_guard<mutex> lck(_mtx);
+            pending.swap(_pending);
+        }
+        pending.for_each([](Request *request) {
+            request->cb(-ECANCELED);
+            delete request;
+        });
+    }
+
+    void reapCompletions() {
+        auto head = *_cq_head;
+        while (head != __atomic_load_n(_cq_tail, __ATOMIC_ACQUIRE)) {
+            auto &cqe = _cqes[head & _cq_mask];
+            auto user_data = cqe.user_data;
+            auto res = cqe.res;
+            ++head;
+            __atomic_store_n(_cq_head, head, __ATOMIC_RELEASE);
+            if (!user_data) {
+                //有新的写请求
+                uint64_t value;
+                while (::read(_event_fd, &value, sizeof(value)) == -1 && errno == EINTR) {}
+                armPoll();
+                continue;
+            }
+            auto request = (Request *) (uintptr_t) user_data;
+            {
+                lock_guard<mutex> lck(_mtx);
+                --_inflight;
+            }
+            request->cb(res);
+            delete request;
+        }
+    }
+
+private:
+    int _ring_fd = -1;
+    int _event_fd = -1;
+    uint32_t _sq_entries = 0;
+    uint32_t _to_submit = 0;
+    size_t _sq_size = 0;
+    size_t _cq_size = 0;
+    uint8_t *_sq_ptr = nullptr;
+    uint8_t *_cq_ptr = nullptr;
+    io_uring_sqe *_sqes = nullptr;
+    uint32_t *_sq_tail = nullptr;
+    uint32_t _sq_mask = 0;
+    uint32_t *_sq_array = nullptr;
+    uint32_t *_cq_head = nullptr;
+    uint32_t *_cq_tail = nullptr;
+    uint32_t _cq_mask = 0;
+    io_uring_cqe *_cqes = nullptr;
+    atomic<bool> _exit_flag{false};
+    std::thread _thread;
+
+    mutex _mtx;
+    uint32_t _inflight = 0;
+    List<Request *> _pending;
+};
+
+#endif //defined(ENABLE_IO_URING)
+
+FileWriteBackend &FileWriteBackend::Instance() {
+    static std::shared_ptr<FileWriteBackend> s_instance = []() -> std::shared_ptr<FileWriteBackend> {
+#if defined(ENABLE_IO_URING)
+        GET_CONFIG(bool, io_uring, Record::kIoUring);
+        if (io_uring) {
+            auto backend = std::make_shared<IoUringWriteBackend>();
+            if (backend->setup()) {
+                InfoL << "async file writer backend: io_uring";
+                return backend;
+            }
+            WarnL << "io_uring is not available, fallback to thread pool";
+        }
+#endif
+        InfoL << "async file writer backend: thread pool";
+        return std::make_shared<ThreadPoolWriteBackend>();
+    }();
+    return *s_instance;
+}
+
+/////////////////////////////////////////////////AsyncFileWriter/////////////////////////////////////////////////
+
+//4K对齐的内存，满足O_DIRECT的要求
+class AlignedBuffer : public Buffer {
+public:
+    AlignedBuffer(size_t capacity) {
+#if defined(_WIN32)
+        _data = (char *) _aligned_malloc(capacity, FILE_WRITE_ALIGN);
+#else
+        if (posix_memalign((void **) &_data, FILE_WRITE_ALIGN, capacity)) {
+            _data = nullptr;
+        }
+#endif
+        if (!_data) {
+            throw std::bad_alloc();
+        }
+    }
+
+    ~AlignedBuffer() override {
+#if defined(_WIN32)
+        _aligned_free(_data);
+#else
+        free(_data);
+#endif
+    }
+
+    char *data() const override {
+        return _data;
+    }
+
+    size_t size() const override {
+        return _size;
+    }
+
+    void setSize(size_t size) {
+        _size = size;
+    }
+
+private:
+    char *_data = nullptr;
+    size_t _size = 0;
+};
+
+static mutex s_mtx;
+static unordered_set<AsyncFileWriter *> s_writers;
+
+AsyncFileWriter::AsyncFileWriter() {
+    GET_CONFIG(uint32_t, buf_size, Record::kFileBufSize);
+    _batch_capacity = (MAX(buf_size, FILE_WRITE_ALIGN) + FILE_WRITE_ALIGN - 1) / FILE_WRITE_ALIGN * FILE_WRITE_ALIGN;
+    _latency_us.reserve(FILE_WRITE_LATENCY_SAMPLES);
+    lock_guard<mutex> lck(s_mtx);
+    s_writers.emplace(this);
+}
+
+AsyncFileWriter::~AsyncFileWriter() {
+    {
+        lock_guard<mutex> lck(s_mtx);
+        s_writers.erase(this);
+    }
+    if (_batch_size) {
+        WarnL << "async file writer released without close, " << _batch_size << " bytes lost:" << _path;
+    }
+#if !defined(_WIN32)
+    if (_fd != -1) {
+        ::close(_fd);
+    }
+#endif
+}
+
+bool AsyncFileWriter::isEnabled() {
+#if defined(_WIN32)
+    return false;
+#else
+    GET_CONFIG(bool, async_write, Record::kAsyncWrite);
+    return async_write;
+#endif
+}
+
+bool AsyncFileWriter::open(const string &path) {
+#if defined(_WIN32)
+    return false;
+#else
+    File::create_path(path.data(), S_IRWXO | S_IRWXG | S_IRWXU);
+    //以读写方式打开，mp4 faststart时需要回读
+    _fd = ::open(path.data(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (_fd == -1) {
+        WarnL << "open file failed:" << path << " " << get_uv_errmsg();
+        return false;
+    }
+    _path = path;
+    return true;
+#endif
+}
+
+Buffer::Ptr AsyncFileWriter::obtainBatch() {
+    {
+        lock_guard<mutex> lck(_mtx);
+        if (!_free_batches.empty()) {
+            auto ret = std::move(_free_batches.back());
+            _free_batches.pop_back();
+            return ret;
+        }
+    }
+    return std::make_shared<AlignedBuffer>(_batch_capacity);
+}
+
+void AsyncFileWriter::write(const void *data, size_t len) {
+    write(data, len, _size);
+}
+
+void AsyncFileWriter::write(const void *data, size_t len, uint64_t offset) {
+    if (_batch_size && offset != _batch_offset + _batch_size) {
+        //写入位置不连续
+        flush();
+    }
+    auto ptr = (const char *) data;
+    while (len) {
+        if (!_batch) {
+            _batch = obtainBatch();
+            _batch_offset = offset;
+        }
+        auto bytes = MIN(len, _batch_capacity - _batch_size);
+        memcpy(_batch->data() + _batch_size, ptr, bytes);
+        _batch_size += bytes;
+        ptr += bytes;
+        offset += bytes;
+        len -= bytes;
+        if (_batch_size == _batch_capacity) {
+            flush();
+        }
+    }
+    _size = MAX(_size, offset);
+}
+
+void AsyncFileWriter::flush() {
+    if (!_batch_size) {
+        return;
+    }
+    static_pointer_cast<AlignedBuffer>(_batch)->setSize(_batch_size);
+    Request request;
+    request.data = std::move(_batch);
+    request.offset = _batch_offset;
+    request.enqueue_us = getCurrentMicrosecond();
+    _batch = nullptr;
+    _batch_size = 0;
+
+    lock_guard<mutex> lck(_mtx);
+    _queue_bytes += request.data->size();
+    _queue.emplace_back(std::move(request));
+    submit_l();
+}
+
+void AsyncFileWriter::submit_l() {
+    if (_inflight || _queue.empty()) {
+        return;
+    }
+    //同一文件同时只有一个写请求，保证写入顺序
+    _inflight = true;
+    auto &request = _queue.front();
+    auto self = shared_from_this();
+    FileWriteBackend::Instance().write(_fd, request.data->data() + request.done, request.data->size() - request.done,
+                                       request.offset + request.done, [self](ssize_t ret) {
+        self->onComplete(ret);
+    });
+}
+
+void AsyncFileWriter::onComplete(ssize_t ret) {
+    function<void()> close_cb;
+    {
+        lock_guard<mutex> lck(_mtx);
+        _inflight = false;
+        auto &request = _queue.front();
+        if (ret > 0 && request.done + ret < request.data->size()) {
+            //部分写入，继续写剩余部分
+            request.done += ret;
+            submit_l();
+            return;
+        }
+        if (ret <= 0) {
+            //ret为0代表没有写入任何数据，同样视为错误
+            ++_error_count;
+            WarnL << "write file failed:" << _path << " " << (ret ? uv_strerror(uv_translate_posix_error((int) -ret)) : "nothing written");
+        } else {
+            ++_write_count;
+            _write_bytes += request.data->size();
+        }
+        auto latency = (uint32_t) (getCurrentMicrosecond() - request.enqueue_us);
+        if (_latency_us.size() < FILE_WRITE_LATENCY_SAMPLES) {
+            _latency_us.emplace_back(latency);
+        } else {
+            _latency_us[_latency_index++ % FILE_WRITE_LATENCY_SAMPLES] = latency;
+        }
+        _queue_bytes -= request.data->size();
+        if (request.data->size() == _batch_capacity && _free_batches.size() < 2) {
+            _free_batches.emplace_back(std::move(request.data));
+        }
+        _queue.pop_front();
+        submit_l();
+        if (_queue.empty()) {
+            _cond.notify_all();
+            if (_closing) {
+                close_cb.swap(_close_cb);
+            }
+        }
+    }
+    if (close_cb) {
+        close_cb();
+    }
+}
+
+int AsyncFileWriter::read(void *data, size_t len, uint64_t offset) {
+#if defined(_WIN32)
+    return -1;
+#else
+    flush();
+    {
+        unique_lock<mutex> lck(_mtx);
+        _cond.wait(lck, [this]() { return _queue.empty(); });
+    }
+    size_t done = 0;
+    while (done < len) {
+        auto ret = pread(_fd, (char *) data + done, len - done, offset + done);
+        if (ret < 0 && errno == EINTR) {
+            continue;
+        }
+        if (ret <= 0) {
+            return ret < 0 ? errno : -1 /*EOF*/;
+        }
+        done += ret;
+    }
+    return 0;
+#endif
+}
+
+void AsyncFileWriter::close(const function<void()> &cb) {
+    flush();
+    {
+        lock_guard<mutex> lck(_mtx);
+        if (!_queue.empty()) {
+            //写完后回调
+            _closing = true;
+            _close_cb = cb;
+            return;
+        }
+    }
+    if (cb) {
+        cb();
+    }
+}
+
+bool AsyncFileWriter::isCongested() const {
+    GET_CONFIG(uint32_t, max_mb, Record::kWriteQueueMaxMB);
+    lock_guard<mutex> lck(_mtx);
+    return _queue_bytes > max_mb * 1024 * 1024;
+}
+
+uint64_t AsyncFileWriter::size() const {
+    return _size;
+}
+
+vector<AsyncFileWriter::Statistic> AsyncFileWriter::getStatistic() {
+    vector<Statistic> ret;
+    lock_guard<mutex> lck(s_mtx);
+    for (auto writer : s_writers) {
+        Statistic stat;
+        vector<uint32_t> latency;
+        {
+            lock_guard<mutex> lck(writer->_mtx);
+            stat.path = writer->_path;
+            stat.queue_depth = writer->_queue.size();
+            stat.queue_bytes = writer->_queue_bytes;
+            stat.write_count = writer->_write_count;
+            stat.write_bytes = writer->_write_bytes;
+            stat.error_count = writer->_error_count;
+            latency = writer->_latency_us;
+        }
+        stat.backend = FileWriteBackend::Instance().name();
+        if (!latency.empty()) {
+            std::sort(latency.begin(), latency.end());
+            auto percentile = [&](size_t percent) {
+                return latency[MIN(latency.size() - 1, latency.size() * percent / 100)];
+            };
+            stat.latency_p50 = percentile(50);
+            stat.latency_p90 = percentile(90);
+            stat.latency_p99 = percentile(99);
+            stat.latency_max = latency.back();
+        }
+        ret.emplace_back(std::move(stat));
+    }
+    return ret;
+}
+
+}//namespace mediakit
@@ -0,0 +1,183 @@
+﻿/*
+ * Copyright (c) 2016 The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/xia-chu/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef ZLMEDIAKIT_ASYNCFILEWRITER_H
+#define ZLMEDIAKIT_ASYNCFILEWRITER_H
+
+#include <mutex>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <condition_variable>
+#include "Network/Buffer.h"
+using namespace std;
+using namespace toolkit;
+
+namespace mediakit {
+
+/**
+ * 异步写文件后端，linux下优先使用io_uring，不支持时使用独立的后台写线程
+ */
+class FileWriteBackend {
+public:
+    //写入完成回调，ret为写入的字节数，失败时为-errno
+    using onComplete = function<void(ssize_t ret)>;
+    virtual ~FileWriteBackend() = default;
+
+    /**
+     * 后端名称
+     */
+    virtual const char *name() const = 0;
+
+    /**
+     * 提交写请求，在后台线程完成后回调
+     * @param fd 文件描述符，回调前必须保持有效
+     * @param data 数据指针，回调前必须保持有效
+     * @param len 数据长度
+     * @param offset 写入的文件偏移量
+     * @param cb 完成回调，在后台线程触发
+     */
+    virtual void write(int fd, const char *data, size_t len, uint64_t offset, onComplete cb) = 0;
+
+    /**
+     * 获取单例，首次调用时根据配置选择后端
+     */
+    static FileWriteBackend &Instance();
+};
+
+/**
+ * 录制用的异步文件写入器，替代在poller线程中同步fwrite
+ * 小块写入先合并到4K对齐的批量缓存中(可用于O_DIRECT)，缓存满、写入位置不连续或flush时提交给后端
+ * 同一文件的写请求按顺序逐个提交，保证seek回写(例如mp4头)的顺序
+ * 后端写入跟不上时(积压超过record.writeQueueMaxMB)isCongested返回true，由录制器自行丢帧，不阻塞poller线程
+ * write/flush/read/close只能在同一个线程调用，使用完毕后必须调用close，否则批量缓存中的数据会丢失
+ */
+class AsyncFileWriter : public std::enable_shared_from_this<AsyncFileWriter> {
+public:
+    using Ptr = std::shared_ptr<AsyncFileWriter>;
+
+    class Statistic {
+    public:
+        string path;
+        string backend;
+        //排队中的写请求个数与字节数
+        size_t queue_depth = 0;
+        size_t queue_bytes = 0;
+        uint64_t write_count = 0;
+        uint64_t write_bytes = 0;
+        uint64_t error_count = 0;
+        //最近写请求从排队到完成的耗时分布，单位微秒
+        uint32_t latency_p50 = 0;
+        uint32_t latency_p90 = 0;
+        uint32_t latency_p99 = 0;
+        uint32_t latency_max = 0;
+    };
+
+    AsyncFileWriter();
+    ~AsyncFileWriter();
+
+    /**
+     * 是否开启异步写文件(record.asyncWrite)
+     */
+    static bool isEnabled();
+
+    /**
+     * 创建并打开文件，文件已存在时清空
+     * @return 是否成功
+     */
+    bool open(const string &path);
+
+    /**
+     * 在当前文件末尾后追加写入
+     */
+    void write(const void *data, size_t len);
+
+    /**
+     * 在指定位置写入
+     */
+    void write(const void *data, size_t len, uint64_t offset);
+
+    /**
+     * 提交批量缓存中的数据
+     */
+    void flush();
+
+    /**
+     * 等待所有数据写入后同步读取，会阻塞调用线程，只应该在后台线程使用
+     * @return 0: 成功，其他: 失败
+     */
+    int read(void *data, size_t len, uint64_t offset);
+
+    /**
+     * 提交剩余数据，全部写入完成后关闭文件
+     * @param cb 全部写入完成后回调，可能在后台线程或者当前线程触发
+     */
+    void close(const function<void()> &cb = nullptr);
+
+    /**
+     * 写入积压是否过多，录制器应该丢弃数据直到恢复
+     */
+    bool isCongested() const;
+
+    /**
+     * 已写入(包括排队中)的文件大小
+     */
+    uint64_t size() const;
+
+    /**
+     * 获取所有写入器的统计
+     */
+    static vector<Statistic> getStatistic();
+
+private:
+    class Request {
+    public:
+        Buffer::Ptr data;
+        uint64_t offset = 0;
+        //已写入的字节数
+        size_t done = 0;
+        uint64_t enqueue_us = 0;
+    };
+
+    void submit_l();
+    void onComplete(ssize_t ret);
+    Buffer::Ptr obtainBatch();
+
+private:
+    int _fd = -1;
+    string _path;
+    uint64_t _size = 0;
+
+    //以下只在写入线程访问
+    Buffer::Ptr _batch;
+    size_t _batch_size = 0;
+    uint64_t _batch_offset = 0;
+    size_t _batch_capacity;
+
+    //以下受锁保护
+    mutable mutex _mtx;
+    condition_variable _cond;
+    deque<Request> _queue;
+    size_t _queue_bytes = 0;
+    bool _inflight = false;
+    bool _closing = false;
+    function<void()> _close_cb;
+    //写完的批量缓存，复用以避免频繁申请对齐内存
+    vector<Buffer::Ptr> _free_batches;
+    uint64_t _write_count = 0;
+    uint64_t _write_bytes = 0;
+    uint64_t _error_count = 0;
+    vector<uint32_t> _latency_us;
+    size_t _latency_index = 0;
+};
+
+}//namespace mediakit
+#endif //ZLMEDIAKIT_ASYNCFILEWRITER_H
@@ -13,11 +13,76 @@
 #include "HlsMakerImp.h"
 #include "Util/util.h"
 #include "Util/uv_errno.h"
+#include "Thread/WorkThreadPool.h"
 
 using namespace toolkit;
 
 namespace mediakit {
 
+/**
+ * 异步写磁盘时，m3u8必须在其引用的切片全部写入磁盘后再写入
+ * m3u8很小，在同一个后台线程中一次性写入，保证写入顺序；切片写完前m3u8又更新时只写最新的
+ */
+class HlsIndexWriter {
+public:
+    HlsIndexWriter(const string &path) {
+        _path = path;
+        _poller = WorkThreadPool::Instance().getPoller();
+    }
+
+    void addSegment() {
+        lock_guard<mutex> lck(_mtx);
+        ++_pending_segments;
+    }
+
+    //在写文件线程回调
+    void onSegmentWritten() {
+        lock_guard<mutex> lck(_mtx);
+        if (--_pending_segments == 0 && _index) {
+            writeIndex_l();
+        }
+    }
+
+    void setIndex(const Buffer::Ptr &index, const function<void()> &cb) {
+        lock_guard<mutex> lck(_mtx);
+        _index = index;
+        _cb = cb;
+        if (!_pending_segments) {
+            writeIndex_l();
+        }
+    }
+
+private:
+    void writeIndex_l() {
+        //在锁内投递，确保投递顺序与m3u8的生成顺序一致
+        auto path = _path;
+        auto index = std::move(_index);
+        auto cb = std::move(_cb);
+        _index = nullptr;
+        _cb = nullptr;
+        _poller->async([path, index, cb]() {
+            auto fp = File::create_file(path.data(), "wb");
+            if (!fp) {
+                WarnL << "create hls file failed," << path << " " << get_uv_errmsg();
+                return;
+            }
+            fwrite(index->data(), index->size(), 1, fp);
+            fclose(fp);
+            if (cb) {
+                cb();
+            }
+        }, false);
+    }
+
+private:
+    string _path;
+    EventPoller::Ptr _poller;
+    mutex _mtx;
+    int _pending_segments = 0;
+    Buffer::Ptr _index;
+    function<void()> _cb;
+};
+
 HlsMakerImp::HlsMakerImp(const string &m3u8_file,
                          const string &params,
                          uint32_t bufSize,
@@ -33,6 +98,15 @@ HlsMakerImp::HlsMakerImp(const string &m3u8_file,
     });
 
     _info.folder = _path_prefix;
+
+    GET_CONFIG(bool, in_memory, Hls::kInMemory);
+    if (in_memory && isLive()) {
+        //直播时切片与m3u8只保存在内存中
+        _memory_store = std::make_shared<HlsMemoryStore>(_path_prefix);
+    } else if (AsyncFileWriter::isEnabled()) {
+        //在后台异步写磁盘，不阻塞poller线程
+        _index_writer = std::make_shared<HlsIndexWriter>(_path_hls);
+    }
 }
 
 HlsMakerImp::~HlsMakerImp() {
@@ -48,7 +122,15 @@ void HlsMakerImp::clearCache(bool immediately) {
 
     clear();
     _file = nullptr;
+    if (_file_writer) {
+        _file_writer->close();
+        _file_writer = nullptr;
+    }
     _segment_file_paths.clear();
+    _segment_data.clear();
+    if (_memory_store) {
+        _memory_store->clear();
+    }
 
     //hls直播才删除文件
     GET_CONFIG(uint32_t, delay, Hls::kDeleteDelaySec);
@@ -75,7 +157,21 @@ string HlsMakerImp::onOpenSegment(uint64_t index) {
             _segment_file_paths.emplace(index, segment_path);
         }
     }
-    _file = makeFile(segment_path, true);
+    bool created = true;
+    if (_memory_store) {
+        //切片写完后才放入内存，按上个切片大小预分配内存
+        _segment_data.clear();
+        _segment_data.reserve(_last_segment_size + _last_segment_size / 4);
+    } else if (_index_writer) {
+        _file_writer = std::make_shared<AsyncFileWriter>();
+        if (!_file_writer->open(segment_path)) {
+            _file_writer = nullptr;
+            created = false;
+        }
+    } else {
+        _file = makeFile(segment_path, true);
+        created = _file != nullptr;
+    }
 
     //保存本切片的元数据
     _info.start_time = ::time(NULL);
@@ -83,7 +179,7 @@ string HlsMakerImp::onOpenSegment(uint64_t index) {
     _info.file_path = segment_path;
     _info.url = _info.app + "/" + _info.stream + "/" + segment_name;
 
-    if (!_file) {
+    if (!created) {
         WarnL << "create file failed," << segment_path << " " << get_uv_errmsg();
     }
     if (_params.empty()) {
@@ -97,12 +193,20 @@ void HlsMakerImp::onDelSegment(uint64_t index) {
     if (it == _segment_file_paths.end()) {
         return;
     }
-    File::delete_file(it->second.data());
+    if (_memory_store) {
+        _memory_store->delFile(it->second);
+    } else {
+        File::delete_file(it->second.data());
+    }
     _segment_file_paths.erase(it);
 }
 
 void HlsMakerImp::onWriteSegment(const char *data, size_t len) {
-    if (_file) {
+    if (_memory_store) {
+        _segment_data.append(data, len);
+    } else if (_file_writer) {
+        _file_writer->write(data, len);
+    } else if (_file) {
         fwrite(data, len, 1, _file.get());
     }
     if (_media_src) {
@@ -110,7 +214,61 @@ void HlsMakerImp::onWriteSegment(const char *data, size_t len) {
     }
 }
 
+void HlsMakerImp::closeMemorySegment() {
+    //m3u8更新前，刚写完的切片必须已经可以访问
+    _last_segment_size = _segment_data.size();
+    auto segment = std::make_shared<BufferString>(std::move(_segment_data));
+    _segment_data.clear();
+    _memory_store->setFile(_info.file_path, std::move(segment));
+}
+
+void HlsMakerImp::closeSegmentWriter(bool broadcast) {
+    if (!_file_writer) {
+        return;
+    }
+    _last_segment_size = _file_writer->size();
+    std::shared_ptr<RecordInfo> info;
+    if (broadcast) {
+        info = std::make_shared<RecordInfo>(_info);
+        info->file_size = _last_segment_size;
+    }
+    auto index_writer = _index_writer;
+    _file_writer->close([index_writer, info]() {
+        index_writer->onSegmentWritten();
+        if (info) {
+            //切片已落盘，在写文件线程广播
+            NoticeCenter::Instance().emitEvent(Broadcast::kBroadcastRecordTs, *info);
+        }
+    });
+    _file_writer = nullptr;
+}
+
+bool HlsMakerImp::isCongested() const {
+    return _file_writer && _file_writer->isCongested();
+}
+
 void HlsMakerImp::onWriteHls(const char *data, size_t len) {
+    if (_memory_store) {
+        closeMemorySegment();
+        _memory_store->setFile(_path_hls, std::make_shared<BufferString>(string(data, len)));
+        if (_media_src) {
+            _media_src->registHls(true);
+        }
+        return;
+    }
+    if (_index_writer) {
+        //m3u8在刚写完的切片落盘后再写入，然后通知等待的播放器；切片在onFlushLastSegment中关闭
+        if (_file_writer) {
+            _index_writer->addSegment();
+        }
+        weak_ptr<HlsMediaSource> weak_src = _media_src;
+        _index_writer->setIndex(std::make_shared<BufferString>(string(data, len)), [weak_src]() {
+            if (auto src = weak_src.lock()) {
+                src->registHls(true);
+            }
+        });
+        return;
+    }
     auto hls = makeFile(_path_hls);
     if (hls) {
         fwrite(data, len, 1, hls.get());
@@ -126,13 +284,22 @@ void HlsMakerImp::onWriteHls(const char *data, size_t len) {
 
 void HlsMakerImp::onFlushLastSegment(uint32_t duration_ms) {
     GET_CONFIG(bool, broadcastRecordTs, Hls::kBroadcastRecordTs);
+    _info.time_len = duration_ms / 1000.0f;
+    if (_index_writer) {
+        //异步写盘时在切片写入完成后再广播
+        closeSegmentWriter(broadcastRecordTs);
+        return;
+    }
     if (broadcastRecordTs) {
         //关闭ts文件以便获取正确的文件大小
         _file = nullptr;
-        _info.time_len = duration_ms / 1000.0f;
-        struct stat fileData;
-        stat(_info.file_path.data(), &fileData);
-        _info.file_size = fileData.st_size;
+        if (_memory_store) {
+            _info.file_size = _last_segment_size;
+        } else {
+            struct stat fileData;
+            stat(_info.file_path.data(), &fileData);
+            _info.file_size = fileData.st_size;
+        }
         NoticeCenter::Instance().emitEvent(Broadcast::kBroadcastRecordTs, _info);
     }
 }
@@ -152,6 +319,7 @@ std::shared_ptr<FILE> HlsMakerImp::makeFile(const string &file, bool setbuf) {
 
 void HlsMakerImp::setMediaSource(const string &vhost, const string &app, const string &stream_id) {
     _media_src = std::make_shared<HlsMediaSource>(vhost, app, stream_id);
+    _media_src->setMemoryStore(_memory_store);
     _info.app = app;
     _info.stream = stream_id;
     _info.vhost = vhost;
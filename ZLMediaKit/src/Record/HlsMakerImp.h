@@ -16,11 +16,14 @@
 #include <stdlib.h>
 #include "HlsMaker.h"
 #include "HlsMediaSource.h"
+#include "AsyncFileWriter.h"
 
 using namespace std;
 
 namespace mediakit {
 
+class HlsIndexWriter;
+
 class HlsMakerImp : public HlsMaker{
 public:
     HlsMakerImp(const string &m3u8_file,
@@ -51,6 +54,11 @@ public:
       */
      void clearCache(bool immediately = true);
 
+    /**
+     * 异步写入积压是否过多，此时应该丢帧
+     */
+    bool isCongested() const;
+
 protected:
     string onOpenSegment(uint64_t index) override ;
     void onDelSegment(uint64_t index) override;
@@ -60,6 +68,8 @@ protected:
 
 private:
     std::shared_ptr<FILE> makeFile(const string &file,bool setbuf = false);
+    void closeMemorySegment();
+    void closeSegmentWriter(bool broadcast);
 
 private:
     int _buf_size;
@@ -72,6 +82,15 @@ private:
     HlsMediaSource::Ptr _media_src;
     EventPoller::Ptr _poller;
     map<uint64_t/*index*/,string/*file_path*/> _segment_file_paths;
+    //上个切片大小
+    size_t _last_segment_size = 0;
+    //以下为内存模式相关，直播时切片与m3u8只保存在内存中
+    HlsMemoryStore::Ptr _memory_store;
+    //正在写入的切片数据
+    string _segment_data;
+    //以下为异步写磁盘相关
+    AsyncFileWriter::Ptr _file_writer;
+    std::shared_ptr<HlsIndexWriter> _index_writer;
 };
 
 }//namespace mediakit
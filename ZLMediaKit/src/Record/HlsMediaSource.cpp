@@ -12,6 +12,95 @@
 
 namespace mediakit{
 
+/////////////////////////////////////HlsMemoryStore//////////////////////////////////////
+
+static mutex s_store_mtx;
+//目录 --> 内存hls文件
+static unordered_map<string, weak_ptr<HlsMemoryStore> > s_store_map;
+
+HlsMemoryStore::HlsMemoryStore(const string &path_prefix) {
+    _path_prefix = path_prefix;
+}
+
+HlsMemoryStore::~HlsMemoryStore() {
+    lock_guard<mutex> lck(s_store_mtx);
+    auto it = s_store_map.find(_path_prefix);
+    if (it != s_store_map.end() && it->second.expired()) {
+        //同一目录可能已经被新的实例覆盖，只移除自己
+        s_store_map.erase(it);
+    }
+}
+
+void HlsMemoryStore::setFile(const string &file_path, Buffer::Ptr data) {
+    {
+        lock_guard<mutex> lck(_mtx);
+        auto &ref = _files[file_path];
+        if (ref) {
+            _bytes -= ref->size();
+        }
+        _bytes += data->size();
+        ref = std::move(data);
+        if (_files.size() > 1) {
+            return;
+        }
+    }
+    //第一次添加文件时再注册，此时shared_from_this可用
+    lock_guard<mutex> lck(s_store_mtx);
+    auto &ref = s_store_map[_path_prefix];
+    if (ref.lock().get() != this) {
+        ref = shared_from_this();
+    }
+}
+
+void HlsMemoryStore::delFile(const string &file_path) {
+    lock_guard<mutex> lck(_mtx);
+    auto it = _files.find(file_path);
+    if (it == _files.end()) {
+        return;
+    }
+    _bytes -= it->second->size();
+    _files.erase(it);
+}
+
+void HlsMemoryStore::clear() {
+    lock_guard<mutex> lck(_mtx);
+    _files.clear();
+    _bytes = 0;
+}
+
+Buffer::Ptr HlsMemoryStore::getFile(const string &file_path) const {
+    lock_guard<mutex> lck(_mtx);
+    auto it = _files.find(file_path);
+    return it == _files.end() ? nullptr : it->second;
+}
+
+size_t HlsMemoryStore::getBytes() const {
+    lock_guard<mutex> lck(_mtx);
+    return _bytes;
+}
+
+Buffer::Ptr HlsMemoryStore::findFile(const string &file_path) {
+    //切片位于hls目录下的子目录中，逐级向上查找注册的目录
+    auto pos = file_path.rfind('/');
+    while (pos != string::npos && pos > 0) {
+        HlsMemoryStore::Ptr store;
+        {
+            lock_guard<mutex> lck(s_store_mtx);
+            auto it = s_store_map.find(file_path.substr(0, pos));
+            if (it != s_store_map.end()) {
+                store = it->second.lock();
+            }
+        }
+        if (store) {
+            return store->getFile(file_path);
+        }
+        pos = file_path.rfind('/', pos - 1);
+    }
+    return nullptr;
+}
+
+/////////////////////////////////////HlsCookieData//////////////////////////////////////
+
 HlsCookieData::HlsCookieData(const MediaInfo &info, const std::shared_ptr<SockInfo> &sock_info) {
     _info = info;
     _sock_info = sock_info;
@@ -16,6 +16,60 @@
 #include "Common/MediaSource.h"
 namespace mediakit{
 
+/**
+ * 内存中的hls文件(切片与m3u8)，以文件绝对路径为key
+ * 切片写完后才放入，之后只读，通过引用计数在各http连接间共享，回复时无需拷贝
+ * 所有实例按目录注册到全局，http服务器可以通过文件路径查找
+ */
+class HlsMemoryStore : public std::enable_shared_from_this<HlsMemoryStore> {
+public:
+    using Ptr = std::shared_ptr<HlsMemoryStore>;
+
+    /**
+     * @param path_prefix hls文件所在目录绝对路径
+     */
+    HlsMemoryStore(const string &path_prefix);
+    ~HlsMemoryStore();
+
+    /**
+     * 添加或替换文件
+     * @param file_path 文件绝对路径
+     * @param data 文件内容
+     */
+    void setFile(const string &file_path, Buffer::Ptr data);
+
+    /**
+     * 删除文件
+     */
+    void delFile(const string &file_path);
+
+    /**
+     * 删除所有文件
+     */
+    void clear();
+
+    /**
+     * 获取文件，不存在时返回nullptr
+     */
+    Buffer::Ptr getFile(const string &file_path) const;
+
+    /**
+     * 占用的内存字节数
+     */
+    size_t getBytes() const;
+
+    /**
+     * 根据文件绝对路径在所有实例中查找文件，不存在时返回nullptr
+     */
+    static Buffer::Ptr findFile(const string &file_path);
+
+private:
+    string _path_prefix;
+    size_t _bytes = 0;
+    mutable mutex _mtx;
+    unordered_map<string, Buffer::Ptr> _files;
+};
+
 class HlsMediaSource : public MediaSource {
 public:
     friend class HlsCookieData;
@@ -83,8 +137,23 @@ public:
         _speed[TrackVideo] += bytes;
     }
 
+    /**
+     * 设置内存hls文件，开启hls.inMemory时有效
+     */
+    void setMemoryStore(HlsMemoryStore::Ptr store) {
+        _memory_store = std::move(store);
+    }
+
+    /**
+     * 获取内存hls文件，未开启hls.inMemory时返回nullptr
+     */
+    const HlsMemoryStore::Ptr &getMemoryStore() const {
+        return _memory_store;
+    }
+
 private:
     bool _is_regist = false;
+    HlsMemoryStore::Ptr _memory_store;
     RingType::Ptr _ring;
     mutex _mtx_cb;
     List<function<void()> > _list_cb;
@@ -67,9 +67,34 @@ public:
             _clear_cache = false;
             _hls->clearCache();
         }
-        if (_enabled || !hls_demand) {
-            TsMuxer::inputFrame(frame);
+        if (!_enabled && hls_demand) {
+            return;
         }
+        if (_hls->isCongested()) {
+            //磁盘写入跟不上，丢帧而不是阻塞poller线程
+            _wait_key_frame = true;
+            return;
+        }
+        if (_wait_key_frame) {
+            if (_have_video && !(frame->getTrackType() == TrackVideo && frame->keyFrame())) {
+                //等待视频关键帧
+                return;
+            }
+            _wait_key_frame = false;
+        }
+        TsMuxer::inputFrame(frame);
+    }
+
+    void addTrack(const Track::Ptr &track) override {
+        if (track->getTrackType() == TrackVideo) {
+            _have_video = true;
+        }
+        TsMuxer::addTrack(track);
+    }
+
+    void resetTracks() override {
+        _have_video = false;
+        TsMuxer::resetTracks();
     }
 
 private:
@@ -85,6 +110,9 @@ private:
     //默认不生成hls文件，有播放器时再生成
     bool _enabled = false;
     bool _clear_cache = false;
+    bool _have_video = false;
+    //异步写入积压过多时丢帧，恢复后等待关键帧
+    bool _wait_key_frame = false;
     std::shared_ptr<HlsMakerImp> _hls;
 };
 }//namespace mediakit
@@ -0,0 +1,329 @@
+﻿/*
+ * Copyright (c) 2016 The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/xia-chu/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include "LLHlsMaker.h"
+#include "Common/macros.h"
+
+//时间戳跳跃超过该值时认为时间戳异常
+#define LL_HLS_MAX_FRAGMENT_MS 10 * 1000
+
+namespace mediakit {
+
+LLHlsMaker::LLHlsMaker(float part_duration, float seg_duration, uint32_t seg_number, uint32_t seg_retain) {
+    _part_duration_ms = MAX(1, (uint32_t) (part_duration * 1000));
+    _seg_duration_ms = MAX(_part_duration_ms, (uint32_t) (seg_duration * 1000));
+    _seg_number = MAX(1, seg_number);
+    _seg_retain = seg_retain;
+}
+
+LLHlsMaker::~LLHlsMaker() {
+    notifyWaiters(true);
+}
+
+void LLHlsMaker::setInitSegment(const string &init_segment) {
+    lock_guard<mutex> lck(_mtx);
+    _init_segment = std::make_shared<BufferString>(init_segment);
+}
+
+void LLHlsMaker::inputFragment(const string &data, uint32_t stamp, bool independent) {
+    uint32_t duration = 0;
+    if (_have_stamp) {
+        duration = stamp - _last_stamp;
+        if (stamp < _last_stamp || duration > LL_HLS_MAX_FRAGMENT_MS) {
+            //时间戳回退或跳跃
+            duration = 0;
+        }
+    }
+    _have_stamp = true;
+    _last_stamp = stamp;
+    if (data.empty()) {
+        return;
+    }
+
+    if (!_segment_open && !independent) {
+        //切片必须以关键帧开始
+        return;
+    }
+
+    if (!_part_data.empty() && (independent || _part_duration + duration > _part_duration_ms)) {
+        //关键帧开始新的part，part时长不超过设定值
+        closePart();
+    }
+
+    if (independent && _segment_open) {
+        uint32_t seg_duration;
+        {
+            lock_guard<mutex> lck(_mtx);
+            seg_duration = _segments.back().duration_ms;
+        }
+        if (seg_duration >= _seg_duration_ms) {
+            //遇到关键帧并且达到切片时长，切片
+            closeSegment();
+        }
+    }
+
+    if (!_segment_open) {
+        lock_guard<mutex> lck(_mtx);
+        _segments.emplace_back();
+        _segments.back().msn = _next_msn++;
+        _segment_open = true;
+    }
+
+    if (_part_data.empty()) {
+        _part_independent = independent;
+    }
+    _part_data.append(data);
+    _part_duration += duration;
+}
+
+void LLHlsMaker::closePart() {
+    if (_part_data.empty()) {
+        return;
+    }
+    {
+        lock_guard<mutex> lck(_mtx);
+        auto &segment = _segments.back();
+        Part part;
+        part.data = std::make_shared<BufferString>(std::move(_part_data));
+        part.duration_ms = _part_duration;
+        part.independent = _part_independent;
+        segment.duration_ms += _part_duration;
+        segment.parts.emplace_back(std::move(part));
+        makePlaylist();
+    }
+    _part_data.clear();
+    _part_duration = 0;
+    _part_independent = false;
+    notifyWaiters(false);
+}
+
+void LLHlsMaker::closeSegment() {
+    closePart();
+    {
+        lock_guard<mutex> lck(_mtx);
+        auto &segment = _segments.back();
+        //切片由part拼接而成，part改为引用切片中的数据
+        size_t size = 0;
+        for (auto &part : segment.parts) {
+            size += part.data->size();
+        }
+        string data;
+        data.reserve(size);
+        for (auto &part : segment.parts) {
+            data.append(part.data->data(), part.data->size());
+        }
+        segment.data = std::make_shared<BufferString>(std::move(data));
+        size_t offset = 0;
+        for (auto &part : segment.parts) {
+            auto part_size = part.data->size();
+            part.data = std::make_shared<BufferOffset<Buffer::Ptr> >(segment.data, offset, part_size);
+            offset += part_size;
+        }
+        segment.complete = true;
+        _segment_open = false;
+
+        while (_segments.size() > _seg_number + _seg_retain) {
+            _segments.pop_front();
+        }
+        makePlaylist();
+    }
+    notifyWaiters(false);
+}
+
+void LLHlsMaker::clear() {
+    _part_data.clear();
+    _part_duration = 0;
+    _part_independent = false;
+    _have_stamp = false;
+    {
+        lock_guard<mutex> lck(_mtx);
+        _segments.clear();
+        _segment_open = false;
+        _playlist = nullptr;
+    }
+    notifyWaiters(true);
+}
+
+void LLHlsMaker::makePlaylist() {
+    char line[256];
+    //m3u8中列出的切片，最后一个可能尚未完成
+    size_t first = 0;
+    size_t complete_count = 0;
+    for (auto &segment : _segments) {
+        complete_count += segment.complete;
+    }
+    if (complete_count > _seg_number) {
+        first = complete_count - _seg_number;
+    }
+
+    uint32_t max_duration = _seg_duration_ms;
+    for (auto i = first; i < _segments.size(); ++i) {
+        if (_segments[i].complete) {
+            max_duration = MAX(max_duration, _segments[i].duration_ms);
+        }
+    }
+    auto target_duration = (max_duration + 999) / 1000;
+    auto part_target = _part_duration_ms / 1000.0;
+
+    string m3u8;
+    snprintf(line, sizeof(line),
+             "#EXTM3U\n"
+             "#EXT-X-VERSION:6\n"
+             "#EXT-X-TARGETDURATION:%u\n"
+             "#EXT-X-PART-INF:PART-TARGET=%.3f\n"
+             "#EXT-X-SERVER-CONTROL:CAN-BLOCK-RELOAD=YES,PART-HOLD-BACK=%.3f\n"
+             "#EXT-X-MEDIA-SEQUENCE:%llu\n"
+             "#EXT-X-MAP:URI=\"ll-hls/init.mp4\"\n",
+             target_duration, part_target, part_target * 3,
+             (unsigned long long) (first < _segments.size() ? _segments[first].msn : _next_msn));
+    m3u8.append(line);
+
+    //只列出距离直播点3倍切片时长以内的part
+    uint32_t part_window_ms = target_duration * 1000 * 3;
+    uint32_t elapsed_ms = 0;
+    auto part_begin = _segments.size();
+    while (part_begin > first && elapsed_ms < part_window_ms) {
+        --part_begin;
+        elapsed_ms += _segments[part_begin].duration_ms;
+    }
+
+    for (auto i = first; i < _segments.size(); ++i) {
+        auto &segment = _segments[i];
+        if (i >= part_begin) {
+            for (size_t j = 0; j < segment.parts.size(); ++j) {
+                auto &part = segment.parts[j];
+                snprintf(line, sizeof(line), "#EXT-X-PART:DURATION=%.3f,URI=\"ll-hls/%llu.%u.m4s\"%s\n",
+                         part.duration_ms / 1000.0, (unsigned long long) segment.msn, (unsigned) j,
+                         part.independent ? ",INDEPENDENT=YES" : "");
+                m3u8.append(line);
+            }
+        }
+        if (segment.complete) {
+            snprintf(line, sizeof(line), "#EXTINF:%.3f,\nll-hls/%llu.m4s\n", segment.duration_ms / 1000.0, (unsigned long long) segment.msn);
+            m3u8.append(line);
+        }
+    }
+
+    //预告下一个part，播放器可以提前请求，生成后立即回复
+    uint64_t next_msn = _segment_open ? _segments.back().msn : _next_msn;
+    uint32_t next_part = _segment_open ? (uint32_t) _segments.back().parts.size() : 0;
+    snprintf(line, sizeof(line), "#EXT-X-PRELOAD-HINT:TYPE=PART,URI=\"ll-hls/%llu.%u.m4s\"\n", (unsigned long long) next_msn, next_part);
+    m3u8.append(line);
+    _playlist = std::make_shared<BufferString>(std::move(m3u8));
+}
+
+Buffer::Ptr LLHlsMaker::getInitSegment() const {
+    lock_guard<mutex> lck(_mtx);
+    return _init_segment;
+}
+
+Buffer::Ptr LLHlsMaker::getPlaylist() const {
+    lock_guard<mutex> lck(_mtx);
+    return _playlist;
+}
+
+Buffer::Ptr LLHlsMaker::getPart(uint64_t msn, uint32_t part) const {
+    lock_guard<mutex> lck(_mtx);
+    for (auto &segment : _segments) {
+        if (segment.msn == msn) {
+            return part < segment.parts.size() ? segment.parts[part].data : nullptr;
+        }
+    }
+    return nullptr;
+}
+
+Buffer::Ptr LLHlsMaker::getSegment(uint64_t msn) const {
+    lock_guard<mutex> lck(_mtx);
+    for (auto &segment : _segments) {
+        if (segment.msn == msn) {
+            return segment.data;
+        }
+    }
+    return nullptr;
+}
+
+bool LLHlsMaker::isReady(uint64_t msn, int part) const {
+    if (_segments.empty()) {
+        return false;
+    }
+    auto &last = _segments.back();
+    if (msn < last.msn) {
+        //请求的切片已经完成
+        return true;
+    }
+    if (msn > last.msn) {
+        return false;
+    }
+    return part < 0 ? last.complete : (size_t) part < last.parts.size();
+}
+
+int LLHlsMaker::waitFor(uint64_t msn, int part, function<void()> cb, uint64_t *wait_id) {
+    lock_guard<mutex> lck(_mtx);
+    if (isReady(msn, part)) {
+        return 0;
+    }
+    auto last_msn = _segments.empty() ? _next_msn : _segments.back().msn;
+    if (msn > last_msn + 2) {
+        return -1;
+    }
+    _waiters.emplace_back(Waiter{++_wait_id, msn, part, std::move(cb)});
+    if (wait_id) {
+        *wait_id = _wait_id;
+    }
+    return 1;
+}
+
+bool LLHlsMaker::cancelWait(uint64_t wait_id) {
+    lock_guard<mutex> lck(_mtx);
+    List<Waiter> waiting;
+    bool found = false;
+    while (!_waiters.empty()) {
+        auto &waiter = _waiters.front();
+        if (waiter.id == wait_id) {
+            found = true;
+        } else {
+            waiting.emplace_back(std::move(waiter));
+        }
+        _waiters.pop_front();
+    }
+    _waiters.swap(waiting);
+    return found;
+}
+
+uint32_t LLHlsMaker::getBlockTimeoutMS() const {
+    return _seg_duration_ms * 3;
+}
+
+void LLHlsMaker::notifyWaiters(bool all) {
+    List<Waiter> ready;
+    {
+        lock_guard<mutex> lck(_mtx);
+        if (all) {
+            ready.swap(_waiters);
+        } else {
+            List<Waiter> waiting;
+            while (!_waiters.empty()) {
+                auto &waiter = _waiters.front();
+                if (isReady(waiter.msn, waiter.part)) {
+                    ready.emplace_back(std::move(waiter));
+                } else {
+                    waiting.emplace_back(std::move(waiter));
+                }
+                _waiters.pop_front();
+            }
+            _waiters.swap(waiting);
+        }
+    }
+    ready.for_each([](Waiter &waiter) {
+        waiter.cb();
+    });
+}
+
+}//namespace mediakit
@@ -0,0 +1,162 @@
+﻿/*
+ * Copyright (c) 2016 The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/xia-chu/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef ZLMEDIAKIT_LLHLSMAKER_H
+#define ZLMEDIAKIT_LLHLSMAKER_H
+
+#include <deque>
+#include <mutex>
+#include <memory>
+#include <functional>
+#include "Util/List.h"
+#include "Network/Buffer.h"
+using namespace std;
+using namespace toolkit;
+
+namespace mediakit {
+
+/**
+ * 低延时hls(LL-HLS)生成器，输入fmp4的moof+mdat片段，生成CMAF partial segment与m3u8
+ * 若干片段组成一个part(不超过part时长)，若干part组成一个切片(遇到关键帧且超过切片时长时切片)
+ * 切片完成后其数据由part拼接而成，part改为引用切片中的数据，不重复占用内存
+ * 所有文件都只保存在内存中，url均相对于m3u8所在目录：
+ * init segment: ll-hls/init.mp4, part: ll-hls/{msn}.{part}.m4s, 切片: ll-hls/{msn}.m4s
+ * inputFragment/setInitSegment/clear只能在生产者线程调用，其他接口可以在任意线程调用
+ */
+class LLHlsMaker {
+public:
+    using Ptr = std::shared_ptr<LLHlsMaker>;
+
+    /**
+     * @param part_duration part时长，单位秒
+     * @param seg_duration 切片时长，单位秒
+     * @param seg_number m3u8中切片个数
+     * @param seg_retain 切片从m3u8中移除后，继续保留在内存中的个数，防止播放器下载时已经删除
+     */
+    LLHlsMaker(float part_duration, float seg_duration, uint32_t seg_number, uint32_t seg_retain);
+    ~LLHlsMaker();
+
+    /**
+     * 设置fmp4 init segment
+     */
+    void setInitSegment(const string &init_segment);
+
+    /**
+     * 输入fmp4片段
+     * @param data 片段数据，为空时仅更新时间戳
+     * @param stamp 片段结束时间戳(即下一个片段的开始时间戳)，单位毫秒
+     * @param independent 是否以关键帧开始(纯音频时都为true)
+     */
+    void inputFragment(const string &data, uint32_t stamp, bool independent);
+
+    /**
+     * 清空所有part与切片，切片序号继续递增
+     */
+    void clear();
+
+    /**
+     * 获取init segment，不存在时返回nullptr
+     */
+    Buffer::Ptr getInitSegment() const;
+
+    /**
+     * 获取m3u8，尚未生成part时返回nullptr
+     */
+    Buffer::Ptr getPlaylist() const;
+
+    /**
+     * 获取part，不存在时返回nullptr
+     */
+    Buffer::Ptr getPart(uint64_t msn, uint32_t part) const;
+
+    /**
+     * 获取完整切片，不存在或尚未完成时返回nullptr
+     */
+    Buffer::Ptr getSegment(uint64_t msn) const;
+
+    /**
+     * 等待m3u8中出现指定的part或者更新的part
+     * @param msn 切片序号
+     * @param part part序号，小于0时等待整个切片完成
+     * @param cb 等待中时，part生成或者被清空时在生产者线程触发，只会触发一次
+     * @param wait_id 返回1时赋值为本次等待的id，用于取消等待
+     * @return 0: 已经生成，cb不会触发; 1: 等待中; -1: 请求的切片过新(超过最新切片2个以上)，cb不会触发
+     */
+    int waitFor(uint64_t msn, int part, function<void()> cb, uint64_t *wait_id = nullptr);
+
+    /**
+     * 取消等待(例如阻塞请求超时)，取消后cb不会再触发
+     * @param wait_id waitFor返回的等待id
+     * @return 是否仍在等待中并被取消，cb已经触发或者已经取消时返回false
+     */
+    bool cancelWait(uint64_t wait_id);
+
+    /**
+     * 阻塞请求的超时时间，单位毫秒，为3倍切片时长
+     */
+    uint32_t getBlockTimeoutMS() const;
+
+private:
+    class Part {
+    public:
+        Buffer::Ptr data;
+        uint32_t duration_ms = 0;
+        bool independent = false;
+    };
+
+    class Segment {
+    public:
+        uint64_t msn = 0;
+        uint32_t duration_ms = 0;
+        bool complete = false;
+        Buffer::Ptr data;
+        vector<Part> parts;
+    };
+
+    class Waiter {
+    public:
+        uint64_t id;
+        uint64_t msn;
+        int part;
+        function<void()> cb;
+    };
+
+    void closePart();
+    void closeSegment();
+    void makePlaylist();
+    bool isReady(uint64_t msn, int part) const;
+    void notifyWaiters(bool all);
+
+private:
+    uint32_t _part_duration_ms;
+    uint32_t _seg_duration_ms;
+    uint32_t _seg_number;
+    uint32_t _seg_retain;
+
+    //以下只在生产者线程访问
+    bool _have_stamp = false;
+    uint32_t _last_stamp = 0;
+    string _part_data;
+    uint32_t _part_duration = 0;
+    bool _part_independent = false;
+
+    //以下受锁保护
+    mutable mutex _mtx;
+    bool _segment_open = false;
+    uint64_t _next_msn = 0;
+    deque<Segment> _segments;
+    Buffer::Ptr _init_segment;
+    Buffer::Ptr _playlist;
+    uint64_t _wait_id = 0;
+    List<Waiter> _waiters;
+};
+
+}//namespace mediakit
+#endif //ZLMEDIAKIT_LLHLSMAKER_H
@@ -157,7 +157,23 @@ MP4FileIO::Reader MP4FileIO::createReader(){
     #define ftell64 ftell
 #endif
 
+MP4FileDisk::~MP4FileDisk() {
+    closeFile();
+}
+
 void MP4FileDisk::openFile(const char *file, const char *mode) {
+    closeFile();
+    if (strchr(mode, 'w') && AsyncFileWriter::isEnabled()) {
+        //录制mp4时异步写文件，不阻塞poller线程
+        auto writer = std::make_shared<AsyncFileWriter>();
+        if (!writer->open(file)) {
+            throw std::runtime_error(string("打开文件失败:") + file);
+        }
+        _writer = std::move(writer);
+        _offset = 0;
+        return;
+    }
+
     //创建文件
     auto fp = File::create_file(file, mode);
     if(!fp){
@@ -185,11 +201,29 @@ void MP4FileDisk::openFile(const char *file, const char *mode) {
     });
 }
 
-void MP4FileDisk::closeFile() {
+void MP4FileDisk::closeFile(const function<void()> &on_closed) {
     _file = nullptr;
+    if (_writer) {
+        _writer->close(on_closed);
+        _writer = nullptr;
+    } else if (on_closed) {
+        on_closed();
+    }
+}
+
+bool MP4FileDisk::isCongested() const {
+    return _writer && _writer->isCongested();
 }
 
 int MP4FileDisk::onRead(void *data, size_t bytes) {
+    if (_writer) {
+        //faststart时回读，等待已写数据落盘后再读取
+        auto ret = _writer->read(data, bytes, _offset);
+        if (!ret) {
+            _offset += bytes;
+        }
+        return ret;
+    }
     if (bytes == fread(data, 1, bytes, _file.get())){
         return 0;
     }
@@ -197,14 +231,26 @@ int MP4FileDisk::onRead(void *data, size_t bytes) {
 }
 
 int MP4FileDisk::onWrite(const void *data, size_t bytes) {
+    if (_writer) {
+        _writer->write(data, bytes, _offset);
+        _offset += bytes;
+        return 0;
+    }
     return bytes == fwrite(data, 1, bytes, _file.get()) ? 0 : ferror(_file.get());
 }
 
 int MP4FileDisk::onSeek(size_t offset) {
+    if (_writer) {
+        _offset = offset;
+        return 0;
+    }
     return fseek64(_file.get(), offset, SEEK_SET);
 }
 
 size_t MP4FileDisk::onTell() {
+    if (_writer) {
+        return _offset;
+    }
     return ftell64(_file.get());
 }
 
@@ -20,6 +20,7 @@
 #include "mpeg4-aac.h"
 #include "mov-buffer.h"
 #include "mov-format.h"
+#include "AsyncFileWriter.h"
 using namespace std;
 namespace mediakit {
 
@@ -93,10 +94,10 @@ class MP4FileDisk : public MP4FileIO {
 public:
     using Ptr = std::shared_ptr<MP4FileDisk>;
     MP4FileDisk() = default;
-    ~MP4FileDisk() override = default;
+    ~MP4FileDisk() override;
 
     /**
-     * 打开磁盘文件
+     * 打开磁盘文件，写文件并且开启了异步写时，在后台异步写入
      * @param file 文件路径
      * @param mode fopen的方式
      */
@@ -104,8 +105,14 @@ public:
 
     /**
      * 关闭磁盘文件
+     * @param on_closed 数据全部写入磁盘后回调，异步写时可能在后台线程触发
      */
-    void closeFile();
+    void closeFile(const function<void()> &on_closed = nullptr);
+
+    /**
+     * 异步写入积压是否过多
+     */
+    bool isCongested() const;
 
 protected:
     size_t onTell() override;
@@ -115,6 +122,9 @@ protected:
 
 private:
     std::shared_ptr<FILE> _file;
+    //异步写文件时，由于写入是异步的，需要自己记录文件偏移量
+    AsyncFileWriter::Ptr _writer;
+    uint64_t _offset = 0;
 };
 
 class MP4FileMemory : public MP4FileIO{
@@ -16,6 +16,7 @@
 #include "Extension/AAC.h"
 #include "Extension/G711.h"
 #include "Extension/Opus.h"
+#include <algorithm>
 using namespace toolkit;
 namespace mediakit {
 
@@ -28,6 +29,24 @@ MP4Demuxer::~MP4Demuxer() {
 void MP4Demuxer::openMP4(const string &file) {
     closeMP4();
 
+    _index = MP4Index::get(file);
+    if (_index) {
+        //同一文件的所有点播共享索引与mmap映射，本对象只保存读取位置
+        for (auto &track : _index->getTracks()) {
+            if (track.video) {
+                onVideoTrack(track.track_id, track.object, track.width, track.height, track.extra.data(), track.extra.size());
+            } else {
+                onAudioTrack(track.track_id, track.object, track.channel_count, track.bit_per_sample, track.sample_rate, track.extra.data(), track.extra.size());
+            }
+        }
+        _duration_ms = _index->getDurationMS();
+        _cursor = 0;
+        _skip_end = 0;
+        _track_start.assign(_index->getTracks().size(), 0);
+        return;
+    }
+
+    //不支持mmap时逐帧读取文件
     _mp4_file = std::make_shared<MP4FileDisk>();
     _mp4_file->openFile(file.data(), "rb+");
     _mov_reader = _mp4_file->createReader();
@@ -36,6 +55,8 @@ void MP4Demuxer::openMP4(const string &file) {
 }
 
 void MP4Demuxer::closeMP4() {
+    _frames.clear();
+    _index.reset();
     _mov_reader.reset();
     _mp4_file.reset();
 }
@@ -152,6 +173,17 @@ void MP4Demuxer::onAudioTrack(uint32_t track_id, uint8_t object, int channel_cou
 }
 
 int64_t MP4Demuxer::seekTo(int64_t stamp_ms) {
+    if (_index) {
+        if (_track_start.empty()) {
+            return -1;
+        }
+        _frames.clear();
+        //二分查找关键帧，复杂度O(log n)
+        stamp_ms = _index->seek(stamp_ms, _track_start);
+        _cursor = *min_element(_track_start.begin(), _track_start.end());
+        _skip_end = *max_element(_track_start.begin(), _track_start.end());
+        return stamp_ms;
+    }
     if(0 != mov_reader_seek(_mov_reader.get(),&stamp_ms)){
         return -1;
     }
@@ -172,6 +204,9 @@ struct Context{
 Frame::Ptr MP4Demuxer::readFrame(bool &keyFrame, bool &eof) {
     keyFrame = false;
     eof = false;
+    if (_index) {
+        return readIndexFrame(keyFrame, eof);
+    }
     static mov_reader_onread mov_reader_onread = [](void *param, uint32_t track_id, const void *buffer, size_t bytes, int64_t pts, int64_t dts, int flags) {
         Context *ctx = (Context *) param;
         ctx->pts = pts;
@@ -255,6 +290,100 @@ Frame::Ptr MP4Demuxer::makeFrame(uint32_t track_id, const Buffer::Ptr &buf, int6
     }
 }
 
+Frame::Ptr MP4Demuxer::readIndexFrame(bool &keyFrame, bool &eof) {
+    if (_frames.empty()) {
+        auto &samples = _index->getSamples();
+        if (_cursor >= samples.size()) {
+            eof = true;
+            return nullptr;
+        }
+        auto pos = _cursor++;
+        auto &sample = samples[pos];
+        if (pos < _skip_end && pos < _track_start[sample.track]) {
+            //seek位置之前的数据
+            return nullptr;
+        }
+        makeIndexFrame(sample);
+        if (_frames.empty()) {
+            return nullptr;
+        }
+    }
+    keyFrame = _frames_key;
+    auto frame = std::move(_frames.front());
+    _frames.pop_front();
+    return frame;
+}
+
+void MP4Demuxer::makeIndexFrame(const MP4Index::Sample &sample) {
+    auto it = _track_to_codec.find(_index->getTracks()[sample.track].track_id);
+    if (it == _track_to_codec.end()) {
+        return;
+    }
+    _frames_key = sample.key;
+    auto dts = (uint32_t) sample.dts;
+    auto pts = (uint32_t) sample.pts;
+    auto codec = it->second->getCodecId();
+    switch (codec) {
+        case CodecH264 :
+        case CodecH265 : {
+            //mmap映射为只读，不能原地把nalu长度改成起始码，所以按nalu拆分为不带起始码的帧，数据不拷贝
+            auto data = _index->getData(sample.offset, sample.bytes);
+            if (!data) {
+                break;
+            }
+            uint32_t offset = 0;
+            while (offset + 4 < sample.bytes) {
+                uint32_t frame_len;
+                memcpy(&frame_len, data->data() + offset, 4);
+                frame_len = ntohl(frame_len);
+                if (frame_len + offset + 4 > sample.bytes) {
+                    WarnL << "mp4 nalu长度非法:" << frame_len;
+                    break;
+                }
+                if (frame_len) {
+                    auto nalu = std::make_shared<BufferOffset<Buffer::Ptr> >(data, offset + 4, frame_len);
+                    if (codec == CodecH264) {
+                        _frames.emplace_back(std::make_shared<FrameWrapper<H264FrameNoCacheAble> >(nalu, dts, pts, 0, 0));
+                    } else {
+                        _frames.emplace_back(std::make_shared<FrameWrapper<H265FrameNoCacheAble> >(nalu, dts, pts, 0, 0));
+                    }
+                }
+                offset += (frame_len + 4);
+            }
+            break;
+        }
+
+        case CodecAAC: {
+            //aac需要加上adts头，数据量小，拷贝即可
+            auto data = _index->getData(sample.offset, sample.bytes);
+            if (!data) {
+                break;
+            }
+            auto buf = _buffer_pool.obtain();
+            buf->setCapacity(sample.bytes + DATA_OFFSET + 1);
+            buf->setSize(sample.bytes + DATA_OFFSET);
+            memcpy(buf->data() + DATA_OFFSET, data->data(), sample.bytes);
+            auto frame = makeFrame(it->first, buf, sample.pts, sample.dts);
+            if (frame) {
+                _frames.emplace_back(std::move(frame));
+            }
+            break;
+        }
+
+        case CodecOpus:
+        case CodecG711A:
+        case CodecG711U: {
+            auto data = _index->getData(sample.offset, sample.bytes);
+            if (data) {
+                _frames.emplace_back(std::make_shared<FrameWrapper<FrameFromPtr> >(std::move(data), dts, pts, 0, 0, codec));
+            }
+            break;
+        }
+
+        default: break;
+    }
+}
+
 vector<Track::Ptr> MP4Demuxer::getTracks(bool trackReady) const {
     vector<Track::Ptr> ret;
     for (auto &pr : _track_to_codec) {
@@ -12,7 +12,9 @@
 #define ZLMEDIAKIT_MP4DEMUXER_H
 #ifdef ENABLE_MP4
 #include "MP4.h"
+#include "MP4Index.h"
 #include "Extension/Track.h"
+#include "Util/List.h"
 #include "Util/ResourcePool.h"
 namespace mediakit {
 
@@ -70,8 +72,21 @@ private:
     void onVideoTrack(uint32_t track_id, uint8_t object, int width, int height, const void *extra, size_t bytes);
     void onAudioTrack(uint32_t track_id, uint8_t object, int channel_count, int bit_per_sample, int sample_rate, const void *extra, size_t bytes);
     Frame::Ptr makeFrame(uint32_t track_id, const Buffer::Ptr &buf, int64_t pts, int64_t dts);
+    Frame::Ptr readIndexFrame(bool &keyFrame, bool &eof);
+    void makeIndexFrame(const MP4Index::Sample &sample);
 
 private:
+    //共享的sample索引，不支持mmap时为空，此时通过_mov_reader逐帧读取文件
+    MP4Index::Ptr _index;
+    //下一个读取的sample下标
+    size_t _cursor = 0;
+    //seek后各track开始读取的sample下标，下标小于_skip_end时跳过各track开始位置之前的sample
+    vector<size_t> _track_start;
+    size_t _skip_end = 0;
+    //一个视频sample拆分出的多个nalu
+    bool _frames_key = false;
+    List<Frame::Ptr> _frames;
+
     MP4FileDisk::Ptr _mp4_file;
     MP4FileDisk::Reader _mov_reader;
     uint64_t _duration_ms = 0;
@@ -0,0 +1,321 @@
+﻿/*
+ * Copyright (c) 2016 The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/xia-chu/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifdef ENABLE_MP4
+#include <mutex>
+#include <algorithm>
+#include <unordered_map>
+#include <sys/stat.h>
+#include "MP4Index.h"
+#include "MP4.h"
+#include "Util/logger.h"
+#include "Util/util.h"
+#include "Util/uv_errno.h"
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+namespace mediakit {
+
+//检测文件修改的最小间隔，单位毫秒
+#define MP4_INDEX_CHECK_MS 1000
+
+static mutex s_mtx;
+static unordered_map<string, weak_ptr<MP4Index> > s_indexes;
+
+//纳秒精度的文件修改时间，秒级精度可能漏掉一秒内的覆盖写入
+static uint64_t getModifyTimeNS(const struct stat &st) {
+#if defined(__APPLE__)
+    return st.st_mtimespec.tv_sec * 1000000000ULL + st.st_mtimespec.tv_nsec;
+#elif defined(_WIN32)
+    return st.st_mtime * 1000000000ULL;
+#else
+    return st.st_mtim.tv_sec * 1000000000ULL + st.st_mtim.tv_nsec;
+#endif
+}
+
+//整个文件的mmap映射
+class MP4MmapBuffer : public Buffer {
+public:
+    MP4MmapBuffer(char *ptr, size_t size) {
+        _ptr = ptr;
+        _size = size;
+    }
+
+    ~MP4MmapBuffer() override {
+#ifndef _WIN32
+        munmap(_ptr, _size);
+#endif
+    }
+
+    char *data() const override {
+        return _ptr;
+    }
+
+    size_t size() const override {
+        return _size;
+    }
+
+private:
+    char *_ptr;
+    size_t _size;
+};
+
+MP4Index::MP4Index(const string &file) {
+    _file = file;
+}
+
+MP4Index::~MP4Index() {
+#ifndef _WIN32
+    if (_fd >= 0) {
+        ::close(_fd);
+    }
+#endif
+    lock_guard<mutex> lck(s_mtx);
+    auto it = s_indexes.find(_file);
+    if (it != s_indexes.end() && it->second.expired()) {
+        s_indexes.erase(it);
+    }
+}
+
+MP4Index::Ptr MP4Index::get(const string &file) {
+#ifdef _WIN32
+    return nullptr;
+#else
+    struct stat st;
+    if (stat(file.data(), &st) != 0) {
+        throw std::runtime_error(StrPrinter << "打开文件失败:" << file << " " << get_uv_errmsg());
+    }
+    {
+        lock_guard<mutex> lck(s_mtx);
+        auto it = s_indexes.find(file);
+        if (it != s_indexes.end()) {
+            auto index = it->second.lock();
+            if (index && index->_file_size == (size_t) st.st_size && index->_mtime_ns == getModifyTimeNS(st)) {
+                //文件未修改，复用索引
+                return index;
+            }
+        }
+    }
+
+    //在锁外解析moov，防止阻塞其他文件的点播
+    Ptr index(new MP4Index(file));
+    index->_mtime_ns = getModifyTimeNS(st);
+    index->load(st.st_size);
+    if (!index->mapFile(st.st_size)) {
+        return nullptr;
+    }
+
+    lock_guard<mutex> lck(s_mtx);
+    auto &ref = s_indexes[file];
+    auto old = ref.lock();
+    if (old && old->_file_size == index->_file_size && old->_mtime_ns == index->_mtime_ns) {
+        //其他线程同时生成了索引
+        return old;
+    }
+    ref = index;
+    return index;
+#endif
+}
+
+void MP4Index::load(size_t file_size) {
+    auto mp4_file = std::make_shared<MP4FileDisk>();
+    mp4_file->openFile(_file.data(), "rb");
+    auto reader = mp4_file->createReader();
+
+    static mov_reader_trackinfo_t s_on_track = {
+            [](void *param, uint32_t track, uint8_t object, int width, int height, const void *extra, size_t bytes) {
+                //onvideo
+                MP4Index *thiz = (MP4Index *) param;
+                TrackInfo info;
+                info.track_id = track;
+                info.video = true;
+                info.object = object;
+                info.width = width;
+                info.height = height;
+                info.extra.assign((char *) extra, bytes);
+                thiz->_tracks.emplace_back(std::move(info));
+            },
+            [](void *param, uint32_t track, uint8_t object, int channel_count, int bit_per_sample, int sample_rate, const void *extra, size_t bytes) {
+                //onaudio
+                MP4Index *thiz = (MP4Index *) param;
+                TrackInfo info;
+                info.track_id = track;
+                info.object = object;
+                info.channel_count = channel_count;
+                info.bit_per_sample = bit_per_sample;
+                info.sample_rate = sample_rate;
+                info.extra.assign((char *) extra, bytes);
+                thiz->_tracks.emplace_back(std::move(info));
+            },
+            [](void *param, uint32_t track, uint8_t object, const void *extra, size_t bytes) {
+                //onsubtitle, do nothing
+            }
+    };
+    mov_reader_getinfo(reader.get(), &s_on_track, this);
+    _duration_ms = mov_reader_getduration(reader.get());
+    _file_size = file_size;
+
+    //只遍历moov中的sample表，不读取sample数据
+    static mov_reader_onindex s_on_index = [](void *param, uint32_t track_id, uint64_t offset, size_t bytes, int64_t pts, int64_t dts, int flags) {
+        MP4Index *thiz = (MP4Index *) param;
+        for (size_t i = 0; i < thiz->_tracks.size(); ++i) {
+            auto &track = thiz->_tracks[i];
+            if (track.track_id != track_id) {
+                continue;
+            }
+            if (offset + bytes > thiz->_file_size) {
+                //文件被截断
+                return;
+            }
+            Sample sample;
+            sample.offset = offset;
+            sample.pts = pts;
+            sample.dts = dts;
+            sample.bytes = (uint32_t) bytes;
+            sample.track = (uint16_t) i;
+            sample.key = flags & MOV_AV_FLAG_KEYFREAME;
+            auto pos = (uint32_t) thiz->_samples.size();
+            track.samples.emplace_back(pos);
+            if (track.video && sample.key) {
+                track.keys.emplace_back(pos);
+            }
+            thiz->_samples.emplace_back(sample);
+            return;
+        }
+    };
+    auto ret = mov_reader_index(reader.get(), s_on_index, this);
+    if (ret < 0) {
+        throw std::runtime_error(StrPrinter << "生成mp4索引失败:" << _file << " " << ret);
+    }
+    _samples.shrink_to_fit();
+    for (auto &track : _tracks) {
+        track.samples.shrink_to_fit();
+        track.keys.shrink_to_fit();
+    }
+}
+
+bool MP4Index::mapFile(size_t file_size) {
+#ifdef _WIN32
+    return false;
+#else
+    if (!file_size) {
+        return false;
+    }
+    int fd = open(_file.data(), O_RDONLY);
+    if (fd < 0) {
+        WarnL << "打开文件失败:" << _file << " " << get_uv_errmsg();
+        return false;
+    }
+    auto ptr = (char *) mmap(nullptr, file_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (ptr == MAP_FAILED) {
+        WarnL << "mmap failed:" << _file << " " << get_uv_errmsg();
+        ::close(fd);
+        return false;
+    }
+    _fd = fd;
+    _map = std::make_shared<MP4MmapBuffer>(ptr, file_size);
+    return true;
+#endif
+}
+
+bool MP4Index::needCheckFile() const {
+    auto now = getCurrentMillisecond();
+    auto last = _check_stamp.load(memory_order_relaxed);
+    //同一时刻只有一个会话执行检测
+    return now - last >= MP4_INDEX_CHECK_MS && _check_stamp.compare_exchange_strong(last, now);
+}
+
+bool MP4Index::fileChanged() const {
+#ifdef _WIN32
+    return false;
+#else
+    //文件被删除或者改名后替换时，映射的仍然是原文件，不受影响；截断或者覆盖写入同一个文件时大小或修改时间会改变
+    struct stat st;
+    return fstat(_fd, &st) != 0 || (size_t) st.st_size != _file_size || getModifyTimeNS(st) != _mtime_ns;
+#endif
+}
+
+const vector<MP4Index::TrackInfo> &MP4Index::getTracks() const {
+    return _tracks;
+}
+
+const vector<MP4Index::Sample> &MP4Index::getSamples() const {
+    return _samples;
+}
+
+uint64_t MP4Index::getDurationMS() const {
+    return _duration_ms;
+}
+
+Buffer::Ptr MP4Index::getData(uint64_t offset, size_t size) const {
+    if (!_changed.load(memory_order_relaxed)) {
+        if (!needCheckFile() || !fileChanged()) {
+            return std::make_shared<BufferOffset<Buffer::Ptr> >(_map, offset, size);
+        }
+        WarnL << "mp4文件已被修改，不再读取mmap映射的内存:" << _file;
+        _changed = true;
+    }
+#ifdef _WIN32
+    return nullptr;
+#else
+    //文件已修改，映射中超出文件末尾的页面访问会触发SIGBUS，改为从文件读取
+    auto buf = BufferRaw::create();
+    buf->setCapacity(size + 1);
+    auto ret = pread(_fd, buf->data(), size, offset);
+    if (ret < 0 || (size_t) ret != size) {
+        //文件被截断
+        return nullptr;
+    }
+    buf->setSize(size);
+    return buf;
+#endif
+}
+
+#define DIFF(a, b) ((a) > (b) ? ((a) - (b)) : ((b) - (a)))
+
+int64_t MP4Index::seek(int64_t stamp_ms, vector<size_t> &track_start) const {
+    auto dts_less = [&](uint32_t pos, int64_t dts) {
+        return _samples[pos].dts < dts;
+    };
+
+    for (auto &track : _tracks) {
+        if (!track.video || track.keys.empty()) {
+            continue;
+        }
+        //有视频时，定位到离目标最近的关键帧
+        auto it = lower_bound(track.keys.begin(), track.keys.end(), stamp_ms, dts_less);
+        if (it == track.keys.end()) {
+            --it;
+        } else if (it != track.keys.begin() && DIFF(_samples[*(it - 1)].dts, stamp_ms) <= DIFF(_samples[*it].dts, stamp_ms)) {
+            --it;
+        }
+        stamp_ms = _samples[*it].dts;
+        break;
+    }
+
+    track_start.resize(_tracks.size());
+    for (size_t i = 0; i < _tracks.size(); ++i) {
+        auto &samples = _tracks[i].samples;
+        auto it = lower_bound(samples.begin(), samples.end(), stamp_ms, dts_less);
+        track_start[i] = it == samples.end() ? _samples.size() : *it;
+    }
+    return stamp_ms;
+}
+
+size_t MP4Index::getIndexCount() {
+    lock_guard<mutex> lck(s_mtx);
+    return s_indexes.size();
+}
+
+}//namespace mediakit
+#endif//ENABLE_MP4
@@ -0,0 +1,137 @@
+﻿/*
+ * Copyright (c) 2016 The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/xia-chu/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef ZLMEDIAKIT_MP4INDEX_H
+#define ZLMEDIAKIT_MP4INDEX_H
+#ifdef ENABLE_MP4
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Network/Buffer.h"
+using namespace std;
+using namespace toolkit;
+
+namespace mediakit {
+
+/**
+ * mp4点播共享的sample索引
+ * 同一个文件只在第一次打开时解析moov生成索引，并把整个文件mmap到内存，
+ * 之后所有点播该文件的MP4Demuxer共享同一份索引与映射，每个会话只保存自己的读取位置
+ * 文件被截断或者覆盖写入后访问映射的内存可能触发SIGBUS，所以每秒最多检测一次文件修改(大小与纳秒精度的修改时间)，
+ * 检测到修改后改为pread读取；两次检测之间原地截断文件仍可能触发SIGBUS，点播期间不支持原地截断或覆盖写入，
+ * 更新文件请写入新文件后改名替换
+ * 索引为只读数据，创建后可以在任意线程访问
+ */
+class MP4Index {
+public:
+    using Ptr = std::shared_ptr<MP4Index>;
+
+    class TrackInfo {
+    public:
+        uint32_t track_id = 0;
+        bool video = false;
+        uint8_t object = 0;
+        int width = 0;
+        int height = 0;
+        int channel_count = 0;
+        int bit_per_sample = 0;
+        int sample_rate = 0;
+        string extra;
+        //该track所有sample在getSamples()中的下标，按解码顺序排列
+        vector<uint32_t> samples;
+        //该track所有关键帧在getSamples()中的下标
+        vector<uint32_t> keys;
+    };
+
+    class Sample {
+    public:
+        //sample数据在文件中的偏移量
+        uint64_t offset;
+        int64_t pts;
+        int64_t dts;
+        uint32_t bytes;
+        //所属track在getTracks()中的下标
+        uint16_t track;
+        bool key;
+    };
+
+    ~MP4Index();
+
+    /**
+     * 获取文件的共享索引，文件未修改时复用已经生成的索引
+     * @param file mp4文件路径
+     * @return 索引，平台不支持mmap或者mmap失败时返回nullptr
+     * @throw 文件不存在或者不是有效的mp4文件时抛异常
+     */
+    static Ptr get(const string &file);
+
+    /**
+     * 获取所有音视频track
+     */
+    const vector<TrackInfo> &getTracks() const;
+
+    /**
+     * 获取所有sample，顺序与mov_reader_read读取的顺序一致
+     */
+    const vector<Sample> &getSamples() const;
+
+    /**
+     * 获取文件长度，单位毫秒
+     */
+    uint64_t getDurationMS() const;
+
+    /**
+     * 获取文件中的一段数据，文件未修改时引用mmap的内存，不拷贝；文件已修改时从文件读取
+     * @param offset 文件偏移量
+     * @param size 数据长度，offset + size不得超过文件长度
+     * @return 数据，文件被截断导致数据不存在时返回nullptr
+     */
+    Buffer::Ptr getData(uint64_t offset, size_t size) const;
+
+    /**
+     * 二分查找seek位置，有视频时定位到离目标最近的关键帧，其他track定位到该时间戳之后的第一个sample
+     * @param stamp_ms 预期的时间轴位置，单位毫秒
+     * @param track_start 输出各track开始读取的sample下标(getSamples()中的下标)，track已读完时为sample总数
+     * @return 实际时间轴位置
+     */
+    int64_t seek(int64_t stamp_ms, vector<size_t> &track_start) const;
+
+    /**
+     * 当前被共享的索引个数
+     */
+    static size_t getIndexCount();
+
+private:
+    MP4Index(const string &file);
+    void load(size_t file_size);
+    bool mapFile(size_t file_size);
+    bool needCheckFile() const;
+    bool fileChanged() const;
+
+private:
+    string _file;
+    size_t _file_size = 0;
+    //文件修改时间，单位纳秒
+    uint64_t _mtime_ns = 0;
+    uint64_t _duration_ms = 0;
+    vector<TrackInfo> _tracks;
+    vector<Sample> _samples;
+    Buffer::Ptr _map;
+    //保持打开，用于检测文件修改与修改后读取
+    int _fd = -1;
+    mutable atomic<bool> _changed{false};
+    //上次检测文件修改的时间，多个会话共享索引，每秒最多检测一次
+    mutable atomic<uint64_t> _check_stamp{0};
+};
+
+}//namespace mediakit
+#endif//ENABLE_MP4
+#endif //ZLMEDIAKIT_MP4INDEX_H
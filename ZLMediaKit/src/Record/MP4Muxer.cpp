@@ -32,9 +32,19 @@ MP4FileIO::Writer MP4Muxer::createWriter(){
     return _mp4_file->createWriter(mp4FastStart ? MOV_FLAG_FASTSTART : 0, false);
 }
 
-void MP4Muxer::closeMP4(){
+void MP4Muxer::closeMP4(const function<void()> &on_closed){
+    //先释放mov writer，写入moov
     MP4MuxerInterface::resetTracks();
-    _mp4_file = nullptr;
+    if (_mp4_file) {
+        _mp4_file->closeFile(on_closed);
+        _mp4_file = nullptr;
+    } else if (on_closed) {
+        on_closed();
+    }
+}
+
+bool MP4Muxer::isCongested() const {
+    return _mp4_file && _mp4_file->isCongested();
 }
 
 void MP4Muxer::resetTracks() {
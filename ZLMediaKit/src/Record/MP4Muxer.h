@@ -96,8 +96,14 @@ public:
 
     /**
      * 手动关闭文件(对象析构时会自动关闭)
+     * @param on_closed 数据全部写入磁盘后回调，异步写时可能在后台线程触发
      */
-    void closeMP4();
+    void closeMP4(const function<void()> &on_closed = nullptr);
+
+    /**
+     * 异步写入积压是否过多，此时应该丢帧
+     */
+    bool isCongested() const;
 
 protected:
     MP4FileIO::Writer createWriter() override;
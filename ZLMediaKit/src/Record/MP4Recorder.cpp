@@ -79,22 +79,25 @@ void MP4Recorder::asyncClose() {
         //获取文件录制时间，放在关闭mp4之前是为了忽略关闭mp4执行时间
         info.time_len = (float)(::time(NULL) - info.start_time);
         //关闭mp4非常耗时，所以要放在后台线程执行
-        muxer->closeMP4();
-
-        //获取文件大小
-        struct stat fileData;
-        stat(strFileTmp.data(), &fileData);
-        info.file_size = fileData.st_size;
-        if (fileData.st_size < 1024) {
-            //录像文件太小，删除之
-            File::delete_file(strFileTmp.data());
-            return;
-        }
-        //临时文件名改成正式文件名，防止mp4未完成时被访问
-        rename(strFileTmp.data(),strFile.data());
-
-        /////record 业务逻辑//////
-        NoticeCenter::Instance().emitEvent(Broadcast::kBroadcastRecordMP4,info);
+        muxer->closeMP4([strFileTmp, strFile, info]() mutable {
+            //异步写文件时在写文件线程回调，切换到后台线程处理
+            WorkThreadPool::Instance().getExecutor()->async([strFileTmp, strFile, info]() mutable {
+                //获取文件大小
+                struct stat fileData;
+                stat(strFileTmp.data(), &fileData);
+                info.file_size = fileData.st_size;
+                if (fileData.st_size < 1024) {
+                    //录像文件太小，删除之
+                    File::delete_file(strFileTmp.data());
+                    return;
+                }
+                //临时文件名改成正式文件名，防止mp4未完成时被访问
+                rename(strFileTmp.data(), strFile.data());
+
+                /////record 业务逻辑//////
+                NoticeCenter::Instance().emitEvent(Broadcast::kBroadcastRecordMP4, info);
+            });
+        });
     });
 }
 
@@ -120,6 +123,23 @@ void MP4Recorder::inputFrame(const Frame::Ptr &frame) {
         createFile();
     }
 
+    if (_muxer && _muxer->isCongested()) {
+        //磁盘写入跟不上，丢帧而不是阻塞poller线程
+        if (!_wait_key_frame) {
+            WarnL << "mp4写文件积压过多，开始丢帧:" << _strFileTmp;
+            _wait_key_frame = true;
+        }
+        return;
+    }
+
+    if (_wait_key_frame) {
+        if (_haveVideo && !(frame->getTrackType() == TrackVideo && frame->keyFrame())) {
+            //等待视频关键帧
+            return;
+        }
+        _wait_key_frame = false;
+    }
+
     if (_muxer) {
         //生成mp4文件
         _muxer->inputFrame(frame);
@@ -57,6 +57,8 @@ private:
     void asyncClose();
 private:
     bool _haveVideo = false;
+    //异步写入积压过多时丢帧，恢复后等待关键帧
+    bool _wait_key_frame = false;
     size_t _max_second;
     string _strPath;
     string _strFile;
@@ -101,6 +101,7 @@ void TsMuxer::inputFrame(const Frame::Ptr &frame) {
                 track_info.stamp.revise(dts, pts, dts_out, pts_out);
                 //取视频时间戳为TS的时间戳
                 _timestamp = (uint32_t) dts_out;
+                _frame_dts = dts;
                 _is_idr_fast_packet = have_idr;
                 mpeg_ts_write(_context, track_info.track_id, have_idr ? 0x0001 : 0,
                               pts_out * 90LL, dts_out * 90LL, buffer->data(), buffer->size());
@@ -122,6 +123,7 @@ void TsMuxer::inputFrame(const Frame::Ptr &frame) {
                 //没有视频时，才以音频时间戳为TS的时间戳
                 _timestamp = (uint32_t) dts_out;
             }
+            _frame_dts = (uint32_t) frame->dts();
             mpeg_ts_write(_context, track_info.track_id, frame->keyFrame() ? 0x0001 : 0,
                           pts_out * 90LL, dts_out * 90LL, frame->data(), frame->size());
             flushCache();
@@ -51,6 +51,11 @@ protected:
      */
     virtual void onTs(std::shared_ptr<Buffer> buffer, uint32_t timestamp,bool is_idr_fast_packet) = 0;
 
+    /**
+     * 正在输出的帧修正前的dts，可在onTs回调中获取，用于与输入帧对应
+     */
+    uint32_t getFrameDts() const { return _frame_dts; }
+
 private:
     void init();
     void uninit();
@@ -65,6 +70,7 @@ private:
     void *_context = nullptr;
     char _tsbuf[188];
     uint32_t _timestamp = 0;
+    uint32_t _frame_dts = 0;
     struct track_info {
         int track_id = -1;
         Stamp stamp;
@@ -10,12 +10,58 @@
 
 #include "FlvMuxer.h"
 #include "Util/File.h"
+#include "Common/config.h"
 #include "Rtmp/utils.h"
+#include "Http/WebSocketSplitter.h"
 
 #define FILE_BUF_SIZE (64 * 1024)
+//websocket帧头最大长度
+#define WS_HEADER_MAX_SIZE 10
 
 namespace mediakit {
 
+FlvTagCache::Ptr FlvTagCache::get(const RtmpPacket::Ptr &pkt) {
+    auto ret = std::atomic_load(&pkt->flv_tag);
+    if (ret) {
+        return ret;
+    }
+
+    //websocket帧头、tag header、PreviousTagSize共用一块内存
+    RtmpTagHeader header;
+    header.type = pkt->type_id;
+    set_be24(header.data_size, (uint32_t) pkt->size());
+    header.timestamp_ex = (pkt->time_stamp >> 24) & 0xff;
+    set_be24(header.timestamp, pkt->time_stamp & 0xFFFFFF);
+    uint32_t size = htonl((uint32_t) (pkt->size() + sizeof(header)));
+
+    WebSocketHeader ws;
+    ws._fin = true;
+    ws._reserved = 0;
+    ws._opcode = WebSocketHeader::BINARY;
+    ws._mask_flag = false;
+    auto ws_header = WebSocketSplitter::encodeHeader(ws, sizeof(header) + pkt->size() + 4);
+
+    auto buffer = BufferRaw::create();
+    buffer->setCapacity(WS_HEADER_MAX_SIZE + sizeof(header) + 4);
+    auto ws_offset = WS_HEADER_MAX_SIZE - ws_header.size();
+    memcpy(buffer->data() + ws_offset, ws_header.data(), ws_header.size());
+    memcpy(buffer->data() + WS_HEADER_MAX_SIZE, &header, sizeof(header));
+    memcpy(buffer->data() + WS_HEADER_MAX_SIZE + sizeof(header), &size, 4);
+    buffer->setSize(WS_HEADER_MAX_SIZE + sizeof(header) + 4);
+
+    ret = std::make_shared<FlvTagCache>();
+    ret->header = std::make_shared<BufferOffset<Buffer::Ptr> >(buffer, WS_HEADER_MAX_SIZE, sizeof(header));
+    ret->ws_header = std::make_shared<BufferOffset<Buffer::Ptr> >(buffer, ws_offset, ws_header.size() + sizeof(header));
+    ret->tail = std::make_shared<BufferOffset<Buffer::Ptr> >(buffer, WS_HEADER_MAX_SIZE + sizeof(header), 4);
+
+    FlvTagCache::Ptr expected;
+    if (!std::atomic_compare_exchange_strong(&pkt->flv_tag, &expected, ret)) {
+        //其他线程已经生成
+        return expected;
+    }
+    return ret;
+}
+
 void FlvMuxer::start(const EventPoller::Ptr &poller, const RtmpMediaSource::Ptr &media) {
     if (!media) {
         throw std::runtime_error("RtmpMediaSource 无效");
@@ -47,7 +93,8 @@ void FlvMuxer::start(const EventPoller::Ptr &poller, const RtmpMediaSource::Ptr
 
     //音频同步于视频
     _stamp[0].syncTo(_stamp[1]);
-    _ring_reader->setReadCB([weakSelf](const RtmpMediaSource::RingDataType &pkt) {
+    weak_ptr<RtmpMediaSource> weak_src = media;
+    _ring_reader->setReadCB([weakSelf, weak_src](const RtmpMediaSource::RingDataType &pkt) {
         auto strongSelf = weakSelf.lock();
         if (!strongSelf) {
             return;
@@ -58,6 +105,15 @@ void FlvMuxer::start(const EventPoller::Ptr &poller, const RtmpMediaSource::Ptr
         pkt->for_each([&](const RtmpPacket::Ptr &rtmp) {
             strongSelf->onWriteRtmp(rtmp, ++i == size);
         });
+        if (auto ingest_stamp = pkt->back()->ingest_stamp) {
+            strongSelf->onWriteMark(ingest_stamp);
+        }
+        GET_CONFIG(bool, adaptive_merge, General::kAdaptiveMergeWrite);
+        auto src = adaptive_merge ? weak_src.lock() : nullptr;
+        if (src) {
+            //上报发送积压，用于自适应合并写
+            src->onReaderSendBacklog(strongSelf->getSendBacklog());
+        }
     });
 }
 
@@ -127,7 +183,33 @@ void FlvMuxer::onWriteFlvTag(uint8_t type, const Buffer::Ptr &buffer, uint32_t t
     onWrite(obtainBuffer((char *) &size, 4), flush);
 }
 
+void FlvMuxer::onWriteFlvTag(const RtmpPacket::Ptr &pkt, const FlvTagCache::Ptr &tag, bool flush) {
+    onWrite(tag->header, false);
+    onWrite(pkt, false);
+    onWrite(tag->tail, flush);
+}
+
 void FlvMuxer::onWriteRtmp(const RtmpPacket::Ptr &pkt, bool flush) {
+    if (pkt->type_id == MSG_VIDEO) {
+        _have_video = true;
+    }
+    if (isCongested()) {
+        //写入跟不上，丢帧而不是阻塞poller线程
+        _wait_key_frame = true;
+        return;
+    }
+    if (_wait_key_frame) {
+        if (_have_video && !pkt->isVideoKeyFrame()) {
+            //等待视频关键帧
+            return;
+        }
+        _wait_key_frame = false;
+    }
+    if (isShareFlvTag()) {
+        //所有播放器共享同一份序列化后的flv tag
+        onWriteFlvTag(pkt, FlvTagCache::get(pkt), flush);
+        return;
+    }
     int64_t dts_out;
     _stamp[pkt->type_id % 2].revise(pkt->time_stamp, 0, dts_out, dts_out);
     onWriteFlvTag(pkt, (uint32_t) dts_out, flush);
@@ -150,6 +232,16 @@ void FlvRecorder::startRecord(const EventPoller::Ptr &poller, const RtmpMediaSou
                               const string &file_path) {
     stop();
     lock_guard<recursive_mutex> lck(_file_mtx);
+    if (AsyncFileWriter::isEnabled()) {
+        //在后台异步写文件，不阻塞poller线程
+        auto writer = std::make_shared<AsyncFileWriter>();
+        if (!writer->open(file_path)) {
+            throw std::runtime_error(StrPrinter << "打开文件失败:" << file_path);
+        }
+        _writer = std::move(writer);
+        start(poller, media);
+        return;
+    }
     //开辟文件写缓存
     std::shared_ptr<char> fileBuf(new char[FILE_BUF_SIZE], [](char *ptr) {
         if (ptr) {
@@ -174,7 +266,9 @@ void FlvRecorder::startRecord(const EventPoller::Ptr &poller, const RtmpMediaSou
 
 void FlvRecorder::onWrite(const Buffer::Ptr &data, bool flush) {
     lock_guard<recursive_mutex> lck(_file_mtx);
-    if (_file) {
+    if (_writer) {
+        _writer->write(data->data(), data->size());
+    } else if (_file) {
         fwrite(data->data(), data->size(), 1, _file.get());
     }
 }
@@ -182,6 +276,15 @@ void FlvRecorder::onWrite(const Buffer::Ptr &data, bool flush) {
 void FlvRecorder::onDetach() {
     lock_guard<recursive_mutex> lck(_file_mtx);
     _file.reset();
+    if (_writer) {
+        _writer->close();
+        _writer = nullptr;
+    }
+}
+
+bool FlvRecorder::isCongested() {
+    lock_guard<recursive_mutex> lck(_file_mtx);
+    return _writer && _writer->isCongested();
 }
 
 std::shared_ptr<FlvMuxer> FlvRecorder::getSharedPtr() {
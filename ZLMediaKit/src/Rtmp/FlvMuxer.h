@@ -15,10 +15,32 @@
 #include "Rtmp/RtmpMediaSource.h"
 #include "Network/Socket.h"
 #include "Common/Stamp.h"
+#include "Record/AsyncFileWriter.h"
 using namespace toolkit;
 
 namespace mediakit {
 
+/**
+ * 序列化后的flv tag头尾，同一个rtmp包只生成一次，由所有http-flv/ws-flv播放器共享
+ * 完整的flv tag为: header + rtmp包负载 + tail，时间戳为rtmp包的原始时间戳
+ */
+class FlvTagCache {
+public:
+    using Ptr = std::shared_ptr<FlvTagCache>;
+
+    /**
+     * 获取rtmp包对应的flv tag头尾，不存在时生成，可以在任意线程调用
+     */
+    static Ptr get(const RtmpPacket::Ptr &pkt);
+
+    //tag header
+    Buffer::Ptr header;
+    //websocket帧头 + tag header，整个flv tag作为一个websocket二进制帧
+    Buffer::Ptr ws_header;
+    //PreviousTagSize
+    Buffer::Ptr tail;
+};
+
 class FlvMuxer {
 public:
     using Ptr = std::shared_ptr<FlvMuxer>;
@@ -32,6 +54,16 @@ protected:
     virtual void onWrite(const Buffer::Ptr &data, bool flush) = 0;
     virtual void onDetach() = 0;
     virtual std::shared_ptr<FlvMuxer> getSharedPtr() = 0;
+    //获取发送缓存中积压的数据包个数，用于自适应合并写
+    virtual size_t getSendBacklog() { return 0; }
+    //写入积压是否过多，此时丢帧直到下一个关键帧
+    virtual bool isCongested() { return false; }
+    //是否使用共享的flv tag，此时不再修整时间戳
+    virtual bool isShareFlvTag() { return false; }
+    //写入共享的flv tag
+    virtual void onWriteFlvTag(const RtmpPacket::Ptr &pkt, const FlvTagCache::Ptr &tag, bool flush);
+    //一批数据写入完毕，参数为其中最后一个rtmp包的入口时刻(微秒)，可用于统计端到端延时
+    virtual void onWriteMark(uint64_t ingest_stamp) {}
 
 private:
     void onWriteFlvHeader(const RtmpMediaSource::Ptr &src);
@@ -41,6 +73,8 @@ private:
     BufferRaw::Ptr obtainBuffer(const void *data, size_t len);
 
 private:
+    bool _have_video = false;
+    bool _wait_key_frame = false;
     //时间戳修整器
     Stamp _stamp[2];
     RtmpMediaSource::RingType::RingReader::Ptr _ring_reader;
@@ -50,7 +84,10 @@ class FlvRecorder : public FlvMuxer , public std::enable_shared_from_this<FlvRec
 public:
     using Ptr = std::shared_ptr<FlvRecorder>;
     FlvRecorder() = default;
-    ~FlvRecorder() override = default;
+    ~FlvRecorder() override {
+        //确保异步写入的数据落盘
+        onDetach();
+    }
 
     void startRecord(const EventPoller::Ptr &poller, const RtmpMediaSource::Ptr &media, const string &file_path);
     void startRecord(const EventPoller::Ptr &poller, const string &vhost, const string &app, const string &stream, const string &file_path);
@@ -59,9 +96,12 @@ private:
     virtual void onWrite(const Buffer::Ptr &data, bool flush) override ;
     virtual void onDetach() override;
     virtual std::shared_ptr<FlvMuxer> getSharedPtr() override;
+    bool isCongested() override;
 
 private:
     std::shared_ptr<FILE> _file;
+    //开启异步写文件时使用
+    AsyncFileWriter::Ptr _writer;
     recursive_mutex _file_mtx;
 };
 
@@ -171,6 +171,7 @@ public:
 #pragma pack(pop)
 #endif // defined(_WIN32)
 
+class FlvTagCache;
 class RtmpPacket : public Buffer{
 public:
     friend class RtmpProtocol;
@@ -183,6 +184,10 @@ public:
     uint32_t chunk_id;
     size_t body_size;
     BufferLikeString buffer;
+    //序列化后的flv tag头尾，由FlvTagCache::get在多个线程中生成与读取
+    std::shared_ptr<FlvTagCache> flv_tag;
+    //入口时刻，单位微秒，用于统计端到端延时，0代表未知
+    uint64_t ingest_stamp;
 
 public:
     static Ptr create();
@@ -200,6 +205,8 @@ public:
         ts_field = 0;
         body_size = 0;
         buffer.clear();
+        flv_tag = nullptr;
+        ingest_stamp = 0;
     }
 
     bool isVideoKeyFrame() const {
@@ -152,7 +152,8 @@ public:
 
             //GOP默认缓冲512组RTMP包，每组RTMP包时间戳相同(如果开启合并写了，那么每组为合并写时间内的RTMP包),
             //每次遇到关键帧第一个RTMP包，则会清空GOP缓存(因为有新的关键帧了，同样可以实现秒开)
-            _ring = std::make_shared<RingType>(_ring_size,std::move(lam));
+            GET_CONFIG(bool, lock_free_ring, General::kLockFreeRing);
+            _ring = std::make_shared<RingType>(_ring_size, std::move(lam), lock_free_ring);
             onReaderChanged(0);
 
             if(_metadata){
@@ -189,6 +190,20 @@ public:
         _ring->clearCache();
     }
 
+    /**
+     * 获取当前合并写窗口，单位毫秒
+     */
+    int getMergeWriteMS() const override {
+        return PacketCache<RtmpPacket>::getMergeWriteMS();
+    }
+
+    /**
+     * 获取每秒合并写刷新次数
+     */
+    int getFlushSpeed() override {
+        return PacketCache<RtmpPacket>::getFlushSpeed();
+    }
+
     bool haveVideo() const {
         return _have_video;
     }
@@ -208,6 +223,13 @@ private:
         _ring->write(std::move(rtmp_list), _have_video ? key_pos : true);
     }
 
+    /**
+     * 根据观看人数、观看者发送积压与码率调整合并写窗口
+     */
+    void onUpdatePolicy(FlushPolicy &policy) override {
+        policy.update(readerCount(), popReaderSendBacklog(), getBytesSpeed());
+    }
+
 private:
     bool _have_video = false;
     bool _have_audio = false;
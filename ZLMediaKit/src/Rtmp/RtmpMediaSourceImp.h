@@ -61,6 +61,8 @@ public:
      * 输入rtmp并解析
      */
     void onWrite(RtmpPacket::Ptr pkt, bool = true) override {
+        //直接转发的rtmp，入口时刻即为到达时刻，用于统计端到端延时
+        pkt->ingest_stamp = getCurrentMicrosecond();
         if (!_all_track_ready || _muxer->isEnabled()) {
             //未获取到所有Track后，或者开启转协议，那么需要解复用rtmp
             _demuxer->inputRtmp(pkt);
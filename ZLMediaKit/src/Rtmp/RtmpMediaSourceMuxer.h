@@ -13,6 +13,8 @@
 
 #include "RtmpMuxer.h"
 #include "Rtmp/RtmpMediaSource.h"
+#include "Common/StreamLatency.h"
+#include "Common/FrameGopCache.h"
 
 namespace mediakit {
 
@@ -26,7 +28,15 @@ public:
                          const string &strId,
                          const TitleMeta::Ptr &title = nullptr) : RtmpMuxer(title){
         _media_src = std::make_shared<RtmpMediaSource>(vhost, strApp, strId);
-        getRtmpRing()->setDelegate(_media_src);
+        getRtmpRing()->setDelegate(std::make_shared<RtmpRingDelegateHelper>([this](RtmpPacket::Ptr rtmp, bool is_key) {
+            if (_demand.dropOutput(is_key)) {
+                return;
+            }
+            if (_latency) {
+                rtmp->ingest_stamp = _latency->onMuxOutput(StreamLatency::ProtocolRtmp, rtmp->time_stamp);
+            }
+            _media_src->onWrite(std::move(rtmp), is_key);
+        }));
     }
 
     ~RtmpMediaSourceMuxer() override{}
@@ -36,6 +46,10 @@ public:
         _media_src->setListener(shared_from_this());
     }
 
+    void setLatency(const StreamLatency::Ptr &latency) {
+        _latency = latency;
+    }
+
     void setTimeStamp(uint32_t stamp){
         _media_src->setTimeStamp(stamp);
     }
@@ -51,34 +65,36 @@ public:
 
     void onReaderChanged(MediaSource &sender, int size) override {
         GET_CONFIG(bool, rtmp_demand, General::kRtmpDemand);
-        _enabled = rtmp_demand ? size : true;
-        if (!size && rtmp_demand) {
-            _clear_cache = true;
-        }
+        _demand.onReaderChanged(rtmp_demand, size);
         MediaSourceEventInterceptor::onReaderChanged(sender, size);
     }
 
     void inputFrame(const Frame::Ptr &frame) override {
         GET_CONFIG(bool, rtmp_demand, General::kRtmpDemand);
-        if (_clear_cache && rtmp_demand) {
-            _clear_cache = false;
+        if (_demand.popClearCache(rtmp_demand)) {
             _media_src->clearCache();
         }
-        if (_enabled || !rtmp_demand) {
+        if (_demand.needMux(rtmp_demand)) {
             RtmpMuxer::inputFrame(frame);
         }
     }
 
     bool isEnabled() {
         GET_CONFIG(bool, rtmp_demand, General::kRtmpDemand);
-        //缓存尚未清空时，还允许触发inputFrame函数，以便及时清空缓存
-        return rtmp_demand ? (_clear_cache ? true : _enabled) : true;
+        return _demand.isEnabled(rtmp_demand);
+    }
+
+    /**
+     * 是否需要先回放共享的gop缓存，调用后复位
+     */
+    bool popReplayGop(bool have_video) {
+        return _demand.popReplayGop(have_video);
     }
 
 private:
-    bool _enabled = true;
-    bool _clear_cache = false;
+    MuxerDemand _demand;
     RtmpMediaSource::Ptr _media_src;
+    StreamLatency::Ptr _latency;
 };
 
 
@@ -18,6 +18,22 @@
 
 namespace mediakit{
 
+class RtmpRingDelegateHelper : public RingDelegate<RtmpPacket::Ptr> {
+public:
+    typedef function<void(RtmpPacket::Ptr in, bool is_key)> onRtmp;
+
+    ~RtmpRingDelegateHelper() override{}
+    RtmpRingDelegateHelper(onRtmp on_rtmp){
+        _on_rtmp = std::move(on_rtmp);
+    }
+    void onWrite(RtmpPacket::Ptr in, bool is_key) override{
+        _on_rtmp(std::move(in), is_key);
+    }
+
+private:
+    onRtmp _on_rtmp;
+};
+
 class RtmpMuxer : public MediaSinkInterface{
 public:
     typedef std::shared_ptr<RtmpMuxer> Ptr;
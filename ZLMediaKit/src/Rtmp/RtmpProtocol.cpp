@@ -79,6 +79,7 @@ void RtmpProtocol::reset() {
     _map_chunk_data.clear();
     _now_stream_index = 0;
     _now_chunk_id = 0;
+    _max_body_size = 0;
     //////////Invoke Request//////////
     _send_req_id = 0;
     //////////Rtmp parser//////////
@@ -204,10 +205,10 @@ void RtmpProtocol::sendRtmp(uint8_t type, uint32_t stream_index, const Buffer::P
     //是否有扩展时间戳
     bool ext_stamp = stamp >= 0xFFFFFF;
 
-    //rtmp头
+    //rtmp头，扩展时间戳紧跟在rtmp头后，合并为一个buffer发送
     BufferRaw::Ptr buffer_header = obtainBuffer();
-    buffer_header->setCapacity(sizeof(RtmpHeader));
-    buffer_header->setSize(sizeof(RtmpHeader));
+    buffer_header->setCapacity(sizeof(RtmpHeader) + 4);
+    buffer_header->setSize(sizeof(RtmpHeader) + (ext_stamp ? 4 : 0));
     //对rtmp头赋值，如果使用整形赋值，在arm android上可能由于数据对齐导致总线错误的问题
     RtmpHeader *header = (RtmpHeader *) buffer_header->data();
     header->fmt = 0;
@@ -216,44 +217,45 @@ void RtmpProtocol::sendRtmp(uint8_t type, uint32_t stream_index, const Buffer::P
     set_be24(header->time_stamp, ext_stamp ? 0xFFFFFF : stamp);
     set_be24(header->body_size, (uint32_t)buf->size());
     set_le32(header->stream_index, stream_index);
-    //发送rtmp头
-    onSendRawData(std::move(buffer_header));
-
-    //扩展时间戳字段
-    BufferRaw::Ptr buffer_ext_stamp;
     if (ext_stamp) {
-        //生成扩展时间戳
-        buffer_ext_stamp = obtainBuffer();
-        buffer_ext_stamp->setCapacity(4);
-        buffer_ext_stamp->setSize(4);
-        set_be32(buffer_ext_stamp->data(), stamp);
+        set_be32(buffer_header->data() + sizeof(RtmpHeader), stamp);
     }
 
-    //生成一个字节的flag，标明是什么chunkId
-    BufferRaw::Ptr buffer_flags = obtainBuffer();
-    buffer_flags->setCapacity(1);
-    buffer_flags->setSize(1);
-    header = (RtmpHeader *) buffer_flags->data();
-    header->fmt = 3;
-    header->chunk_id = chunk_id;
+    //后续chunk的一个字节的flag(标明是什么chunkId)与扩展时间戳，所有后续chunk共用该buffer
+    BufferRaw::Ptr buffer_flags;
+    if (buf->size() > _chunk_size_out) {
+        buffer_flags = obtainBuffer();
+        buffer_flags->setCapacity(1 + 4);
+        buffer_flags->setSize(1 + (ext_stamp ? 4 : 0));
+        header = (RtmpHeader *) buffer_flags->data();
+        header->fmt = 3;
+        header->chunk_id = chunk_id;
+        if (ext_stamp) {
+            set_be32(buffer_flags->data() + 1, stamp);
+        }
+    }
 
+    //chunk头与负载分别作为独立的buffer发送，负载不拷贝，由writev一次性写入socket
     size_t offset = 0;
-    size_t totalSize = sizeof(RtmpHeader);
+    size_t totalSize = 0;
     while (offset < buf->size()) {
         if (offset) {
+            totalSize += buffer_flags->size();
             onSendRawData(buffer_flags);
-            totalSize += 1;
-        }
-        if (ext_stamp) {
-            //扩展时间戳
-            onSendRawData(buffer_ext_stamp);
-            totalSize += 4;
+        } else {
+            totalSize += buffer_header->size();
+            onSendRawData(std::move(buffer_header));
         }
         size_t chunk = min(_chunk_size_out, buf->size() - offset);
         onSendRawData(std::make_shared<BufferPartial>(buf, offset, chunk));
         totalSize += chunk;
         offset += chunk;
     }
+    if (buffer_header) {
+        //空的消息体，只发送rtmp头
+        totalSize += buffer_header->size();
+        onSendRawData(std::move(buffer_header));
+    }
     _bytes_sent += (uint32_t)totalSize;
     if (_windows_size > 0 && _bytes_sent - _bytes_sent_last >= _windows_size) {
         _bytes_sent_last = _bytes_sent;
@@ -529,6 +531,7 @@ const char* RtmpProtocol::handle_C2(const char *data, size_t len) {
 static constexpr size_t HEADER_LENGTH[] = {12, 8, 4, 1};
 
 const char* RtmpProtocol::handle_rtmp(const char *data, size_t len) {
+    GET_CONFIG(bool, reserve_body, Rtmp::kReserveChunkBody);
     auto ptr = data;
     while (len) {
         size_t offset = 0;
@@ -614,6 +617,10 @@ const char* RtmpProtocol::handle_rtmp(const char *data, size_t len) {
             return ptr;
         }
         if (more) {
+            if (chunk_data.buffer.empty() && chunk_data.body_size > more && reserve_body) {
+                //消息的首个chunk，按bodySize一次性预留内存，避免后续chunk逐个追加时反复扩容拷贝
+                chunk_data.buffer.reserve(getReserveSize(chunk_data.body_size));
+            }
             chunk_data.buffer.append(ptr + header_len + offset, more);
         }
         ptr += header_len + offset + more;
@@ -622,6 +629,7 @@ const char* RtmpProtocol::handle_rtmp(const char *data, size_t len) {
             //frame is ready
             _now_stream_index = chunk_data.stream_index;
             chunk_data.time_stamp = time_stamp + (chunk_data.is_abs_stamp ? 0 : chunk_data.time_stamp);
+            _max_body_size = MAX(_max_body_size, chunk_data.body_size);
             //保存chunk上下文
             last_packet = now_packet;
             if (chunk_data.body_size) {
@@ -634,6 +642,13 @@ const char* RtmpProtocol::handle_rtmp(const char *data, size_t len) {
     return ptr;
 }
 
+size_t RtmpProtocol::getReserveSize(size_t body_size) const {
+    //bodySize最大可达16MB，为防止恶意的bodySize耗尽内存，最多按本连接已收到的最大消息的2倍预留，
+    //超过部分仍然按需扩容
+    static constexpr size_t kMinReserveSize = 64 * 1024;
+    return MIN(body_size, MAX(kMinReserveSize, _max_body_size * 2));
+}
+
 void RtmpProtocol::handle_chunk(RtmpPacket::Ptr packet) {
     auto &chunk_data = *packet;
     switch (chunk_data.type_id) {
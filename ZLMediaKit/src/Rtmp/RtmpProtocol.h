@@ -84,6 +84,7 @@ private:
     const char* handle_C2(const char *data, size_t len);
     const char* handle_rtmp(const char *data, size_t len);
     void handle_chunk(RtmpPacket::Ptr chunk_data);
+    size_t getReserveSize(size_t body_size) const;
 
 protected:
     int _send_req_id = 0;
@@ -106,6 +107,8 @@ private:
     //////////Rtmp parser//////////
     function<const char * (const char *data, size_t len)> _next_step_func;
     ////////////Chunk////////////
+    //本连接已收到的最大消息长度，用于限制chunk重组时预留的内存
+    size_t _max_body_size = 0;
     unordered_map<int, std::pair<RtmpPacket::Ptr/*now*/, RtmpPacket::Ptr/*last*/> > _map_chunk_data;
 };
 
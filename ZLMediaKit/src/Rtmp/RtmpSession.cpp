@@ -10,6 +10,7 @@
 
 #include "RtmpSession.h"
 #include "Common/config.h"
+#include "Common/StreamLatency.h"
 #include "Util/onceToken.h"
 namespace mediakit {
 
@@ -42,24 +43,28 @@ void RtmpSession::onError(const SockException& err) {
 }
 
 void RtmpSession::onManager() {
+    //空闲超时由时间轮管理，见attachServer与onTimeout
+}
+
+void RtmpSession::attachServer(const Server &server) {
     GET_CONFIG(uint32_t,handshake_sec,Rtmp::kHandshakeSecond);
-    GET_CONFIG(uint32_t,keep_alive_sec,Rtmp::kKeepAliveSecond);
+    //握手完成前按握手超时计时，开始推流或播放后改为按心跳超时计时
+    setTimeout(handshake_sec * 1000);
+}
 
-    if (_ticker.createdTime() > handshake_sec * 1000) {
-        if (!_ring_reader && !_publisher_src) {
-            shutdown(SockException(Err_timeout,"illegal connection"));
-        }
-    }
+void RtmpSession::onTimeout() {
     if (_publisher_src) {
         //publisher
-        if (_ticker.elapsedTime() > keep_alive_sec * 1000) {
-            shutdown(SockException(Err_timeout,"recv data from rtmp pusher timeout"));
-        }
+        shutdown(SockException(Err_timeout,"recv data from rtmp pusher timeout"));
+        return;
+    }
+    if (!_ring_reader) {
+        shutdown(SockException(Err_timeout,"illegal connection"));
     }
+    //播放器不因空闲断开
 }
 
 void RtmpSession::onRecv(const Buffer::Ptr &buf) {
-    _ticker.resetTime();
     try {
         _total_bytes += buf->size();
         onParseRtmp(buf->data(), buf->size());
@@ -151,6 +156,8 @@ void RtmpSession::onCmd_publish(AMFDecoder &dec) {
         //设置转协议
         _publisher_src->setProtocolTranslation(enableHls, enableMP4);
         setSocketFlags();
+        GET_CONFIG(uint32_t,keep_alive_sec,Rtmp::kKeepAliveSecond);
+        setTimeout(keep_alive_sec * 1000);
     };
 
     if(_media_info._app.empty() || _media_info._streamid.empty()){
@@ -269,8 +276,12 @@ void RtmpSession::sendPlayResponse(const string &err,const RtmpMediaSource::Ptr
     //音频同步于视频
     _stamp[0].syncTo(_stamp[1]);
     _ring_reader = src->getRing()->attach(getPoller());
+    GET_CONFIG(uint32_t,keep_alive_sec,Rtmp::kKeepAliveSecond);
+    setTimeout(keep_alive_sec * 1000);
+    StreamLatency::attachSocket(getSock(), src->getVhost(), src->getApp(), src->getId(), StreamLatency::ProtocolRtmp);
     weak_ptr<RtmpSession> weakSelf = dynamic_pointer_cast<RtmpSession>(shared_from_this());
-    _ring_reader->setReadCB([weakSelf](const RtmpMediaSource::RingDataType &pkt) {
+    weak_ptr<RtmpMediaSource> weak_src = src;
+    _ring_reader->setReadCB([weakSelf, weak_src](const RtmpMediaSource::RingDataType &pkt) {
         auto strongSelf = weakSelf.lock();
         if (!strongSelf) {
             return;
@@ -287,6 +298,16 @@ void RtmpSession::sendPlayResponse(const string &err,const RtmpMediaSource::Ptr
             }
             strongSelf->onSendMedia(rtmp);
         });
+        if (auto ingest_stamp = pkt->back()->ingest_stamp) {
+            //本批数据全部写入socket时统计端到端延时
+            strongSelf->getSock()->addSendMark(ingest_stamp);
+        }
+        GET_CONFIG(bool, adaptive_merge, General::kAdaptiveMergeWrite);
+        auto src = adaptive_merge ? weak_src.lock() : nullptr;
+        if (src) {
+            //上报发送积压，用于自适应合并写
+            src->onReaderSendBacklog(strongSelf->getSock()->getSendBufferCount());
+        }
     });
     _ring_reader->setDetachCB([weakSelf]() {
         auto strongSelf = weakSelf.lock();
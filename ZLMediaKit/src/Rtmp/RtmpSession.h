@@ -36,6 +36,11 @@ public:
     void onRecv(const Buffer::Ptr &buf) override;
     void onError(const SockException &err) override;
     void onManager() override;
+    void attachServer(const Server &server) override;
+
+protected:
+    ////Session override////
+    void onTimeout() override;
 
 private:
     void onProcessCmd(AMFDecoder &dec);
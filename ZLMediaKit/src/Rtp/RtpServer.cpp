@@ -128,6 +128,13 @@ void RtpServer::start(uint16_t local_port, const string &stream_id,  bool enable
             helper->onRecvRtp(buf, addr, addr_len);
             process->inputRtp(true, rtp_socket, buf->data(), buf->size(), addr);
         });
+        //开启udp批量接收时，一次recvmmsg读到的多个rtp包通过一次回调处理
+        rtp_socket->setOnMultiRead([rtp_socket, process, helper](const BufferRaw::Ptr *buf, struct sockaddr *addr, size_t count) {
+            for (size_t i = 0; i < count; ++i) {
+                helper->onRecvRtp(buf[i], addr + i, sizeof(struct sockaddr));
+                process->inputRtp(true, rtp_socket, buf[i]->data(), buf[i]->size(), addr + i);
+            }
+        });
     } else {
 #if 1
         //单端口多线程接收多个流，根据ssrc区分流
@@ -148,6 +155,7 @@ void RtpServer::start(uint16_t local_port, const string &stream_id,  bool enable
         if (rtp_socket) {
             //去除循环引用
             rtp_socket->setOnRead(nullptr);
+            rtp_socket->setOnMultiRead(nullptr);
         }
         if (process) {
             //删除rtp处理器
@@ -29,6 +29,8 @@ void RtpSession::attachServer(const Server &server) {
     } else {
         _statistic_tcp = std::make_shared<ObjectStatistic<TcpSession> >();
     }
+    //未收到rtp前10秒没有数据视为非法连接，收到rtp后按rtp超时时间计时
+    setTimeout(10 * 1000);
 }
 
 RtpSession::RtpSession(const Socket::Ptr &sock) : Session(sock) {
@@ -63,13 +65,18 @@ void RtpSession::onError(const SockException &err) {
 }
 
 void RtpSession::onManager() {
-    if(_process && !_process->alive()){
-        shutdown(SockException(Err_timeout, "receive rtp timeout"));
-    }
+    //空闲超时由时间轮管理，见attachServer与onTimeout
+}
 
-    if(!_process && _ticker.createdTime() > 10 * 1000){
+void RtpSession::onTimeout() {
+    if (!_process) {
         shutdown(SockException(Err_timeout, "illegal connection"));
+        return;
+    }
+    if (!_process->alive()) {
+        shutdown(SockException(Err_timeout, "receive rtp timeout"));
     }
+    //暂停了rtp超时检测时继续计时
 }
 
 void RtpSession::onRtpPacket(const char *data, size_t len) {
@@ -101,6 +108,8 @@ void RtpSession::onRtpPacket(const char *data, size_t len) {
         //tcp情况下，一个tcp链接只可能是一路流，不需要通过多个ssrc来区分，所以不需要频繁getProcess
         _process = RtpSelector::Instance().getProcess(_stream_id, true);
         _process->setListener(dynamic_pointer_cast<RtpSession>(shared_from_this()));
+        GET_CONFIG(uint64_t, timeout_sec, RtpProxy::kTimeoutSec);
+        setTimeout(timeout_sec * 1000);
     }
     try {
         _process->inputRtp(false, getSock(), data, len, &_addr);
@@ -114,7 +123,6 @@ void RtpSession::onRtpPacket(const char *data, size_t len) {
     } catch (...) {
         throw;
     }
-    _ticker.resetTime();
 }
 
 bool RtpSession::close(MediaSource &sender, bool force) {
@@ -33,6 +33,8 @@ public:
     void attachServer(const Server &server) override;
 
 protected:
+    // 空闲超时
+    void onTimeout() override;
     // 通知其停止推流
     bool close(MediaSource &sender,bool force) override;
     // 观看总人数
@@ -47,7 +49,6 @@ private:
     bool _search_rtp = false;
     bool _search_rtp_finished = false;
     uint32_t _ssrc = 0;
-    Ticker _ticker;
     string _stream_id;
     struct sockaddr _addr;
     RtpProcess::Ptr _process;
@@ -12,23 +12,52 @@
 
 namespace mediakit{
 
+//负载小于该值时直接拷贝，此时拷贝开销比分散聚集发送的开销更小
+#define RTP_PAYLOAD_REF_MIN_SIZE 128
+
 RtpPacket::Ptr RtpInfo::makeRtp(TrackType type, const void* data, size_t len, bool mark, uint32_t stamp) {
-    uint16_t payload_len = (uint16_t) (len + RtpPacket::kRtpHeaderSize);
     auto rtp = RtpPacket::create();
-    rtp->setCapacity(payload_len + RtpPacket::kRtpTcpHeaderSize);
-    rtp->setSize(payload_len + RtpPacket::kRtpTcpHeaderSize);
-    rtp->sample_rate = _sample_rate;
-    rtp->type = type;
+    setupRtp(*rtp, type, len, len, mark, stamp);
+    //有效负载
+    if (data) {
+        memcpy(rtp->getPayload(), data, len);
+    }
+    return rtp;
+}
+
+RtpPacket::Ptr RtpInfo::makeRtp(TrackType type, const void *head, size_t head_len, const Buffer::Ptr &holder,
+                                const char *data, size_t len, bool mark, uint32_t stamp) {
+    if (len < RTP_PAYLOAD_REF_MIN_SIZE) {
+        auto rtp = makeRtp(type, nullptr, head_len + len, mark, stamp);
+        auto payload = rtp->getPayload();
+        memcpy(payload, head, head_len);
+        memcpy(payload + head_len, data, len);
+        return rtp;
+    }
+    //本对象内存只存放负载头，负载数据直接引用帧
+    auto rtp = RtpPacket::createRef();
+    setupRtp(*rtp, type, head_len, head_len + len, mark, stamp);
+    memcpy(rtp->getPayload(), head, head_len);
+    rtp->setPayloadRef(holder, data, len);
+    return rtp;
+}
+
+void RtpInfo::setupRtp(RtpPacket &rtp, TrackType type, size_t len, size_t rtp_len, bool mark, uint32_t stamp) {
+    uint16_t payload_len = (uint16_t) (rtp_len + RtpPacket::kRtpHeaderSize);
+    rtp.setCapacity(len + RtpPacket::kRtpHeaderSize + RtpPacket::kRtpTcpHeaderSize);
+    rtp.setSize(len + RtpPacket::kRtpHeaderSize + RtpPacket::kRtpTcpHeaderSize);
+    rtp.sample_rate = _sample_rate;
+    rtp.type = type;
 
     //rtsp over tcp 头
-    auto ptr = (uint8_t *) rtp->data();
+    auto ptr = (uint8_t *) rtp.data();
     ptr[0] = '$';
     ptr[1] = _interleaved;
     ptr[2] = payload_len >> 8;
     ptr[3] = payload_len & 0xFF;
 
     //rtp头
-    auto header = rtp->getHeader();
+    auto header = rtp.getHeader();
     header->version = RtpPacket::kRtpVersion;
     header->padding = 0;
     header->ext = 0;
@@ -38,12 +67,6 @@ RtpPacket::Ptr RtpInfo::makeRtp(TrackType type, const void* data, size_t len, bo
     header->seq = htons(_seq++);
     header->stamp = htonl(uint64_t(stamp) * _sample_rate / 1000);
     header->ssrc = htonl(_ssrc);
-
-    //有效负载
-    if (data) {
-        memcpy(&ptr[RtpPacket::kRtpHeaderSize + RtpPacket::kRtpTcpHeaderSize], data, len);
-    }
-    return rtp;
 }
 
 }//namespace mediakit
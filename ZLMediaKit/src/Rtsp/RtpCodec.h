@@ -86,6 +86,20 @@ public:
 
     RtpPacket::Ptr makeRtp(TrackType type,const void *data, size_t len, bool mark, uint32_t stamp);
 
+    /**
+     * 生成负载引用帧数据的rtp包，免去负载拷贝
+     * @param head 负载头(例如FU-A的2个字节)，会拷贝至rtp包
+     * @param head_len 负载头长度
+     * @param holder 负载数据所属对象，rtp包持有其引用
+     * @param data 负载数据，位于holder内
+     * @param len 负载数据长度
+     */
+    RtpPacket::Ptr makeRtp(TrackType type, const void *head, size_t head_len, const Buffer::Ptr &holder,
+                           const char *data, size_t len, bool mark, uint32_t stamp);
+
+private:
+    void setupRtp(RtpPacket &rtp, TrackType type, size_t len, size_t rtp_len, bool mark, uint32_t stamp);
+
 private:
     uint8_t _pt;
     uint8_t _interleaved;
@@ -12,8 +12,11 @@
 #define ZLMEDIAKIT_RTPRECEIVER_H
 
 #include <map>
+#include <limits>
 #include <string>
+#include <vector>
 #include <memory>
+#include <type_traits>
 #include "RtpCodec.h"
 #include "RtspMediaSource.h"
 #include "Common/Stamp.h"
@@ -22,9 +25,18 @@ using namespace toolkit;
 
 namespace mediakit {
 
+/**
+ * rtp包排序器，排序缓存为以seq为下标的环形数组，seq连续的包不经过缓存直接输出
+ * 排序窗口为[下个输出seq, 下个输出seq + 2 * kMax)，seq按模运算比较，天然支持回环
+ * 缓存包个数超过最大排序长度(kMin ~ kMax，随缓存长度自适应)时，跳过丢失的包继续输出
+ */
 template<typename T, typename SEQ = uint16_t, size_t kMax = 1024, size_t kMin = 32>
 class PacketSortor {
 public:
+    static_assert(std::is_unsigned<SEQ>::value, "SEQ must be unsigned");
+    static_assert(kMax && !(kMax & (kMax - 1)) && kMin < kMax, "kMax must be power of 2 and greater than kMin");
+    static_assert((std::numeric_limits<SEQ>::max)() / 4 >= kMax, "SEQ range is too small");
+
     PacketSortor() = default;
     ~PacketSortor() = default;
 
@@ -36,17 +48,23 @@ public:
      * 清空状态
      */
     void clear() {
-        _seq_cycle_count = 0;
-        _pkt_sort_cache_map.clear();
+        _started = false;
+        _output = false;
         _next_seq_out = 0;
+        _last_seq_out = 0;
+        _seq_cycle_count = 0;
         _max_sort_size = kMin;
+        _size = 0;
+        _pkt_sort_cache.clear();
+        _pkt_cache_flag.clear();
+        dropJump();
     }
 
     /**
      * 获取排序缓存长度
      */
     size_t getJitterSize() const{
-        return _pkt_sort_cache_map.size();
+        return _size;
     }
 
     /**
@@ -62,101 +80,196 @@ public:
      * @param packet 包负载
      */
     void sortPacket(SEQ seq, T packet) {
-        if (seq < _next_seq_out) {
-            if (_next_seq_out < seq + kMax) {
-                //过滤seq回退包(回环包除外)
+        if (!_started) {
+            //刚开始时可能就是乱序的，预留kMin个包的回退空间，等缓存溢出时从最小的seq开始输出
+            _started = true;
+            _next_seq_out = seq - kMin;
+        }
+
+        SEQ diff = seq - _next_seq_out;
+        if (diff == 0) {
+            //正是下个要输出的包，直接输出，不经过排序缓存
+            dropJump();
+            outputPacket(seq, packet);
+            if (_size) {
+                popSorted();
+            }
+            setSortSize();
+            return;
+        }
+
+        if (diff < kWindow) {
+            //在排序窗口内，放入排序缓存
+            dropJump();
+            if (!cachePacket(seq, diff, packet)) {
+                //重复包
                 return;
             }
-        } else if (_next_seq_out && seq - _next_seq_out > ((std::numeric_limits<SEQ>::max)() >> 1)) {
-            //过滤seq跳变非常大的包(防止回环时乱序时收到非常大的seq)
+            if (_size > _max_sort_size) {
+                //排序缓存溢出，不再等待丢失的包
+                popFirst();
+                popSorted();
+                setSortSize();
+            }
             return;
         }
 
-        //放入排序缓存
-        _pkt_sort_cache_map.emplace(seq, std::move(packet));
-        //尝试输出排序后的包
-        tryPopPacket();
+        if ((SEQ) (_next_seq_out - seq) <= kWindow) {
+            //过滤seq回退包(已经输出过或者已经放弃等待)
+            return;
+        }
+
+        //seq远离排序窗口，可能是推流端重启或者大量丢包，也可能只是个异常包
+        onJump(seq, std::move(packet));
     }
 
     void flush(){
         //清空缓存
-        while (!_pkt_sort_cache_map.empty()) {
-            popIterator(_pkt_sort_cache_map.begin());
-        }
+        flush_l();
+        dropJump();
     }
 
 private:
-    void popPacket() {
-        auto it = _pkt_sort_cache_map.begin();
-        if (it->first >= _next_seq_out) {
-            //过滤回跳包
-            popIterator(it);
+    //排序窗口长度
+    static constexpr size_t kWindow = kMax * 2;
+
+    void onJump(SEQ seq, T packet) {
+        if (!_has_jump || ((SEQ) (seq - _jump_seq) >= kWindow && (SEQ) (_jump_seq - seq) >= kWindow)) {
+            //先缓存，如果后续的包都回到排序窗口内，说明这只是个异常包，将被丢弃
+            _has_jump = true;
+            _jump_seq = seq;
+            _jump_pkt = std::move(packet);
             return;
         }
 
-        if (_next_seq_out - it->first > (0xFFFF >> 1)) {
-            //产生回环了
-            if (_pkt_sort_cache_map.size() < 2 * kMin) {
-                //等足够多的数据后才处理回环, 因为后面还可能出现大的SEQ
-                return;
-            }
-            ++_seq_cycle_count;
-            //找到大的SEQ并清空掉，然后从小的SEQ重新开始排序
-            auto hit = _pkt_sort_cache_map.upper_bound((SEQ) (_next_seq_out - _pkt_sort_cache_map.size()));
-            while (hit != _pkt_sort_cache_map.end()) {
-                //回环前，清空剩余的大的SEQ的数据
-                _cb(hit->first, hit->second);
-                hit = _pkt_sort_cache_map.erase(hit);
+        //连续收到两个相近的窗口外的包，认为seq发生了跳变，输出完缓存后从新的位置重新开始排序
+        flush_l();
+        auto first_seq = _jump_seq;
+        auto first_pkt = std::move(_jump_pkt);
+        dropJump();
+        if ((SEQ) (seq - first_seq) >= kWindow) {
+            std::swap(first_seq, seq);
+            std::swap(first_pkt, packet);
+        }
+        _next_seq_out = first_seq;
+        sortPacket(first_seq, std::move(first_pkt));
+        sortPacket(seq, std::move(packet));
+    }
+
+    void flush_l() {
+        while (_size) {
+            popFirst();
+            popSorted();
+        }
+    }
+
+    void dropJump() {
+        if (_has_jump) {
+            _has_jump = false;
+            _jump_pkt = T();
+        }
+    }
+
+    bool cachePacket(SEQ seq, SEQ diff, T &packet) {
+        if (diff >= _pkt_sort_cache.size()) {
+            //环形数组按需扩容，没有乱序的流不占用排序缓存内存
+            growCache(diff);
+        }
+        auto index = seq & (_pkt_sort_cache.size() - 1);
+        if (_pkt_cache_flag[index]) {
+            return false;
+        }
+        _pkt_sort_cache[index] = std::move(packet);
+        _pkt_cache_flag[index] = 1;
+        ++_size;
+        return true;
+    }
+
+    void growCache(SEQ diff) {
+        auto capacity = std::max<size_t>(_pkt_sort_cache.size(), kMin);
+        while (capacity <= diff) {
+            capacity <<= 1;
+        }
+        vector<T> cache(capacity);
+        vector<uint8_t> flag(capacity, 0);
+        auto old_size = _pkt_sort_cache.size();
+        for (size_t i = 0; i < old_size; ++i) {
+            if (!_pkt_cache_flag[i]) {
+                continue;
             }
-            //下一个回环的数据
-            popIterator(_pkt_sort_cache_map.begin());
-            return;
+            //根据在窗口中的位置还原seq
+            SEQ seq = _next_seq_out + ((i - _next_seq_out) & (old_size - 1));
+            auto index = seq & (capacity - 1);
+            cache[index] = std::move(_pkt_sort_cache[i]);
+            flag[index] = 1;
         }
-        //删除回跳的数据包
-        _pkt_sort_cache_map.erase(it);
+        _pkt_sort_cache.swap(cache);
+        _pkt_cache_flag.swap(flag);
     }
 
-    void popIterator(typename map<SEQ, T>::iterator it) {
-        auto seq = it->first;
-        auto data = std::move(it->second);
-        _pkt_sort_cache_map.erase(it);
-        _next_seq_out = seq + 1;
-        _cb(seq, data);
+    //跳过丢失的包，移动到缓存中最小的seq
+    void popFirst() {
+        auto mask = _pkt_sort_cache.size() - 1;
+        while (!_pkt_cache_flag[_next_seq_out & mask]) {
+            ++_next_seq_out;
+        }
     }
 
-    void tryPopPacket() {
-        int count = 0;
-        while ((!_pkt_sort_cache_map.empty() && _pkt_sort_cache_map.begin()->first == _next_seq_out)) {
-            //找到下个包，直接输出
-            popPacket();
-            ++count;
+    //输出缓存中seq连续的包
+    void popSorted() {
+        auto mask = _pkt_sort_cache.size() - 1;
+        while (_size) {
+            auto index = _next_seq_out & mask;
+            if (!_pkt_cache_flag[index]) {
+                break;
+            }
+            _pkt_cache_flag[index] = 0;
+            --_size;
+            auto packet = std::move(_pkt_sort_cache[index]);
+            outputPacket(_next_seq_out, packet);
         }
+    }
 
-        if (count) {
-            setSortSize();
-        } else if (_pkt_sort_cache_map.size() > _max_sort_size) {
-            //排序缓存溢出，不再继续排序
-            popPacket();
-            setSortSize();
+    void outputPacket(SEQ seq, T &packet) {
+        if (_output && seq < _last_seq_out) {
+            //seq变小，产生回环了
+            ++_seq_cycle_count;
         }
+        _output = true;
+        _last_seq_out = seq;
+        _next_seq_out = seq + 1;
+        _cb(seq, packet);
     }
 
     void setSortSize() {
-        _max_sort_size = kMin + _pkt_sort_cache_map.size();
+        _max_sort_size = kMin + _size;
         if (_max_sort_size > kMax) {
             _max_sort_size = kMax;
         }
     }
 
 private:
+    //是否收到过包
+    bool _started = false;
+    //是否输出过包
+    bool _output = false;
     //下次应该输出的SEQ
     SEQ _next_seq_out = 0;
+    //上次输出的SEQ
+    SEQ _last_seq_out = 0;
     //seq回环次数计数
     size_t _seq_cycle_count = 0;
     //排序缓存长度
     size_t _max_sort_size = kMin;
-    //pkt排序缓存，根据seq排序
-    map<SEQ, T> _pkt_sort_cache_map;
+    //排序缓存中的包个数
+    size_t _size = 0;
+    //pkt排序缓存，下标为seq % 数组长度，数组长度为2的幂
+    vector<T> _pkt_sort_cache;
+    vector<uint8_t> _pkt_cache_flag;
+    //排序窗口外的包，用于判断seq是否发生跳变
+    bool _has_jump = false;
+    SEQ _jump_seq = 0;
+    T _jump_pkt;
     //回调
     function<void(SEQ seq, T &packet)> _cb;
 };
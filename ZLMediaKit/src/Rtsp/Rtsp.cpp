@@ -546,12 +546,12 @@ string RtpHeader::dumpString(size_t rtp_size) const {
 ///////////////////////////////////////////////////////////////////////
 
 RtpHeader *RtpPacket::getHeader() {
-    //需除去rtcp over tcp 4个字节长度
-    return (RtpHeader *) (data() + RtpPacket::kRtpTcpHeaderSize);
+    //需除去rtcp over tcp 4个字节长度；rtp头总是位于本对象内存中
+    return (RtpHeader *) (BufferRaw::data() + RtpPacket::kRtpTcpHeaderSize);
 }
 
 const RtpHeader *RtpPacket::getHeader() const {
-    return (RtpHeader *) (data() + RtpPacket::kRtpTcpHeaderSize);
+    return (RtpHeader *) (BufferRaw::data() + RtpPacket::kRtpTcpHeaderSize);
 }
 
 string RtpPacket::dumpString() const {
@@ -575,6 +575,10 @@ uint32_t RtpPacket::getSSRC() const {
 }
 
 uint8_t *RtpPacket::getPayload() {
+    if (_payload_ref) {
+        //负载不连续，返回拼接后的内存
+        return ((RtpHeader *) (data() + RtpPacket::kRtpTcpHeaderSize))->getPayloadData();
+    }
     return getHeader()->getPayloadData();
 }
 
@@ -583,6 +587,61 @@ size_t RtpPacket::getPayloadSize() const {
     return getHeader()->getPayloadSize(size() - kRtpTcpHeaderSize);
 }
 
+void RtpPacket::setPayloadRef(Buffer::Ptr holder, const char *ptr, size_t len) {
+    _payload_ref = std::move(holder);
+    _payload_ref_ptr = ptr;
+    _payload_ref_size = len;
+    _flat = nullptr;
+}
+
+char *RtpPacket::data() const {
+    if (!_payload_ref) {
+        return BufferRaw::data();
+    }
+    auto flat = std::atomic_load(&_flat);
+    if (!flat) {
+        //rtp包可能同时被多个线程读取，拼接结果通过原子操作发布，重复拼接者丢弃自己的结果
+        auto head_size = BufferRaw::size();
+        auto buffer = BufferRaw::create();
+        buffer->setCapacity(head_size + _payload_ref_size + 1);
+        buffer->setSize(head_size + _payload_ref_size);
+        memcpy(buffer->data(), BufferRaw::data(), head_size);
+        memcpy(buffer->data() + head_size, _payload_ref_ptr, _payload_ref_size);
+        if (std::atomic_compare_exchange_strong(&_flat, &flat, buffer)) {
+            flat = std::move(buffer);
+        }
+    }
+    return flat->data();
+}
+
+size_t RtpPacket::size() const {
+    return BufferRaw::size() + _payload_ref_size;
+}
+
+size_t RtpPacket::getIovec(struct iovec *iov) const {
+    iov[0].iov_base = BufferRaw::data();
+    iov[0].iov_len = (decltype(iov[0].iov_len)) BufferRaw::size();
+    if (!_payload_ref) {
+        return 1;
+    }
+    iov[1].iov_base = (char *) _payload_ref_ptr;
+    iov[1].iov_len = (decltype(iov[1].iov_len)) _payload_ref_size;
+    return 2;
+}
+
+RtpPacket::Ptr RtpPacket::createRef() {
+    static ResourcePool<RtpPacket> packet_pool;
+    static onceToken token([]() {
+        packet_pool.setSize(1024);
+    });
+    return packet_pool.obtain([](RtpPacket *packet) {
+        //回收时立即释放外部内存引用
+        packet->setPayloadRef(nullptr, nullptr, 0);
+        packet->setSize(0);
+        packet->ingest_stamp = 0;
+    });
+}
+
 RtpPacket::Ptr RtpPacket::create() {
 #if 0
     static ResourcePool<RtpPacket> packet_pool;
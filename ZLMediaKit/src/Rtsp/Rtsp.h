@@ -171,20 +171,50 @@ public:
     //有效负载长度，不包括csrc、ext、padding
     size_t getPayloadSize() const;
 
+    /**
+     * 引用外部内存作为rtp负载的尾部，免去打包时的内存拷贝
+     * 此时本对象内存只存放rtp over tcp头、rtp头以及负载头(例如FU-A头)，发送时通过getIovec分散聚集发送
+     * @param holder 外部内存所属对象(一般为帧)，rtp包销毁前持有其引用
+     * @param ptr 负载尾部数据指针
+     * @param len 负载尾部长度
+     */
+    void setPayloadRef(Buffer::Ptr holder, const char *ptr, size_t len);
+
+    /**
+     * rtp over tcp头 + rtp包的连续内存
+     * 负载引用外部内存时，首次调用会拼接拷贝一次，所以发送时请使用getIovec
+     */
+    char *data() const override;
+    size_t size() const override;
+    size_t getIovec(struct iovec *iov) const override;
+
     //音视频类型
     TrackType type;
     //音频为采样率，视频一般为90000
     uint32_t sample_rate;
     //ntp时间戳
     uint64_t ntp_stamp;
+    //入口时刻，单位微秒，用于统计端到端延时，0代表未知
+    uint64_t ingest_stamp = 0;
 
     static Ptr create();
 
+    /**
+     * 创建负载引用外部内存的rtp包，其内存只存放各种头部，所以循环使用
+     */
+    static Ptr createRef();
+
 private:
     friend class ResourcePool_l<RtpPacket>;
     RtpPacket() = default;
 
 private:
+    //负载尾部引用的外部内存
+    Buffer::Ptr _payload_ref;
+    const char *_payload_ref_ptr = nullptr;
+    size_t _payload_ref_size = 0;
+    //负载引用外部内存时，拼接后的连续内存
+    mutable BufferRaw::Ptr _flat;
     //对象个数统计
     ObjectStatistic<RtpPacket> _statistic;
 };
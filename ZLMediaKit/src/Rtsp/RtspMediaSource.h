@@ -177,7 +177,8 @@ public:
             };
             //GOP默认缓冲512组RTP包，每组RTP包时间戳相同(如果开启合并写了，那么每组为合并写时间内的RTP包),
             //每次遇到关键帧第一个RTP包，则会清空GOP缓存(因为有新的关键帧了，同样可以实现秒开)
-            _ring = std::make_shared<RingType>(_ring_size, std::move(lam));
+            GET_CONFIG(bool, lock_free_ring, General::kLockFreeRing);
+            _ring = std::make_shared<RingType>(_ring_size, std::move(lam), lock_free_ring);
             onReaderChanged(0);
             if (!_sdp.empty()) {
                 regist();
@@ -192,6 +193,20 @@ public:
         _ring->clearCache();
     }
 
+    /**
+     * 获取当前合并写窗口，单位毫秒
+     */
+    int getMergeWriteMS() const override {
+        return PacketCache<RtpPacket>::getMergeWriteMS();
+    }
+
+    /**
+     * 获取每秒合并写刷新次数
+     */
+    int getFlushSpeed() override {
+        return PacketCache<RtpPacket>::getFlushSpeed();
+    }
+
 private:
     /**
      * 批量flush rtp包时触发该函数
@@ -203,6 +218,13 @@ private:
         _ring->write(std::move(rtp_list), _have_video ? key_pos : true);
     }
 
+    /**
+     * 根据观看人数、观看者发送积压与码率调整合并写窗口
+     */
+    void onUpdatePolicy(FlushPolicy &policy) override {
+        policy.update(readerCount(), popReaderSendBacklog(), getBytesSpeed());
+    }
+
 private:
     bool _have_video = false;
     int _ring_size;
@@ -48,6 +48,8 @@ public:
      * 输入rtp并解析
      */
     void onWrite(RtpPacket::Ptr rtp, bool key_pos) override {
+        //直接转发的rtp，入口时刻即为到达时刻，用于统计端到端延时
+        rtp->ingest_stamp = getCurrentMicrosecond();
         if (_all_track_ready && !_muxer->isEnabled()) {
             //获取到所有Track后，并且未开启转协议，那么不需要解复用rtp
             //在关闭rtp解复用后，无法知道是否为关键帧，这样会导致无法秒开，或者开播花屏
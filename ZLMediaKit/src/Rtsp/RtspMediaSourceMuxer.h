@@ -13,6 +13,8 @@
 
 #include "RtspMuxer.h"
 #include "Rtsp/RtspMediaSource.h"
+#include "Common/StreamLatency.h"
+#include "Common/FrameGopCache.h"
 
 namespace mediakit {
 
@@ -26,7 +28,15 @@ public:
                          const string &strId,
                          const TitleSdp::Ptr &title = nullptr) : RtspMuxer(title){
         _media_src = std::make_shared<RtspMediaSource>(vhost,strApp,strId);
-        getRtpRing()->setDelegate(_media_src);
+        getRtpRing()->setDelegate(std::make_shared<RingDelegateHelper>([this](RtpPacket::Ptr rtp, bool is_key) {
+            if (_demand.dropOutput(is_key)) {
+                return;
+            }
+            if (_latency) {
+                rtp->ingest_stamp = _latency->onMuxOutputRtp(rtp->getStamp(), rtp->sample_rate);
+            }
+            _media_src->onWrite(std::move(rtp), is_key);
+        }));
     }
 
     ~RtspMediaSourceMuxer() override{}
@@ -36,6 +46,10 @@ public:
         _media_src->setListener(shared_from_this());
     }
 
+    void setLatency(const StreamLatency::Ptr &latency) {
+        _latency = latency;
+    }
+
     int readerCount() const{
         return _media_src->readerCount();
     }
@@ -50,34 +64,36 @@ public:
 
     void onReaderChanged(MediaSource &sender, int size) override {
         GET_CONFIG(bool, rtsp_demand, General::kRtspDemand);
-        _enabled = rtsp_demand ? size : true;
-        if (!size && rtsp_demand) {
-            _clear_cache = true;
-        }
+        _demand.onReaderChanged(rtsp_demand, size);
         MediaSourceEventInterceptor::onReaderChanged(sender, size);
     }
 
     void inputFrame(const Frame::Ptr &frame) override {
         GET_CONFIG(bool, rtsp_demand, General::kRtspDemand);
-        if (_clear_cache && rtsp_demand) {
-            _clear_cache = false;
+        if (_demand.popClearCache(rtsp_demand)) {
             _media_src->clearCache();
         }
-        if (_enabled || !rtsp_demand) {
+        if (_demand.needMux(rtsp_demand)) {
             RtspMuxer::inputFrame(frame);
         }
     }
 
     bool isEnabled() {
         GET_CONFIG(bool, rtsp_demand, General::kRtspDemand);
-        //缓存尚未清空时，还允许触发inputFrame函数，以便及时清空缓存
-        return rtsp_demand ? (_clear_cache ? true : _enabled) : true;
+        return _demand.isEnabled(rtsp_demand);
+    }
+
+    /**
+     * 是否需要先回放共享的gop缓存，调用后复位
+     */
+    bool popReplayGop(bool have_video) {
+        return _demand.popReplayGop(have_video);
     }
 
 private:
-    bool _enabled = true;
-    bool _clear_cache = false;
+    MuxerDemand _demand;
     RtspMediaSource::Ptr _media_src;
+    StreamLatency::Ptr _latency;
 };
 
 
@@ -11,6 +11,7 @@
 #include <atomic>
 #include <iomanip>
 #include "Common/config.h"
+#include "Common/StreamLatency.h"
 #include "UDPServer.h"
 #include "RtspSession.h"
 #include "Util/MD5.h"
@@ -89,30 +90,37 @@ void RtspSession::onError(const SockException &err) {
 }
 
 void RtspSession::onManager() {
+    //空闲超时由时间轮管理，见attachServer与onTimeout
+}
+
+void RtspSession::attachServer(const Server &server) {
     GET_CONFIG(uint32_t,handshake_sec,Rtsp::kHandshakeSecond);
-    GET_CONFIG(uint32_t,keep_alive_sec,Rtsp::kKeepAliveSecond);
+    //握手完成前按握手超时计时，开始推流或播放后改为按心跳超时计时
+    setTimeout(handshake_sec * 1000);
+}
 
-    if (_alive_ticker.createdTime() > handshake_sec * 1000) {
-        if (_sessionid.size() == 0) {
-            shutdown(SockException(Err_timeout,"illegal connection"));
-            return;
-        }
+void RtspSession::onTimeout() {
+    if (_sessionid.empty()) {
+        shutdown(SockException(Err_timeout,"illegal connection"));
+        return;
     }
 
-    if (_push_src && _alive_ticker.elapsedTime() > keep_alive_sec * 1000) {
+    if (_push_src) {
         //推流超时
         shutdown(SockException(Err_timeout, "pusher session timeout"));
         return;
     }
 
-    if (!_push_src && _rtp_type == Rtsp::RTP_UDP && _enable_send_rtp && _alive_ticker.elapsedTime() > keep_alive_sec * 4000) {
+    if (_rtp_type == Rtsp::RTP_UDP && _enable_send_rtp) {
         //rtp over udp播放器超时
         shutdown(SockException(Err_timeout, "rtp over udp player timeout"));
     }
+    //其他播放器不因空闲断开
 }
 
 void RtspSession::onRecv(const Buffer::Ptr &buf) {
-    _alive_ticker.resetTime();
+    //rtsp over http时数据由http poster转发而来，需要自行刷新空闲计时
+    resetTimeout();
     _bytes_usage += buf->size();
     if (_on_recv) {
         //http poster的请求数据转发给http getter处理
@@ -308,6 +316,8 @@ void RtspSession::handleReq_RECORD(const Parser &parser){
     }
     rtp_info.pop_back();
     sendRtspResponse("200 OK", {"RTP-Info", rtp_info});
+    GET_CONFIG(uint32_t,keep_alive_sec,Rtsp::kKeepAliveSecond);
+    setTimeout(keep_alive_sec * 1000);
     if (_rtp_type == Rtsp::RTP_TCP) {
         //如果是rtsp推流服务器，并且是TCP推流，设置socket flags,，这样能提升接收性能
         setSocketFlags();
@@ -823,9 +833,17 @@ void RtspSession::handleReq_Play(const Parser &parser) {
     _enable_send_rtp = true;
     play_src->pause(false);
 
+    //rtp over udp播放器通过rtcp保活，4倍心跳时间内没有收到任何数据则断开
+    GET_CONFIG(uint32_t,keep_alive_sec,Rtsp::kKeepAliveSecond);
+    setTimeout(keep_alive_sec * (_rtp_type == Rtsp::RTP_UDP ? 4000 : 1000));
+
     setSocketFlags();
 
     if (!_play_reader && _rtp_type != Rtsp::RTP_MULTICAST) {
+        if (_rtp_type == Rtsp::RTP_TCP) {
+            //统计rtp写入socket的耗时，udp方式的rtp不经过本socket
+            StreamLatency::attachSocket(getSock(), play_src->getVhost(), play_src->getApp(), play_src->getId(), StreamLatency::ProtocolRtsp);
+        }
         weak_ptr<RtspSession> weakSelf = dynamic_pointer_cast<RtspSession>(shared_from_this());
         _play_reader = play_src->getRing()->attach(getPoller(), useGOP);
         _play_reader->setDetachCB([weakSelf]() {
@@ -835,13 +853,20 @@ void RtspSession::handleReq_Play(const Parser &parser) {
             }
             strongSelf->shutdown(SockException(Err_shutdown, "rtsp ring buffer detached"));
         });
-        _play_reader->setReadCB([weakSelf](const RtspMediaSource::RingDataType &pack) {
+        weak_ptr<RtspMediaSource> weak_src = play_src;
+        _play_reader->setReadCB([weakSelf, weak_src](const RtspMediaSource::RingDataType &pack) {
             auto strongSelf = weakSelf.lock();
             if (!strongSelf) {
                 return;
             }
             if (strongSelf->_enable_send_rtp) {
                 strongSelf->sendRtpPacket(pack);
+                GET_CONFIG(bool, adaptive_merge, General::kAdaptiveMergeWrite);
+                auto src = adaptive_merge ? weak_src.lock() : nullptr;
+                if (src) {
+                    //上报发送积压，用于自适应合并写
+                    src->onReaderSendBacklog(strongSelf->getSock()->getSendBufferCount());
+                }
             }
         });
     }
@@ -939,7 +964,7 @@ void RtspSession::onRtpSorted(RtpPacket::Ptr rtp, int track_idx) {
 
 void RtspSession::onRcvPeerUdpData(int interleaved, const Buffer::Ptr &buf, const struct sockaddr &addr) {
     //这是rtcp心跳包，说明播放器还存活
-    _alive_ticker.resetTime();
+    resetTimeout();
 
     if (interleaved % 2 == 0) {
         if (_push_src) {
@@ -1187,6 +1212,10 @@ void RtspSession::sendRtpPacket(const RtspMediaSource::RingDataType &pkt) {
                 }
                 send(rtp);
             });
+            if (auto ingest_stamp = pkt->back()->ingest_stamp) {
+                //本批rtp全部写入socket时统计端到端延时
+                getSock()->addSendMark(ingest_stamp);
+            }
         }
             break;
         case Rtsp::RTP_UDP: {
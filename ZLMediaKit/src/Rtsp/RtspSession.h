@@ -49,6 +49,14 @@ public:
         return _rtp->size() - _offset;
     }
 
+    size_t getIovec(struct iovec *iov) const override {
+        //跳过的头部位于第一个内存片段内
+        auto count = _rtp->getIovec(iov);
+        iov[0].iov_base = (char *) iov[0].iov_base + _offset;
+        iov[0].iov_len -= _offset;
+        return count;
+    }
+
 private:
     size_t _offset;
     Buffer::Ptr _rtp;
@@ -68,8 +76,12 @@ public:
     void onRecv(const Buffer::Ptr &buf) override;
     void onError(const SockException &err) override;
     void onManager() override;
+    void attachServer(const Server &server) override;
 
 protected:
+    ////Session override////
+    void onTimeout() override;
+
     /////RtspSplitter override/////
     //收到完整的rtsp包回调，包括sdp等content数据
     void onWholeRtspPacket(Parser &parser) override;
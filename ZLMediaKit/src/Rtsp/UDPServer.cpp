@@ -38,6 +38,7 @@ Socket::Ptr UDPServer::getSock(SocketHelper &helper, const char* local_ip, int i
 
         sock->setOnErr(bind(&UDPServer::onErr, this, key, placeholders::_1));
         sock->setOnRead(bind(&UDPServer::onRecv, this, interleaved, placeholders::_1, placeholders::_2));
+        sock->setOnMultiRead(bind(&UDPServer::onMultiRecv, this, interleaved, placeholders::_1, placeholders::_2, placeholders::_3));
         _udp_sock_map[key] = sock;
         DebugL << local_ip << " " << sock->get_local_port() << " " << interleaved;
         return sock;
@@ -74,9 +75,21 @@ void UDPServer::onErr(const string &key, const SockException &err) {
 }
 
 void UDPServer::onRecv(int interleaved, const Buffer::Ptr &buf, struct sockaddr* peer_addr) {
+    lock_guard<mutex> lck(_mtx_on_recv);
+    onRecv_l(interleaved, buf, peer_addr);
+}
+
+void UDPServer::onMultiRecv(int interleaved, const BufferRaw::Ptr *buf, struct sockaddr *peer_addr, size_t count) {
+    //一批数据只加锁一次
+    lock_guard<mutex> lck(_mtx_on_recv);
+    for (size_t i = 0; i < count; ++i) {
+        onRecv_l(interleaved, buf[i], peer_addr + i);
+    }
+}
+
+void UDPServer::onRecv_l(int interleaved, const Buffer::Ptr &buf, struct sockaddr* peer_addr) {
     struct sockaddr_in *in = (struct sockaddr_in *) peer_addr;
     string peer_ip = SockUtil::inet_ntoa(in->sin_addr);
-    lock_guard<mutex> lck(_mtx_on_recv);
     auto it0 = _on_recv_map.find(peer_ip);
     if (it0 == _on_recv_map.end()) {
         return;
@@ -37,6 +37,8 @@ public:
 private:
     UDPServer();
     void onRecv(int interleaved, const Buffer::Ptr &buf, struct sockaddr *peer_addr);
+    void onMultiRecv(int interleaved, const BufferRaw::Ptr *buf, struct sockaddr *peer_addr, size_t count);
+    void onRecv_l(int interleaved, const Buffer::Ptr &buf, struct sockaddr *peer_addr);
     void onErr(const string &strKey,const SockException &err);
 
 private:
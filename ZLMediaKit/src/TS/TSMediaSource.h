@@ -28,6 +28,8 @@ public:
 
 public:
     uint32_t time_stamp = 0;
+    //入口时刻，单位微秒，用于统计端到端延时，0代表未知
+    uint64_t ingest_stamp = 0;
 };
 
 //TS直播源
@@ -83,16 +85,31 @@ public:
         _ring->clearCache();
     }
 
+    /**
+     * 获取当前合并写窗口，单位毫秒
+     */
+    int getMergeWriteMS() const override {
+        return PacketCache<TSPacket>::getMergeWriteMS();
+    }
+
+    /**
+     * 获取每秒合并写刷新次数
+     */
+    int getFlushSpeed() override {
+        return PacketCache<TSPacket>::getFlushSpeed();
+    }
+
 private:
     void createRing(){
         weak_ptr<TSMediaSource> weak_self = dynamic_pointer_cast<TSMediaSource>(shared_from_this());
+        GET_CONFIG(bool, lock_free_ring, General::kLockFreeRing);
         _ring = std::make_shared<RingType>(_ring_size, [weak_self](int size) {
             auto strong_self = weak_self.lock();
             if (!strong_self) {
                 return;
             }
             strong_self->onReaderChanged(size);
-        });
+        }, lock_free_ring);
         onReaderChanged(0);
         //注册媒体源
         regist();
@@ -108,6 +125,13 @@ private:
         _ring->write(std::move(packet_list), _have_video ? key_pos : true);
     }
 
+    /**
+     * 根据观看人数、观看者发送积压与码率调整合并写窗口
+     */
+    void onUpdatePolicy(FlushPolicy &policy) override {
+        policy.update(readerCount(), popReaderSendBacklog(), getBytesSpeed());
+    }
+
 private:
     bool _have_video = false;
     int _ring_size;
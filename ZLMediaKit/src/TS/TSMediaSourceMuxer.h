@@ -13,6 +13,8 @@
 
 #include "TSMediaSource.h"
 #include "Record/TsMuxer.h"
+#include "Common/StreamLatency.h"
+#include "Common/FrameGopCache.h"
 
 namespace mediakit {
 
@@ -34,50 +36,59 @@ public:
         _media_src->setListener(shared_from_this());
     }
 
+    void setLatency(const StreamLatency::Ptr &latency) {
+        _latency = latency;
+    }
+
     int readerCount() const{
         return _media_src->readerCount();
     }
 
     void onReaderChanged(MediaSource &sender, int size) override {
         GET_CONFIG(bool, ts_demand, General::kTSDemand);
-        _enabled = ts_demand ? size : true;
-        if (!size && ts_demand) {
-            _clear_cache = true;
-        }
+        _demand.onReaderChanged(ts_demand, size);
         MediaSourceEventInterceptor::onReaderChanged(sender, size);
     }
 
     void inputFrame(const Frame::Ptr &frame) override {
         GET_CONFIG(bool, ts_demand, General::kTSDemand);
-        if (_clear_cache && ts_demand) {
-            _clear_cache = false;
+        if (_demand.popClearCache(ts_demand)) {
             _media_src->clearCache();
         }
-        if (_enabled || !ts_demand) {
+        if (_demand.needMux(ts_demand)) {
             TsMuxer::inputFrame(frame);
         }
     }
 
     bool isEnabled() {
         GET_CONFIG(bool, ts_demand, General::kTSDemand);
-        //缓存尚未清空时，还允许触发inputFrame函数，以便及时清空缓存
-        return ts_demand ? (_clear_cache ? true : _enabled) : true;
+        return _demand.isEnabled(ts_demand);
+    }
+
+    /**
+     * 是否需要先回放共享的gop缓存，调用后复位
+     */
+    bool popReplayGop(bool have_video) {
+        return _demand.popReplayGop(have_video);
     }
 
 protected:
     void onTs(std::shared_ptr<Buffer> buffer, uint32_t timestamp, bool is_idr_fast_packet) override {
-        if (!buffer) {
+        if (!buffer || _demand.dropOutput(is_idr_fast_packet)) {
             return;
         }
         auto packet = std::make_shared<TSPacket>(std::move(buffer));
         packet->time_stamp = timestamp;
+        if (_latency) {
+            packet->ingest_stamp = _latency->onMuxOutput(StreamLatency::ProtocolTS, getFrameDts());
+        }
         _media_src->onWrite(std::move(packet), is_idr_fast_packet);
     }
 
 private:
-    bool _enabled = true;
-    bool _clear_cache = false;
+    MuxerDemand _demand;
     TSMediaSource::Ptr _media_src;
+    StreamLatency::Ptr _latency;
 };
 
 }//namespace mediakit
@@ -0,0 +1,80 @@
+﻿/*
+ * Copyright (c) 2016 The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/xia-chu/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef ZLMEDIAKIT_TESTUTIL_H
+#define ZLMEDIAKIT_TESTUTIL_H
+
+#include <string>
+#include <functional>
+#include "Util/logger.h"
+#include "Common/Device.h"
+
+//测试用例中的检查，失败时打印表达式并返回false
+#define EXPECT(exp) \
+    if (!(exp)) { \
+        ErrorL << "检查失败:" << #exp; \
+        return false; \
+    }
+
+namespace mediakit {
+
+//依次运行测试用例并打印结果，任一用例失败时main返回非0
+class TestSuite {
+public:
+    void run(const char *name, const std::function<bool()> &test) {
+        auto ret = test();
+        InfoL << name << (ret ? " 通过" : " 失败");
+        _ok = _ok && ret;
+    }
+
+    int result() const {
+        return _ok ? 0 : -1;
+    }
+
+private:
+    bool _ok = true;
+};
+
+//合成的320x240 25fps baseline h264源，每秒一个关键帧
+class TestH264Source {
+public:
+    static DevChannel::Ptr createChannel(const std::string &app, const std::string &stream) {
+        auto channel = std::make_shared<DevChannel>(DEFAULT_VHOST, app, stream, 0, false, false);
+        VideoInfo video;
+        video.codecId = CodecH264;
+        video.iWidth = 320;
+        video.iHeight = 240;
+        video.iFrameRate = 25;
+        channel->initVideo(video);
+        channel->addTrackCompleted();
+        return channel;
+    }
+
+    //输入第index帧，帧间隔40ms
+    static void inputFrame(DevChannel &channel, uint32_t index) {
+        static const std::string s_sps("\x00\x00\x00\x01\x67\x42\xc0\x1e\xda\x05\x07\xe8\x40\x00\x00\x03\x00\x40\x00\x00\x0c\xa1", 22);
+        static const std::string s_pps("\x00\x00\x00\x01\x68\xce\x3c\x80", 8);
+        auto dts = index * 40;
+        bool key = index % 25 == 0;
+        if (key) {
+            channel.inputH264(s_sps.data(), s_sps.size(), dts);
+            channel.inputH264(s_pps.data(), s_pps.size(), dts);
+        }
+        //first_mb_in_slice为0，其余为填充数据
+        std::string nalu("\x00\x00\x00\x01", 4);
+        nalu.push_back(key ? 0x65 : 0x41);
+        nalu.push_back((char) 0x88);
+        nalu.append(1000, (char) 0xAA);
+        channel.inputH264(nalu.data(), nalu.size(), dts);
+    }
+};
+
+} // namespace mediakit
+#endif //ZLMEDIAKIT_TESTUTIL_H
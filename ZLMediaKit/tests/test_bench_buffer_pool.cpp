@@ -0,0 +1,199 @@
+﻿/*
+ * Copyright (c) 2016 The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/xia-chu/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <signal.h>
+#include <atomic>
+#include <thread>
+#include <iostream>
+#include "Util/logger.h"
+#include "Util/CMD.h"
+#include "Util/TimeTicker.h"
+#include "Util/BufferPool.h"
+#include "Network/Buffer.h"
+
+using namespace std;
+using namespace toolkit;
+
+class CMD_main : public CMD {
+public:
+    CMD_main() {
+        _parser.reset(new OptionParser(nullptr));
+
+        (*_parser) << Option('t',/*该选项简称，如果是\x00则说明无简称*/
+                             "threads",/*该选项全称,每个选项必须有全称；不得为null或空字符串*/
+                             Option::ArgRequired,/*该选项后面必须跟值*/
+                             "4",/*该选项默认值*/
+                             false,/*该选项是否必须赋值，如果没有默认值且为ArgRequired时用户必须提供该参数否则将抛异常*/
+                             "生产者/消费者线程对数",/*该选项说明文字*/
+                             nullptr);
+
+        (*_parser) << Option('d',/*该选项简称，如果是\x00则说明无简称*/
+                             "duration",/*该选项全称,每个选项必须有全称；不得为null或空字符串*/
+                             Option::ArgRequired,/*该选项后面必须跟值*/
+                             "2",/*该选项默认值*/
+                             false,/*该选项是否必须赋值，如果没有默认值且为ArgRequired时用户必须提供该参数否则将抛异常*/
+                             "每轮测试时长,单位秒",/*该选项说明文字*/
+                             nullptr);
+    }
+
+    ~CMD_main() override {}
+
+    const char *description() const override {
+        return "主程序命令参数";
+    }
+};
+
+//模拟媒体数据包大小分布：rtp包、音频帧、rtmp视频包等
+static size_t getPacketSize(size_t index) {
+    static const size_t sizes[] = {1412, 1412, 1412, 1412, 16, 200, 400, 4096, 1412, 20000};
+    return sizes[index % (sizeof(sizes) / sizeof(sizes[0]))];
+}
+
+//生产者线程批量交给消费者线程释放，模拟一个poller线程写入、另外一个poller线程释放的场景
+class PacketQueue {
+public:
+    void push(vector<BufferRaw::Ptr> &batch) {
+        lock_guard<mutex> lck(_mtx);
+        _queue.emplace_back(std::move(batch));
+        batch.clear();
+    }
+
+    bool pop(vector<BufferRaw::Ptr> &batch) {
+        lock_guard<mutex> lck(_mtx);
+        if (_queue.empty()) {
+            return false;
+        }
+        batch = std::move(_queue.front());
+        _queue.pop_front();
+        return true;
+    }
+
+    size_t size() {
+        lock_guard<mutex> lck(_mtx);
+        return _queue.size();
+    }
+
+private:
+    mutex _mtx;
+    deque<vector<BufferRaw::Ptr> > _queue;
+};
+
+static void getStatistic(uint64_t &hit, uint64_t &miss, size_t &resident_bytes) {
+    hit = miss = resident_bytes = 0;
+    for (auto &stat : BufferPool::getStatistic()) {
+        hit += stat.hit;
+        miss += stat.miss;
+        resident_bytes += stat.resident_bytes;
+    }
+}
+
+static bool bench(bool enable, int threads, int duration) {
+    BufferPool::setEnable(enable);
+    uint64_t last_hit, last_miss;
+    size_t resident_bytes;
+    getStatistic(last_hit, last_miss, resident_bytes);
+    atomic<bool> exit_flag{false};
+    atomic<uint64_t> packets{0};
+    atomic<bool> corrupted{false};
+
+    vector<thread> workers;
+    vector<std::shared_ptr<PacketQueue> > queues;
+    for (int i = 0; i < threads; ++i) {
+        auto queue = std::make_shared<PacketQueue>();
+        queues.emplace_back(queue);
+        workers.emplace_back([&, queue]() {
+            uint64_t count = 0;
+            vector<BufferRaw::Ptr> batch;
+            while (!exit_flag) {
+                if (queue->size() > 64) {
+                    //消费者跟不上，避免内存无限增长
+                    this_thread::yield();
+                    continue;
+                }
+                auto buffer = BufferRaw::create();
+                auto size = getPacketSize(count);
+                buffer->setCapacity(size);
+                buffer->setSize(size);
+                buffer->data()[0] = (char) count;
+                buffer->data()[size - 1] = (char) count;
+                batch.emplace_back(std::move(buffer));
+                if (batch.size() == 128) {
+                    queue->push(batch);
+                }
+                ++count;
+            }
+            packets += count;
+        });
+        workers.emplace_back([&, queue]() {
+            vector<BufferRaw::Ptr> batch;
+            while (!exit_flag || queue->size()) {
+                if (!queue->pop(batch)) {
+                    this_thread::yield();
+                    continue;
+                }
+                for (auto &buffer : batch) {
+                    if (buffer->data()[0] != buffer->data()[buffer->size() - 1]) {
+                        corrupted = true;
+                    }
+                }
+                batch.clear();
+            }
+        });
+    }
+
+    this_thread::sleep_for(chrono::seconds(duration));
+    exit_flag = true;
+    for (auto &worker : workers) {
+        worker.join();
+    }
+
+    uint64_t hit, miss;
+    getStatistic(hit, miss, resident_bytes);
+    hit -= last_hit;
+    miss -= last_miss;
+    InfoL << (enable ? "buffer pool" : "malloc     ")
+          << " threads:" << threads
+          << " packets/sec:" << packets / duration
+          << " hit rate:" << (hit + miss ? (double) hit / (hit + miss) : 0.0)
+          << " resident KB:" << resident_bytes / 1024;
+    if (corrupted) {
+        ErrorL << "buffer data corrupted";
+        return false;
+    }
+    return true;
+}
+
+//此程序用于测试Buffer内存池在跨线程分配释放时的正确性与性能
+int main(int argc, char *argv[]) {
+    CMD_main cmd_main;
+    try {
+        cmd_main.operator()(argc, argv);
+    } catch (ExitException &) {
+        return 0;
+    } catch (std::exception &ex) {
+        cout << ex.what() << endl;
+        return -1;
+    }
+
+    auto threads = cmd_main["threads"].as<int>();
+    auto duration = cmd_main["duration"].as<int>();
+
+    //设置日志
+    Logger::Instance().add(std::make_shared<ConsoleChannel>());
+    //启动异步日志线程
+    Logger::Instance().setWriter(std::make_shared<AsyncLogWriter>());
+
+    for (int i = 1; i <= threads; i *= 2) {
+        if (!bench(false, i, duration) || !bench(true, i, duration)) {
+            return -1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,286 @@
+﻿/*
+ * Copyright (c) 2016 The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/xia-chu/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <vector>
+#include <iostream>
+#include <algorithm>
+#include "Util/File.h"
+#include "Util/logger.h"
+#include "Util/CMD.h"
+#include "Network/TcpServer.h"
+#include "Network/sockutil.h"
+#include "Common/config.h"
+#include "Http/HttpSession.h"
+#include "Http/HttpFileCache.h"
+
+using namespace std;
+using namespace toolkit;
+using namespace mediakit;
+
+class CMD_main : public CMD {
+public:
+    CMD_main() {
+        _parser.reset(new OptionParser(nullptr));
+
+        (*_parser) << Option('c',/*该选项简称，如果是\x00则说明无简称*/
+                             "connections",/*该选项全称,每个选项必须有全称；不得为null或空字符串*/
+                             Option::ArgRequired,/*该选项后面必须跟值*/
+                             "16",/*该选项默认值*/
+                             false,/*该选项是否必须赋值，如果没有默认值且为ArgRequired时用户必须提供该参数否则将抛异常*/
+                             "并发的keep-alive连接个数(每个连接一个线程，同步请求)",/*该选项说明文字*/
+                             nullptr);
+
+        (*_parser) << Option('d',/*该选项简称，如果是\x00则说明无简称*/
+                             "duration",/*该选项全称,每个选项必须有全称；不得为null或空字符串*/
+                             Option::ArgRequired,/*该选项后面必须跟值*/
+                             "10",/*该选项默认值*/
+                             false,/*该选项是否必须赋值，如果没有默认值且为ArgRequired时用户必须提供该参数否则将抛异常*/
+                             "测试时长,单位秒",/*该选项说明文字*/
+                             nullptr);
+
+        (*_parser) << Option('n',/*该选项简称，如果是\x00则说明无简称*/
+                             "small",/*该选项全称,每个选项必须有全称；不得为null或空字符串*/
+                             Option::ArgRequired,/*该选项后面必须跟值*/
+                             "200",/*该选项默认值*/
+                             false,/*该选项是否必须赋值，如果没有默认值且为ArgRequired时用户必须提供该参数否则将抛异常*/
+                             "语料库中小文件个数(1KB~64KB)",/*该选项说明文字*/
+                             nullptr);
+
+        (*_parser) << Option('l',/*该选项简称，如果是\x00则说明无简称*/
+                             "large",/*该选项全称,每个选项必须有全称；不得为null或空字符串*/
+                             Option::ArgRequired,/*该选项后面必须跟值*/
+                             "4",/*该选项默认值*/
+                             false,/*该选项是否必须赋值，如果没有默认值且为ArgRequired时用户必须提供该参数否则将抛异常*/
+                             "语料库中大文件个数(8MB)",/*该选项说明文字*/
+                             nullptr);
+
+        (*_parser) << Option('r',/*该选项简称，如果是\x00则说明无简称*/
+                             "ratio",/*该选项全称,每个选项必须有全称；不得为null或空字符串*/
+                             Option::ArgRequired,/*该选项后面必须跟值*/
+                             "5",/*该选项默认值*/
+                             false,/*该选项是否必须赋值，如果没有默认值且为ArgRequired时用户必须提供该参数否则将抛异常*/
+                             "请求大文件的百分比",/*该选项说明文字*/
+                             nullptr);
+
+        (*_parser) << Option('e',/*该选项简称，如果是\x00则说明无简称*/
+                             "etag",/*该选项全称,每个选项必须有全称；不得为null或空字符串*/
+                             Option::ArgRequired,/*该选项后面必须跟值*/
+                             "0",/*该选项默认值*/
+                             false,/*该选项是否必须赋值，如果没有默认值且为ArgRequired时用户必须提供该参数否则将抛异常*/
+                             "携带If-None-Match重新验证的请求百分比(模拟浏览器缓存)",/*该选项说明文字*/
+                             nullptr);
+
+        (*_parser) << Option('m',/*该选项简称，如果是\x00则说明无简称*/
+                             "cache",/*该选项全称,每个选项必须有全称；不得为null或空字符串*/
+                             Option::ArgRequired,/*该选项后面必须跟值*/
+                             "64",/*该选项默认值*/
+                             false,/*该选项是否必须赋值，如果没有默认值且为ArgRequired时用户必须提供该参数否则将抛异常*/
+                             "热点文件缓存大小,单位MB,0为关闭",/*该选项说明文字*/
+                             nullptr);
+
+        (*_parser) << Option('f',/*该选项简称，如果是\x00则说明无简称*/
+                             "sendfile",/*该选项全称,每个选项必须有全称；不得为null或空字符串*/
+                             Option::ArgRequired,/*该选项后面必须跟值*/
+                             "1",/*该选项默认值*/
+                             false,/*该选项是否必须赋值，如果没有默认值且为ArgRequired时用户必须提供该参数否则将抛异常*/
+                             "大文件是否通过sendfile发送",/*该选项说明文字*/
+                             nullptr);
+
+        (*_parser) << Option('p',/*该选项简称，如果是\x00则说明无简称*/
+                             "port",/*该选项全称,每个选项必须有全称；不得为null或空字符串*/
+                             Option::ArgRequired,/*该选项后面必须跟值*/
+                             "8880",/*该选项默认值*/
+                             false,/*该选项是否必须赋值，如果没有默认值且为ArgRequired时用户必须提供该参数否则将抛异常*/
+                             "http服务器端口",/*该选项说明文字*/
+                             nullptr);
+    }
+
+    ~CMD_main() override {}
+
+    const char *description() const override {
+        return "主程序命令参数";
+    }
+};
+
+static const char kCorpusDir[] = "/tmp/zlm_http_bench/";
+static const size_t kLargeSize = 8 * 1024 * 1024;
+
+static string fileName(bool large, int index) {
+    return StrPrinter << (large ? "large_" : "small_") << index << ".bin";
+}
+
+//生成测试语料库，已存在时不重复生成
+static void makeCorpus(int small, int large) {
+    File::create_path(kCorpusDir, 0777);
+    string data;
+    for (int i = 0; i < small + large; ++i) {
+        bool is_large = i >= small;
+        auto path = kCorpusDir + fileName(is_large, is_large ? i - small : i);
+        size_t size = is_large ? kLargeSize : 1024 + rand() % (63 * 1024);
+        if (File::is_file(path.data())) {
+            continue;
+        }
+        data.resize(size);
+        for (auto &ch : data) {
+            ch = (char) rand();
+        }
+        File::saveFile(data, path.data());
+    }
+}
+
+class Result {
+public:
+    uint64_t bytes = 0;
+    uint64_t not_modified = 0;
+    uint64_t errors = 0;
+    //每个请求的耗时，单位微秒
+    vector<uint32_t> latency;
+};
+
+//读取一个http回复，返回状态码，失败返回-1
+static int readResponse(int fd, string &buf, string &etag, uint64_t &body_size) {
+    size_t header_end;
+    char tmp[64 * 1024];
+    while ((header_end = buf.find("\r\n\r\n")) == string::npos) {
+        auto n = recv(fd, tmp, sizeof(tmp), 0);
+        if (n <= 0) {
+            return -1;
+        }
+        buf.append(tmp, n);
+    }
+    auto header = buf.substr(0, header_end + 4);
+    buf.erase(0, header_end + 4);
+    int code = atoi(header.data() + header.find(' ') + 1);
+    body_size = atoll(FindField(header.data(), "Content-Length: ", "\r\n").data());
+    etag = FindField(header.data(), "ETag: ", "\r\n");
+
+    //丢弃body
+    uint64_t remain = body_size;
+    auto consumed = min<uint64_t>(remain, buf.size());
+    buf.erase(0, consumed);
+    remain -= consumed;
+    while (remain) {
+        auto n = recv(fd, tmp, min<uint64_t>(remain, sizeof(tmp)), 0);
+        if (n <= 0) {
+            return -1;
+        }
+        remain -= n;
+    }
+    return code;
+}
+
+static void runClient(uint16_t port, int small, int large, int ratio, int etag_ratio, int seconds, Result &result) {
+    auto fd = SockUtil::connect("127.0.0.1", port, false);
+    if (fd < 0) {
+        ++result.errors;
+        return;
+    }
+    SockUtil::setNoBlocked(fd, false);
+    SockUtil::setNoDelay(fd);
+    vector<string> etags(small + large);
+    string buf;
+    auto end = chrono::steady_clock::now() + chrono::seconds(seconds);
+    while (chrono::steady_clock::now() < end) {
+        bool is_large = large && rand() % 100 < ratio;
+        int index = is_large ? rand() % large : rand() % small;
+        auto &etag = etags[is_large ? small + index : index];
+        string req = "GET /" + fileName(is_large, index) + " HTTP/1.1\r\nHost: 127.0.0.1\r\n";
+        if (!etag.empty() && rand() % 100 < etag_ratio) {
+            req += "If-None-Match: " + etag + "\r\n";
+        }
+        req += "\r\n";
+
+        auto start = chrono::steady_clock::now();
+        if (::send(fd, req.data(), req.size(), 0) != (ssize_t) req.size()) {
+            ++result.errors;
+            break;
+        }
+        uint64_t body_size;
+        auto code = readResponse(fd, buf, etag, body_size);
+        if (code != 200 && code != 304) {
+            ++result.errors;
+            break;
+        }
+        result.latency.emplace_back((uint32_t) chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count());
+        result.bytes += body_size;
+        result.not_modified += code == 304;
+    }
+    close(fd);
+}
+
+//此程序用于测试http静态文件服务器的性能(请求数/秒与延时分位数)
+//可通过-m与-f参数对比热点文件缓存、sendfile开启前后的性能
+int main(int argc, char *argv[]) {
+    CMD_main cmd_main;
+    try {
+        cmd_main.operator()(argc, argv);
+    } catch (ExitException &) {
+        return 0;
+    } catch (std::exception &ex) {
+        cout << ex.what() << endl;
+        return -1;
+    }
+
+    auto connections = cmd_main["connections"].as<int>();
+    auto seconds = cmd_main["duration"].as<int>();
+    auto small = max(1, cmd_main["small"].as<int>());
+    auto large = cmd_main["large"].as<int>();
+    auto ratio = cmd_main["ratio"].as<int>();
+    auto etag_ratio = cmd_main["etag"].as<int>();
+    auto port = cmd_main["port"].as<uint16_t>();
+
+    Logger::Instance().add(std::make_shared<ConsoleChannel>("ConsoleChannel", LWarn));
+    Logger::Instance().setWriter(std::make_shared<AsyncLogWriter>());
+
+    srand(0);
+    makeCorpus(small, large);
+    mINI::Instance()[Http::kRootPath] = kCorpusDir;
+    mINI::Instance()[Http::kFileCacheMaxMB] = cmd_main["cache"].as<int>();
+    mINI::Instance()[Http::kSendFile] = cmd_main["sendfile"].as<int>();
+    NoticeCenter::Instance().emitEvent(Broadcast::kBroadcastReloadConfig);
+
+    TcpServer::Ptr server(new TcpServer());
+    server->start<HttpSession>(port);
+
+    vector<Result> results(connections);
+    vector<std::thread> threads;
+    for (int i = 0; i < connections; ++i) {
+        threads.emplace_back([&, i]() {
+            runClient(port, small, large, ratio, etag_ratio, seconds, results[i]);
+        });
+    }
+    for (auto &th : threads) {
+        th.join();
+    }
+
+    Result total;
+    for (auto &result : results) {
+        total.bytes += result.bytes;
+        total.not_modified += result.not_modified;
+        total.errors += result.errors;
+        total.latency.insert(total.latency.end(), result.latency.begin(), result.latency.end());
+    }
+    sort(total.latency.begin(), total.latency.end());
+    auto percentile = [&](double p) -> uint32_t {
+        return total.latency.empty() ? 0 : total.latency[min(total.latency.size() - 1, (size_t) (total.latency.size() * p))];
+    };
+    auto stat = HttpFileCache::Instance().getStatistic();
+    cout << "cache:" << cmd_main["cache"] << "MB sendfile:" << cmd_main["sendfile"]
+         << " requests:" << total.latency.size() << " req/s:" << total.latency.size() / seconds
+         << " MB/s:" << total.bytes / seconds / 1024 / 1024
+         << " 304:" << total.not_modified << " errors:" << total.errors << endl;
+    cout << "latency(us) p50:" << percentile(0.5) << " p90:" << percentile(0.9) << " p99:" << percentile(0.99)
+         << " max:" << (total.latency.empty() ? 0 : total.latency.back())
+         << " cache hit:" << stat.hit << " miss:" << stat.miss << endl;
+    return 0;
+}
@@ -0,0 +1,131 @@
+﻿/*
+ * Copyright (c) 2016 The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/xia-chu/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <iostream>
+#include "Util/logger.h"
+#include "Util/CMD.h"
+#include "Common/config.h"
+#include "Common/StreamLatency.h"
+
+using namespace std;
+using namespace toolkit;
+using namespace mediakit;
+
+class CMD_main : public CMD {
+public:
+    CMD_main() {
+        _parser.reset(new OptionParser(nullptr));
+
+        (*_parser) << Option('n',/*该选项简称，如果是\x00则说明无简称*/
+                             "records",/*该选项全称,每个选项必须有全称；不得为null或空字符串*/
+                             Option::ArgRequired,/*该选项后面必须跟值*/
+                             "10000000",/*该选项默认值*/
+                             false,/*该选项是否必须赋值，如果没有默认值且为ArgRequired时用户必须提供该参数否则将抛异常*/
+                             "直方图记录的样本个数",/*该选项说明文字*/
+                             nullptr);
+
+        (*_parser) << Option('f',/*该选项简称，如果是\x00则说明无简称*/
+                             "frames",/*该选项全称,每个选项必须有全称；不得为null或空字符串*/
+                             Option::ArgRequired,/*该选项后面必须跟值*/
+                             "1000000",/*该选项默认值*/
+                             false,/*该选项是否必须赋值，如果没有默认值且为ArgRequired时用户必须提供该参数否则将抛异常*/
+                             "模拟输入的帧数",/*该选项说明文字*/
+                             nullptr);
+    }
+
+    ~CMD_main() override {}
+
+    const char *description() const override {
+        return "主程序命令参数";
+    }
+};
+
+static uint64_t exactPercentile(const vector<uint64_t> &sorted, double percent) {
+    auto index = (size_t) (percent * sorted.size());
+    return sorted[std::min(index, sorted.size() - 1)];
+}
+
+static void printError(const char *name, uint64_t approx, uint64_t exact) {
+    InfoL << name << " histogram:" << approx << "us exact:" << exact << "us error:"
+          << (exact ? (double) ((int64_t) approx - (int64_t) exact) * 100 / exact : 0) << "%";
+}
+
+//此程序测试端到端延时统计的开销与直方图分位数的精度
+int main(int argc, char *argv[]) {
+    CMD_main cmd_main;
+    try {
+        cmd_main.operator()(argc, argv);
+    } catch (ExitException &) {
+        return 0;
+    } catch (std::exception &ex) {
+        cout << ex.what() << endl;
+        return -1;
+    }
+
+    auto records = cmd_main["records"].as<size_t>();
+    auto frames = cmd_main["frames"].as<uint32_t>();
+
+    //设置日志
+    Logger::Instance().add(std::make_shared<ConsoleChannel>());
+    //启动异步日志线程
+    Logger::Instance().setWriter(std::make_shared<AsyncLogWriter>());
+
+    //对数正态分布的延时样本，中位数约20ms，有较长的尾部
+    mt19937_64 engine(0);
+    lognormal_distribution<double> dist(log(20000.0), 1.0);
+    vector<uint64_t> samples(records);
+    for (auto &us : samples) {
+        us = (uint64_t) dist(engine);
+    }
+
+    LatencyHistogram histogram;
+    auto start = chrono::steady_clock::now();
+    for (auto us : samples) {
+        histogram.record(us);
+    }
+    auto used_ns = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+    InfoL << "record " << records << " samples, ns/record:" << (records ? used_ns / records : 0);
+
+    auto snap = histogram.snapshot();
+    sort(samples.begin(), samples.end());
+    printError("p50", snap.p50_us, exactPercentile(samples, 0.5));
+    printError("p90", snap.p90_us, exactPercentile(samples, 0.9));
+    printError("p99", snap.p99_us, exactPercentile(samples, 0.99));
+    printError("p999", snap.p999_us, exactPercentile(samples, 0.999));
+    printError("max", snap.max_us, samples.empty() ? 0 : samples.back());
+
+    //模拟25fps视频与43fps音频，每帧都经过rtsp/rtmp/ts/fmp4四种muxer
+    auto latency = StreamLatency::create(DEFAULT_VHOST, "live", "bench");
+    char payload[16] = {0};
+    vector<Frame::Ptr> input;
+    input.reserve(frames);
+    for (uint32_t i = 0; i < frames; ++i) {
+        bool video = i % 3 != 2;
+        auto dts = video ? (i / 3 * 2 + i % 3) * 40 : i / 3 * 23;
+        input.emplace_back(std::make_shared<FrameFromPtr>(video ? CodecH264 : CodecAAC, payload, sizeof(payload), dts));
+    }
+
+    start = chrono::steady_clock::now();
+    for (auto &frame : input) {
+        latency->onIngest(frame);
+        latency->onTrackFrame(frame->dts(), frame->dts(), frame->pts());
+        latency->onMuxOutputRtp(frame->pts() * 90, 90000);
+        latency->onMuxOutput(StreamLatency::ProtocolRtmp, frame->dts());
+        latency->onMuxOutput(StreamLatency::ProtocolTS, frame->dts());
+        latency->onMuxOutput(StreamLatency::ProtocolFMP4, frame->dts());
+    }
+    used_ns = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+    InfoL << "input " << frames << " frames through 4 muxers, ns/frame:" << (frames ? used_ns / frames : 0)
+          << ", matched(ts):" << latency->getHistogram(StreamLatency::ProtocolTS, StreamLatency::StageMux).snapshot().count;
+    return 0;
+}
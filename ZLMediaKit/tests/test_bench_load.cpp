@@ -0,0 +1,1062 @@
+﻿/*
+ * Copyright (c) 2016 The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/xia-chu/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <signal.h>
+#include <set>
+#include <atomic>
+#include <algorithm>
+#include <cinttypes>
+#include <fstream>
+#include <iostream>
+#include "Util/logger.h"
+#include "Util/CMD.h"
+#include "Util/TimeTicker.h"
+#include "Common/config.h"
+#include "Common/Device.h"
+#include "Common/StreamLatency.h"
+#include "Extension/AAC.h"
+#include "Extension/H264.h"
+#include "Http/HttpClientImp.h"
+#include "Player/MediaPlayer.h"
+#include "Pusher/MediaPusher.h"
+#include "Thread/WorkThreadPool.h"
+
+using namespace std;
+using namespace toolkit;
+using namespace mediakit;
+
+class CMD_main : public CMD {
+public:
+    CMD_main() {
+        _parser.reset(new OptionParser(nullptr));
+
+        (*_parser) << Option('l',/*该选项简称，如果是\x00则说明无简称*/
+                             "level",/*该选项全称,每个选项必须有全称；不得为null或空字符串*/
+                             Option::ArgRequired,/*该选项后面必须跟值*/
+                             to_string(LInfo).data(),/*该选项默认值*/
+                             false,/*该选项是否必须赋值，如果没有默认值且为ArgRequired时用户必须提供该参数否则将抛异常*/
+                             "日志等级,LTrace~LError(0~4)",/*该选项说明文字*/
+                             nullptr);
+
+        (*_parser) << Option('t',/*该选项简称，如果是\x00则说明无简称*/
+                             "threads",/*该选项全称,每个选项必须有全称；不得为null或空字符串*/
+                             Option::ArgRequired,/*该选项后面必须跟值*/
+                             to_string(thread::hardware_concurrency()).data(),/*该选项默认值*/
+                             false,/*该选项是否必须赋值，如果没有默认值且为ArgRequired时用户必须提供该参数否则将抛异常*/
+                             "启动事件触发线程数",/*该选项说明文字*/
+                             nullptr);
+
+        (*_parser) << Option('s',/*该选项简称，如果是\x00则说明无简称*/
+                             "server",/*该选项全称,每个选项必须有全称；不得为null或空字符串*/
+                             Option::ArgRequired,/*该选项后面必须跟值*/
+                             "127.0.0.1",/*该选项默认值*/
+                             false,/*该选项是否必须赋值，如果没有默认值且为ArgRequired时用户必须提供该参数否则将抛异常*/
+                             "被测服务器地址",/*该选项说明文字*/
+                             nullptr);
+
+        (*_parser) << Option('r',/*该选项简称，如果是\x00则说明无简称*/
+                             "rtsp_port",/*该选项全称,每个选项必须有全称；不得为null或空字符串*/
+                             Option::ArgRequired,/*该选项后面必须跟值*/
+                             "554",/*该选项默认值*/
+                             false,/*该选项是否必须赋值，如果没有默认值且为ArgRequired时用户必须提供该参数否则将抛异常*/
+                             "服务器rtsp端口",/*该选项说明文字*/
+                             nullptr);
+
+        (*_parser) << Option('m',/*该选项简称，如果是\x00则说明无简称*/
+                             "rtmp_port",/*该选项全称,每个选项必须有全称；不得为null或空字符串*/
+                             Option::ArgRequired,/*该选项后面必须跟值*/
+                             "1935",/*该选项默认值*/
+                             false,/*该选项是否必须赋值，如果没有默认值且为ArgRequired时用户必须提供该参数否则将抛异常*/
+                             "服务器rtmp端口",/*该选项说明文字*/
+                             nullptr);
+
+        (*_parser) << Option('H',/*该选项简称，如果是\x00则说明无简称*/
+                             "http_port",/*该选项全称,每个选项必须有全称；不得为null或空字符串*/
+                             Option::ArgRequired,/*该选项后面必须跟值*/
+                             "80",/*该选项默认值*/
+                             false,/*该选项是否必须赋值，如果没有默认值且为ArgRequired时用户必须提供该参数否则将抛异常*/
+                             "服务器http端口(http-flv/hls)",/*该选项说明文字*/
+                             nullptr);
+
+        (*_parser) << Option('g',/*该选项简称，如果是\x00则说明无简称*/
+                             "rtp_port",/*该选项全称,每个选项必须有全称；不得为null或空字符串*/
+                             Option::ArgRequired,/*该选项后面必须跟值*/
+                             "10000",/*该选项默认值*/
+                             false,/*该选项是否必须赋值，如果没有默认值且为ArgRequired时用户必须提供该参数否则将抛异常*/
+                             "服务器GB28181 rtp(udp)端口",/*该选项说明文字*/
+                             nullptr);
+
+        (*_parser) << Option('P',/*该选项简称，如果是\x00则说明无简称*/
+                             "publishers",/*该选项全称,每个选项必须有全称；不得为null或空字符串*/
+                             Option::ArgRequired,/*该选项后面必须跟值*/
+                             "rtmp:1",/*该选项默认值*/
+                             false,/*该选项是否必须赋值，如果没有默认值且为ArgRequired时用户必须提供该参数否则将抛异常*/
+                             "各协议推流器个数,协议支持rtsp_tcp/rtsp_udp/rtmp/gb28181,例如rtmp:2,gb28181:1",/*该选项说明文字*/
+                             nullptr);
+
+        (*_parser) << Option('p',/*该选项简称，如果是\x00则说明无简称*/
+                             "players",/*该选项全称,每个选项必须有全称；不得为null或空字符串*/
+                             Option::ArgRequired,/*该选项后面必须跟值*/
+                             "rtsp_tcp:10,rtmp:10,flv:10",/*该选项默认值*/
+                             false,/*该选项是否必须赋值，如果没有默认值且为ArgRequired时用户必须提供该参数否则将抛异常*/
+                             "各协议播放器个数,协议支持rtsp_tcp/rtsp_udp/rtmp/flv/hls,播放器轮流播放各推流器的流",/*该选项说明文字*/
+                             nullptr);
+
+        (*_parser) << Option('D',/*该选项简称，如果是\x00则说明无简称*/
+                             "duration",/*该选项全称,每个选项必须有全称；不得为null或空字符串*/
+                             Option::ArgRequired,/*该选项后面必须跟值*/
+                             "30",/*该选项默认值*/
+                             false,/*该选项是否必须赋值，如果没有默认值且为ArgRequired时用户必须提供该参数否则将抛异常*/
+                             "播放器全部启动后的压测时长,单位秒",/*该选项说明文字*/
+                             nullptr);
+
+        (*_parser) << Option('d',/*该选项简称，如果是\x00则说明无简称*/
+                             "delay",/*该选项全称,每个选项必须有全称；不得为null或空字符串*/
+                             Option::ArgRequired,/*该选项后面必须跟值*/
+                             "10",/*该选项默认值*/
+                             false,/*该选项是否必须赋值，如果没有默认值且为ArgRequired时用户必须提供该参数否则将抛异常*/
+                             "启动客户端间隔,单位毫秒",/*该选项说明文字*/
+                             nullptr);
+
+        (*_parser) << Option('b',/*该选项简称，如果是\x00则说明无简称*/
+                             "bitrate",/*该选项全称,每个选项必须有全称；不得为null或空字符串*/
+                             Option::ArgRequired,/*该选项后面必须跟值*/
+                             "1000",/*该选项默认值*/
+                             false,/*该选项是否必须赋值，如果没有默认值且为ArgRequired时用户必须提供该参数否则将抛异常*/
+                             "合成视频码率,单位kbps",/*该选项说明文字*/
+                             nullptr);
+
+        (*_parser) << Option('f',/*该选项简称，如果是\x00则说明无简称*/
+                             "fps",/*该选项全称,每个选项必须有全称；不得为null或空字符串*/
+                             Option::ArgRequired,/*该选项后面必须跟值*/
+                             "25",/*该选项默认值*/
+                             false,/*该选项是否必须赋值，如果没有默认值且为ArgRequired时用户必须提供该参数否则将抛异常*/
+                             "合成视频帧率",/*该选项说明文字*/
+                             nullptr);
+
+        (*_parser) << Option('G',/*该选项简称，如果是\x00则说明无简称*/
+                             "gop",/*该选项全称,每个选项必须有全称；不得为null或空字符串*/
+                             Option::ArgRequired,/*该选项后面必须跟值*/
+                             "2",/*该选项默认值*/
+                             false,/*该选项是否必须赋值，如果没有默认值且为ArgRequired时用户必须提供该参数否则将抛异常*/
+                             "合成视频关键帧间隔,单位秒",/*该选项说明文字*/
+                             nullptr);
+
+        (*_parser) << Option('S',/*该选项简称，如果是\x00则说明无简称*/
+                             "stall",/*该选项全称,每个选项必须有全称；不得为null或空字符串*/
+                             Option::ArgRequired,/*该选项后面必须跟值*/
+                             "1000",/*该选项默认值*/
+                             false,/*该选项是否必须赋值，如果没有默认值且为ArgRequired时用户必须提供该参数否则将抛异常*/
+                             "相邻视频帧到达间隔超过该值时记为一次卡顿,单位毫秒",/*该选项说明文字*/
+                             nullptr);
+
+        (*_parser) << Option('o',/*该选项简称，如果是\x00则说明无简称*/
+                             "out",/*该选项全称,每个选项必须有全称；不得为null或空字符串*/
+                             Option::ArgRequired,/*该选项后面必须跟值*/
+                             "",/*该选项默认值*/
+                             false,/*该选项是否必须赋值，如果没有默认值且为ArgRequired时用户必须提供该参数否则将抛异常*/
+                             "json报告输出文件,为空时输出到标准输出",/*该选项说明文字*/
+                             nullptr);
+    }
+
+    ~CMD_main() override {}
+
+    const char *description() const override {
+        return "主程序命令参数";
+    }
+};
+
+enum Protocol {
+    ProtocolRtspTcp = 0,
+    ProtocolRtspUdp,
+    ProtocolRtmp,
+    ProtocolFlv,
+    ProtocolHls,
+    ProtocolGB28181,
+    ProtocolMax
+};
+
+static const char *kProtocolName[ProtocolMax] = {"rtsp_tcp", "rtsp_udp", "rtmp", "flv", "hls", "gb28181"};
+
+//解析"rtmp:2,flv:10"格式的客户端个数
+static map<Protocol, int> parseSpec(const string &spec, const set<Protocol> &supported) {
+    map<Protocol, int> ret;
+    for (auto &item : split(spec, ",")) {
+        auto pos = item.find(':');
+        auto name = trim(item.substr(0, pos));
+        auto count = pos == string::npos ? 1 : atoi(item.substr(pos + 1).data());
+        auto it = std::find_if(supported.begin(), supported.end(), [&](Protocol protocol) {
+            return name == kProtocolName[protocol];
+        });
+        if (it == supported.end()) {
+            throw std::invalid_argument("不支持的协议:" + name);
+        }
+        if (count > 0) {
+            ret[*it] += count;
+        }
+    }
+    return ret;
+}
+
+//每种协议推流器或播放器的统计
+class Stats {
+public:
+    int count = 0;
+    //建立连接(推流或播放成功)耗时，单位微秒
+    LatencyHistogram connect;
+    //从开始播放到收到第一个视频帧的耗时，单位微秒
+    LatencyHistogram first_frame;
+    atomic<uint64_t> failures{0};
+    atomic<uint64_t> bytes{0};
+    atomic<uint64_t> frames{0};
+};
+
+class BitWriter {
+public:
+    void u(int bits, uint32_t value) {
+        while (bits--) {
+            if (_bit_pos % 8 == 0) {
+                _bytes.push_back(0);
+            }
+            if ((value >> bits) & 1) {
+                _bytes.back() |= 0x80 >> (_bit_pos % 8);
+            }
+            ++_bit_pos;
+        }
+    }
+
+    void ue(uint32_t value) {
+        int bits = 0;
+        for (auto tmp = value + 1; tmp > 1; tmp >>= 1) {
+            ++bits;
+        }
+        u(bits, 0);
+        u(bits + 1, value + 1);
+    }
+
+    void se(int32_t value) {
+        ue(value <= 0 ? -2 * value : 2 * value - 1);
+    }
+
+    //添加rbsp_trailing_bits并插入防竞争字节，生成带起始码的nalu
+    string toNalu(uint8_t nal_header) {
+        u(1, 1);
+        while (_bit_pos % 8) {
+            u(1, 0);
+        }
+        string ret("\x00\x00\x00\x01", 4);
+        ret.push_back(nal_header);
+        int zeros = 0;
+        for (auto byte : _bytes) {
+            if (zeros == 2 && byte <= 3) {
+                ret.push_back(3);
+                zeros = 0;
+            }
+            ret.push_back(byte);
+            zeros = byte ? 0 : zeros + 1;
+        }
+        return ret;
+    }
+
+private:
+    size_t _bit_pos = 0;
+    string _bytes;
+};
+
+//合成的H264(baseline)与AAC直播源，按真实帧率输入DevChannel，负载为不可解码的填充数据
+class SyntheticSource : public std::enable_shared_from_this<SyntheticSource> {
+public:
+    using Ptr = std::shared_ptr<SyntheticSource>;
+
+    SyntheticSource(const string &app, const string &stream, int fps, int kbps, int gop_sec) : _app(app), _stream(stream) {
+        _fps = MAX(1, fps);
+        _gop = MAX(1, gop_sec * _fps);
+        _frame_bytes = MAX(64, kbps * 1000 / 8 / _fps);
+
+        VideoInfo video;
+        video.codecId = CodecH264;
+        video.iWidth = 1280;
+        video.iHeight = 720;
+        video.iFrameRate = _fps;
+        AudioInfo audio;
+        audio.codecId = CodecAAC;
+        audio.iChannel = 2;
+        audio.iSampleBit = 16;
+        audio.iSampleRate = 44100;
+
+        _channel = std::make_shared<DevChannel>(DEFAULT_VHOST, app, stream, 0, false, false);
+        _channel->initVideo(video);
+        _channel->initAudio(audio);
+        _sps = makeSps(video.iWidth, video.iHeight, _fps);
+        _pps = makePps();
+        //关键帧为普通帧的4倍大小，填充数据不含0，不会出现起始码
+        _filler.assign(_frame_bytes * 4, (char) 0xAA);
+    }
+
+    void start(const EventPoller::Ptr &poller) {
+        _poller = poller;
+        weak_ptr<SyntheticSource> weak_self = shared_from_this();
+        poller->async([weak_self, poller]() {
+            auto strong_self = weak_self.lock();
+            if (!strong_self) {
+                return;
+            }
+            strong_self->_ticker.resetTime();
+            poller->doDelayTask(10, [weak_self]() -> uint64_t {
+                auto strong_self = weak_self.lock();
+                if (!strong_self) {
+                    return 0;
+                }
+                strong_self->onTick();
+                return 10;
+            });
+        });
+    }
+
+    const EventPoller::Ptr &getPoller() const {
+        return _poller;
+    }
+
+    const DevChannel::Ptr &getChannel() const {
+        return _channel;
+    }
+
+    const string &getApp() const {
+        return _app;
+    }
+
+    const string &getStream() const {
+        return _stream;
+    }
+
+    //校验合成的sps能被正确解析
+    static bool checkSps(int fps) {
+        int width, height;
+        float sps_fps;
+        auto sps = makeSps(1280, 720, fps);
+        //去除起始码
+        return getAVCInfo(sps.substr(4), width, height, sps_fps) && width == 1280 && height == 720 && (int) sps_fps == fps;
+    }
+
+private:
+    static string makeSps(int width, int height, int fps) {
+        auto mb_width = (width + 15) / 16, mb_height = (height + 15) / 16;
+        BitWriter bw;
+        //profile_idc baseline, constraint_set0/1, level 3.1
+        bw.u(8, 66);
+        bw.u(8, 0xC0);
+        bw.u(8, 31);
+        //seq_parameter_set_id, log2_max_frame_num_minus4, pic_order_cnt_type, max_num_ref_frames
+        bw.ue(0);
+        bw.ue(0);
+        bw.ue(2);
+        bw.ue(1);
+        //gaps_in_frame_num_value_allowed_flag
+        bw.u(1, 0);
+        bw.ue(mb_width - 1);
+        bw.ue(mb_height - 1);
+        //frame_mbs_only_flag, direct_8x8_inference_flag
+        bw.u(1, 1);
+        bw.u(1, 1);
+        bool crop = mb_width * 16 != width || mb_height * 16 != height;
+        bw.u(1, crop);
+        if (crop) {
+            bw.ue(0);
+            bw.ue((mb_width * 16 - width) / 2);
+            bw.ue(0);
+            bw.ue((mb_height * 16 - height) / 2);
+        }
+        //vui_parameters_present_flag，只携带帧率
+        bw.u(1, 1);
+        bw.u(1, 0);
+        bw.u(1, 0);
+        bw.u(1, 0);
+        bw.u(1, 0);
+        //timing_info_present_flag, num_units_in_tick, time_scale, fixed_frame_rate_flag
+        bw.u(1, 1);
+        bw.u(32, 1);
+        bw.u(32, 2 * fps);
+        bw.u(1, 1);
+        //nal_hrd, vcl_hrd, pic_struct_present, bitstream_restriction
+        bw.u(4, 0);
+        return bw.toNalu(0x67);
+    }
+
+    static string makePps() {
+        BitWriter bw;
+        //pic_parameter_set_id, seq_parameter_set_id
+        bw.ue(0);
+        bw.ue(0);
+        //entropy_coding_mode_flag, bottom_field_pic_order_in_frame_present_flag
+        bw.u(2, 0);
+        //num_slice_groups_minus1, num_ref_idx_l0/l1_default_active_minus1
+        bw.ue(0);
+        bw.ue(0);
+        bw.ue(0);
+        //weighted_pred_flag, weighted_bipred_idc
+        bw.u(3, 0);
+        //pic_init_qp_minus26, pic_init_qs_minus26, chroma_qp_index_offset
+        bw.se(0);
+        bw.se(0);
+        bw.se(0);
+        //deblocking_filter_control_present_flag, constrained_intra_pred_flag, redundant_pic_cnt_present_flag
+        bw.u(1, 1);
+        bw.u(2, 0);
+        return bw.toNalu(0x68);
+    }
+
+    void onTick() {
+        auto elapsed = _ticker.elapsedTime();
+        while (_video_index * 1000 / _fps <= elapsed) {
+            inputVideo((uint32_t) (_video_index * 1000 / _fps));
+            ++_video_index;
+        }
+        //aac每帧1024个采样
+        while (_audio_index * 1024 * 1000 / 44100 <= elapsed) {
+            inputAudio((uint32_t) (_audio_index * 1024 * 1000 / 44100));
+            ++_audio_index;
+        }
+    }
+
+    void inputVideo(uint32_t dts) {
+        bool key = _video_index % _gop == 0;
+        if (key) {
+            _channel->inputH264(_sps.data(), _sps.size(), dts);
+            _channel->inputH264(_pps.data(), _pps.size(), dts);
+        }
+        //first_mb_in_slice为0，slice_type为I(7)或P(5)，其余为填充数据
+        BitWriter bw;
+        bw.ue(0);
+        bw.ue(key ? 7 : 5);
+        bw.ue(0);
+        auto nalu = bw.toNalu(key ? 0x65 : 0x41);
+        nalu.append(_filler.data(), key ? _filler.size() : _frame_bytes);
+        _channel->inputH264(nalu.data(), nalu.size(), dts);
+    }
+
+    void inputAudio(uint32_t dts) {
+        //aac lc, 44100hz, 双声道, 64kbps
+        static const string config("\x12\x10", 2);
+        static constexpr size_t kAudioBytes = 64 * 1000 / 8 * 1024 / 44100;
+        char adts_header[32];
+        if (dumpAacConfig(config, kAudioBytes, (uint8_t *) adts_header, sizeof(adts_header)) > 0) {
+            _channel->inputAAC(_filler.data(), kAudioBytes, dts, adts_header);
+        }
+    }
+
+private:
+    string _app;
+    string _stream;
+    int _fps;
+    int _gop;
+    size_t _frame_bytes;
+    uint64_t _video_index = 0;
+    uint64_t _audio_index = 0;
+    string _sps;
+    string _pps;
+    string _filler;
+    Ticker _ticker;
+    DevChannel::Ptr _channel;
+    EventPoller::Ptr _poller;
+};
+
+//推流器，把本地合成源推到被测服务器
+class BenchPublisher : public std::enable_shared_from_this<BenchPublisher> {
+public:
+    using Ptr = std::shared_ptr<BenchPublisher>;
+
+    /**
+     * @param url rtsp/rtmp推流地址，gb28181推流时为服务器地址
+     * @param rtp_port gb28181推流的服务器端口
+     * @param ssrc gb28181推流的ssrc
+     */
+    BenchPublisher(Protocol protocol, const SyntheticSource::Ptr &source, const string &url, uint16_t rtp_port, uint32_t ssrc, Stats &stats)
+        : _protocol(protocol), _rtp_port(rtp_port), _ssrc(ssrc), _url(url), _source(source), _stats(stats) {}
+
+    //失败或断开后由主线程重新调用
+    void start() {
+        weak_ptr<BenchPublisher> weak_self = shared_from_this();
+        _source->getPoller()->async([weak_self]() {
+            if (auto strong_self = weak_self.lock()) {
+                strong_self->start_l();
+            }
+        });
+    }
+
+    bool alive() const {
+        return _alive;
+    }
+
+private:
+    void start_l() {
+        auto &channel = _source->getChannel();
+        if (_protocol == ProtocolGB28181) {
+            if (channel->getTracks(true).size() < 2) {
+                //等待合成源所有track就绪
+                return;
+            }
+            _alive = true;
+            _ticker.resetTime();
+            weak_ptr<BenchPublisher> weak_self = shared_from_this();
+            //rtp_proxy服务以ssrc的16进制作为流id，startSendRtp的ssrc参数为10进制
+            channel->startSendRtp(*MediaSource::NullMediaSource, _url, _rtp_port, to_string(_ssrc), true, 0,
+                                  [weak_self](uint16_t local_port, const SockException &ex) {
+                if (auto strong_self = weak_self.lock()) {
+                    strong_self->onPublished(ex);
+                }
+            });
+            return;
+        }
+
+        auto schema = _protocol == ProtocolRtmp ? RTMP_SCHEMA : RTSP_SCHEMA;
+        auto src = MediaSource::find(schema, DEFAULT_VHOST, _source->getApp(), _source->getStream());
+        if (!src) {
+            //合成源尚未注册
+            return;
+        }
+        _alive = true;
+        _ticker.resetTime();
+        weak_ptr<BenchPublisher> weak_self = shared_from_this();
+        _pusher = std::make_shared<MediaPusher>(src, _source->getPoller());
+        _pusher->setOnPublished([weak_self](const SockException &ex) {
+            if (auto strong_self = weak_self.lock()) {
+                strong_self->onPublished(ex);
+            }
+        });
+        _pusher->setOnShutdown([weak_self](const SockException &ex) {
+            if (auto strong_self = weak_self.lock()) {
+                strong_self->onFailed(ex);
+            }
+        });
+        (*_pusher)[Client::kRtpType] = _protocol == ProtocolRtspUdp ? Rtsp::RTP_UDP : Rtsp::RTP_TCP;
+        _pusher->publish(_url);
+    }
+
+    void onPublished(const SockException &ex) {
+        if (ex) {
+            onFailed(ex);
+            return;
+        }
+        _stats.connect.record(_ticker.elapsedTime() * 1000);
+    }
+
+    void onFailed(const SockException &ex) {
+        WarnL << kProtocolName[_protocol] << " 推流失败:" << _url << " " << ex.what();
+        _stats.failures.fetch_add(1, memory_order_relaxed);
+        _alive = false;
+    }
+
+private:
+    Protocol _protocol;
+    uint16_t _rtp_port;
+    uint32_t _ssrc;
+    string _url;
+    atomic<bool> _alive{false};
+    Ticker _ticker;
+    SyntheticSource::Ptr _source;
+    MediaPusher::Ptr _pusher;
+    Stats &_stats;
+};
+
+//http-flv播放器，只解析flv tag头，不解复用
+class FlvClient : public HttpClientImp {
+public:
+    using Ptr = std::shared_ptr<FlvClient>;
+    using onResult = function<void(const SockException &ex)>;
+    using onTag = function<void(uint8_t type, uint32_t stamp, size_t size)>;
+
+    FlvClient(const EventPoller::Ptr &poller) {
+        setPoller(poller);
+    }
+
+    ~FlvClient() override {}
+
+    //收到200回复时触发
+    void setOnPlayResult(const onResult &cb) {
+        _on_play_result = cb;
+    }
+
+    //播放失败或中途断开时触发
+    void setOnShutdown(const onResult &cb) {
+        _on_shutdown = cb;
+    }
+
+    void setOnTag(const onTag &cb) {
+        _on_tag = cb;
+    }
+
+protected:
+    ssize_t onResponseHeader(const string &status, const HttpHeader &headers) override {
+        if (status != "200") {
+            //http状态码不符合预期
+            onShutdown(SockException(Err_other, "bad http status code:" + status));
+            shutdown(SockException(Err_other, "bad http status code:" + status));
+            return 0;
+        }
+        if (_on_play_result) {
+            _on_play_result(SockException());
+        }
+        //后续是不定长content
+        return -1;
+    }
+
+    void onResponseBody(const char *buf, size_t size, size_t recvedSize, size_t totalSize) override {
+        //flv header(9字节)与PreviousTagSize0(4字节)
+        static constexpr size_t kFlvHeaderSize = 13;
+        static constexpr size_t kTagHeaderSize = 11;
+        while (size) {
+            size_t n;
+            if (_header_skip < kFlvHeaderSize) {
+                n = MIN(size, kFlvHeaderSize - _header_skip);
+                _header_skip += n;
+            } else if (_tag_skip) {
+                n = MIN(size, _tag_skip);
+                _tag_skip -= n;
+            } else {
+                n = MIN(size, kTagHeaderSize - _tag_header.size());
+                _tag_header.append(buf, n);
+                if (_tag_header.size() == kTagHeaderSize) {
+                    auto ptr = (uint8_t *) _tag_header.data();
+                    size_t data_size = ptr[1] << 16 | ptr[2] << 8 | ptr[3];
+                    uint32_t stamp = ptr[7] << 24 | ptr[4] << 16 | ptr[5] << 8 | ptr[6];
+                    if (_on_tag) {
+                        _on_tag(ptr[0] & 0x1F, stamp, data_size + kTagHeaderSize + 4);
+                    }
+                    //tag data与PreviousTagSize
+                    _tag_skip = data_size + 4;
+                    _tag_header.clear();
+                }
+            }
+            buf += n;
+            size -= n;
+        }
+    }
+
+    void onResponseCompleted() override {
+        shutdown(SockException(Err_eof, "http-flv stream completed"));
+    }
+
+    void onDisconnect(const SockException &ex) override {
+        onShutdown(ex);
+    }
+
+private:
+    void onShutdown(const SockException &ex) {
+        if (_on_shutdown) {
+            auto cb = std::move(_on_shutdown);
+            _on_shutdown = nullptr;
+            cb(ex);
+        }
+    }
+
+private:
+    size_t _header_skip = 0;
+    size_t _tag_skip = 0;
+    string _tag_header;
+    onResult _on_play_result;
+    onResult _on_shutdown;
+    onTag _on_tag;
+};
+
+//播放器，统计连接耗时、首帧耗时、卡顿次数与接收数据量
+class BenchPlayer : public std::enable_shared_from_this<BenchPlayer> {
+public:
+    using Ptr = std::shared_ptr<BenchPlayer>;
+
+    BenchPlayer(Protocol protocol, const string &url, uint64_t stall_ms, Stats &stats)
+        : _protocol(protocol), _stall_ms(stall_ms), _url(url), _stats(stats) {
+        _poller = EventPollerPool::Instance().getPoller();
+    }
+
+    //失败或断开后由主线程重新调用
+    void start() {
+        _alive = true;
+        weak_ptr<BenchPlayer> weak_self = shared_from_this();
+        _poller->async([weak_self]() {
+            if (auto strong_self = weak_self.lock()) {
+                strong_self->start_l();
+            }
+        });
+    }
+
+    bool alive() const {
+        return _alive;
+    }
+
+    uint64_t getStalls() const {
+        return _stalls;
+    }
+
+    Protocol getProtocol() const {
+        return _protocol;
+    }
+
+private:
+    void start_l() {
+        _got_frame = false;
+        _have_last_dts = false;
+        _ticker.resetTime();
+        weak_ptr<BenchPlayer> weak_self = shared_from_this();
+        auto on_shutdown = [weak_self](const SockException &ex) {
+            if (auto strong_self = weak_self.lock()) {
+                strong_self->onFailed(ex);
+            }
+        };
+
+        if (_protocol == ProtocolFlv) {
+            _player = nullptr;
+            _flv = std::make_shared<FlvClient>(_poller);
+            _flv->setOnPlayResult([weak_self](const SockException &ex) {
+                if (auto strong_self = weak_self.lock()) {
+                    strong_self->onPlayed();
+                }
+            });
+            _flv->setOnShutdown(on_shutdown);
+            _flv->setOnTag([weak_self](uint8_t type, uint32_t stamp, size_t size) {
+                if (auto strong_self = weak_self.lock()) {
+                    //9为视频tag
+                    strong_self->onData(type == 9, stamp, size);
+                }
+            });
+            _flv->setMethod("GET");
+            _flv->sendRequest(_url, 10);
+            return;
+        }
+
+        _flv = nullptr;
+        _player = std::make_shared<MediaPlayer>(_poller);
+        weak_ptr<MediaPlayer> weak_player = _player;
+        _player->setOnPlayResult([weak_self, weak_player](const SockException &ex) {
+            auto strong_self = weak_self.lock();
+            auto strong_player = weak_player.lock();
+            if (!strong_self || !strong_player) {
+                return;
+            }
+            if (ex) {
+                strong_self->onFailed(ex);
+                return;
+            }
+            strong_self->onPlayed();
+            for (auto &track : strong_player->getTracks(false)) {
+                bool video = track->getTrackType() == TrackVideo;
+                track->addDelegate(std::make_shared<FrameWriterInterfaceHelper>([weak_self, video](const Frame::Ptr &frame) {
+                    if (auto strong_self = weak_self.lock()) {
+                        strong_self->onData(video, frame->dts(), frame->size());
+                    }
+                }));
+            }
+        });
+        _player->setOnShutdown(on_shutdown);
+        (*_player)[Client::kRtpType] = _protocol == ProtocolRtspUdp ? Rtsp::RTP_UDP : Rtsp::RTP_TCP;
+        _player->play(_url);
+    }
+
+    void onPlayed() {
+        _stats.connect.record(_ticker.elapsedTime() * 1000);
+    }
+
+    void onData(bool video, uint32_t dts, size_t bytes) {
+        _stats.bytes.fetch_add(bytes, memory_order_relaxed);
+        if (!video || (_have_last_dts && dts == _last_dts)) {
+            //sps、pps与关键帧等时间戳相同的视频帧算作一帧
+            return;
+        }
+        _have_last_dts = true;
+        _last_dts = dts;
+        _stats.frames.fetch_add(1, memory_order_relaxed);
+
+        auto now = _ticker.elapsedTime();
+        if (!_got_frame) {
+            _got_frame = true;
+            _stats.first_frame.record(now * 1000);
+        } else if (now - _last_frame_ms > _stall_ms) {
+            ++_stalls;
+        }
+        _last_frame_ms = now;
+    }
+
+    void onFailed(const SockException &ex) {
+        WarnL << kProtocolName[_protocol] << " 播放失败:" << _url << " " << ex.what();
+        _stats.failures.fetch_add(1, memory_order_relaxed);
+        _alive = false;
+    }
+
+private:
+    Protocol _protocol;
+    uint64_t _stall_ms;
+    string _url;
+    atomic<bool> _alive{false};
+    atomic<uint64_t> _stalls{0};
+    bool _got_frame = false;
+    bool _have_last_dts = false;
+    uint32_t _last_dts = 0;
+    uint64_t _last_frame_ms = 0;
+    Ticker _ticker;
+    Stats &_stats;
+    EventPoller::Ptr _poller;
+    MediaPlayer::Ptr _player;
+    FlvClient::Ptr _flv;
+};
+
+//直方图转json，单位毫秒
+static string toJson(const LatencyHistogram &histogram) {
+    auto snap = histogram.snapshot();
+    char buf[256];
+    snprintf(buf, sizeof(buf), "{\"count\": %" PRIu64 ", \"avg\": %.3f, \"p50\": %.3f, \"p90\": %.3f, \"p99\": %.3f, \"p999\": %.3f, \"max\": %.3f}",
+             snap.count, snap.count ? snap.sum_us / 1000.0 / snap.count : 0, snap.p50_us / 1000.0, snap.p90_us / 1000.0,
+             snap.p99_us / 1000.0, snap.p999_us / 1000.0, snap.max_us / 1000.0);
+    return buf;
+}
+
+//卡顿次数转json
+static string toJson(vector<uint64_t> stalls) {
+    sort(stalls.begin(), stalls.end());
+    auto percentile = [&](double percent) -> uint64_t {
+        return stalls.empty() ? 0 : stalls[std::min((size_t) (percent * stalls.size()), stalls.size() - 1)];
+    };
+    uint64_t total = 0;
+    for (auto count : stalls) {
+        total += count;
+    }
+    return StrPrinter << "{\"total\": " << total << ", \"p50\": " << percentile(0.5) << ", \"p90\": " << percentile(0.9)
+                      << ", \"p99\": " << percentile(0.99) << ", \"max\": " << percentile(1) << "}";
+}
+
+//此程序用于模拟多协议推流与播放的综合压测，输出json格式的压测报告，用于对比不同版本的服务器性能
+int main(int argc, char *argv[]) {
+    CMD_main cmd_main;
+    try {
+        cmd_main.operator()(argc, argv);
+    } catch (ExitException &) {
+        return 0;
+    } catch (std::exception &ex) {
+        cout << ex.what() << endl;
+        return -1;
+    }
+
+    int threads = cmd_main["threads"];
+    LogLevel logLevel = (LogLevel) cmd_main["level"].as<int>();
+    logLevel = MIN(MAX(logLevel, LTrace), LError);
+    auto server = cmd_main["server"];
+    auto rtsp_port = cmd_main["rtsp_port"].as<uint16_t>();
+    auto rtmp_port = cmd_main["rtmp_port"].as<uint16_t>();
+    auto http_port = cmd_main["http_port"].as<uint16_t>();
+    auto rtp_port = cmd_main["rtp_port"].as<uint16_t>();
+    auto duration_sec = cmd_main["duration"].as<int>();
+    auto delay_ms = cmd_main["delay"].as<int>();
+    auto kbps = cmd_main["bitrate"].as<int>();
+    auto fps = cmd_main["fps"].as<int>();
+    auto gop_sec = cmd_main["gop"].as<int>();
+    auto stall_ms = cmd_main["stall"].as<uint64_t>();
+    auto out_file = cmd_main["out"];
+
+    map<Protocol, int> publisher_spec, player_spec;
+    try {
+        publisher_spec = parseSpec(cmd_main["publishers"], {ProtocolRtspTcp, ProtocolRtspUdp, ProtocolRtmp, ProtocolGB28181});
+        player_spec = parseSpec(cmd_main["players"], {ProtocolRtspTcp, ProtocolRtspUdp, ProtocolRtmp, ProtocolFlv, ProtocolHls});
+    } catch (std::exception &ex) {
+        cout << ex.what() << endl;
+        return -1;
+    }
+    if (publisher_spec.empty()) {
+        cout << "至少需要一个推流器！" << endl;
+        return -1;
+    }
+
+    //设置日志
+    Logger::Instance().add(std::make_shared<ConsoleChannel>("ConsoleChannel", logLevel));
+    //启动异步日志线程
+    Logger::Instance().setWriter(std::make_shared<AsyncLogWriter>());
+
+    //设置线程数
+    EventPollerPool::setPoolSize(threads);
+    WorkThreadPool::setPoolSize(threads);
+
+    if (!SyntheticSource::checkSps(fps)) {
+        ErrorL << "合成的sps解析失败";
+        return -1;
+    }
+
+    Stats publisher_stats[ProtocolMax], player_stats[ProtocolMax];
+    vector<SyntheticSource::Ptr> sources;
+    vector<BenchPublisher::Ptr> publishers;
+    vector<BenchPlayer::Ptr> players;
+    //推流后服务器上的流路径(app/stream)
+    vector<string> stream_paths;
+
+    uint32_t ssrc = 0x10000000;
+    for (auto &pr : publisher_spec) {
+        auto protocol = pr.first;
+        publisher_stats[protocol].count = pr.second;
+        for (int i = 0; i < pr.second; ++i) {
+            string stream = StrPrinter << kProtocolName[protocol] << "_" << i;
+            auto source = std::make_shared<SyntheticSource>("bench", stream, fps, kbps, gop_sec);
+            source->start(EventPollerPool::Instance().getPoller());
+            sources.emplace_back(source);
+
+            string url;
+            switch (protocol) {
+                case ProtocolRtmp: url = StrPrinter << "rtmp://" << server << ":" << rtmp_port << "/bench/" << stream; break;
+                case ProtocolGB28181: url = server; break;
+                default: url = StrPrinter << "rtsp://" << server << ":" << rtsp_port << "/bench/" << stream; break;
+            }
+            publishers.emplace_back(std::make_shared<BenchPublisher>(protocol, source, url, rtp_port, ++ssrc, publisher_stats[protocol]));
+            //rtp_proxy服务以ssrc的16进制作为流id
+            stream_paths.emplace_back(protocol == ProtocolGB28181 ? "rtp/" + printSSRC(ssrc) : "bench/" + stream);
+        }
+    }
+
+    size_t player_index = 0;
+    for (auto &pr : player_spec) {
+        auto protocol = pr.first;
+        player_stats[protocol].count = pr.second;
+        for (int i = 0; i < pr.second; ++i) {
+            //播放器轮流播放各推流器的流
+            auto &path = stream_paths[player_index++ % stream_paths.size()];
+            string url;
+            switch (protocol) {
+                case ProtocolRtmp: url = StrPrinter << "rtmp://" << server << ":" << rtmp_port << "/" << path; break;
+                case ProtocolFlv: url = StrPrinter << "http://" << server << ":" << http_port << "/" << path << ".flv"; break;
+                case ProtocolHls: url = StrPrinter << "http://" << server << ":" << http_port << "/" << path << "/hls.m3u8"; break;
+                default: url = StrPrinter << "rtsp://" << server << ":" << rtsp_port << "/" << path; break;
+            }
+            players.emplace_back(std::make_shared<BenchPlayer>(protocol, url, stall_ms, player_stats[protocol]));
+        }
+    }
+
+    // 设置退出信号
+    static bool exit_flag = false;
+    signal(SIGINT, [](int) { exit_flag = true; });
+
+    auto restart_dead = [&]() {
+        for (auto &publisher : publishers) {
+            if (!publisher->alive()) {
+                publisher->start();
+            }
+        }
+        for (auto &player : players) {
+            if (!exit_flag && !player->alive()) {
+                player->start();
+                //休眠后再启动下一个播放，防止短时间海量链接
+                if (delay_ms > 0) {
+                    usleep(1000 * delay_ms);
+                }
+            }
+        }
+    };
+
+    //等待所有推流器推流成功，最多等待15秒
+    Ticker wait_ticker;
+    while (!exit_flag && wait_ticker.elapsedTime() < 15 * 1000) {
+        for (auto &publisher : publishers) {
+            if (!publisher->alive()) {
+                publisher->start();
+            }
+        }
+        sleep(1);
+        size_t published = 0;
+        for (auto &pr : publisher_spec) {
+            published += publisher_stats[pr.first].connect.snapshot().count;
+        }
+        if (published >= publishers.size()) {
+            break;
+        }
+    }
+    InfoL << "推流器启动耗时:" << wait_ticker.elapsedTime() << "ms, 开始启动播放器";
+
+    //压测时长从开始启动播放器时计算
+    Ticker run_ticker;
+    uint64_t last_bytes[ProtocolMax] = {0};
+    while (!exit_flag && run_ticker.elapsedTime() < (uint64_t) duration_sec * 1000) {
+        Ticker tick;
+        restart_dead();
+        auto used = tick.elapsedTime();
+        if (used < 1000) {
+            usleep((1000 - used) * 1000);
+        }
+
+        _StrPrinter printer;
+        size_t alive_publisher = 0;
+        for (auto &publisher : publishers) {
+            alive_publisher += publisher->alive();
+        }
+        printer << "推流器:" << alive_publisher << "/" << publishers.size();
+        for (auto &pr : player_spec) {
+            auto protocol = pr.first;
+            size_t alive = 0;
+            for (auto &player : players) {
+                alive += player->getProtocol() == protocol && player->alive();
+            }
+            auto bytes = player_stats[protocol].bytes.load();
+            printer << " " << kProtocolName[protocol] << ":" << alive << "/" << pr.second << " "
+                    << (bytes - last_bytes[protocol]) * 8 / 1000 << "kbps";
+            last_bytes[protocol] = bytes;
+        }
+        InfoL << printer;
+    }
+
+    auto elapsed_sec = run_ticker.elapsedTime() / 1000.0;
+    _StrPrinter json;
+    json << "{\n"
+         << "  \"server\": \"" << server << "\",\n"
+         << "  \"duration_sec\": " << elapsed_sec << ",\n"
+         << "  \"video_kbps\": " << kbps << ",\n"
+         << "  \"fps\": " << fps << ",\n"
+         << "  \"gop_sec\": " << gop_sec << ",\n"
+         << "  \"stall_ms\": " << stall_ms << ",\n"
+         << "  \"publishers\": {";
+    bool first = true;
+    for (auto &pr : publisher_spec) {
+        auto protocol = pr.first;
+        auto &stats = publisher_stats[protocol];
+        json << (first ? "\n" : ",\n") << "    \"" << kProtocolName[protocol] << "\": {"
+             << "\"count\": " << stats.count
+             << ", \"failures\": " << stats.failures.load()
+             << ", \"connect_ms\": " << toJson(stats.connect) << "}";
+        first = false;
+    }
+    json << "\n  },\n  \"players\": {";
+    first = true;
+    for (auto &pr : player_spec) {
+        auto protocol = pr.first;
+        auto &stats = player_stats[protocol];
+        size_t alive = 0;
+        vector<uint64_t> stalls;
+        for (auto &player : players) {
+            if (player->getProtocol() != protocol) {
+                continue;
+            }
+            alive += player->alive();
+            stalls.emplace_back(player->getStalls());
+        }
+        auto bytes = stats.bytes.load();
+        json << (first ? "\n" : ",\n") << "    \"" << kProtocolName[protocol] << "\": {\n"
+             << "      \"count\": " << stats.count << ",\n"
+             << "      \"online\": " << alive << ",\n"
+             << "      \"failures\": " << stats.failures.load() << ",\n"
+             << "      \"connect_ms\": " << toJson(stats.connect) << ",\n"
+             << "      \"first_frame_ms\": " << toJson(stats.first_frame) << ",\n"
+             << "      \"stalls\": " << toJson(std::move(stalls)) << ",\n"
+             << "      \"video_frames\": " << stats.frames.load() << ",\n"
+             << "      \"bytes\": " << bytes << ",\n"
+             << "      \"throughput_kbps\": " << (uint64_t) (elapsed_sec > 0 ? bytes * 8 / 1000 / elapsed_sec : 0) << "\n"
+             << "    }";
+        first = false;
+    }
+    json << "\n  }\n}\n";
+
+    if (out_file.empty()) {
+        cout << json;
+    } else {
+        ofstream(out_file) << json;
+        InfoL << "压测报告已保存:" << out_file;
+    }
+    return 0;
+}
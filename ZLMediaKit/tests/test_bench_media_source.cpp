@@ -0,0 +1,232 @@
+﻿/*
+ * Copyright (c) 2016 The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/xia-chu/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <signal.h>
+#include <atomic>
+#include <iostream>
+#include "Util/logger.h"
+#include "Util/CMD.h"
+#include "Util/TimeTicker.h"
+#include "Common/config.h"
+#include "Common/MediaSource.h"
+
+using namespace std;
+using namespace toolkit;
+using namespace mediakit;
+
+class CMD_main : public CMD {
+public:
+    CMD_main() {
+        _parser.reset(new OptionParser(nullptr));
+
+        (*_parser) << Option('c',/*该选项简称，如果是\x00则说明无简称*/
+                             "count",/*该选项全称,每个选项必须有全称；不得为null或空字符串*/
+                             Option::ArgRequired,/*该选项后面必须跟值*/
+                             "1000",/*该选项默认值*/
+                             false,/*该选项是否必须赋值，如果没有默认值且为ArgRequired时用户必须提供该参数否则将抛异常*/
+                             "预先注册的媒体源个数",/*该选项说明文字*/
+                             nullptr);
+
+        (*_parser) << Option('t',/*该选项简称，如果是\x00则说明无简称*/
+                             "threads",/*该选项全称,每个选项必须有全称；不得为null或空字符串*/
+                             Option::ArgRequired,/*该选项后面必须跟值*/
+                             "16",/*该选项默认值*/
+                             false,/*该选项是否必须赋值，如果没有默认值且为ArgRequired时用户必须提供该参数否则将抛异常*/
+                             "最大查找线程数，从1开始每次翻倍测试",/*该选项说明文字*/
+                             nullptr);
+
+        (*_parser) << Option('d',/*该选项简称，如果是\x00则说明无简称*/
+                             "duration",/*该选项全称,每个选项必须有全称；不得为null或空字符串*/
+                             Option::ArgRequired,/*该选项后面必须跟值*/
+                             "2",/*该选项默认值*/
+                             false,/*该选项是否必须赋值，如果没有默认值且为ArgRequired时用户必须提供该参数否则将抛异常*/
+                             "每轮测试时长,单位秒",/*该选项说明文字*/
+                             nullptr);
+    }
+
+    ~CMD_main() override {}
+
+    const char *description() const override {
+        return "主程序命令参数";
+    }
+};
+
+class BenchMediaSource : public MediaSource {
+public:
+    using Ptr = std::shared_ptr<BenchMediaSource>;
+
+    BenchMediaSource(const string &app, const string &stream) : MediaSource(RTSP_SCHEMA, DEFAULT_VHOST, app, stream) {}
+    ~BenchMediaSource() override = default;
+
+    int readerCount() override { return 0; }
+    vector<Track::Ptr> getTracks(bool ready = true) const override { return vector<Track::Ptr>(); }
+    void regist() { MediaSource::regist(); }
+};
+
+//改造前的媒体源注册表：全局递归锁 + 四级嵌套map，用于对比
+class LegacyRegistry {
+public:
+    void regist(const MediaSource::Ptr &src) {
+        lock_guard<recursive_mutex> lck(_mtx);
+        _map[src->getSchema()][src->getVhost()][src->getApp()][src->getId()] = src;
+    }
+
+    void unregist(const MediaSource::Ptr &src) {
+        lock_guard<recursive_mutex> lck(_mtx);
+        _map[src->getSchema()][src->getVhost()][src->getApp()].erase(src->getId());
+    }
+
+    MediaSource::Ptr find(const string &schema, const string &vhost, const string &app, const string &stream) {
+        lock_guard<recursive_mutex> lck(_mtx);
+        auto it0 = _map.find(schema);
+        if (it0 == _map.end()) {
+            return nullptr;
+        }
+        auto it1 = it0->second.find(vhost);
+        if (it1 == it0->second.end()) {
+            return nullptr;
+        }
+        auto it2 = it1->second.find(app);
+        if (it2 == it1->second.end()) {
+            return nullptr;
+        }
+        auto it3 = it2->second.find(stream);
+        return it3 == it2->second.end() ? nullptr : it3->second.lock();
+    }
+
+    size_t list() {
+        deque<MediaSource::Ptr> ret;
+        lock_guard<recursive_mutex> lck(_mtx);
+        for (auto &pr0 : _map) {
+            for (auto &pr1 : pr0.second) {
+                for (auto &pr2 : pr1.second) {
+                    for (auto &pr3 : pr2.second) {
+                        if (auto src = pr3.second.lock()) {
+                            ret.emplace_back(std::move(src));
+                        }
+                    }
+                }
+            }
+        }
+        return ret.size();
+    }
+
+private:
+    recursive_mutex _mtx;
+    MediaSource::SchemaVhostAppStreamMap _map;
+};
+
+static LegacyRegistry s_legacy;
+
+static void bench(bool legacy, int threads, int duration, const vector<string> &streams) {
+    atomic<bool> exit_flag{false};
+    atomic<uint64_t> finds{0};
+    atomic<uint64_t> regists{0};
+    atomic<uint64_t> lists{0};
+
+    vector<thread> workers;
+    //查找线程，模拟海量播放器同时查找流
+    for (int i = 0; i < threads; ++i) {
+        workers.emplace_back([&, i]() {
+            uint64_t count = 0;
+            size_t index = i;
+            while (!exit_flag) {
+                auto &stream = streams[index++ % streams.size()];
+                auto src = legacy ? s_legacy.find(RTSP_SCHEMA, DEFAULT_VHOST, "live", stream)
+                                  : MediaSource::find(RTSP_SCHEMA, DEFAULT_VHOST, "live", stream);
+                if (!src) {
+                    throw std::runtime_error("media source not found:" + stream);
+                }
+                ++count;
+            }
+            finds += count;
+        });
+    }
+    //注册线程，模拟推流端频繁上下线
+    workers.emplace_back([&]() {
+        uint64_t count = 0;
+        while (!exit_flag) {
+            auto src = std::make_shared<BenchMediaSource>("churn", to_string(count % 100));
+            if (legacy) {
+                //与MediaSource::regist保持一致，同样触发注册与注销广播
+                s_legacy.regist(src);
+                NoticeCenter::Instance().emitEvent(Broadcast::kBroadcastMediaChanged, true, *src);
+                s_legacy.unregist(src);
+                NoticeCenter::Instance().emitEvent(Broadcast::kBroadcastMediaChanged, false, *src);
+            } else {
+                //析构时自动注销
+                src->regist();
+            }
+            ++count;
+        }
+        regists += count;
+    });
+    //遍历线程，模拟getMediaList接口
+    workers.emplace_back([&]() {
+        uint64_t count = 0;
+        while (!exit_flag) {
+            if (legacy) {
+                s_legacy.list();
+            } else {
+                MediaSource::for_each_media([](const MediaSource::Ptr &src) {});
+            }
+            ++count;
+        }
+        lists += count;
+    });
+
+    this_thread::sleep_for(chrono::seconds(duration));
+    exit_flag = true;
+    for (auto &worker : workers) {
+        worker.join();
+    }
+
+    cout << (legacy ? "legacy " : "sharded") << " find threads:" << threads
+         << " finds/sec:" << finds / duration
+         << " regists/sec:" << regists / duration
+         << " lists/sec:" << lists / duration << endl;
+}
+
+//此程序用于测试媒体源注册表在并发查找、注册、遍历时的吞吐量
+int main(int argc, char *argv[]) {
+    CMD_main cmd_main;
+    try {
+        cmd_main.operator()(argc, argv);
+    } catch (ExitException &) {
+        return 0;
+    } catch (std::exception &ex) {
+        cout << ex.what() << endl;
+        return -1;
+    }
+
+    auto count = cmd_main["count"].as<int>();
+    auto max_threads = cmd_main["threads"].as<int>();
+    auto duration = cmd_main["duration"].as<int>();
+
+    //媒体注册日志太多，只打印警告以上日志
+    Logger::Instance().add(std::make_shared<ConsoleChannel>("ConsoleChannel", LWarn));
+    Logger::Instance().setWriter(std::make_shared<AsyncLogWriter>());
+
+    vector<string> streams;
+    vector<BenchMediaSource::Ptr> sources;
+    for (int i = 0; i < count; ++i) {
+        streams.emplace_back("stream_" + to_string(i));
+        auto src = std::make_shared<BenchMediaSource>("live", streams.back());
+        src->regist();
+        s_legacy.regist(src);
+        sources.emplace_back(std::move(src));
+    }
+
+    for (int threads = 1; threads <= max_threads; threads *= 2) {
+        bench(true, threads, duration, streams);
+        bench(false, threads, duration, streams);
+    }
+    return 0;
+}
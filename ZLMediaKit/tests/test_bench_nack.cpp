@@ -0,0 +1,164 @@
+﻿/*
+ * Copyright (c) 2016 The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/xia-chu/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <chrono>
+#include <iostream>
+#include "Util/logger.h"
+#include "Util/CMD.h"
+#include "Rtcp/RtcpFCI.h"
+#include "../webrtc/Nack.h"
+
+using namespace std;
+using namespace toolkit;
+using namespace mediakit;
+
+class CMD_main : public CMD {
+public:
+    CMD_main() {
+        _parser.reset(new OptionParser(nullptr));
+
+        (*_parser) << Option('p',/*该选项简称，如果是\x00则说明无简称*/
+                             "peers",/*该选项全称,每个选项必须有全称；不得为null或空字符串*/
+                             Option::ArgRequired,/*该选项后面必须跟值*/
+                             "1000",/*该选项默认值*/
+                             false,/*该选项是否必须赋值，如果没有默认值且为ArgRequired时用户必须提供该参数否则将抛异常*/
+                             "模拟的webrtc peer个数",/*该选项说明文字*/
+                             nullptr);
+
+        (*_parser) << Option('n',/*该选项简称，如果是\x00则说明无简称*/
+                             "packets",/*该选项全称,每个选项必须有全称；不得为null或空字符串*/
+                             Option::ArgRequired,/*该选项后面必须跟值*/
+                             "10000",/*该选项默认值*/
+                             false,/*该选项是否必须赋值，如果没有默认值且为ArgRequired时用户必须提供该参数否则将抛异常*/
+                             "每个peer发送的rtp包个数",/*该选项说明文字*/
+                             nullptr);
+
+        (*_parser) << Option('l',/*该选项简称，如果是\x00则说明无简称*/
+                             "loss",/*该选项全称,每个选项必须有全称；不得为null或空字符串*/
+                             Option::ArgRequired,/*该选项后面必须跟值*/
+                             "5",/*该选项默认值*/
+                             false,/*该选项是否必须赋值，如果没有默认值且为ArgRequired时用户必须提供该参数否则将抛异常*/
+                             "丢包率(百分比)，重传包同样按该比例丢失",/*该选项说明文字*/
+                             nullptr);
+    }
+
+    ~CMD_main() override {}
+
+    const char *description() const override {
+        return "主程序命令参数";
+    }
+};
+
+//rtp包发送间隔，单位毫秒，相当于每秒200个包的视频流
+static constexpr uint32_t kPacketIntervalMS = 5;
+
+//一个peer的发送端与接收端，发送端缓存rtp用于重传，接收端检测丢包并发送nack
+class Peer {
+public:
+    Peer() {
+        ctx.setOnNack([this](const FCI_NACK &nack) {
+            //nack通过网络到达发送端需要时间，先缓存起来
+            nacks.emplace_back(nack);
+        });
+    }
+
+    NackList list;
+    NackContext ctx;
+    vector<FCI_NACK> nacks;
+};
+
+static bool isLost(int loss) {
+    return rand() % 100 < loss;
+}
+
+//此程序模拟多个webrtc peer在丢包情况下的nack处理，用于测试NackList与NackContext的性能
+int main(int argc, char *argv[]) {
+    CMD_main cmd_main;
+    try {
+        cmd_main.operator()(argc, argv);
+    } catch (ExitException &) {
+        return 0;
+    } catch (std::exception &ex) {
+        cout << ex.what() << endl;
+        return -1;
+    }
+
+    auto peer_count = cmd_main["peers"].as<int>();
+    auto packets = cmd_main["packets"].as<int>();
+    auto loss = cmd_main["loss"].as<int>();
+
+    //设置日志
+    Logger::Instance().add(std::make_shared<ConsoleChannel>());
+    //启动异步日志线程
+    Logger::Instance().setWriter(std::make_shared<AsyncLogWriter>());
+
+    srand((unsigned) time(NULL));
+    vector<std::shared_ptr<Peer> > peers;
+    for (int i = 0; i < peer_count; ++i) {
+        peers.emplace_back(std::make_shared<Peer>());
+    }
+
+    uint64_t lost = 0, nack_count = 0, rtx = 0, rtx_lost = 0, used_ns = 0;
+    vector<RtpPacket::Ptr> rtps(peer_count);
+    //seq从接近回环处开始，覆盖16位seq回环
+    uint16_t seq = UINT16_MAX - 1000;
+    for (int i = 0; i < packets; ++i, ++seq) {
+        //创建rtp包不计入耗时，真实场景中rtp包由打包器生成
+        for (auto &rtp : rtps) {
+            rtp = RtpPacket::create();
+            rtp->setCapacity(RtpPacket::kRtpTcpHeaderSize + RtpPacket::kRtpHeaderSize);
+            rtp->setSize(RtpPacket::kRtpTcpHeaderSize + RtpPacket::kRtpHeaderSize);
+            memset(rtp->data(), 0, rtp->size());
+            rtp->getHeader()->seq = htons(seq);
+            rtp->ntp_stamp = (uint64_t) i * kPacketIntervalMS;
+        }
+
+        auto start = chrono::steady_clock::now();
+        for (int j = 0; j < peer_count; ++j) {
+            auto &peer = peers[j];
+            peer->list.push_back(std::move(rtps[j]));
+            if (isLost(loss)) {
+                ++lost;
+                continue;
+            }
+            peer->ctx.received(seq);
+            if (peer->nacks.empty()) {
+                continue;
+            }
+            //发送端收到nack，从缓存中找出rtp重传
+            for (auto &nack : peer->nacks) {
+                ++nack_count;
+                peer->list.for_each_nack(nack, [&](const RtpPacket::Ptr &rtp) {
+                    if (isLost(loss)) {
+                        ++rtx_lost;
+                        return;
+                    }
+                    ++rtx;
+                    peer->ctx.received(rtp->getSeq(), true);
+                });
+            }
+            peer->nacks.clear();
+        }
+        if (i % 20 == 0) {
+            //模拟nack定时器
+            for (auto &peer : peers) {
+                peer->ctx.reSendNack();
+            }
+        }
+        used_ns += chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+    }
+
+    auto total = (uint64_t) peer_count * packets;
+    InfoL << "peers:" << peer_count << " packets:" << total << " lost:" << lost << " nack:" << nack_count
+          << " rtx received:" << rtx << " rtx lost:" << rtx_lost;
+    InfoL << "used:" << used_ns / 1000 / 1000 << "ms, packets/sec:" << (used_ns ? total * 1000 * 1000 * 1000 / used_ns : 0)
+          << ", ns/packet:" << (total ? used_ns / total : 0);
+    return 0;
+}
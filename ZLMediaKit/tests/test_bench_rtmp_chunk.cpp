@@ -0,0 +1,187 @@
+﻿/*
+ * Copyright (c) 2016 The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/xia-chu/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <iostream>
+#include "Util/logger.h"
+#include "Util/CMD.h"
+#include "Util/TimeTicker.h"
+#include "Util/NoticeCenter.h"
+#include "Common/config.h"
+#include "Rtmp/RtmpProtocol.h"
+
+using namespace std;
+using namespace toolkit;
+using namespace mediakit;
+
+class CMD_main : public CMD {
+public:
+    CMD_main() {
+        _parser.reset(new OptionParser(nullptr));
+
+        (*_parser) << Option('c',/*该选项简称，如果是\x00则说明无简称*/
+                             "chunk",/*该选项全称,每个选项必须有全称；不得为null或空字符串*/
+                             Option::ArgRequired,/*该选项后面必须跟值*/
+                             to_string(DEFAULT_CHUNK_LEN).data(),/*该选项默认值*/
+                             false,/*该选项是否必须赋值，如果没有默认值且为ArgRequired时用户必须提供该参数否则将抛异常*/
+                             "推流端chunk大小",/*该选项说明文字*/
+                             nullptr);
+
+        (*_parser) << Option('b',/*该选项简称，如果是\x00则说明无简称*/
+                             "bitrate",/*该选项全称,每个选项必须有全称；不得为null或空字符串*/
+                             Option::ArgRequired,/*该选项后面必须跟值*/
+                             "2000",/*该选项默认值*/
+                             false,/*该选项是否必须赋值，如果没有默认值且为ArgRequired时用户必须提供该参数否则将抛异常*/
+                             "模拟视频码率,单位kbps(25fps,2秒一个关键帧,关键帧为普通帧的10倍)",/*该选项说明文字*/
+                             nullptr);
+
+        (*_parser) << Option('r',/*该选项简称，如果是\x00则说明无简称*/
+                             "recv",/*该选项全称,每个选项必须有全称；不得为null或空字符串*/
+                             Option::ArgRequired,/*该选项后面必须跟值*/
+                             "16384",/*该选项默认值*/
+                             false,/*该选项是否必须赋值，如果没有默认值且为ArgRequired时用户必须提供该参数否则将抛异常*/
+                             "每次输入解析器的字节数,模拟每次socket读取的数据量",/*该选项说明文字*/
+                             nullptr);
+
+        (*_parser) << Option('d',/*该选项简称，如果是\x00则说明无简称*/
+                             "duration",/*该选项全称,每个选项必须有全称；不得为null或空字符串*/
+                             Option::ArgRequired,/*该选项后面必须跟值*/
+                             "3",/*该选项默认值*/
+                             false,/*该选项是否必须赋值，如果没有默认值且为ArgRequired时用户必须提供该参数否则将抛异常*/
+                             "每种重组模式测试时长,单位秒",/*该选项说明文字*/
+                             nullptr);
+    }
+
+    ~CMD_main() override {}
+
+    const char *description() const override {
+        return "主程序命令参数";
+    }
+};
+
+//在内存中收发rtmp数据的协议对象
+class LoopbackRtmp : public RtmpProtocol {
+public:
+    using RtmpProtocol::sendRtmp;
+    using RtmpProtocol::sendChunkSize;
+
+    function<void(const Buffer::Ptr &buffer)> on_send;
+    function<void(const RtmpPacket::Ptr &packet)> on_packet;
+
+protected:
+    void onSendRawData(Buffer::Ptr buffer) override {
+        on_send(buffer);
+    }
+
+    void onRtmpChunk(RtmpPacket::Ptr packet) override {
+        on_packet(packet);
+    }
+};
+
+//完成客户端与服务端的握手，双方的输出都先缓存再交给对端，防止解析器重入
+static void handshake(LoopbackRtmp &client, LoopbackRtmp &server) {
+    string to_server, to_client;
+    client.on_send = [&](const Buffer::Ptr &buffer) { to_server.append(buffer->data(), buffer->size()); };
+    server.on_send = [&](const Buffer::Ptr &buffer) { to_client.append(buffer->data(), buffer->size()); };
+    bool done = false;
+    client.startClientSession([&]() { done = true; });
+    while (!to_server.empty() || !to_client.empty()) {
+        auto data = std::move(to_server);
+        to_server.clear();
+        server.onParseRtmp(data.data(), data.size());
+        data = std::move(to_client);
+        to_client.clear();
+        client.onParseRtmp(data.data(), data.size());
+    }
+    if (!done) {
+        throw std::runtime_error("rtmp handshake failed");
+    }
+}
+
+//生成2秒(50帧视频、86帧音频)的rtmp chunk流
+static string makeChunkStream(LoopbackRtmp &client, int kbps, size_t &messages, size_t &buffers) {
+    string ret;
+    client.on_send = [&](const Buffer::Ptr &buffer) {
+        ret.append(buffer->data(), buffer->size());
+        ++buffers;
+    };
+    //2秒共(10 + 49)个单位
+    auto unit = MAX(16, kbps * 1000 / 8 * 2 / 59);
+    string payload(unit * 10, (char) 0x17);
+    for (int i = 0; i < 50; ++i) {
+        auto size = i == 0 ? unit * 10 : unit;
+        client.sendRtmp(MSG_VIDEO, STREAM_MEDIA, std::make_shared<BufferString>(payload.substr(0, size)), i * 40, CHUNK_VIDEO);
+        ++messages;
+        //aac每帧约23ms
+        while (messages - 1 - i < (size_t) ((i + 1) * 40 / 23)) {
+            client.sendRtmp(MSG_AUDIO, STREAM_MEDIA, std::make_shared<BufferString>(payload.substr(0, 300)), i * 40, CHUNK_AUDIO);
+            ++messages;
+        }
+    }
+    return ret;
+}
+
+static void bench(const string &name, bool reserve, const string &stream, size_t recv_size, int duration) {
+    mINI::Instance()[Rtmp::kReserveChunkBody] = reserve;
+    NoticeCenter::Instance().emitEvent(Broadcast::kBroadcastReloadConfig);
+
+    LoopbackRtmp client, server;
+    handshake(client, server);
+    uint64_t bytes = 0, packets = 0;
+    server.on_packet = [&](const RtmpPacket::Ptr &packet) { ++packets; };
+
+    Ticker ticker;
+    while (ticker.elapsedTime() < (uint64_t) duration * 1000) {
+        for (size_t offset = 0; offset < stream.size(); offset += recv_size) {
+            server.onParseRtmp(stream.data() + offset, MIN(recv_size, stream.size() - offset));
+        }
+        bytes += stream.size();
+    }
+    auto elapsed_sec = ticker.elapsedTime() / 1000.0;
+    InfoL << name << " MB/s:" << bytes / elapsed_sec / 1000000.0 << " messages/s:" << (uint64_t) (packets / elapsed_sec)
+          << " 单核可承载2秒码流的推流数:" << (uint64_t) (bytes / stream.size() / elapsed_sec * 2);
+}
+
+//此程序用于测试rtmp chunk重组(推流收流)的性能
+int main(int argc, char *argv[]) {
+    CMD_main cmd_main;
+    try {
+        cmd_main.operator()(argc, argv);
+    } catch (ExitException &) {
+        return 0;
+    } catch (std::exception &ex) {
+        cout << ex.what() << endl;
+        return -1;
+    }
+
+    //设置日志
+    Logger::Instance().add(std::make_shared<ConsoleChannel>("ConsoleChannel", LInfo));
+
+    auto chunk = cmd_main["chunk"].as<uint32_t>();
+    auto kbps = cmd_main["bitrate"].as<int>();
+    auto recv_size = MAX(1, cmd_main["recv"].as<size_t>());
+    auto duration = cmd_main["duration"].as<int>();
+
+    LoopbackRtmp client, server;
+    handshake(client, server);
+    string stream;
+    size_t messages = 0, buffers = 0;
+    server.on_packet = [](const RtmpPacket::Ptr &packet) {};
+    if (chunk != DEFAULT_CHUNK_LEN) {
+        client.on_send = [&](const Buffer::Ptr &buffer) { stream.append(buffer->data(), buffer->size()); };
+        client.sendChunkSize(chunk);
+    }
+    stream.append(makeChunkStream(client, kbps, messages, buffers));
+    InfoL << "chunk大小:" << chunk << " 2秒码流:" << stream.size() << "字节 消息数:" << messages
+          << " 发送buffer数:" << buffers;
+
+    bench("逐chunk追加", false, stream, recv_size, duration);
+    bench("按消息长度预留", true, stream, recv_size, duration);
+    return 0;
+}
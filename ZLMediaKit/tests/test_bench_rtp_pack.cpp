@@ -0,0 +1,242 @@
+﻿/*
+ * Copyright (c) 2016 The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/xia-chu/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <signal.h>
+#include <thread>
+#include <iostream>
+#include <sys/socket.h>
+#include "Util/logger.h"
+#include "Util/CMD.h"
+#include "Util/TimeTicker.h"
+#include "Network/Buffer.h"
+#include "Extension/H264Rtp.h"
+
+using namespace std;
+using namespace toolkit;
+using namespace mediakit;
+
+class CMD_main : public CMD {
+public:
+    CMD_main() {
+        _parser.reset(new OptionParser(nullptr));
+
+        (*_parser) << Option('s',/*该选项简称，如果是\x00则说明无简称*/
+                             "size",/*该选项全称,每个选项必须有全称；不得为null或空字符串*/
+                             Option::ArgRequired,/*该选项后面必须跟值*/
+                             "300000",/*该选项默认值*/
+                             false,/*该选项是否必须赋值，如果没有默认值且为ArgRequired时用户必须提供该参数否则将抛异常*/
+                             "帧大小(4K 20Mbps关键帧约300KB)",/*该选项说明文字*/
+                             nullptr);
+
+        (*_parser) << Option('d',/*该选项简称，如果是\x00则说明无简称*/
+                             "duration",/*该选项全称,每个选项必须有全称；不得为null或空字符串*/
+                             Option::ArgRequired,/*该选项后面必须跟值*/
+                             "3",/*该选项默认值*/
+                             false,/*该选项是否必须赋值，如果没有默认值且为ArgRequired时用户必须提供该参数否则将抛异常*/
+                             "每种打包方式测试时长,单位秒",/*该选项说明文字*/
+                             nullptr);
+    }
+
+    ~CMD_main() override {}
+
+    const char *description() const override {
+        return "主程序命令参数";
+    }
+};
+
+//收集打包生成的rtp包
+class RtpRingDelegateHelper : public RingDelegate<RtpPacket::Ptr> {
+public:
+    RtpRingDelegateHelper(function<void(const RtpPacket::Ptr &rtp)> cb) : _cb(std::move(cb)) {}
+
+    void onWrite(RtpPacket::Ptr rtp, bool is_key) override {
+        _cb(rtp);
+    }
+
+private:
+    function<void(const RtpPacket::Ptr &rtp)> _cb;
+};
+
+class H264RtpEncoderHelper : public H264RtpEncoder {
+public:
+    H264RtpEncoderHelper(function<void(const RtpPacket::Ptr &rtp)> cb) : H264RtpEncoder(0x12345678) {
+        auto ring = std::make_shared<RingType>();
+        ring->setDelegate(std::make_shared<RtpRingDelegateHelper>(std::move(cb)));
+        setRtpRing(ring);
+    }
+};
+
+static Frame::Ptr makeFrame(uint8_t nal_header, size_t size, uint32_t stamp) {
+    auto frame = FrameImp::create<H264Frame>();
+    frame->_prefix_size = 4;
+    frame->_dts = stamp;
+    frame->_buffer.assign("\x00\x00\x00\x01", 4);
+    frame->_buffer.push_back(nal_header);
+    for (size_t i = 1; i < size; ++i) {
+        frame->_buffer.push_back((char) (rand() & 0xFF));
+    }
+    return frame;
+}
+
+static string getGatherData(const RtpPacket::Ptr &rtp) {
+    struct iovec iov[Buffer::kMaxIovecCount];
+    auto count = rtp->getIovec(iov);
+    string ret;
+    for (size_t i = 0; i < count; ++i) {
+        ret.append((char *) iov[i].iov_base, iov[i].iov_len);
+    }
+    return ret;
+}
+
+//校验分散聚集发送的数据与连续内存一致，并且解包后与原始帧一致
+static bool check(size_t frame_size) {
+    vector<Frame::Ptr> frames;
+    frames.emplace_back(makeFrame(0x67, 20, 0));
+    frames.emplace_back(makeFrame(0x68, 4, 0));
+    frames.emplace_back(makeFrame(0x65, frame_size, 0));
+    for (int i = 1; i < 10; ++i) {
+        frames.emplace_back(makeFrame(0x41, frame_size / 10 * i, i * 40));
+    }
+
+    vector<RtpPacket::Ptr> rtps;
+    H264RtpEncoderHelper encoder([&](const RtpPacket::Ptr &rtp) { rtps.emplace_back(rtp); });
+    for (auto &frame : frames) {
+        encoder.inputFrame(frame);
+    }
+    //最后一帧需要等待下一帧才能确定mark位
+    encoder.inputFrame(makeFrame(0x41, 100, 10 * 40));
+
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == -1) {
+        ErrorL << "socketpair failed:" << get_uv_errmsg();
+        return false;
+    }
+    string expect, received;
+    List<std::pair<Buffer::Ptr, bool> > pkt_list;
+    for (auto &rtp : rtps) {
+        auto gather = getGatherData(rtp);
+        if (gather != string(rtp->data(), rtp->size())) {
+            ErrorL << "gather data mismatch, seq:" << rtp->getSeq();
+            return false;
+        }
+        expect.append(gather);
+        pkt_list.emplace_back(rtp, false);
+    }
+    //通过rtsp over tcp发送时使用的BufferList发送，校验接收端收到的数据
+    thread reader([&]() {
+        char buf[64 * 1024];
+        while (received.size() < expect.size()) {
+            auto n = recv(fds[1], buf, sizeof(buf), 0);
+            if (n <= 0) {
+                break;
+            }
+            received.append(buf, n);
+        }
+    });
+    BufferList buffer_list(pkt_list);
+    while (!buffer_list.empty()) {
+        if (buffer_list.send(fds[0], 0, false) == -1 && get_uv_error(true) != UV_EAGAIN) {
+            break;
+        }
+    }
+    reader.join();
+    close(fds[0]);
+    close(fds[1]);
+    if (received != expect) {
+        ErrorL << "rtsp over tcp data mismatch, expect:" << expect.size() << " received:" << received.size();
+        return false;
+    }
+
+    vector<Frame::Ptr> decoded;
+    H264RtpDecoder decoder;
+    decoder.addDelegate(std::make_shared<FrameWriterInterfaceHelper>([&](const Frame::Ptr &frame) {
+        decoded.emplace_back(Frame::getCacheAbleFrame(frame));
+    }));
+    for (auto &rtp : rtps) {
+        decoder.inputRtp(rtp);
+    }
+    if (decoded.size() < frames.size()) {
+        ErrorL << "decoded frame count mismatch:" << decoded.size() << " != " << frames.size();
+        return false;
+    }
+    for (size_t i = 0; i < frames.size(); ++i) {
+        if (string(frames[i]->data(), frames[i]->size()) != string(decoded[i]->data(), decoded[i]->size())) {
+            ErrorL << "decoded frame mismatch, index:" << i;
+            return false;
+        }
+    }
+    InfoL << "check success, frames:" << frames.size() << " rtp packets:" << rtps.size() << " bytes:" << expect.size();
+    return true;
+}
+
+//flatten为true时，每个rtp包都拼接一次连续内存，相当于改造前逐分片拷贝的开销
+static void bench(size_t frame_size, bool flatten, int duration) {
+    uint64_t packets = 0;
+    uint64_t bytes = 0;
+    H264RtpEncoderHelper encoder([&](const RtpPacket::Ptr &rtp) {
+        ++packets;
+        if (flatten) {
+            bytes += rtp->data() ? rtp->size() : 0;
+        } else {
+            struct iovec iov[Buffer::kMaxIovecCount];
+            auto count = rtp->getIovec(iov);
+            for (size_t i = 0; i < count; ++i) {
+                bytes += iov[i].iov_len;
+            }
+        }
+    });
+
+    vector<Frame::Ptr> frames;
+    for (int i = 0; i < 8; ++i) {
+        frames.emplace_back(makeFrame(i ? 0x41 : 0x65, frame_size, 0));
+    }
+
+    uint64_t frame_count = 0;
+    Ticker ticker;
+    while (ticker.elapsedTime() < (uint64_t) duration * 1000) {
+        auto &frame = frames[frame_count % frames.size()];
+        static_pointer_cast<FrameImp>(frame)->_dts = (uint32_t) frame_count * 40;
+        encoder.inputFrame(frame);
+        ++frame_count;
+    }
+    auto elapsed_sec = ticker.elapsedTime() / 1000.0;
+    InfoL << (flatten ? "copy payload" : "ref payload ")
+          << " frames/sec:" << (uint64_t) (frame_count / elapsed_sec)
+          << " rtp/sec:" << (uint64_t) (packets / elapsed_sec)
+          << " MB/s:" << bytes / elapsed_sec / 1024 / 1024;
+}
+
+//此程序用于校验与测试H264 rtp打包时负载直接引用帧数据(免拷贝)的正确性与性能
+int main(int argc, char *argv[]) {
+    CMD_main cmd_main;
+    try {
+        cmd_main.operator()(argc, argv);
+    } catch (ExitException &) {
+        return 0;
+    } catch (std::exception &ex) {
+        cout << ex.what() << endl;
+        return -1;
+    }
+
+    auto frame_size = cmd_main["size"].as<size_t>();
+    auto duration = cmd_main["duration"].as<int>();
+
+    //设置日志
+    Logger::Instance().add(std::make_shared<ConsoleChannel>());
+    //启动异步日志线程
+    Logger::Instance().setWriter(std::make_shared<AsyncLogWriter>());
+
+    if (!check(frame_size)) {
+        return -1;
+    }
+    bench(frame_size, true, duration);
+    bench(frame_size, false, duration);
+    return 0;
+}
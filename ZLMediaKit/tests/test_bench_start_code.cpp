@@ -0,0 +1,215 @@
+﻿/*
+ * Copyright (c) 2016 The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/xia-chu/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <signal.h>
+#include <string.h>
+#include <iostream>
+#include "Util/logger.h"
+#include "Util/CMD.h"
+#include "Util/TimeTicker.h"
+#include "Extension/H264.h"
+#include "Extension/StartCode.h"
+
+using namespace std;
+using namespace toolkit;
+using namespace mediakit;
+
+class CMD_main : public CMD {
+public:
+    CMD_main() {
+        _parser.reset(new OptionParser(nullptr));
+
+        (*_parser) << Option('s',/*该选项简称，如果是\x00则说明无简称*/
+                             "size",/*该选项全称,每个选项必须有全称；不得为null或空字符串*/
+                             Option::ArgRequired,/*该选项后面必须跟值*/
+                             "4194304",/*该选项默认值*/
+                             false,/*该选项是否必须赋值，如果没有默认值且为ArgRequired时用户必须提供该参数否则将抛异常*/
+                             "关键帧大小(4K关键帧一般为数MB)",/*该选项说明文字*/
+                             nullptr);
+
+        (*_parser) << Option('n',/*该选项简称，如果是\x00则说明无简称*/
+                             "slices",/*该选项全称,每个选项必须有全称；不得为null或空字符串*/
+                             Option::ArgRequired,/*该选项后面必须跟值*/
+                             "8",/*该选项默认值*/
+                             false,/*该选项是否必须赋值，如果没有默认值且为ArgRequired时用户必须提供该参数否则将抛异常*/
+                             "关键帧slice个数，每个slice以起始码开头",/*该选项说明文字*/
+                             nullptr);
+
+        (*_parser) << Option('d',/*该选项简称，如果是\x00则说明无简称*/
+                             "duration",/*该选项全称,每个选项必须有全称；不得为null或空字符串*/
+                             Option::ArgRequired,/*该选项后面必须跟值*/
+                             "2",/*该选项默认值*/
+                             false,/*该选项是否必须赋值，如果没有默认值且为ArgRequired时用户必须提供该参数否则将抛异常*/
+                             "每种查找方式测试时长,单位秒",/*该选项说明文字*/
+                             nullptr);
+    }
+
+    ~CMD_main() override {}
+
+    const char *description() const override {
+        return "主程序命令参数";
+    }
+};
+
+//改造前的查找方式，逐字节memcmp，用于对比
+static const char *memfind(const char *buf, ssize_t len, const char *subbuf, ssize_t sublen) {
+    for (auto i = 0; i < len - sublen; ++i) {
+        if (memcmp(buf + i, subbuf, sublen) == 0) {
+            return buf + i;
+        }
+    }
+    return NULL;
+}
+
+//生成带防竞争字节的随机slice数据，不含起始码
+static void appendSliceData(string &frame, size_t size) {
+    size_t zero_count = 0;
+    for (size_t i = 0; i < size; ++i) {
+        //适当提高0x00出现的概率，模拟真实码流
+        auto byte = (uint8_t) (rand() % 5 == 0 ? 0 : rand() & 0xFF);
+        if (zero_count >= 2 && byte <= 3) {
+            //00 00后面出现00/01/02/03时插入防竞争字节03
+            frame.push_back(0x03);
+            zero_count = 0;
+        }
+        frame.push_back((char) byte);
+        zero_count = byte ? 0 : zero_count + 1;
+    }
+    if (zero_count) {
+        //slice不能以0x00结尾
+        frame.push_back(0x80);
+    }
+}
+
+//生成一个由sps、pps以及多个slice组成的4K关键帧
+static string makeFrame(size_t size, int slices) {
+    string frame;
+    frame.append("\x00\x00\x00\x01\x67", 5);
+    appendSliceData(frame, 20);
+    frame.append("\x00\x00\x00\x01\x68", 5);
+    appendSliceData(frame, 4);
+    for (int i = 0; i < slices; ++i) {
+        //第一个slice使用4字节起始码，其他slice使用3字节起始码
+        frame.append(i ? "\x00\x00\x01\x65" : "\x00\x00\x00\x01\x65", i ? 4 : 5);
+        appendSliceData(frame, size / slices);
+    }
+    return frame;
+}
+
+using FindFunc = function<const char *(const char *ptr, size_t len)>;
+
+//返回所有起始码位置
+static vector<size_t> findAll(const string &frame, const FindFunc &func) {
+    vector<size_t> ret;
+    auto ptr = frame.data();
+    auto end = frame.data() + frame.size();
+    while (true) {
+        auto pos = func(ptr, end - ptr);
+        if (!pos) {
+            break;
+        }
+        ret.emplace_back(pos - frame.data());
+        ptr = pos + 3;
+    }
+    return ret;
+}
+
+static void bench(const string &name, const string &frame, const FindFunc &func, int duration) {
+    uint64_t bytes = 0;
+    uint64_t count = 0;
+    Ticker ticker;
+    while (ticker.elapsedTime() < (uint64_t) duration * 1000) {
+        count += findAll(frame, func).size();
+        bytes += frame.size();
+    }
+    auto elapsed_sec = ticker.elapsedTime() / 1000.0;
+    InfoL << name << " GB/s:" << bytes / elapsed_sec / 1000000000.0 << " start codes:" << count;
+}
+
+//此程序用于校验与测试annexb起始码查找的正确性与性能
+int main(int argc, char *argv[]) {
+    CMD_main cmd_main;
+    try {
+        cmd_main.operator()(argc, argv);
+    } catch (ExitException &) {
+        return 0;
+    } catch (std::exception &ex) {
+        cout << ex.what() << endl;
+        return -1;
+    }
+
+    auto size = cmd_main["size"].as<size_t>();
+    auto slices = std::max(cmd_main["slices"].as<int>(), 1);
+    auto duration = cmd_main["duration"].as<int>();
+
+    //设置日志
+    Logger::Instance().add(std::make_shared<ConsoleChannel>());
+    //启动异步日志线程
+    Logger::Instance().setWriter(std::make_shared<AsyncLogWriter>());
+
+    auto frame = makeFrame(size, slices);
+    InfoL << "frame size:" << frame.size() << " cpu simd:" << getStartCodeSimdName(getStartCodeSimd());
+
+    vector<pair<string, FindFunc> > funcs;
+    funcs.emplace_back("memfind", [](const char *ptr, size_t len) -> const char * {
+        //memfind不会查找最后一个位置，多传入一个字节以便结果可比
+        return memfind(ptr, len + 1, "\x00\x00\x01", 3);
+    });
+    for (auto simd : {StartCodeScalar, StartCodeSSE2, StartCodeAVX2}) {
+        if (simd > getStartCodeSimd()) {
+            break;
+        }
+        funcs.emplace_back(getStartCodeSimdName(simd), [simd](const char *ptr, size_t len) {
+            return findStartCode(ptr, len, simd);
+        });
+    }
+
+    //校验各实现结果一致，并且与构造的帧结构一致
+    auto expect = findAll(frame, funcs[0].second);
+    if (expect.size() != (size_t) slices + 2) {
+        ErrorL << "start code count mismatch:" << expect.size() << " != " << slices + 2;
+        return -1;
+    }
+    for (auto &pr : funcs) {
+        if (findAll(frame, pr.second) != expect) {
+            ErrorL << pr.first << " result mismatch";
+            return -1;
+        }
+        //所有长度与偏移组合，覆盖simd尾部处理逻辑
+        for (size_t offset = 0; offset < 40; ++offset) {
+            for (size_t len = 0; len < 80; ++len) {
+                string sub = frame.substr(0, 200);
+                auto ptr = sub.data() + offset;
+                auto ret = pr.second(ptr, len);
+                auto ref = funcs[0].second(ptr, len);
+                if (ret != ref) {
+                    ErrorL << pr.first << " result mismatch, offset:" << offset << " len:" << len;
+                    return -1;
+                }
+            }
+        }
+    }
+
+    //splitH264的结果与帧结构一致
+    size_t nalus = 0;
+    splitH264(frame.data(), frame.size(), 4, [&](const char *ptr, size_t len, size_t prefix) {
+        ++nalus;
+    });
+    if (nalus != (size_t) slices + 2) {
+        ErrorL << "splitH264 nalu count mismatch:" << nalus << " != " << slices + 2;
+        return -1;
+    }
+    InfoL << "check success, start codes:" << expect.size();
+
+    for (auto &pr : funcs) {
+        bench(pr.first, frame, pr.second, duration);
+    }
+    return 0;
+}
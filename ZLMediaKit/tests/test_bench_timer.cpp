@@ -0,0 +1,144 @@
+﻿/*
+ * Copyright (c) 2016 The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/xia-chu/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <map>
+#include <chrono>
+#include <random>
+#include <iostream>
+#include "Util/logger.h"
+#include "Util/CMD.h"
+#include "Poller/TimingWheel.h"
+
+using namespace std;
+using namespace toolkit;
+
+class CMD_main : public CMD {
+public:
+    CMD_main() {
+        _parser.reset(new OptionParser(nullptr));
+
+        (*_parser) << Option('n',/*该选项简称，如果是\x00则说明无简称*/
+                             "timers",/*该选项全称,每个选项必须有全称；不得为null或空字符串*/
+                             Option::ArgRequired,/*该选项后面必须跟值*/
+                             "50000",/*该选项默认值*/
+                             false,/*该选项是否必须赋值，如果没有默认值且为ArgRequired时用户必须提供该参数否则将抛异常*/
+                             "定时器个数(模拟的会话个数)",/*该选项说明文字*/
+                             nullptr);
+
+        (*_parser) << Option('s',/*该选项简称，如果是\x00则说明无简称*/
+                             "seconds",/*该选项全称,每个选项必须有全称；不得为null或空字符串*/
+                             Option::ArgRequired,/*该选项后面必须跟值*/
+                             "15",/*该选项默认值*/
+                             false,/*该选项是否必须赋值，如果没有默认值且为ArgRequired时用户必须提供该参数否则将抛异常*/
+                             "定时器的最长超时时间,单位秒",/*该选项说明文字*/
+                             nullptr);
+    }
+
+    ~CMD_main() override {}
+
+    const char *description() const override {
+        return "主程序命令参数";
+    }
+};
+
+//原EventPoller的实现，按到期时间排序的multimap
+class TimerMap {
+public:
+    void add(uint64_t expire_ms, DelayTask::Ptr task) {
+        _map.emplace(expire_ms, std::move(task));
+    }
+
+    void expire(uint64_t now_ms, List<DelayTask::Ptr> &out) {
+        for (auto it = _map.begin(); it != _map.end() && it->first <= now_ms; it = _map.erase(it)) {
+            if (*it->second) {
+                out.emplace_back(std::move(it->second));
+            }
+        }
+    }
+
+    uint64_t nextTime() {
+        return _map.empty() ? 0 : _map.begin()->first;
+    }
+
+private:
+    multimap<uint64_t, DelayTask::Ptr> _map;
+};
+
+static uint64_t elapsedNS(const chrono::steady_clock::time_point &start) {
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+}
+
+//模拟大量会话的空闲超时定时器：添加、取消一半、逐毫秒推进时间直到全部到期，任务对象预先创建，只统计定时器本身的开销
+template<typename Timers>
+static void bench(const char *name, const vector<DelayTask::Ptr> &tasks, const vector<uint64_t> &delays, int rounds) {
+    uint64_t add_ns = 0, expire_ns = 0, fired = 0, ticks = 0;
+    for (int round = 0; round < rounds; ++round) {
+        Timers timers;
+        auto now = getCurrentMillisecond();
+        auto start = chrono::steady_clock::now();
+        for (size_t i = 0; i < tasks.size(); ++i) {
+            timers.add(now + delays[i], tasks[i]);
+        }
+        add_ns += elapsedNS(start);
+
+        start = chrono::steady_clock::now();
+        List<DelayTask::Ptr> out;
+        while (auto next = timers.nextTime()) {
+            //poller休眠到下次需要处理的时间
+            now = std::max(now + 1, next);
+            timers.expire(now, out);
+            ++ticks;
+        }
+        fired += out.size();
+        expire_ns += elapsedNS(start);
+    }
+    InfoL << name << " timers:" << tasks.size() << " fired:" << fired / rounds << " wakeups:" << ticks / rounds
+          << " add ns/timer:" << add_ns / rounds / tasks.size()
+          << " expire ns/timer:" << expire_ns / rounds / tasks.size();
+}
+
+//此程序用于对比时间轮与multimap实现的延时任务在大量会话超时场景下的开销
+int main(int argc, char *argv[]) {
+    CMD_main cmd_main;
+    try {
+        cmd_main.operator()(argc, argv);
+    } catch (ExitException &) {
+        return 0;
+    } catch (std::exception &ex) {
+        cout << ex.what() << endl;
+        return -1;
+    }
+
+    auto count = cmd_main["timers"].as<int>();
+    auto seconds = cmd_main["seconds"].as<int>();
+
+    //设置日志
+    Logger::Instance().add(std::make_shared<ConsoleChannel>());
+    Logger::Instance().setWriter(std::make_shared<AsyncLogWriter>());
+
+    std::mt19937 rng(0);
+    vector<DelayTask::Ptr> tasks(count);
+    vector<uint64_t> delays(count);
+    for (int i = 0; i < count; ++i) {
+        tasks[i] = std::make_shared<DelayTask>([]() -> uint64_t {
+            return 0;
+        });
+        //会话超时时间在1~seconds秒之间
+        delays[i] = 1000 + rng() % (seconds * 1000);
+    }
+    //一半的定时器在到期前被取消(会话已经关闭)
+    for (int i = 0; i < count; i += 2) {
+        tasks[i]->cancel();
+    }
+
+    bench<TimerMap>("multimap    ", tasks, delays, 5);
+    bench<TimingWheel>("timing wheel", tasks, delays, 5);
+    return 0;
+}
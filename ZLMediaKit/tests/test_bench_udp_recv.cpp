@@ -0,0 +1,220 @@
+﻿/*
+ * Copyright (c) 2016 The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/xia-chu/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <signal.h>
+#include <atomic>
+#include <iostream>
+#include "Util/logger.h"
+#include "Util/CMD.h"
+#include "Util/TimeTicker.h"
+#include "Network/Socket.h"
+#include "Network/sockutil.h"
+#include "Thread/semaphore.h"
+#include "Rtsp/Rtsp.h"
+
+using namespace std;
+using namespace toolkit;
+using namespace mediakit;
+
+class CMD_main : public CMD {
+public:
+    CMD_main() {
+        _parser.reset(new OptionParser(nullptr));
+
+        (*_parser) << Option('c',/*该选项简称，如果是\x00则说明无简称*/
+                             "count",/*该选项全称,每个选项必须有全称；不得为null或空字符串*/
+                             Option::ArgRequired,/*该选项后面必须跟值*/
+                             "100",/*该选项默认值*/
+                             false,/*该选项是否必须赋值，如果没有默认值且为ArgRequired时用户必须提供该参数否则将抛异常*/
+                             "模拟推流设备个数(每个设备一个udp socket，推流至同一端口)",/*该选项说明文字*/
+                             nullptr);
+
+        (*_parser) << Option('s',/*该选项简称，如果是\x00则说明无简称*/
+                             "size",/*该选项全称,每个选项必须有全称；不得为null或空字符串*/
+                             Option::ArgRequired,/*该选项后面必须跟值*/
+                             "1400",/*该选项默认值*/
+                             false,/*该选项是否必须赋值，如果没有默认值且为ArgRequired时用户必须提供该参数否则将抛异常*/
+                             "rtp包大小",/*该选项说明文字*/
+                             nullptr);
+
+        (*_parser) << Option('m',/*该选项简称，如果是\x00则说明无简称*/
+                             "mode",/*该选项全称,每个选项必须有全称；不得为null或空字符串*/
+                             Option::ArgRequired,/*该选项后面必须跟值*/
+                             "-1",/*该选项默认值*/
+                             false,/*该选项是否必须赋值，如果没有默认值且为ArgRequired时用户必须提供该参数否则将抛异常*/
+                             "接收方式,recvfrom/recvmmsg:0/1，-1则依次测试所有方式",/*该选项说明文字*/
+                             nullptr);
+
+        (*_parser) << Option('d',/*该选项简称，如果是\x00则说明无简称*/
+                             "duration",/*该选项全称,每个选项必须有全称；不得为null或空字符串*/
+                             Option::ArgRequired,/*该选项后面必须跟值*/
+                             "3",/*该选项默认值*/
+                             false,/*该选项是否必须赋值，如果没有默认值且为ArgRequired时用户必须提供该参数否则将抛异常*/
+                             "每种接收方式测试时长,单位秒",/*该选项说明文字*/
+                             nullptr);
+    }
+
+    ~CMD_main() override {}
+
+    const char *description() const override {
+        return "主程序命令参数";
+    }
+};
+
+//获取当前线程占用cpu时间，单位秒
+static double getThreadCpuSeconds() {
+#if defined(CLOCK_THREAD_CPUTIME_ID)
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+#else
+    return 0;
+#endif
+}
+
+static void bench(const vector<int> &socks, const vector<Buffer::Ptr> &packets, bool batch, int duration) {
+    Socket::setUdpBatchRecv(batch);
+
+    auto poller = EventPollerPool::Instance().getPoller();
+    auto sock = Socket::createSocket(poller, false);
+    if (!sock->bindUdpSock(0, "127.0.0.1")) {
+        ErrorL << "bind udp socket failed:" << get_uv_errmsg();
+        return;
+    }
+    SockUtil::setRecvBuf(sock->rawFD(), 4 * 1024 * 1024);
+
+    //统计收到的rtp包个数与回调次数，并简单解析rtp头，模拟RtpSplitter/RtpSelector按ssrc分流
+    atomic<uint64_t> received(0);
+    atomic<uint64_t> callbacks(0);
+    atomic<uint64_t> ssrc_sum(0);
+    sock->setOnRead([&](const Buffer::Ptr &buf, struct sockaddr *addr, int addr_len) {
+        ++callbacks;
+        ++received;
+        ssrc_sum += ntohl(((RtpHeader *) buf->data())->ssrc);
+    });
+    sock->setOnMultiRead([&](const BufferRaw::Ptr *buf, struct sockaddr *addr, size_t count) {
+        ++callbacks;
+        received += count;
+        for (size_t i = 0; i < count; ++i) {
+            ssrc_sum += ntohl(((RtpHeader *) buf[i]->data())->ssrc);
+        }
+    });
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(sock->get_local_port());
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+
+    double cpu_begin = 0;
+    poller->sync([&]() { cpu_begin = getThreadCpuSeconds(); });
+
+    //每个设备每次发送一批rtp包(约等于一帧)，发送端使用sendmmsg，避免发送端成为瓶颈
+    uint64_t sent = 0;
+    Ticker ticker;
+    while (ticker.elapsedTime() < (uint64_t) duration * 1000) {
+        //发送期间阻塞接收线程，模拟接收线程繁忙时数据在内核中堆积，
+        //防止单核环境下每个数据包都唤醒接收线程，测试结果主要反映线程切换开销
+        auto sem = std::make_shared<semaphore>();
+        poller->async([sem]() { sem->wait(); });
+        for (auto fd : socks) {
+            List<std::pair<Buffer::Ptr, bool> > pkt_list;
+            for (auto &pkt : packets) {
+                pkt_list.emplace_back(std::make_shared<BufferSock>(pkt, (struct sockaddr *) &addr, sizeof(addr)), true);
+            }
+            BufferList buffer_list(pkt_list);
+            auto size = buffer_list.count();
+            UdpSendMode mode = UdpSend_Mmsg;
+            buffer_list.send(fd, 0, true, &mode);
+            sent += size - buffer_list.count();
+        }
+        sem->post();
+    }
+    //等待接收端处理完毕
+    this_thread::sleep_for(chrono::milliseconds(100));
+    double cpu_end = 0;
+    poller->sync([&]() { cpu_end = getThreadCpuSeconds(); });
+
+    auto elapsed_sec = ticker.elapsedTime() / 1000.0;
+    auto cpu_sec = cpu_end - cpu_begin;
+    InfoL << (batch ? "recvmmsg" : "recvfrom")
+          << " sent:" << sent
+          << " received:" << received
+          << " packets/sec:" << (uint64_t) (received / elapsed_sec)
+          << " packets/sec per core:" << (uint64_t) (cpu_sec > 0 ? received / cpu_sec : 0)
+          << " packets/callback:" << (callbacks ? (double) received / callbacks : 0)
+          << " cpu:" << cpu_sec << "s";
+
+    poller->sync([&]() { sock = nullptr; });
+}
+
+//此程序用于测试udp批量接收(recvmmsg)对收流性能的影响
+//模拟大量GB28181设备通过rtp over udp推流至同一端口，统计接收线程每个cpu核心每秒能处理的rtp包个数
+int main(int argc, char *argv[]) {
+    CMD_main cmd_main;
+    try {
+        cmd_main.operator()(argc, argv);
+    } catch (ExitException &) {
+        return 0;
+    } catch (std::exception &ex) {
+        cout << ex.what() << endl;
+        return -1;
+    }
+
+    auto sock_count = cmd_main["count"].as<int>();
+    auto pkt_size = cmd_main["size"].as<int>();
+    auto mode = cmd_main["mode"].as<int>();
+    auto duration = cmd_main["duration"].as<int>();
+
+    //设置日志
+    Logger::Instance().add(std::make_shared<ConsoleChannel>());
+    //启动异步日志线程
+    Logger::Instance().setWriter(std::make_shared<AsyncLogWriter>());
+    //接收端只需要一个线程
+    EventPollerPool::setPoolSize(1);
+
+    vector<int> socks;
+    for (int i = 0; i < sock_count; ++i) {
+        auto fd = SockUtil::bindUdpSock(0, "127.0.0.1");
+        if (fd == -1) {
+            WarnL << "bind udp socket failed:" << get_uv_errmsg();
+            break;
+        }
+        socks.emplace_back(fd);
+    }
+
+    //一帧的rtp包
+    vector<Buffer::Ptr> packets;
+    for (int i = 0; i < 8; ++i) {
+        auto pkt = BufferRaw::create();
+        pkt->setCapacity(std::max(pkt_size, (int) sizeof(RtpHeader)) + 1);
+        pkt->setSize(std::max(pkt_size, (int) sizeof(RtpHeader)));
+        memset(pkt->data(), 0, pkt->size());
+        auto header = (RtpHeader *) pkt->data();
+        header->version = RtpPacket::kRtpVersion;
+        header->pt = 96;
+        header->seq = htons(i);
+        header->ssrc = htonl(i);
+        packets.emplace_back(std::move(pkt));
+    }
+
+    InfoL << "sockets:" << socks.size() << " size:" << pkt_size;
+    if (mode == 0 || mode == 1) {
+        bench(socks, packets, mode == 1, duration);
+    } else {
+        bench(socks, packets, false, duration);
+        bench(socks, packets, true, duration);
+    }
+
+    for (auto fd : socks) {
+        close(fd);
+    }
+    return 0;
+}
@@ -0,0 +1,211 @@
+﻿/*
+ * Copyright (c) 2016 The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/xia-chu/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <signal.h>
+#include <iostream>
+#include "Util/logger.h"
+#include "Util/CMD.h"
+#include "Util/TimeTicker.h"
+#include "Network/Buffer.h"
+#include "Network/sockutil.h"
+#if !defined(_WIN32)
+#include <sys/resource.h>
+#endif
+
+using namespace std;
+using namespace toolkit;
+
+class CMD_main : public CMD {
+public:
+    CMD_main() {
+        _parser.reset(new OptionParser(nullptr));
+
+        (*_parser) << Option('c',/*该选项简称，如果是\x00则说明无简称*/
+                             "count",/*该选项全称,每个选项必须有全称；不得为null或空字符串*/
+                             Option::ArgRequired,/*该选项后面必须跟值*/
+                             "500",/*该选项默认值*/
+                             false,/*该选项是否必须赋值，如果没有默认值且为ArgRequired时用户必须提供该参数否则将抛异常*/
+                             "模拟udp播放器个数(每个播放器一个udp socket)",/*该选项说明文字*/
+                             nullptr);
+
+        (*_parser) << Option('n',/*该选项简称，如果是\x00则说明无简称*/
+                             "packets",/*该选项全称,每个选项必须有全称；不得为null或空字符串*/
+                             Option::ArgRequired,/*该选项后面必须跟值*/
+                             "8",/*该选项默认值*/
+                             false,/*该选项是否必须赋值，如果没有默认值且为ArgRequired时用户必须提供该参数否则将抛异常*/
+                             "每个播放器每次flush的rtp包个数(一帧或合并写的包数)",/*该选项说明文字*/
+                             nullptr);
+
+        (*_parser) << Option('s',/*该选项简称，如果是\x00则说明无简称*/
+                             "size",/*该选项全称,每个选项必须有全称；不得为null或空字符串*/
+                             Option::ArgRequired,/*该选项后面必须跟值*/
+                             "1400",/*该选项默认值*/
+                             false,/*该选项是否必须赋值，如果没有默认值且为ArgRequired时用户必须提供该参数否则将抛异常*/
+                             "rtp包大小，最后一个包为该值的一半",/*该选项说明文字*/
+                             nullptr);
+
+        (*_parser) << Option('m',/*该选项简称，如果是\x00则说明无简称*/
+                             "mode",/*该选项全称,每个选项必须有全称；不得为null或空字符串*/
+                             Option::ArgRequired,/*该选项后面必须跟值*/
+                             "-1",/*该选项默认值*/
+                             false,/*该选项是否必须赋值，如果没有默认值且为ArgRequired时用户必须提供该参数否则将抛异常*/
+                             "发送方式,sendmsg/sendmmsg/gso:0/1/2，-1则依次测试所有方式",/*该选项说明文字*/
+                             nullptr);
+
+        (*_parser) << Option('d',/*该选项简称，如果是\x00则说明无简称*/
+                             "duration",/*该选项全称,每个选项必须有全称；不得为null或空字符串*/
+                             Option::ArgRequired,/*该选项后面必须跟值*/
+                             "3",/*该选项默认值*/
+                             false,/*该选项是否必须赋值，如果没有默认值且为ArgRequired时用户必须提供该参数否则将抛异常*/
+                             "每种发送方式测试时长,单位秒",/*该选项说明文字*/
+                             nullptr);
+    }
+
+    ~CMD_main() override {}
+
+    const char *description() const override {
+        return "主程序命令参数";
+    }
+};
+
+//获取进程占用cpu时间(用户态+内核态)，单位秒
+static double getCpuSeconds() {
+#if !defined(_WIN32)
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1000000.0 +
+           usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1000000.0;
+#else
+    return 0;
+#endif
+}
+
+static const char *getModeName(UdpSendMode mode) {
+    switch (mode) {
+        case UdpSend_Single: return "sendmsg ";
+        case UdpSend_Mmsg: return "sendmmsg";
+        case UdpSend_Gso: return "gso     ";
+        default: return "auto    ";
+    }
+}
+
+static void bench(const vector<int> &socks, const vector<Buffer::Ptr> &packets, UdpSendMode mode, int duration) {
+    //每个socket的发送方式独立，降级互不影响
+    vector<UdpSendMode> modes(socks.size(), mode);
+    uint64_t pkt_count = 0;
+    uint64_t bytes = 0;
+    uint64_t syscalls = 0;
+    uint64_t dropped = 0;
+
+    auto cpu_begin = getCpuSeconds();
+    Ticker ticker;
+    while (ticker.elapsedTime() < (uint64_t) duration * 1000) {
+        for (size_t i = 0; i < socks.size(); ++i) {
+            List<std::pair<Buffer::Ptr, bool> > pkt_list;
+            for (auto &pkt : packets) {
+                pkt_list.emplace_back(pkt, false);
+            }
+            BufferList buffer_list(pkt_list);
+            auto size = buffer_list.count();
+            auto n = buffer_list.send(socks[i], 0, true, mode == UdpSend_Single ? nullptr : &modes[i]);
+            if (n > 0) {
+                bytes += n;
+            }
+            //发送缓存满等原因未发送的包
+            dropped += buffer_list.count();
+            pkt_count += size - buffer_list.count();
+            syscalls += buffer_list.getSendSyscalls();
+        }
+    }
+    auto elapsed_sec = ticker.elapsedTime() / 1000.0;
+    auto cpu_sec = getCpuSeconds() - cpu_begin;
+    auto gbps = bytes * 8 / elapsed_sec / 1000000000.0;
+
+    InfoL << getModeName(mode)
+          << " packets/sec:" << (uint64_t) (pkt_count / elapsed_sec)
+          << " syscalls/packet:" << (pkt_count ? (double) syscalls / pkt_count : 0)
+          << " Gbps:" << gbps
+          << " cpu(core)/Gbps:" << (gbps > 0 ? cpu_sec / elapsed_sec / gbps : 0)
+          << " dropped:" << dropped
+          << " actual:" << getModeName(modes.empty() ? mode : modes[0]);
+}
+
+//此程序用于测试udp批量发送(sendmmsg/GSO)的系统调用次数与cpu占用
+//模拟rtsp over udp等场景下，每个播放器一个udp socket，每次flush多个等长rtp包
+int main(int argc, char *argv[]) {
+    CMD_main cmd_main;
+    try {
+        cmd_main.operator()(argc, argv);
+    } catch (ExitException &) {
+        return 0;
+    } catch (std::exception &ex) {
+        cout << ex.what() << endl;
+        return -1;
+    }
+
+    auto sock_count = cmd_main["count"].as<int>();
+    auto pkt_count = cmd_main["packets"].as<int>();
+    auto pkt_size = cmd_main["size"].as<int>();
+    auto mode = cmd_main["mode"].as<int>();
+    auto duration = cmd_main["duration"].as<int>();
+
+    //设置日志
+    Logger::Instance().add(std::make_shared<ConsoleChannel>());
+    //启动异步日志线程
+    Logger::Instance().setWriter(std::make_shared<AsyncLogWriter>());
+
+    //接收端只用于承接数据，不读取，内核接收缓存满后直接丢弃，不影响发送端统计
+    auto recv_fd = SockUtil::bindUdpSock(0, "127.0.0.1");
+    if (recv_fd == -1) {
+        ErrorL << "bind udp socket failed:" << get_uv_errmsg();
+        return -1;
+    }
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(SockUtil::get_local_port(recv_fd));
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+
+    vector<int> socks;
+    for (int i = 0; i < sock_count; ++i) {
+        auto fd = SockUtil::bindUdpSock(0, "127.0.0.1");
+        if (fd == -1) {
+            WarnL << "bind udp socket failed:" << get_uv_errmsg();
+            break;
+        }
+        SockUtil::connectUdpSock(fd, (struct sockaddr *) &addr, sizeof(addr));
+        socks.emplace_back(fd);
+    }
+
+    //一次flush的rtp包，最后一个包更短
+    vector<Buffer::Ptr> packets;
+    for (int i = 0; i < pkt_count; ++i) {
+        auto pkt = BufferRaw::create();
+        pkt->setCapacity(pkt_size + 1);
+        pkt->setSize(i + 1 == pkt_count ? std::max(pkt_size / 2, 1) : pkt_size);
+        memset(pkt->data(), i, pkt->size());
+        packets.emplace_back(std::move(pkt));
+    }
+
+    InfoL << "sockets:" << socks.size() << " packets/flush:" << pkt_count << " size:" << pkt_size;
+    if (mode >= UdpSend_Single && mode <= UdpSend_Gso) {
+        bench(socks, packets, (UdpSendMode) mode, duration);
+    } else {
+        for (auto m : {UdpSend_Single, UdpSend_Mmsg, UdpSend_Gso}) {
+            bench(socks, packets, m, duration);
+        }
+    }
+
+    for (auto fd : socks) {
+        close(fd);
+    }
+    close(recv_fd);
+    return 0;
+}
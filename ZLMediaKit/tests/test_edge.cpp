@@ -0,0 +1,144 @@
+﻿/*
+ * Copyright (c) 2016 The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/xia-chu/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <signal.h>
+#include <atomic>
+#include <iostream>
+#include "Util/logger.h"
+#include "Util/NoticeCenter.h"
+#include "Network/TcpServer.h"
+#include "Common/config.h"
+#include "Rtmp/RtmpSession.h"
+#include "Player/MediaPlayer.h"
+#include "Player/EdgeProxy.h"
+#include "TestUtil.h"
+#ifndef _WIN32
+#include <unistd.h>
+#include <sys/wait.h>
+#endif
+
+using namespace std;
+using namespace toolkit;
+using namespace mediakit;
+
+//源站进程：在随机端口启动rtmp服务器并生成live/test直播流，通过管道把端口告诉边缘进程
+static void runOrigin(int pipe_fd) {
+    auto poller = EventPollerPool::Instance().getPoller();
+    auto server = std::make_shared<TcpServer>(poller);
+    server->start<RtmpSession>(0, "127.0.0.1");
+    auto port = server->getPort();
+
+    DevChannel::Ptr channel;
+    poller->sync([&]() { channel = TestH264Source::createChannel("live", "test"); });
+    auto index = std::make_shared<uint32_t>(0);
+    poller->doDelayTask(40, [channel, index]() -> uint64_t {
+        TestH264Source::inputFrame(*channel, (*index)++);
+        return 40;
+    });
+
+    if (write(pipe_fd, &port, sizeof(port)) != sizeof(port)) {
+        return;
+    }
+    //由边缘进程结束
+    while (true) {
+        sleep(1);
+    }
+}
+
+//边缘进程：并发播放同一个流，只从源站拉流一次，无人观看后断开源站拉流
+static bool runEdge(uint16_t origin_port, int player_count) {
+    mINI::Instance()[Edge::kOrigin] = "rtmp://127.0.0.1:" + to_string(origin_port);
+    mINI::Instance()[Edge::kIdleTimeoutMS] = 1000;
+    NoticeCenter::Instance().emitEvent(Broadcast::kBroadcastReloadConfig);
+
+    auto server = std::make_shared<TcpServer>();
+    server->start<RtmpSession>(0, "127.0.0.1");
+    EdgeManager::Instance().install();
+    auto url = "rtmp://127.0.0.1:" + to_string(server->getPort()) + "/live/test";
+
+    atomic<int> success{0};
+    atomic<int> failed{0};
+    vector<MediaPlayer::Ptr> players;
+    for (int i = 0; i < player_count; ++i) {
+        auto player = std::make_shared<MediaPlayer>();
+        player->setOnPlayResult([&](const SockException &ex) {
+            ++(ex ? failed : success);
+        });
+        player->play(url);
+        players.emplace_back(std::move(player));
+    }
+
+    Ticker ticker;
+    while (success + failed < player_count && ticker.elapsedTime() < 10 * 1000) {
+        usleep(100 * 1000);
+    }
+    auto stat = EdgeManager::Instance().getStatistic();
+    InfoL << "播放成功:" << success << " 失败:" << failed << " 源站拉流次数:" << stat.origin_fetches
+          << " 合并的播放请求:" << stat.coalesced << " 观看人次:" << stat.edge_hits;
+    EXPECT(success == player_count);
+    EXPECT(stat.origin_fetches == 1);
+    EXPECT(stat.origin_failures == 0);
+    EXPECT(stat.edges == 1);
+    EXPECT(stat.edge_hits == (uint64_t) player_count);
+
+    //全部停止播放，无人观看超时后断开源站拉流
+    players.clear();
+    ticker.resetTime();
+    while (EdgeManager::Instance().getStatistic().edges && ticker.elapsedTime() < 5 * 1000) {
+        usleep(100 * 1000);
+    }
+    stat = EdgeManager::Instance().getStatistic();
+    InfoL << "无人观看关闭的边缘流:" << stat.idle_closes;
+    EXPECT(stat.edges == 0);
+    EXPECT(stat.idle_closes == 1);
+    EdgeManager::Instance().uninstall();
+    return true;
+}
+
+//此程序用于测试边缘节点合并源站拉流：源站与边缘节点分别在两个进程(两个端口)中运行，
+//二者不能在同一进程中运行，因为同一进程中媒体源注册表是共享的
+int main(int argc, char *argv[]) {
+#ifdef _WIN32
+    return 0;
+#else
+    int player_count = argc > 1 ? MAX(1, atoi(argv[1])) : 20;
+    int fds[2];
+    if (pipe(fds) != 0) {
+        return -1;
+    }
+    //在创建任何线程之前fork
+    auto pid = fork();
+    if (pid < 0) {
+        return -1;
+    }
+    if (pid == 0) {
+        close(fds[0]);
+        Logger::Instance().add(std::make_shared<ConsoleChannel>("ConsoleChannel", LWarn));
+        runOrigin(fds[1]);
+        _exit(0);
+    }
+    close(fds[1]);
+    Logger::Instance().add(std::make_shared<ConsoleChannel>("ConsoleChannel", LInfo));
+
+    uint16_t origin_port = 0;
+    TestSuite suite;
+    suite.run("test_edge", [&]() {
+        if (read(fds[0], &origin_port, sizeof(origin_port)) != sizeof(origin_port)) {
+            ErrorL << "源站启动失败";
+            return false;
+        }
+        return runEdge(origin_port, player_count);
+    });
+    close(fds[0]);
+    kill(pid, SIGKILL);
+    waitpid(pid, nullptr, 0);
+    return suite.result();
+#endif
+}
@@ -0,0 +1,124 @@
+﻿/*
+ * Copyright (c) 2016 The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/xia-chu/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <iostream>
+#include "Util/logger.h"
+#include "Util/NoticeCenter.h"
+#include "Poller/EventPoller.h"
+#include "Common/config.h"
+#include "Rtmp/RtmpMediaSource.h"
+#include "TestUtil.h"
+
+using namespace std;
+using namespace toolkit;
+using namespace mediakit;
+
+class RtmpReader {
+public:
+    void attach(const EventPoller::Ptr &poller, const RtmpMediaSource::Ptr &src) {
+        _reader = src->getRing()->attach(poller);
+        _reader->setReadCB([this](const RtmpMediaSource::RingDataType &pkt) {
+            pkt->for_each([this](const RtmpPacket::Ptr &rtmp) {
+                if (rtmp->type_id != MSG_VIDEO || rtmp->isCfgFrame()) {
+                    return;
+                }
+                if (!_frames++) {
+                    _first_key = rtmp->isVideoKeyFrame();
+                }
+            });
+        });
+    }
+
+    void detach() {
+        _reader = nullptr;
+    }
+
+    size_t frames() const {
+        return _frames;
+    }
+
+    bool firstIsKey() const {
+        return _first_key;
+    }
+
+private:
+    size_t _frames = 0;
+    bool _first_key = false;
+    RtmpMediaSource::RingType::RingReader::Ptr _reader;
+};
+
+//无人观看时rtmp不打包，后加入的观看者先收到共享gop缓存重新打包的帧，从关键帧开始播放
+static bool test_late_joiner(const EventPoller::Ptr &poller) {
+    DevChannel::Ptr channel;
+    RtmpMediaSource::Ptr src;
+    uint32_t index = 0;
+    poller->sync([&]() {
+        channel = TestH264Source::createChannel("live", "gop_cache");
+        //输入半个gop，此时无人观看
+        for (; index < 12; ++index) {
+            TestH264Source::inputFrame(*channel, index);
+        }
+        src = dynamic_pointer_cast<RtmpMediaSource>(MediaSource::find(RTMP_SCHEMA, DEFAULT_VHOST, "live", "gop_cache"));
+    });
+    EXPECT(src);
+
+    RtmpReader first, second;
+    poller->sync([&]() {
+        first.attach(poller, src);
+        //有人观看后的下一帧触发回放
+        TestH264Source::inputFrame(*channel, index++);
+        TestH264Source::inputFrame(*channel, index++);
+    });
+    //等待ring派发
+    poller->sync([]() {});
+    InfoL << "第一个观看者收到帧数:" << first.frames();
+    EXPECT(first.firstIsKey());
+    //无人观看时输入的12帧都需要回放(h264帧在下一帧输入时才输出，所以之后输入的帧最多输出1帧)
+    EXPECT(first.frames() >= 12);
+
+    //全部离开后再加入，仍然从关键帧开始
+    poller->sync([&]() {
+        first.detach();
+        for (; index < 30; ++index) {
+            TestH264Source::inputFrame(*channel, index);
+        }
+        second.attach(poller, src);
+        TestH264Source::inputFrame(*channel, index++);
+        TestH264Source::inputFrame(*channel, index++);
+    });
+    poller->sync([]() {});
+    InfoL << "第二个观看者收到帧数:" << second.frames();
+    EXPECT(second.firstIsKey());
+    //第二个gop从第25帧开始，无人观看时输入了5帧
+    EXPECT(second.frames() >= 5);
+
+    poller->sync([&]() {
+        second.detach();
+        src = nullptr;
+        channel = nullptr;
+    });
+    return true;
+}
+
+//此程序用于测试共享gop缓存对后加入观看者的回放
+int main(int argc, char *argv[]) {
+    Logger::Instance().add(std::make_shared<ConsoleChannel>("ConsoleChannel", LInfo));
+
+    mINI::Instance()[General::kSharedGopCache] = 1;
+    //关闭合并写，每帧立即派发
+    mINI::Instance()[General::kMergeWriteMS] = 0;
+    mINI::Instance()[General::kAdaptiveMergeWrite] = 0;
+    NoticeCenter::Instance().emitEvent(Broadcast::kBroadcastReloadConfig);
+
+    auto poller = EventPollerPool::Instance().getPoller();
+    TestSuite suite;
+    suite.run("test_late_joiner", [&]() { return test_late_joiner(poller); });
+    return suite.result();
+}
@@ -0,0 +1,132 @@
+﻿/*
+ * Copyright (c) 2016 The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/xia-chu/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <atomic>
+#include <iostream>
+#include "Util/logger.h"
+#include "Thread/semaphore.h"
+#include "Poller/EventPoller.h"
+#include "Record/LLHlsMaker.h"
+#include "TestUtil.h"
+
+using namespace std;
+using namespace toolkit;
+using namespace mediakit;
+
+//每个片段40ms，每秒一个关键帧
+class FragmentSource {
+public:
+    void input(LLHlsMaker &maker, int count) {
+        for (int i = 0; i < count; ++i, ++_index) {
+            maker.inputFragment(string(100, 'x'), _index * 40, _index % 25 == 0);
+        }
+    }
+
+private:
+    uint32_t _index = 0;
+};
+
+//part生成后等待者被触发且从等待列表中移除
+static bool test_notify() {
+    LLHlsMaker maker(0.2f, 1.0f, 3, 2);
+    FragmentSource source;
+    atomic<int> called{0};
+    uint64_t wait_id = 0;
+    EXPECT(maker.waitFor(0, 0, [&]() { ++called; }, &wait_id) == 1);
+    source.input(maker, 10);
+    EXPECT(called == 1);
+    EXPECT(maker.getPart(0, 0));
+    //已经触发的等待不能再取消
+    EXPECT(!maker.cancelWait(wait_id));
+    //已经生成的part无需等待
+    EXPECT(maker.waitFor(0, 0, [&]() { ++called; }) == 0);
+    //请求的切片过新
+    EXPECT(maker.waitFor(3, 0, [&]() { ++called; }) == -1);
+    source.input(maker, 100);
+    EXPECT(called == 1);
+    return true;
+}
+
+//模拟HttpSession的阻塞请求超时：超时后取消等待，之后part生成也不再触发
+static bool test_timeout() {
+    LLHlsMaker maker(0.2f, 1.0f, 3, 2);
+    FragmentSource source;
+    source.input(maker, 10);
+
+    atomic<int> called{0};
+    uint64_t wait_id = 0;
+    EXPECT(maker.waitFor(2, 0, [&]() { ++called; }, &wait_id) == 1);
+
+    semaphore sem;
+    atomic<bool> canceled{false};
+    auto poller = EventPollerPool::Instance().getPoller();
+    Ticker ticker;
+    poller->doDelayTask(maker.getBlockTimeoutMS(), [&]() {
+        canceled = maker.cancelWait(wait_id);
+        sem.post();
+        return 0;
+    });
+    sem.wait();
+    EXPECT(canceled);
+    EXPECT(ticker.elapsedTime() + 50 >= maker.getBlockTimeoutMS());
+    EXPECT(!maker.cancelWait(wait_id));
+
+    //等待的part生成后不再触发已超时的等待
+    source.input(maker, 100);
+    EXPECT(maker.getPart(2, 0));
+    EXPECT(called == 0);
+    return true;
+}
+
+//大量超时的阻塞请求不残留在等待列表中
+static bool test_cleanup() {
+    LLHlsMaker maker(0.2f, 1.0f, 3, 2);
+    FragmentSource source;
+    source.input(maker, 10);
+
+    atomic<int> called{0};
+    vector<uint64_t> ids;
+    for (int i = 0; i < 1000; ++i) {
+        uint64_t wait_id = 0;
+        EXPECT(maker.waitFor(1 + i % 2, i % 5, [&]() { ++called; }, &wait_id) == 1);
+        ids.emplace_back(wait_id);
+    }
+    //id不重复
+    for (size_t i = 1; i < ids.size(); ++i) {
+        EXPECT(ids[i] != ids[i - 1]);
+    }
+    for (auto wait_id : ids) {
+        EXPECT(maker.cancelWait(wait_id));
+    }
+    source.input(maker, 100);
+    EXPECT(called == 0);
+
+    //清空时触发所有未超时的等待
+    EXPECT(maker.waitFor(100, -1, [&]() { ++called; }) == -1);
+    uint64_t last_msn = 0;
+    while (maker.getSegment(last_msn + 1)) {
+        ++last_msn;
+    }
+    EXPECT(maker.waitFor(last_msn + 2, -1, [&]() { ++called; }) == 1);
+    maker.clear();
+    EXPECT(called == 1);
+    return true;
+}
+
+//此程序用于测试ll-hls阻塞请求的等待、超时与清理
+int main(int argc, char *argv[]) {
+    Logger::Instance().add(std::make_shared<ConsoleChannel>("ConsoleChannel", LInfo));
+
+    TestSuite suite;
+    suite.run("test_notify", test_notify);
+    suite.run("test_timeout", test_timeout);
+    suite.run("test_cleanup", test_cleanup);
+    return suite.result();
+}
@@ -0,0 +1,124 @@
+﻿/*
+ * Copyright (c) 2016 The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/xia-chu/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <iostream>
+#include "Util/logger.h"
+#include "Util/NoticeCenter.h"
+#include "Common/config.h"
+#include "Common/MediaSource.h"
+#include "TestUtil.h"
+
+using namespace std;
+using namespace toolkit;
+using namespace mediakit;
+
+static void setConfig(bool adaptive, int merge_ms) {
+    mINI::Instance()[General::kAdaptiveMergeWrite] = adaptive;
+    mINI::Instance()[General::kMergeWriteMS] = merge_ms;
+    mINI::Instance()[General::kMergeWriteMaxMS] = 200;
+    NoticeCenter::Instance().emitEvent(Broadcast::kBroadcastReloadConfig);
+}
+
+//观看人数达到8人后开始合并写，之后每翻一倍窗口增加10ms
+static bool test_reader_threshold() {
+    setConfig(true, 0);
+    FlushPolicy policy;
+    for (int readers = 0; readers < 8; ++readers) {
+        policy.update(readers, 0, 0);
+        EXPECT(policy.getMergeWriteMS() == 0);
+    }
+    policy.update(8, 0, 0);
+    EXPECT(policy.getMergeWriteMS() == 10);
+    policy.update(15, 0, 0);
+    EXPECT(policy.getMergeWriteMS() == 10);
+    policy.update(16, 0, 0);
+    EXPECT(policy.getMergeWriteMS() == 20);
+    policy.update(64, 0, 0);
+    EXPECT(policy.getMergeWriteMS() == 40);
+    return true;
+}
+
+//人数减少后逐步缩小窗口，最终恢复逐帧发送
+static bool test_shrink() {
+    setConfig(true, 0);
+    FlushPolicy policy;
+    policy.update(64, 0, 0);
+    EXPECT(policy.getMergeWriteMS() == 40);
+    policy.update(1, 0, 0);
+    EXPECT(policy.getMergeWriteMS() == 20);
+    int last = policy.getMergeWriteMS();
+    for (int i = 0; i < 10 && last; ++i) {
+        policy.update(1, 0, 0);
+        EXPECT(policy.getMergeWriteMS() < last);
+        last = policy.getMergeWriteMS();
+    }
+    EXPECT(last == 0);
+    return true;
+}
+
+//观看者发送积压时加大窗口，mergeWriteMS为窗口下限，关闭自适应时只使用mergeWriteMS
+static bool test_backlog_and_config() {
+    setConfig(true, 0);
+    FlushPolicy policy;
+    policy.update(1, 128, 0);
+    EXPECT(policy.getMergeWriteMS() == 40);
+    policy.update(8, 128, 0);
+    EXPECT(policy.getMergeWriteMS() == 40);
+    policy.update(32, 128, 0);
+    EXPECT(policy.getMergeWriteMS() == 60);
+
+    //码率很高时，窗口内的数据量不超过1MB
+    policy.update(64, 0, 100 * 1024 * 1024);
+    EXPECT(policy.getMergeWriteMS() == 10);
+
+    setConfig(true, 30);
+    policy.update(1, 0, 0);
+    policy.update(1, 0, 0);
+    policy.update(1, 0, 0);
+    policy.update(1, 0, 0);
+    EXPECT(policy.getMergeWriteMS() == 30);
+
+    setConfig(false, 0);
+    policy.update(64, 128, 0);
+    EXPECT(policy.getMergeWriteMS() == 0);
+    return true;
+}
+
+//窗口决定是否刷新：窗口内时间戳递增的非关键帧合并，超出窗口或遇到视频关键帧时刷新
+static bool test_flush() {
+    setConfig(true, 0);
+    FlushPolicy per_frame;
+    per_frame.update(1, 0, 0);
+    EXPECT(per_frame.isFlushAble(true, false, 40, 1));
+    EXPECT(per_frame.isFlushAble(true, false, 80, 1));
+    //同一帧的数据包不刷新
+    EXPECT(!per_frame.isFlushAble(true, false, 80, 2));
+
+    FlushPolicy merged;
+    merged.update(16, 0, 0);
+    EXPECT(merged.getMergeWriteMS() == 20);
+    EXPECT(merged.isFlushAble(true, true, 100, 1));
+    EXPECT(!merged.isFlushAble(true, false, 110, 1));
+    EXPECT(!merged.isFlushAble(true, false, 120, 1));
+    EXPECT(merged.isFlushAble(true, false, 140, 1));
+    return true;
+}
+
+//此程序用于测试自适应合并写窗口随观看人数与发送积压的切换
+int main(int argc, char *argv[]) {
+    Logger::Instance().add(std::make_shared<ConsoleChannel>("ConsoleChannel", LInfo));
+
+    TestSuite suite;
+    suite.run("test_reader_threshold", test_reader_threshold);
+    suite.run("test_shrink", test_shrink);
+    suite.run("test_backlog_and_config", test_backlog_and_config);
+    suite.run("test_flush", test_flush);
+    return suite.result();
+}
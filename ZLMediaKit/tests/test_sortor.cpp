@@ -10,6 +10,8 @@
 
 #include <map>
 #include <list>
+#include <chrono>
+#include <vector>
 #include <iostream>
 #include <functional>
 #include "Rtsp/RtpReceiver.h"
@@ -270,7 +272,56 @@ void test_rand(){
 #endif
 }
 
-//该测试程序用于检验rtp排序算法的正确性
+//生成模拟的rtp seq序列，从回环前开始
+//jitter: 连续倒序的最大个数，0为不乱序; loss: 丢包率(百分比)
+static vector<uint16_t> make_input(size_t count, int jitter, int loss) {
+    vector<uint16_t> ret;
+    ret.reserve(count);
+    uint16_t start = 0xFFFF - 500;
+    for (size_t i = 0; i < count;) {
+        size_t n = jitter ? 1 + rand() % jitter : 1;
+        for (size_t j = i + n; j-- > i;) {
+            if (loss && rand() % 100 < loss) {
+                continue;
+            }
+            ret.emplace_back((uint16_t) (start + j));
+        }
+        i += n;
+    }
+    return ret;
+}
+
+static void test_bench(const char *name, size_t count, int jitter, int loss) {
+    auto input = make_input(count, jitter, loss);
+    PacketSortor<uint16_t, uint16_t> sortor;
+    size_t output = 0, disorder = 0;
+    uint16_t last = 0;
+    sortor.setOnSort([&](uint16_t seq, uint16_t &packet) {
+        //输出的seq必须是递增的(按模运算比较)
+        if (output++ && (uint16_t) (seq - last) > 0x7FFF) {
+            ++disorder;
+        }
+        last = seq;
+    });
+
+    auto start = chrono::steady_clock::now();
+    for (auto seq : input) {
+        sortor.sortPacket(seq, seq);
+    }
+    sortor.flush();
+    auto ns = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+
+    cout << name << " 输入:" << input.size()
+         << " 输出:" << output
+         << " 乱序输出:" << disorder
+         << " 回环次数:" << sortor.getCycleCount()
+         << " 耗时:" << ns / 1000 / 1000 << "ms"
+         << " ns/packet:" << (input.empty() ? 0 : ns / input.size())
+         << " packets/sec:" << (ns ? input.size() * 1000 * 1000 * 1000 / ns : 0) << endl;
+}
+
+//该测试程序用于检验rtp排序算法的正确性与性能
+//参数为性能测试的rtp包个数，默认1000万
 int main(int argc, char *argv[]) {
     //测试真实的rtp seq
     cout << "###### 真实的rtp seq #####" << endl;
@@ -279,5 +330,12 @@ int main(int argc, char *argv[]) {
     //模拟rtp乱序、回环、丢包、重复情况
     cout << "###### 模拟的rtp seq #####" << endl;
     test_rand();
+
+    size_t count = argc > 1 ? atoll(argv[1]) : 10 * 1000 * 1000;
+    cout << "###### 排序性能 #####" << endl;
+    test_bench("顺序:", count, 0, 0);
+    test_bench("乱序:", count, 10, 0);
+    test_bench("丢包:", count, 0, 5);
+    test_bench("乱序+丢包:", count, 10, 5);
     return 0;
 }
\ No newline at end of file
@@ -12,10 +12,35 @@
 
 static constexpr uint32_t kMaxNackMS = 10 * 1000;
 
+static_assert((NackList::kMinSize & (NackList::kMinSize - 1)) == 0, "kMinSize must be power of 2");
+static_assert((NackList::kMaxSize & (NackList::kMaxSize - 1)) == 0 && NackList::kMaxSize <= UINT16_MAX / 2 + 1, "kMaxSize must be power of 2");
+static_assert((NackContext::kNackMaxSize & (NackContext::kNackMaxSize - 1)) == 0, "kNackMaxSize must be power of 2");
+static_assert((NackContext::kSeqWindow & (NackContext::kSeqWindow - 1)) == 0 && NackContext::kSeqWindow % 64 == 0, "kSeqWindow must be power of 2");
+
 void NackList::push_back(RtpPacket::Ptr rtp) {
     auto seq = rtp->getSeq();
-    _nack_cache_seq.emplace_back(seq);
-    _nack_cache_pkt.emplace(seq, std::move(rtp));
+    if (!_size) {
+        _begin_seq = seq;
+    }
+    uint16_t pos = seq - _begin_seq;
+    if (pos >= kMaxSize) {
+        //seq回退或跳跃太大，清空缓存重新开始
+        clear();
+        _begin_seq = seq;
+        pos = 0;
+    }
+    while (pos >= _cache.size() && !grow()) {
+        //缓存已满且不能再扩容，移除最早的rtp
+        pop_front();
+        if (!_size) {
+            _begin_seq = seq;
+        }
+        pos = seq - _begin_seq;
+    }
+    slot(seq) = std::move(rtp);
+    if (pos >= _size) {
+        _size = pos + 1;
+    }
     while (get_cache_ms() > kMaxNackMS) {
         //需要清除部分nack缓存
         pop_front();
@@ -36,28 +61,65 @@ void NackList::for_each_nack(const FCI_NACK &nack, const function<void(const Rtp
     }
 }
 
+RtpPacket::Ptr &NackList::slot(uint16_t seq) {
+    return _cache[seq & (_cache.size() - 1)];
+}
+
+bool NackList::grow() {
+    if (_cache.size() >= kMaxSize) {
+        return false;
+    }
+    //缓存的rtp时长未达上限但是环形数组已满，扩容一倍
+    vector<RtpPacket::Ptr> cache(_cache.empty() ? kMinSize : _cache.size() * 2);
+    for (uint32_t i = 0; i < _size; ++i) {
+        uint16_t seq = _begin_seq + i;
+        cache[seq & (cache.size() - 1)] = std::move(slot(seq));
+    }
+    _cache.swap(cache);
+    return true;
+}
+
 void NackList::pop_front() {
-    if (_nack_cache_seq.empty()) {
+    if (!_size) {
         return;
     }
-    _nack_cache_pkt.erase(_nack_cache_seq.front());
-    _nack_cache_seq.pop_front();
+    slot(_begin_seq).reset();
+    ++_begin_seq;
+    --_size;
+    //跳过未缓存的seq，保证第一个位置总是有效的rtp
+    while (_size && !slot(_begin_seq)) {
+        ++_begin_seq;
+        --_size;
+    }
+}
+
+void NackList::clear() {
+    for (uint32_t i = 0; i < _size; ++i) {
+        slot(_begin_seq + i).reset();
+    }
+    _size = 0;
 }
 
 RtpPacket::Ptr *NackList::get_rtp(uint16_t seq) {
-    auto it = _nack_cache_pkt.find(seq);
-    if (it == _nack_cache_pkt.end()) {
+    uint16_t pos = seq - _begin_seq;
+    if (pos >= _size) {
         return nullptr;
     }
-    return &it->second;
+    auto &ref = slot(seq);
+    return ref ? &ref : nullptr;
 }
 
 uint32_t NackList::get_cache_ms() {
-    if (_nack_cache_seq.size() < 2) {
+    if (_size < 2) {
+        return 0;
+    }
+    auto &back_rtp = slot(_begin_seq + _size - 1);
+    auto &front_rtp = slot(_begin_seq);
+    if (!back_rtp || !front_rtp) {
         return 0;
     }
-    uint32_t back = _nack_cache_pkt[_nack_cache_seq.back()]->getStampMS();
-    uint32_t front = _nack_cache_pkt[_nack_cache_seq.front()]->getStampMS();
+    uint32_t back = back_rtp->getStampMS();
+    uint32_t front = front_rtp->getStampMS();
     if (back >= front) {
         return back - front;
     }
@@ -67,59 +129,86 @@ uint32_t NackList::get_cache_ms() {
 
 ////////////////////////////////////////////////////////////////////////////////////////////////
 
+bool NackContext::testSeq(uint16_t seq) const {
+    auto index = seq & (kSeqWindow - 1);
+    return _seq_bits[index / 64] & (1ULL << (index % 64));
+}
+
+void NackContext::setSeq(uint16_t seq) {
+    auto index = seq & (kSeqWindow - 1);
+    _seq_bits[index / 64] |= (1ULL << (index % 64));
+}
+
+bool NackContext::clearSeq(uint16_t seq) {
+    auto index = seq & (kSeqWindow - 1);
+    auto mask = 1ULL << (index % 64);
+    auto ret = _seq_bits[index / 64] & mask;
+    _seq_bits[index / 64] &= ~mask;
+    return ret;
+}
+
+void NackContext::reset() {
+    memset(_seq_bits, 0, sizeof(_seq_bits));
+    _seq_count = 0;
+    for (uint32_t i = 0; i < _nack_range; ++i) {
+        _nack_send_status[(uint16_t) (_nack_begin_seq + i) & (kNackMaxSize - 1)].valid = false;
+    }
+    _nack_range = 0;
+    _nack_count = 0;
+}
+
 void NackContext::received(uint16_t seq, bool is_rtx) {
-    if (!_last_max_seq && _seq.empty()) {
+    if (!_started) {
+        _started = true;
         _last_max_seq = seq - 1;
+        _max_seq = _last_max_seq;
     }
-    if (is_rtx || (seq < _last_max_seq && !(seq < 1024 && _last_max_seq > UINT16_MAX - 1024))) {
+    //按16位无符号差值比较，seq回环时同样适用
+    uint16_t offset = seq - _last_max_seq;
+    if (is_rtx || !offset || offset > UINT16_MAX / 2) {
         //重传包或
-        //seq回退，且非回环，那么这个应该是重传包
+        //seq回退，那么这个应该是重传包
         onRtx(seq);
         return;
     }
 
-    _seq.emplace(seq);
-    auto max_seq = *_seq.rbegin();
-    auto min_seq = *_seq.begin();
-    auto diff = max_seq - min_seq;
-    if (!diff) {
+    if (offset > kSeqWindow) {
+        //seq跳跃太大，可能是流重置了，重新开始
+        reset();
+        _last_max_seq = seq;
+        _max_seq = seq;
         return;
     }
 
-    if (diff > UINT16_MAX / 2) {
-        //回环
-        _seq.clear();
-        _last_max_seq = min_seq;
-        _nack_send_status.clear();
+    if (testSeq(seq)) {
+        //重复的包
         return;
     }
+    setSeq(seq);
+    ++_seq_count;
+    if ((uint16_t) (seq - _last_max_seq) > (uint16_t) (_max_seq - _last_max_seq)) {
+        _max_seq = seq;
+    }
 
-    if (_seq.size() == diff + 1 && _last_max_seq + 1 == min_seq) {
-        //都是连续的seq，未丢包
-        _seq.clear();
-        _last_max_seq = max_seq;
-    } else {
-        //seq不连续，有丢包
-        if (min_seq == _last_max_seq + 1) {
-            //前面部分seq是连续的，未丢包，移除之
-            eraseFrontSeq();
-        }
+    //前面部分seq是连续的，未丢包，移除之；都是连续的seq时全部移除
+    eraseFrontSeq();
+    if (!_seq_count) {
+        return;
+    }
 
-        //有丢包，丢包从_last_max_seq开始
-        auto nack_rtp_count = FCI_NACK::kBitSize;
-        if (max_seq - _last_max_seq > nack_rtp_count) {
-            vector<bool> vec;
-            vec.resize(FCI_NACK::kBitSize, false);
-            for (auto i = 0; i < nack_rtp_count; ++i) {
-                vec[i] = _seq.find(_last_max_seq + i + 2) == _seq.end();
-            }
-            doNack(FCI_NACK(_last_max_seq + 1, vec), true);
-            _last_max_seq += nack_rtp_count + 1;
-            if (_last_max_seq >= max_seq) {
-                _seq.clear();
-            } else {
-                auto it = _seq.emplace_hint(_seq.begin(), _last_max_seq + 1);
-                _seq.erase(_seq.begin(), it);
+    //有丢包，丢包从_last_max_seq开始
+    auto nack_rtp_count = FCI_NACK::kBitSize;
+    if ((uint16_t) (_max_seq - _last_max_seq) > nack_rtp_count) {
+        vector<bool> vec;
+        vec.resize(FCI_NACK::kBitSize, false);
+        for (auto i = 0; i < nack_rtp_count; ++i) {
+            vec[i] = !testSeq(_last_max_seq + i + 2);
+        }
+        doNack(FCI_NACK(_last_max_seq + 1, vec), true);
+        //跳过已经nack的seq
+        for (auto i = 0; i < nack_rtp_count + 1; ++i) {
+            if (clearSeq(++_last_max_seq)) {
+                --_seq_count;
             }
         }
     }
@@ -140,103 +229,138 @@ void NackContext::doNack(const FCI_NACK &nack, bool record_nack) {
 
 void NackContext::eraseFrontSeq() {
     //前面部分seq是连续的，未丢包，移除之
-    for (auto it = _seq.begin(); it != _seq.end();) {
-        if (*it != _last_max_seq + 1) {
-            //seq不连续，丢包了
-            break;
-        }
-        _last_max_seq = *it;
-        it = _seq.erase(it);
+    while (_seq_count && clearSeq(_last_max_seq + 1)) {
+        ++_last_max_seq;
+        --_seq_count;
     }
 }
 
 void NackContext::onRtx(uint16_t seq) {
-    auto it = _nack_send_status.find(seq);
-    if (it == _nack_send_status.end()) {
+    uint16_t pos = seq - _nack_begin_seq;
+    if (pos >= _nack_range) {
         return;
     }
-    auto rtt = getCurrentMillisecond() - it->second.update_stamp;
-    _nack_send_status.erase(it);
+    auto &ref = _nack_send_status[seq & (kNackMaxSize - 1)];
+    if (!ref.valid) {
+        return;
+    }
+    auto rtt = (uint32_t) getCurrentMillisecond() - ref.update_stamp;
+    ref.valid = false;
+    --_nack_count;
+    eraseFrontStatus();
+
+    //rtt不可能小于0
+    _rtt = rtt;
+    //InfoL << "rtt:" << rtt;
+}
 
-    if (rtt >= 0) {
-        //rtt不肯小于0
-        _rtt = rtt;
-        //InfoL << "rtt:" << rtt;
+void NackContext::eraseFrontStatus() {
+    //移除前面已经失效的状态，保证第一个位置总是有效的状态
+    while (_nack_range && !_nack_send_status[_nack_begin_seq & (kNackMaxSize - 1)].valid) {
+        ++_nack_begin_seq;
+        --_nack_range;
     }
 }
 
 void NackContext::recordNack(const FCI_NACK &nack) {
-    auto now = getCurrentMillisecond();
-    auto i = nack.getPid();
+    if (_nack_send_status.empty()) {
+        _nack_send_status.resize(kNackMaxSize);
+    }
+    auto now = (uint32_t) getCurrentMillisecond();
+    auto seq = nack.getPid();
     for (auto flag : nack.getBitArray()) {
         if (flag) {
-            auto &ref = _nack_send_status[i];
+            if (!_nack_range) {
+                _nack_begin_seq = seq;
+            }
+            uint16_t pos = seq - _nack_begin_seq;
+            if (pos > UINT16_MAX / 2) {
+                //早于最早的丢包状态，不应该发生
+                ++seq;
+                continue;
+            }
+            while (pos >= kNackMaxSize) {
+                //记录太多了，移除早期的记录
+                auto &front = _nack_send_status[_nack_begin_seq & (kNackMaxSize - 1)];
+                if (front.valid) {
+                    front.valid = false;
+                    --_nack_count;
+                }
+                ++_nack_begin_seq;
+                --_nack_range;
+                eraseFrontStatus();
+                if (!_nack_range) {
+                    _nack_begin_seq = seq;
+                }
+                pos = seq - _nack_begin_seq;
+            }
+            auto &ref = _nack_send_status[seq & (kNackMaxSize - 1)];
+            if (!ref.valid) {
+                ref.valid = true;
+                ++_nack_count;
+            }
             ref.first_stamp = now;
             ref.update_stamp = now;
             ref.nack_count = 1;
+            if (pos >= _nack_range) {
+                _nack_range = pos + 1;
+            }
         }
-        ++i;
-    }
-    //记录太多了，移除一部分早期的记录
-    while (_nack_send_status.size() > kNackMaxSize) {
-        _nack_send_status.erase(_nack_send_status.begin());
+        ++seq;
     }
 }
 
 uint64_t NackContext::reSendNack() {
-    set<uint16_t> nack_rtp;
-    auto now = getCurrentMillisecond();
-    for (auto it = _nack_send_status.begin(); it != _nack_send_status.end();) {
-        if (now - it->second.first_stamp > kNackMaxMS) {
+    auto now = (uint32_t) getCurrentMillisecond();
+    int pid = -1;
+    vector<bool> vec;
+    for (uint32_t i = 0; i < _nack_range && _nack_count; ++i) {
+        uint16_t seq = _nack_begin_seq + i;
+        auto &ref = _nack_send_status[seq & (kNackMaxSize - 1)];
+        if (!ref.valid) {
+            continue;
+        }
+        if (now - ref.first_stamp > kNackMaxMS) {
             //该rtp丢失太久了，不再要求重传
-            it = _nack_send_status.erase(it);
+            ref.valid = false;
+            --_nack_count;
             continue;
         }
-        if (now - it->second.update_stamp < kNackIntervalRatio * _rtt) {
+        if (now - ref.update_stamp < kNackIntervalRatio * _rtt) {
             //距离上次nack不足2倍的rtt，不用再发送nack
-            ++it;
             continue;
         }
-        //此rtp需要请求重传
-        nack_rtp.emplace(it->first);
         //更新nack发送时间戳
-        it->second.update_stamp = now;
-        if (++(it->second.nack_count) == kNackMaxCount) {
+        ref.update_stamp = now;
+        if (++ref.nack_count == kNackMaxCount) {
             //nack次数太多，移除之
-            it = _nack_send_status.erase(it);
-            continue;
+            ref.valid = false;
+            --_nack_count;
         }
-        ++it;
-    }
 
-    if (_nack_send_status.empty()) {
-        //不需要再发送nack
-        return 0;
-    }
-
-    int pid = -1;
-    vector<bool> vec;
-    for (auto it = nack_rtp.begin(); it != nack_rtp.end();) {
-        if (pid == -1) {
-            pid = *it;
-            vec.resize(FCI_NACK::kBitSize, false);
-            ++it;
-            continue;
-        }
-        auto inc = *it - pid;
-        if (inc > FCI_NACK::kBitSize) {
+        //此rtp需要请求重传，状态按seq顺序遍历，直接合并为nack包
+        if (pid != -1 && (uint16_t) (seq - pid) > FCI_NACK::kBitSize) {
             //新的nack包
             doNack(FCI_NACK(pid, vec), false);
             pid = -1;
+        }
+        if (pid == -1) {
+            pid = seq;
+            vec.assign(FCI_NACK::kBitSize, false);
             continue;
         }
         //这个包丢了
-        vec[inc - 1] = true;
-        ++it;
+        vec[(uint16_t) (seq - pid) - 1] = true;
     }
     if (pid != -1) {
         doNack(FCI_NACK(pid, vec), false);
     }
+    eraseFrontStatus();
+
+    if (!_nack_count) {
+        //不需要再发送nack
+        return 0;
+    }
 
     //重传间隔不得低于5ms
     return max(_rtt, 5);
@@ -16,8 +16,17 @@
 
 using namespace mediakit;
 
+/**
+ * 发送端缓存的rtp包，用于响应nack重传
+ * 以seq为下标的环形数组，seq连续递增时插入、查找、过期都是O(1)，缓存满时才扩容
+ */
 class NackList {
 public:
+    //环形数组初始大小，必须为2的幂
+    static constexpr auto kMinSize = 256;
+    //环形数组最大大小，必须为2的幂且不超过seq范围的一半
+    static constexpr auto kMaxSize = 32 * 1024;
+
     NackList() = default;
     ~NackList() = default;
 
@@ -26,20 +35,32 @@ public:
 
 private:
     void pop_front();
+    void clear();
+    bool grow();
     uint32_t get_cache_ms();
     RtpPacket::Ptr *get_rtp(uint16_t seq);
+    RtpPacket::Ptr &slot(uint16_t seq);
 
 private:
-    deque<uint16_t> _nack_cache_seq;
-    unordered_map<uint16_t, RtpPacket::Ptr> _nack_cache_pkt;
+    //第一个缓存的rtp的seq
+    uint16_t _begin_seq = 0;
+    //_begin_seq开始的seq个数(包括未缓存的空洞)
+    uint32_t _size = 0;
+    vector<RtpPacket::Ptr> _cache;
 };
 
+/**
+ * 接收端丢包检测与nack重传请求
+ * 已收到的seq与丢包状态均保存在以seq为下标的定长环形数组中，不按包分配内存
+ */
 class NackContext {
 public:
     using Ptr = std::shared_ptr<NackContext>;
     using onNack = function<void(const FCI_NACK &nack)>;
-    //最大保留的rtp丢包状态个数
+    //最大保留的rtp丢包状态个数，必须为2的幂
     static constexpr auto kNackMaxSize = 1024;
+    //乱序接收窗口，seq跳跃超过该值时认为流重置，必须为2的幂
+    static constexpr auto kSeqWindow = 4096;
     //rtp丢包状态最长保留时间
     static constexpr auto kNackMaxMS = 3 * 1000;
     //nack最多请求重传10次
@@ -59,19 +80,40 @@ private:
     void doNack(const FCI_NACK &nack, bool record_nack);
     void recordNack(const FCI_NACK &nack);
     void onRtx(uint16_t seq);
+    void reset();
+    bool testSeq(uint16_t seq) const;
+    void setSeq(uint16_t seq);
+    bool clearSeq(uint16_t seq);
+    void eraseFrontStatus();
 
 private:
     int _rtt = 50;
     onNack _cb;
-    set<uint16_t> _seq;
+    bool _started = false;
+    //该seq及之前的rtp已经处理完毕(收到或者已经nack)
     uint16_t _last_max_seq = 0;
+    //_last_max_seq之后收到的最大seq
+    uint16_t _max_seq = 0;
+    //_last_max_seq之后收到的rtp个数
+    uint32_t _seq_count = 0;
+    //_last_max_seq之后收到的seq位图
+    uint64_t _seq_bits[kSeqWindow / 64] = {0};
 
     struct NackStatus{
-        uint64_t first_stamp;
-        uint64_t update_stamp;
-        int nack_count = 0;
+        //时间戳只保存低32位，按无符号差值计算时长
+        uint32_t first_stamp;
+        uint32_t update_stamp;
+        uint16_t nack_count = 0;
+        bool valid = false;
     };
-    map<uint16_t/*seq*/, NackStatus > _nack_send_status;
+    //丢包状态，第一个丢包状态的seq
+    uint16_t _nack_begin_seq = 0;
+    //_nack_begin_seq开始的seq个数(包括已经移除的状态)
+    uint32_t _nack_range = 0;
+    //有效的丢包状态个数
+    uint32_t _nack_count = 0;
+    //第一次丢包时才分配
+    vector<NackStatus> _nack_send_status;
 };
 
 #endif //ZLMEDIAKIT_NACK_H
@@ -234,6 +234,7 @@ namespace RTC
 	bool SrtpSession::EncryptRtp(uint8_t* data, int* len)
 	{
 		MS_TRACE();
+		std::lock_guard<std::mutex> lck(_mtx);
 		srtp_err_status_t err =
 		  srtp_protect(this->session, static_cast<void*>(data), reinterpret_cast<int*>(len));
 
@@ -246,6 +247,35 @@ namespace RTC
 		return true;
 	}
 
+	size_t SrtpSession::EncryptRtp(uint8_t** datas, int* lens, size_t count)
+	{
+		MS_TRACE();
+		size_t ret = 0;
+		srtp_err_status_t last_err = srtp_err_status_ok;
+		{
+			std::lock_guard<std::mutex> lck(_mtx);
+			for (size_t i = 0; i < count; ++i)
+			{
+				srtp_err_status_t err = srtp_protect(this->session, static_cast<void*>(datas[i]), &lens[i]);
+				if (DepLibSRTP::IsError(err))
+				{
+					lens[i]  = 0;
+					last_err = err;
+					continue;
+				}
+				++ret;
+			}
+		}
+
+		if (ret != count)
+		{
+			//一批只打印一次日志
+			WarnL << "srtp_protect() failed:" << DepLibSRTP::GetErrorString(last_err) << ", count:" << count - ret;
+		}
+
+		return ret;
+	}
+
 	bool SrtpSession::DecryptSrtp(uint8_t* data, int* len)
 	{
 		MS_TRACE();
@@ -265,6 +295,7 @@ namespace RTC
 	bool SrtpSession::EncryptRtcp(uint8_t* data, int* len)
 	{
 		MS_TRACE();
+		std::lock_guard<std::mutex> lck(_mtx);
 		srtp_err_status_t err = srtp_protect_rtcp(
 		  this->session, static_cast<void*>(data), reinterpret_cast<int*>(len));
 
@@ -23,6 +23,7 @@ OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
 #include <srtp2/srtp.h>
 #include <vector>
 #include <memory>
+#include <mutex>
 
 namespace RTC
 {
@@ -65,6 +66,14 @@ namespace RTC
 
 	public:
 		bool EncryptRtp(uint8_t* data, int* len);
+		/**
+		 * 批量加密rtp，整批复用同一个srtp会话的cipher上下文，只加锁一次
+		 * @param datas 各rtp数据指针，每个缓存都需要预留SRTP_MAX_TRAILER_LEN字节
+		 * @param lens 各rtp长度，加密后为srtp长度，加密失败时置0
+		 * @param count rtp个数
+		 * @return 加密成功的个数
+		 */
+		size_t EncryptRtp(uint8_t** datas, int* lens, size_t count);
 		bool DecryptSrtp(uint8_t* data, int* len);
 		bool EncryptRtcp(uint8_t* data, int* len);
 		bool DecryptSrtcp(uint8_t* data, int* len);
@@ -76,6 +85,8 @@ namespace RTC
 	private:
 		// Allocated by this.
 		srtp_t session{ nullptr };
+		//加密可能在后台线程执行，libsrtp会话不是线程安全的
+		std::mutex _mtx;
         DepLibSRTP::Ptr _env;
 	};
 } // namespace RTC
@@ -14,12 +14,15 @@
 #include "Rtcp/Rtcp.h"
 #include "Rtcp/RtcpFCI.h"
 #include "Rtsp/RtpReceiver.h"
+#include "Thread/WorkThreadPool.h"
 
 #define RTX_SSRC_OFFSET 2
 #define RTP_CNAME "zlmediakit-rtp"
 #define RTP_LABEL "zlmediakit-label"
 #define RTP_MSLABEL "zlmediakit-mslabel"
 #define RTP_MSID RTP_MSLABEL " " RTP_LABEL
+//一次批量加密的最大rtp个数
+#define SRTP_MAX_BATCH 64
 
 //RTC配置项目
 namespace RTC {
@@ -30,11 +33,14 @@ const string kTimeOutSec = RTC_FIELD"timeoutSec";
 const string kExternIP = RTC_FIELD"externIP";
 //设置remb比特率，非0时关闭twcc并开启remb。该设置在rtc推流时有效，可以控制推流画质
 const string kRembBitRate = RTC_FIELD"rembBitRate";
+//是否在后台线程池中加密rtp，同一个peer固定使用同一个后台线程，不会乱序
+const string kSrtpThreadPool = RTC_FIELD"srtpThreadPool";
 
 static onceToken token([]() {
     mINI::Instance()[kTimeOutSec] = 15;
     mINI::Instance()[kExternIP] = "";
     mINI::Instance()[kRembBitRate] = 0;
+    mINI::Instance()[kSrtpThreadPool] = 0;
 });
 
 }//namespace RTC
@@ -98,6 +104,10 @@ void WebRtcTransport::OnDtlsTransportConnected(
     InfoL;
     _srtp_session_send = std::make_shared<RTC::SrtpSession>(RTC::SrtpSession::Type::OUTBOUND, srtpCryptoSuite, srtpLocalKey, srtpLocalKeyLen);
     _srtp_session_recv = std::make_shared<RTC::SrtpSession>(RTC::SrtpSession::Type::INBOUND, srtpCryptoSuite, srtpRemoteKey, srtpRemoteKeyLen);
+    GET_CONFIG(bool, srtp_thread_pool, RTC::kSrtpThreadPool);
+    if (srtp_thread_pool) {
+        _srtp_poller = WorkThreadPool::Instance().getPoller();
+    }
     onStartWebRTC();
 }
 
@@ -265,26 +275,139 @@ void WebRtcTransport::inputSockData(char *buf, int len, RTC::TransportTuple *tup
 }
 
 void WebRtcTransport::sendRtpPacket(const char *buf, int len, bool flush, void *ctx) {
-    if (_srtp_session_send) {
-        //预留rtx加入的两个字节
-        CHECK(len + SRTP_MAX_TRAILER_LEN + 2 <= sizeof(_srtp_buf));
-        memcpy(_srtp_buf, buf, len);
-        onBeforeEncryptRtp((char *) _srtp_buf, len, ctx);
-        if (_srtp_session_send->EncryptRtp(_srtp_buf, &len)) {
-            onSendSockData((char *) _srtp_buf, len, flush);
+    struct iovec iov;
+    iov.iov_base = (char *) buf;
+    iov.iov_len = len;
+    sendRtpPacket(&iov, 1, flush, ctx);
+}
+
+void WebRtcTransport::sendRtpPacket(const struct iovec *iov, size_t count, bool flush, void *ctx) {
+    if (!_srtp_session_send) {
+        return;
+    }
+    size_t size = 0;
+    for (size_t i = 0; i < count; ++i) {
+        size += iov[i].iov_len;
+    }
+    //直接聚集拷贝至发送缓存，预留rtx加入的两个字节与srtp尾部，加密后即可发送，不再拷贝
+    auto buf = BufferRaw::create();
+    buf->setCapacity(size + SRTP_MAX_TRAILER_LEN + 2);
+    int len = 0;
+    for (size_t i = 0; i < count; ++i) {
+        memcpy(buf->data() + len, iov[i].iov_base, iov[i].iov_len);
+        len += iov[i].iov_len;
+    }
+    onBeforeEncryptRtp(buf->data(), len, ctx);
+    buf->setSize(len);
+    _srtp_batch.emplace_back(std::move(buf));
+    if (flush || _srtp_batch.size() >= SRTP_MAX_BATCH) {
+        flushRtpBatch(flush);
+    }
+}
+
+static void encryptRtpBatch(RTC::SrtpSession &session, vector<BufferRaw::Ptr> &batch) {
+    uint8_t *datas[SRTP_MAX_BATCH];
+    int lens[SRTP_MAX_BATCH];
+    for (size_t i = 0; i < batch.size(); ++i) {
+        datas[i] = (uint8_t *) batch[i]->data();
+        lens[i] = (int) batch[i]->size();
+    }
+    session.EncryptRtp(datas, lens, batch.size());
+    for (size_t i = 0; i < batch.size(); ++i) {
+        //加密失败时长度为0，不发送
+        batch[i]->setSize(lens[i]);
+    }
+}
+
+void WebRtcTransport::flushRtpBatch(bool flush) {
+    if (_srtp_batch.empty()) {
+        return;
+    }
+    if (!_srtp_poller) {
+        encryptRtpBatch(*_srtp_session_send, _srtp_batch);
+        sendRtpBatch(_srtp_batch, flush);
+        _srtp_batch.clear();
+        return;
+    }
+
+    //在后台线程加密，完成后切回本线程发送；同一个peer的任务在同一个后台线程与本线程中都按顺序执行，不会乱序
+    auto batch = std::make_shared<vector<BufferRaw::Ptr> >();
+    batch->swap(_srtp_batch);
+    _srtp_batch.reserve(batch->size());
+    auto session = _srtp_session_send;
+    auto poller = _poller;
+    weak_ptr<bool> weak_alive = _srtp_alive;
+    _srtp_poller->async([this, batch, session, poller, weak_alive, flush]() {
+        encryptRtpBatch(*session, *batch);
+        poller->async([this, batch, weak_alive, flush]() {
+            if (!weak_alive.lock()) {
+                //本对象已经销毁
+                return;
+            }
+            sendRtpBatch(*batch, flush);
+        }, false);
+    }, false);
+}
+
+void WebRtcTransport::sendRtpBatch(vector<BufferRaw::Ptr> &batch, bool flush) {
+    auto tuple = _ice_server ? _ice_server->GetSelectedTuple() : nullptr;
+    if (!tuple) {
+        return;
+    }
+    //最后一个发送的rtp才flush socket
+    size_t last = batch.size();
+    while (last && !batch[last - 1]->size()) {
+        --last;
+    }
+    for (size_t i = 0; i < last; ++i) {
+        if (batch[i]->size()) {
+            onSendSockData(std::move(batch[i]), (struct sockaddr_in *) tuple, flush && i + 1 == last);
         }
     }
 }
 
 void WebRtcTransport::sendRtcpPacket(const char *buf, int len, bool flush, void *ctx){
-    if (_srtp_session_send) {
+    if (!_srtp_session_send) {
+        return;
+    }
+    //先发送缓存中的rtp，保持发送顺序
+    flushRtpBatch(false);
+    if (!_srtp_poller) {
         CHECK(len + SRTP_MAX_TRAILER_LEN <= sizeof(_srtp_buf));
         memcpy(_srtp_buf, buf, len);
         onBeforeEncryptRtcp((char *) _srtp_buf, len, ctx);
         if (_srtp_session_send->EncryptRtcp(_srtp_buf, &len)) {
             onSendSockData((char *) _srtp_buf, len, flush);
         }
+        return;
     }
+
+    //之前的rtp可能还在后台线程加密，rtcp也经后台线程加密后再切回本线程发送，否则rtcp可能先于之前的rtp发送
+    auto rtcp = BufferRaw::create();
+    rtcp->setCapacity(len + SRTP_MAX_TRAILER_LEN);
+    memcpy(rtcp->data(), buf, len);
+    onBeforeEncryptRtcp(rtcp->data(), len, ctx);
+    rtcp->setSize(len);
+    auto session = _srtp_session_send;
+    auto poller = _poller;
+    weak_ptr<bool> weak_alive = _srtp_alive;
+    _srtp_poller->async([this, rtcp, session, poller, weak_alive, flush]() {
+        int size = (int) rtcp->size();
+        if (!session->EncryptRtcp((uint8_t *) rtcp->data(), &size)) {
+            return;
+        }
+        rtcp->setSize(size);
+        poller->async([this, rtcp, weak_alive, flush]() {
+            if (!weak_alive.lock()) {
+                //本对象已经销毁
+                return;
+            }
+            auto tuple = _ice_server ? _ice_server->GetSelectedTuple() : nullptr;
+            if (tuple) {
+                onSendSockData(rtcp, (struct sockaddr_in *) tuple, flush);
+            }
+        }, false);
+    }, false);
 }
 
 ///////////////////////////////////////////////////////////////////////////////////
@@ -375,7 +498,11 @@ void WebRtcTransportImp::attach(const RtspMediaSource::Ptr &src, const MediaInfo
 void WebRtcTransportImp::onSendSockData(const char *buf, size_t len, struct sockaddr_in *dst, bool flush) {
     auto ptr = BufferRaw::create();
     ptr->assign(buf, len);
-    _socket->send(ptr, (struct sockaddr *)(dst), sizeof(struct sockaddr), flush);
+    onSendSockData(std::move(ptr), dst, flush);
+}
+
+void WebRtcTransportImp::onSendSockData(Buffer::Ptr buf, struct sockaddr_in *dst, bool flush) {
+    _socket->send(std::move(buf), (struct sockaddr *)(dst), sizeof(struct sockaddr), flush);
 }
 
 ///////////////////////////////////////////////////////////////////
@@ -897,7 +1024,12 @@ void WebRtcTransportImp::onSendRtp(const RtpPacket::Ptr &rtp, bool flush, bool r
         WarnL << "send rtx rtp:" << rtp->getSeq();
     }
     pair<bool/*rtx*/, MediaTrack *> ctx{rtx, track.get()};
-    sendRtpPacket(rtp->data() + RtpPacket::kRtpTcpHeaderSize, rtp->size() - RtpPacket::kRtpTcpHeaderSize, flush, &ctx);
+    //负载可能引用帧数据，聚集拷贝至加密缓存，跳过rtp over tcp头
+    struct iovec iov[Buffer::kMaxIovecCount];
+    auto count = rtp->getIovec(iov);
+    iov[0].iov_base = (char *) iov[0].iov_base + RtpPacket::kRtpTcpHeaderSize;
+    iov[0].iov_len -= RtpPacket::kRtpTcpHeaderSize;
+    sendRtpPacket(iov, count, flush, &ctx);
     _bytes_usage += rtp->size() - RtpPacket::kRtpTcpHeaderSize;
 }
 
@@ -66,6 +66,16 @@ public:
      * @param ctx 用户指针
      */
     void sendRtpPacket(const char *buf, int len, bool flush, void *ctx = nullptr);
+
+    /**
+     * 发送由多个内存片段组成的rtp，片段直接聚集拷贝至发送缓存
+     * rtp先加入待发送列表，flush时整批加密并发送
+     * @param iov rtp内存片段
+     * @param count 片段个数
+     * @param flush 是否flush socket
+     * @param ctx 用户指针
+     */
+    void sendRtpPacket(const struct iovec *iov, size_t count, bool flush, void *ctx = nullptr);
     void sendRtcpPacket(const char *buf, int len, bool flush, void *ctx = nullptr);
 
     const EventPoller::Ptr& getPoller() const;
@@ -99,6 +109,7 @@ protected:
     virtual void onRtcConfigure(RtcConfigure &configure) const;
     virtual void onCheckSdp(SdpType type, RtcSession &sdp);
     virtual void onSendSockData(const char *buf, size_t len, struct sockaddr_in *dst, bool flush = true) = 0;
+    virtual void onSendSockData(Buffer::Ptr buf, struct sockaddr_in *dst, bool flush = true) = 0;
 
     virtual void onRtp(const char *buf, size_t len) = 0;
     virtual void onRtcp(const char *buf, size_t len) = 0;
@@ -115,9 +126,17 @@ protected:
 private:
     void onSendSockData(const char *buf, size_t len, bool flush = true);
     void setRemoteDtlsFingerprint(const RtcSession &remote);
+    void flushRtpBatch(bool flush);
+    void sendRtpBatch(vector<BufferRaw::Ptr> &batch, bool flush);
 
 private:
     uint8_t _srtp_buf[2000];
+    //待批量加密发送的rtp
+    vector<BufferRaw::Ptr> _srtp_batch;
+    //后台加密线程，为空时在本线程加密
+    EventPoller::Ptr _srtp_poller;
+    //后台加密完成后切回本线程发送时，用于判断本对象是否已经销毁
+    std::shared_ptr<bool> _srtp_alive = std::make_shared<bool>(true);
     EventPoller::Ptr _poller;
     std::shared_ptr<RTC::IceServer> _ice_server;
     std::shared_ptr<RTC::DtlsTransport> _dtls_transport;
@@ -171,6 +190,7 @@ public:
 protected:
     void onStartWebRTC() override;
     void onSendSockData(const char *buf, size_t len, struct sockaddr_in *dst, bool flush = true) override;
+    void onSendSockData(Buffer::Ptr buf, struct sockaddr_in *dst, bool flush = true) override;
     void onCheckSdp(SdpType type, RtcSession &sdp) override;
     void onRtcConfigure(RtcConfigure &configure) const override;
 